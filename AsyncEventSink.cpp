@@ -0,0 +1,383 @@
+#include "AsyncEventSink.h"
+#include "QueryInterfaceTable.h"
+#include "CallProfiler.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+AsyncEventOptions defaultAsyncEventOptions() {
+    AsyncEventOptions options;
+    options.capacity = 1024;
+    options.overflow = AsyncEventOverflowBlock;
+    options.debounce = std::chrono::microseconds(0);
+    return options;
+}
+
+enum AsyncEventKind {
+    AsyncFileOk,
+    AsyncFolderChanging,
+    AsyncFolderChange,
+    AsyncSelectionChange,
+    AsyncShareViolation,
+    AsyncTypeChange,
+    AsyncOverwrite
+};
+
+// A caller waiting for its event's answer
+struct AsyncEventAnswer {
+    void* pResponse;  // FDE_SHAREVIOLATION_RESPONSE or FDE_OVERWRITE_RESPONSE, per kind
+    HRESULT hr;
+    bool done;
+};
+
+struct AsyncEvent {
+    AsyncEventKind kind;
+    IFileDialog* pfd;   // Referenced while queued
+    IShellItem* psi;    // Referenced while queued, or nullptr
+    std::chrono::steady_clock::time_point received;  // Of the first event merged into this one
+    std::chrono::steady_clock::time_point readyAt;   // End of the debounce
+    AsyncEventAnswer* pAnswer;                       // nullptr for notifications
+};
+
+// Queue and worker state; shared with the worker thread, which may outlive the sink when the
+// target drops the sink's last reference from inside a callback
+class AsyncEventQueueState {
+public:
+    AsyncEventQueueState(IFileDialogEvents* pTarget, const AsyncEventOptions& options)
+        : pTarget(pTarget), options(options), stopping(false), inFlight(false), flushers(0),
+          received(0), coalesced(0), dropped(0), delivered(0), totalLatency(0), maxLatency(0),
+          latencyBuckets(kLatencyBucketCount, 0) {
+        pTarget->AddRef();
+        this->options.capacity = std::max<size_t>(this->options.capacity, 1);
+    }
+
+    ~AsyncEventQueueState() {
+        pTarget->Release();
+    }
+
+    void setWorker(std::thread::id id) {
+        workerId = id;
+    }
+
+    HRESULT post(AsyncEventKind kind, IFileDialog* pfd, IShellItem* psi);
+    HRESULT ask(AsyncEventKind kind, IFileDialog* pfd, IShellItem* psi, void* pResponse);
+    HRESULT flush();
+    void getCounters(AsyncEventCounters& counters);
+
+    // Deliver what is left, then let the worker exit
+    void stop();
+
+    static void run(std::shared_ptr<AsyncEventQueueState> state);
+
+private:
+    bool onWorker() const {
+        return std::this_thread::get_id() == workerId;
+    }
+
+    HRESULT deliver(const AsyncEvent& event);
+    void forget(const AsyncEvent* pEvent);
+    void work();
+
+    IFileDialogEvents* pTarget;
+    AsyncEventOptions options;
+    std::thread::id workerId;
+
+    std::mutex mutex;
+    std::condition_variable wake;      // Worker: something queued, or stopping
+    std::condition_variable space;     // Blocked producers: the queue shrank
+    std::condition_variable answered;  // Callers waiting for an answer
+    std::condition_variable idle;      // Flush: queue empty and nothing in flight
+    std::deque<AsyncEvent> queue;
+    std::vector<AsyncEvent*> pendingNotifications;  // Queued notifications that can absorb the next one
+    bool stopping;
+    bool inFlight;
+    size_t flushers;
+
+    uint64_t received;
+    uint64_t coalesced;
+    uint64_t dropped;
+    uint64_t delivered;
+    uint64_t totalLatency;
+    uint64_t maxLatency;
+    std::vector<uint64_t> latencyBuckets;
+};
+
+HRESULT AsyncEventQueueState::post(AsyncEventKind kind, IFileDialog* pfd, IShellItem* psi) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    IShellItem* pReplaced = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        ++received;
+        for (;;) {
+            std::vector<AsyncEvent*>::iterator pending = std::find_if(pendingNotifications.begin(), pendingNotifications.end(),
+                [&](const AsyncEvent* pEvent) { return pEvent->kind == kind && pEvent->pfd == pfd; });
+            if (pending != pendingNotifications.end()) {
+                AsyncEvent& event = **pending;
+                if (psi != event.psi) {
+                    if (psi) {
+                        psi->AddRef();
+                    }
+                    pReplaced = event.psi;
+                    event.psi = psi;
+                }
+                event.readyAt = now + options.debounce;
+                ++coalesced;
+                break;
+            }
+            // The worker never waits on itself: a target raising events from a callback queues past capacity
+            if (queue.size() >= options.capacity && !onWorker() && !stopping) {
+                if (options.overflow == AsyncEventOverflowDropNewest) {
+                    ++dropped;
+                    break;
+                }
+                space.wait(lock);
+                continue;  // A pending one may have appeared meanwhile
+            }
+            pfd->AddRef();
+            if (psi) {
+                psi->AddRef();
+            }
+            queue.push_back({ kind, pfd, psi, now, now + options.debounce, nullptr });
+            pendingNotifications.push_back(&queue.back());
+            wake.notify_one();
+            break;
+        }
+    }
+    if (pReplaced) {
+        pReplaced->Release();
+    }
+    return S_OK;
+}
+
+HRESULT AsyncEventQueueState::ask(AsyncEventKind kind, IFileDialog* pfd, IShellItem* psi, void* pResponse) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    AsyncEventAnswer answer = { pResponse, S_OK, false };
+    AsyncEvent event = { kind, pfd, psi, now, now, &answer };
+    if (onWorker()) {
+        // The target asking from inside a callback; whatever is queued stays behind
+        std::unique_lock<std::mutex> lock(mutex);
+        ++received;
+        ++delivered;
+        lock.unlock();
+        return deliver(event);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    ++received;
+    pfd->AddRef();
+    if (psi) {
+        psi->AddRef();
+    }
+    queue.push_back(event);
+    wake.notify_one();
+    answered.wait(lock, [&]() { return answer.done; });
+    return answer.hr;
+}
+
+HRESULT AsyncEventQueueState::flush() {
+    if (onWorker()) {
+        return E_FAIL;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    ++flushers;
+    wake.notify_one();
+    idle.wait(lock, [&]() { return queue.empty() && !inFlight; });
+    --flushers;
+    return S_OK;
+}
+
+void AsyncEventQueueState::getCounters(AsyncEventCounters& counters) {
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.received = received;
+    counters.coalesced = coalesced;
+    counters.dropped = dropped;
+    counters.delivered = delivered;
+    counters.meanLatencyNanoseconds = delivered ? totalLatency / delivered : 0;
+    counters.p50LatencyNanoseconds = latencyPercentile(latencyBuckets.data(), 0.50, maxLatency);
+    counters.p99LatencyNanoseconds = latencyPercentile(latencyBuckets.data(), 0.99, maxLatency);
+    counters.maxLatencyNanoseconds = maxLatency;
+}
+
+void AsyncEventQueueState::stop() {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    wake.notify_one();
+    space.notify_all();
+}
+
+void AsyncEventQueueState::run(std::shared_ptr<AsyncEventQueueState> state) {
+    state->work();
+}
+
+HRESULT AsyncEventQueueState::deliver(const AsyncEvent& event) {
+    switch (event.kind) {
+    case AsyncFileOk:
+        return pTarget->OnFileOk(event.pfd);
+    case AsyncFolderChanging:
+        return pTarget->OnFolderChanging(event.pfd, event.psi);
+    case AsyncFolderChange:
+        return pTarget->OnFolderChange(event.pfd);
+    case AsyncSelectionChange:
+        return pTarget->OnSelectionChange(event.pfd);
+    case AsyncShareViolation:
+        return pTarget->OnShareViolation(event.pfd, event.psi, static_cast<FDE_SHAREVIOLATION_RESPONSE*>(event.pAnswer->pResponse));
+    case AsyncTypeChange:
+        return pTarget->OnTypeChange(event.pfd);
+    case AsyncOverwrite:
+        return pTarget->OnOverwrite(event.pfd, event.psi, static_cast<FDE_OVERWRITE_RESPONSE*>(event.pAnswer->pResponse));
+    }
+    return E_FAIL;
+}
+
+void AsyncEventQueueState::forget(const AsyncEvent* pEvent) {
+    std::vector<AsyncEvent*>::iterator pending = std::find(pendingNotifications.begin(), pendingNotifications.end(), pEvent);
+    if (pending != pendingNotifications.end()) {
+        *pending = pendingNotifications.back();
+        pendingNotifications.pop_back();
+    }
+}
+
+void AsyncEventQueueState::work() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        if (queue.empty()) {
+            idle.notify_all();
+            if (stopping) {
+                return;
+            }
+            wake.wait(lock);
+            continue;
+        }
+        // Debouncing holds back the head of the queue, and with it everything behind it
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (queue.front().readyAt > now && !stopping && !flushers) {
+            wake.wait_until(lock, queue.front().readyAt);
+            continue;
+        }
+        AsyncEvent event = queue.front();
+        forget(&queue.front());
+        queue.pop_front();
+        inFlight = true;
+        space.notify_one();
+        lock.unlock();
+
+        uint64_t latency = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - event.received).count());
+        HRESULT hr = deliver(event);
+        event.pfd->Release();
+        if (event.psi) {
+            event.psi->Release();
+        }
+
+        lock.lock();
+        inFlight = false;
+        ++delivered;
+        totalLatency += latency;
+        maxLatency = std::max(maxLatency, latency);
+        ++latencyBuckets[latencyBucket(latency)];
+        if (event.pAnswer) {
+            event.pAnswer->hr = hr;
+            event.pAnswer->done = true;
+            answered.notify_all();
+        }
+    }
+}
+
+class AsyncEventSink : public IFileDialogEvents, public IAsyncEventQueue {
+public:
+    AsyncEventSink(IFileDialogEvents* pTarget, const AsyncEventOptions& options)
+        : refCount(1), state(std::make_shared<AsyncEventQueueState>(pTarget, options)) {
+        worker = std::thread(AsyncEventQueueState::run, state);
+        state->setWorker(worker.get_id());
+    }
+
+    // IUnknown methods
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppv) {
+        return QueryInterfaceTable<AsyncEventSink, IFileDialogEvents, IAsyncEventQueue>::query(this, riid, ppv);
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() {
+        return InterlockedIncrement(&refCount);
+    }
+
+    ULONG STDMETHODCALLTYPE Release() {
+        ULONG count = InterlockedDecrement(&refCount);
+        if (count == 0) {
+            delete this;
+        }
+        return count;
+    }
+
+    // IFileDialogEvents methods
+    HRESULT STDMETHODCALLTYPE OnFileOk(IFileDialog *pfd) {
+        return state->ask(AsyncFileOk, pfd, nullptr, nullptr);
+    }
+
+    HRESULT STDMETHODCALLTYPE OnFolderChanging(IFileDialog *pfd, IShellItem *psiFolder) {
+        return state->post(AsyncFolderChanging, pfd, psiFolder);
+    }
+
+    HRESULT STDMETHODCALLTYPE OnFolderChange(IFileDialog *pfd) {
+        return state->post(AsyncFolderChange, pfd, nullptr);
+    }
+
+    HRESULT STDMETHODCALLTYPE OnSelectionChange(IFileDialog *pfd) {
+        return state->post(AsyncSelectionChange, pfd, nullptr);
+    }
+
+    HRESULT STDMETHODCALLTYPE OnShareViolation(IFileDialog *pfd, IShellItem *psi, FDE_SHAREVIOLATION_RESPONSE *pResponse) {
+        return state->ask(AsyncShareViolation, pfd, psi, pResponse);
+    }
+
+    HRESULT STDMETHODCALLTYPE OnTypeChange(IFileDialog *pfd) {
+        return state->post(AsyncTypeChange, pfd, nullptr);
+    }
+
+    HRESULT STDMETHODCALLTYPE OnOverwrite(IFileDialog *pfd, IShellItem *psi, FDE_OVERWRITE_RESPONSE *pResponse) {
+        return state->ask(AsyncOverwrite, pfd, psi, pResponse);
+    }
+
+    // IAsyncEventQueue methods
+    HRESULT STDMETHODCALLTYPE GetCounters(AsyncEventCounters *pCounters) {
+        if (!pCounters) {
+            return E_POINTER;
+        }
+        state->getCounters(*pCounters);
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE Flush() {
+        return state->flush();
+    }
+
+protected:
+    virtual ~AsyncEventSink() {
+        state->stop();
+        // Released from inside a callback: the worker finishes the queue on its own
+        if (worker.get_id() == std::this_thread::get_id()) {
+            worker.detach();
+        } else {
+            worker.join();
+        }
+    }
+
+private:
+    LONG refCount;
+    std::shared_ptr<AsyncEventQueueState> state;
+    std::thread worker;
+};
+
+HRESULT createAsyncEventSink(IFileDialogEvents* pTarget, const AsyncEventOptions& options, IFileDialogEvents** ppSink) {
+    if (!ppSink) {
+        return E_POINTER;
+    }
+    *ppSink = nullptr;
+    if (!pTarget) {
+        return E_INVALIDARG;
+    }
+    *ppSink = static_cast<IFileDialogEvents*>(new AsyncEventSink(pTarget, options));
+    return S_OK;
+}
@@ -0,0 +1,53 @@
+#ifndef ASYNC_EVENT_SINK_H
+#define ASYNC_EVENT_SINK_H
+
+#include <chrono>
+#include <cstdint>
+#include "IFileDialog.h"
+
+// What a full queue does to the thread raising a notification
+enum AsyncEventOverflow {
+    AsyncEventOverflowBlock,       // Wait until the worker makes room
+    AsyncEventOverflowDropNewest   // Drop the new notification and count it
+};
+
+struct AsyncEventOptions {
+    size_t capacity;                      // Pending notifications before the overflow policy applies
+    AsyncEventOverflow overflow;
+    std::chrono::microseconds debounce;   // Quiet time a coalesced notification waits for before delivery
+};
+
+// Capacity 1024, blocking, no debounce
+AsyncEventOptions defaultAsyncEventOptions();
+
+struct AsyncEventCounters {
+    uint64_t received;
+    uint64_t coalesced;   // Merged into a notification already pending
+    uint64_t dropped;     // Refused by AsyncEventOverflowDropNewest
+    uint64_t delivered;
+    uint64_t meanLatencyNanoseconds;  // From the first merged event to the start of delivery
+    uint64_t p50LatencyNanoseconds;
+    uint64_t p99LatencyNanoseconds;
+    uint64_t maxLatencyNanoseconds;
+};
+
+// Counters and draining for a sink made by createAsyncEventSink
+#define DEFINE_IAsyncEventQueue_METHODS \
+    virtual HRESULT STDMETHODCALLTYPE GetCounters(AsyncEventCounters *pCounters) = 0; \
+    virtual HRESULT STDMETHODCALLTYPE Flush() = 0;
+
+interface IAsyncEventQueue;  // Forward declaration of the interface
+static constexpr IID IID_IAsyncEventQueue = guidFromString("5A1E8C37-2D94-4B6F-930E-7C4BA218D56F");
+COM_INTERFACE_ID(IAsyncEventQueue, IID_IAsyncEventQueue)
+typedef interface IAsyncEventQueue IAsyncEventQueue;
+DEFINE_INTERFACE(IAsyncEventQueue, IUnknown, DEFINE_IAsyncEventQueue_METHODS)
+
+// An IFileDialogEvents to Advise in place of pTarget, delivering to it from a worker thread.
+// OnSelectionChange, OnFolderChange, OnFolderChanging and OnTypeChange are queued and return S_OK
+// at once; one still pending for the same dialog absorbs the next (which keeps its place in the
+// queue, with the latest folder for OnFolderChanging), so a burst reaches pTarget as one call.
+// OnFileOk, OnOverwrite and OnShareViolation need pTarget's answer: the caller waits while they are
+// delivered in order behind what is pending. Final Release delivers what is left, then stops.
+HRESULT createAsyncEventSink(IFileDialogEvents* pTarget, const AsyncEventOptions& options, IFileDialogEvents** ppSink);
+
+#endif // ASYNC_EVENT_SINK_H
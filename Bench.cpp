@@ -0,0 +1,2179 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cwctype>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include "Bench.h"
+#include "IFileDialog.h"
+#include "ShellItemExtractor.h"
+#include "SyntheticShellItems.h"
+#include "PathTable.h"
+#include "PosixShellItem.h"
+#include "DirectoryEnumerator.h"
+#include "FolderPrefetch.h"
+#include "StandInFileDialog.h"
+#include "ProjUtil.h"
+#include "FilterMatcher.h"
+#include "RecentItems.h"
+#include "ShellItemArray.h"
+#include "SnapshotShellItemArray.h"
+#include "CollationKey.h"
+#include "EventSinkRegistry.h"
+#include "AsyncEventSink.h"
+#include "Trace.h"
+#include "ResultSink.h"
+#include "SessionPool.h"
+#include "ComPtr.h"
+#include "QueryInterfaceTable.h"
+#include "SlabAllocator.h"
+#include "PathTrie.h"
+#include "ShellItemDisplayNames.h"
+#include "ScenarioRunner.h"
+#include "DialogOptions.h"
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#ifndef _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+typedef int (*BenchFunction)(const std::vector<std::string>& args);
+
+struct BenchEntry {
+    const char* name;
+    const char* usage;
+    BenchFunction run;
+};
+
+void printBenchResult(const std::string& name, size_t items, double seconds) {
+    double rate = (seconds > 0.0) ? items / seconds : 0.0;
+    std::cout << std::left << std::setw(40) << name
+              << " items=" << items
+              << " time=" << std::fixed << std::setprecision(3) << seconds << "s"
+              << " rate=" << std::setprecision(0) << rate << "/s" << std::endl;
+}
+
+void printBenchPeakBytes(size_t bytes, size_t items) {
+    if (!benchCountsAllocations()) {
+        std::cout << std::left << std::setw(40) << "" << " peak=n/a (counted by CIFileDialogBench)" << std::endl;
+        return;
+    }
+    double perItem = items ? static_cast<double>(bytes) / items : 0.0;
+    std::cout << std::left << std::setw(40) << "" << " peak=" << std::fixed << std::setprecision(1)
+              << bytes / (1024.0 * 1024.0) << "MiB (" << std::setprecision(1) << perItem << " bytes per item)" << std::endl;
+}
+
+void printBenchAllocations(size_t allocations, size_t items) {
+    if (!benchCountsAllocations()) {
+        std::cout << std::left << std::setw(40) << "" << " allocations=n/a (counted by CIFileDialogBench)" << std::endl;
+        return;
+    }
+    double perItem = items ? static_cast<double>(allocations) / items : 0.0;
+    std::cout << std::left << std::setw(40) << "" << " allocations=" << allocations
+              << " (" << std::fixed << std::setprecision(2) << perItem << " per item)" << std::endl;
+}
+
+// Heap bytes per item as "12.5B", or "n/a" where allocations are not counted
+static std::string benchBytesPerItem(size_t bytes, size_t items) {
+    if (!benchCountsAllocations()) {
+        return "n/a";
+    }
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(1) << (items ? static_cast<double>(bytes) / items : 0.0) << "B";
+    return text.str();
+}
+
+// Numeric positional argument, or defaultValue when absent or malformed
+static size_t benchArg(const std::vector<std::string>& args, size_t index, size_t defaultValue) {
+    if (index >= args.size()) {
+        return defaultValue;
+    }
+    try {
+        return static_cast<size_t>(std::stoull(args[index]));
+    } catch (const std::exception&) {
+        return defaultValue;
+    }
+}
+
+// Single-pass batched extraction over a synthetic selection, at several Next() batch sizes
+static int benchExtract(const std::vector<std::string>& args) {
+    DWORD itemCount = static_cast<DWORD>(benchArg(args, 1, 1000000));
+    COMFunctionPointers comFuncs = LoadCOMFunctionPointers();
+    IShellItemArray* pArray = createSyntheticShellItemArray(itemCount);
+
+    const ULONG batchSizes[] = { 1, 16, kShellItemBatchSize };
+    for (ULONG batchSize : batchSizes) {
+        std::vector<ShellItemRecord> records;
+        BenchTimer timer;
+        HRESULT hr = extractShellItemRecords(comFuncs, pArray, records, batchSize);
+        double seconds = timer.seconds();
+        if (FAILED(hr) || records.size() != itemCount) {
+            std::cerr << "extract: expected " << itemCount << " records, got " << records.size() << std::endl;
+            pArray->Release();
+            return 1;
+        }
+        printBenchResult("extract batch=" + std::to_string(batchSize), records.size(), seconds);
+    }
+
+    pArray->Release();
+    FreeCOMFunctionPointers(comFuncs);
+    return 0;
+}
+
+// Vector-of-wstring vs PathTable result collection, including teardown of the result
+static int benchPathTable(const std::vector<std::string>& args) {
+    DWORD itemCount = static_cast<DWORD>(benchArg(args, 1, 1000000));
+    COMFunctionPointers comFuncs = LoadCOMFunctionPointers();
+    IShellItemArray* pArray = createSyntheticShellItemArray(itemCount);
+
+    // Allocations made by the synthetic items themselves, common to both runs
+    size_t allocations = benchAllocationCount();
+    for (DWORD i = 0; i < itemCount; ++i) {
+        IShellItem* pItem = nullptr;
+        pArray->GetItemAt(i, &pItem);
+        pItem->Release();
+    }
+    size_t sourceAllocations = benchAllocationCount() - allocations;
+
+    size_t pathCount = 0;
+    allocations = benchAllocationCount();
+    BenchTimer timer;
+    {
+        std::vector<std::wstring> paths = getFilePathsFromShellItemArray(pArray, comFuncs);
+        pathCount = paths.size();
+    }
+    double seconds = timer.seconds();
+    printBenchResult("paths vector<wstring>", pathCount, seconds);
+    printBenchAllocations(benchAllocationCount() - allocations - sourceAllocations, pathCount);
+
+    allocations = benchAllocationCount();
+    timer.reset();
+    {
+        PathTable paths;
+        getFilePathsFromShellItemArray(pArray, comFuncs, paths);
+        pathCount = paths.size();
+    }
+    seconds = timer.seconds();
+    printBenchResult("paths PathTable", pathCount, seconds);
+    printBenchAllocations(benchAllocationCount() - allocations - sourceAllocations, pathCount);
+
+    pArray->Release();
+    FreeCOMFunctionPointers(comFuncs);
+    return pathCount == itemCount ? 0 : 1;
+}
+
+// Runs every filter of a set over a name listing, compiled vs. one globMatch per pattern
+static int benchFilterSet(const std::string& label, const std::vector<COMDLG_FILTERSPEC>& filters, const std::vector<std::wstring_view>& names) {
+    BenchTimer timer;
+    FilterMatcher matcher(filters.data(), static_cast<UINT>(filters.size()));
+    double compileSeconds = timer.seconds();
+
+    std::vector<uint8_t> selected;
+    size_t compiledMatches = 0;
+    timer.reset();
+    for (size_t filter = 0; filter < filters.size(); ++filter) {
+        matcher.matchListing(filter, names.data(), names.size(), selected);
+        for (uint8_t hit : selected) {
+            compiledMatches += hit;
+        }
+    }
+    double seconds = timer.seconds();
+    printBenchResult("filters " + label + " compiled", names.size() * filters.size(), seconds + compileSeconds);
+
+    std::vector<int> firstMatches;
+    timer.reset();
+    matcher.classifyListing(names.data(), names.size(), firstMatches);
+    printBenchResult("filters " + label + " classify", names.size(), timer.seconds());
+
+    std::vector<std::vector<std::wstring>> patterns(filters.size());
+    for (size_t filter = 0; filter < filters.size(); ++filter) {
+        std::wstring_view spec = filters[filter].pszSpec;
+        while (!spec.empty()) {
+            size_t separator = spec.find(L';');
+            patterns[filter].emplace_back(spec.substr(0, separator));
+            spec = (separator == std::wstring_view::npos) ? std::wstring_view() : spec.substr(separator + 1);
+        }
+    }
+    size_t naiveMatches = 0;
+    timer.reset();
+    for (size_t filter = 0; filter < filters.size(); ++filter) {
+        for (std::wstring_view name : names) {
+            for (const std::wstring& pattern : patterns[filter]) {
+                // Dialog semantics on top of the plain glob: "*.*" is everything, "*." is no extension
+                bool hit = (pattern == L"*.*") ||
+                           (pattern == L"*." ? name.find(L'.') == std::wstring_view::npos || name.back() == L'.'
+                                             : FilterMatcher::globMatch(pattern, name));
+                if (hit) {
+                    ++naiveMatches;
+                    break;
+                }
+            }
+        }
+    }
+    printBenchResult("filters " + label + " naive glob", names.size() * filters.size(), timer.seconds());
+
+    if (compiledMatches != naiveMatches) {
+        std::cerr << "filters: compiled matcher found " << compiledMatches << " matches, naive " << naiveMatches << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// File-type filtering of a large listing against the filter sets the randomizer builds
+static int benchFilters(const std::vector<std::string>& args) {
+    size_t nameCount = benchArg(args, 1, 1000000);
+    const wchar_t* extensions[] = { L".1", L".7", L".13", L".25", L".26", L".txt", L".TXT", L".Md", L".png",
+                                    L".jpeg", L".tar.gz", L".log.3", L"", L".", L".\u00DCn\u00EF", L".markdown" };
+    const size_t extensionTotal = sizeof(extensions) / sizeof(extensions[0]);
+
+    PathTable table;
+    table.reserve(nameCount, nameCount * 20);
+    uint64_t state = 0x2545F4914F6CDD1Dull;
+    for (size_t i = 0; i < nameCount; ++i) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        const wchar_t* prefix = (state & 0x100) ? L"log_" : L"file";
+        std::wstring name = prefix + std::to_wstring(i) + extensions[state % extensionTotal];
+        table.append(name);
+    }
+    std::vector<std::wstring_view> names(nameCount);
+    for (size_t i = 0; i < nameCount; ++i) {
+        names[i] = table[i];
+    }
+
+    // Same shape as the "Randomize all options" menu: All Files plus 25 single-extension filters
+    std::vector<std::wstring> filterNames;
+    std::vector<std::wstring> filterSpecs;
+    for (int i = 1; i <= 25; ++i) {
+        filterNames.push_back(L"Random Filter " + std::to_wstring(i));
+        filterSpecs.push_back(L"*." + std::to_wstring(i));
+    }
+    std::vector<COMDLG_FILTERSPEC> randomizer = { { L"All Files", L"*.*" } };
+    for (size_t i = 0; i < filterNames.size(); ++i) {
+        randomizer.push_back({ filterNames[i].c_str(), filterSpecs[i].c_str() });
+    }
+
+    std::vector<COMDLG_FILTERSPEC> globs = {
+        { L"Text", L"*.txt;*.md;*.markdown" },
+        { L"Images", L"*.png;*.jp?g;*.jpeg" },
+        { L"Logs", L"log_*.txt;*.log.?;log_1*" },
+        { L"Archives", L"*.tar.gz;*.zip" },
+        { L"No extension", L"*." },
+        { L"Unicode", L"*.\u00FCn\u00EF" },
+    };
+
+    int status = benchFilterSet("randomizer", randomizer, names);
+    status |= benchFilterSet("globs", globs, names);
+    return status;
+}
+
+static void writeRecentItemsFile(const std::string& fileName, size_t entries) {
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    file << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<xbel version=\"1.0\">\n";
+    for (size_t i = 0; i < entries; ++i) {
+        char visited[32];
+        std::snprintf(visited, sizeof(visited), "2024-01-01T00:%02zu:%02zu.%06zuZ", (i / 60) % 60, i % 60, i % 1000000);
+        file << "  <bookmark href=\"file:///home/user/Projects/proj" << (i % 97) << "/src/File%20" << i << ".cpp\""
+             << " added=\"" << visited << "\" modified=\"" << visited << "\" visited=\"" << visited << "\">\n"
+             << "    <info><metadata owner=\"http://freedesktop.org\"><mime:mime-type type=\"text/x-c++src\"/></metadata></info>\n"
+             << "  </bookmark>\n";
+    }
+    file << "</xbel>\n";
+}
+
+// Recent-items index over a generated recently-used.xbel: load, no-op refresh, prefix and
+// substring queries, against a case-folding linear scan of the path list
+static int benchRecent(const std::vector<std::string>& args) {
+    size_t entries = benchArg(args, 1, 10000);
+    size_t queries = benchArg(args, 2, 100000);
+    std::string fileName = (std::filesystem::temp_directory_path() / "CIFileDialogTester-recent.xbel").string();
+    writeRecentItemsFile(fileName, entries);
+
+    RecentItemsIndex index(createXbelRecentItemsBackend(fileName));
+    BenchTimer timer;
+    index.refresh();
+    printBenchResult("recent load", index.size(), timer.seconds());
+    if (index.size() != entries) {
+        std::cerr << "recent: expected " << entries << " entries, loaded " << index.size() << std::endl;
+        std::filesystem::remove(fileName);
+        return 1;
+    }
+
+    const size_t refreshes = 10000;
+    timer.reset();
+    for (size_t i = 0; i < refreshes; ++i) {
+        index.refresh();
+    }
+    printBenchResult("recent refresh unchanged", refreshes, timer.seconds());
+
+    std::vector<std::wstring> prefixes;
+    std::vector<std::wstring> fragments;
+    for (size_t i = 0; i < 256; ++i) {
+        prefixes.push_back(L"/HOME/user/projects/proj" + std::to_wstring(i % 97) + L"/src/file " + std::to_wstring(i % 10));
+        fragments.push_back(L"FILE " + std::to_wstring(i * 37 % (entries + 1)));
+    }
+
+    std::vector<size_t> hits;
+    size_t prefixHits = 0;
+    timer.reset();
+    for (size_t i = 0; i < queries; ++i) {
+        index.prefixSearch(prefixes[i % prefixes.size()], hits, 20);
+        prefixHits += hits.size();
+    }
+    printBenchResult("recent prefix search", queries, timer.seconds());
+
+    size_t substringHits = 0;
+    size_t substringQueries = std::max<size_t>(1, queries / 10);
+    timer.reset();
+    for (size_t i = 0; i < substringQueries; ++i) {
+        index.substringSearch(fragments[i % fragments.size()], hits, 20);
+        substringHits += hits.size();
+    }
+    printBenchResult("recent substring search", substringQueries, timer.seconds());
+
+    // What a caller of the plain path list does per query
+    size_t naiveQueries = std::max<size_t>(1, queries / 100);
+    size_t naiveHits = 0;
+    timer.reset();
+    for (size_t i = 0; i < naiveQueries; ++i) {
+        std::wstring key = prefixes[i % prefixes.size()];
+        std::transform(key.begin(), key.end(), key.begin(), [](wchar_t ch) { return static_cast<wchar_t>(std::towlower(ch)); });
+        size_t found = 0;
+        for (const std::wstring& path : index.allPaths()) {
+            std::wstring folded = path;
+            std::transform(folded.begin(), folded.end(), folded.begin(), [](wchar_t ch) { return static_cast<wchar_t>(std::towlower(ch)); });
+            if (folded.compare(0, key.size(), key) == 0 && found < 20) {
+                ++found;
+            }
+        }
+        naiveHits += found;
+    }
+    printBenchResult("recent prefix linear scan", naiveQueries, timer.seconds());
+
+    // One more entry: the stamp moves and the next refresh reloads
+    writeRecentItemsFile(fileName, entries + 1);
+    timer.reset();
+    bool changed = index.refresh();
+    printBenchResult("recent refresh after change", index.size(), timer.seconds());
+    std::cout << std::left << std::setw(40) << "" << " added=" << index.lastAdded() << " removed=" << index.lastRemoved()
+              << " prefix hits=" << prefixHits << " substring hits=" << substringHits << std::endl;
+
+    std::filesystem::remove(fileName);
+    return (changed && index.size() == entries + 1 && naiveHits > 0) ? 0 : 1;
+}
+
+// Ordering a shuffled selection: std::sort calling IShellItem::Compare, the GetDisplayName + wcscmp
+// comparison Compare used to make, and sortShellItemArray over precomputed keys
+static int benchSort(const std::vector<std::string>& args) {
+    DWORD itemCount = static_cast<DWORD>(benchArg(args, 1, 1000000));
+    COMFunctionPointers comFuncs = LoadCOMFunctionPointers();
+    IShellItemArray* pSource = createSyntheticShellItemArray(itemCount);
+    std::vector<IShellItem*> items(itemCount);
+    for (DWORD i = 0; i < itemCount; ++i) {
+        pSource->GetItemAt(i, &items[i]);
+    }
+    pSource->Release();
+    std::shuffle(items.begin(), items.end(), std::mt19937_64(42));
+
+    std::vector<IShellItem*> sorted = items;
+    BenchTimer timer;
+    std::sort(sorted.begin(), sorted.end(), [](IShellItem* a, IShellItem* b) {
+        int order = 0;
+        a->Compare(b, SICHINT_CANONICAL, &order);
+        return order < 0;
+    });
+    printBenchResult("sort Compare()", itemCount, timer.seconds());
+    std::vector<std::wstring> expected;
+    for (IShellItem* pItem : sorted) {
+        LPWSTR pszFilePath = nullptr;
+        pItem->GetDisplayName(SIGDN_FILESYSPATH, &pszFilePath);
+        expected.push_back(pszFilePath);
+        comFuncs.pCoTaskMemFree(pszFilePath);
+    }
+
+    sorted = items;
+    timer.reset();
+    std::sort(sorted.begin(), sorted.end(), [&comFuncs](IShellItem* a, IShellItem* b) {
+        LPWSTR pszA = nullptr;
+        LPWSTR pszB = nullptr;
+        a->GetDisplayName(SIGDN_FILESYSPATH, &pszA);
+        b->GetDisplayName(SIGDN_FILESYSPATH, &pszB);
+        bool less = std::wcscmp(pszA, pszB) < 0;
+        comFuncs.pCoTaskMemFree(pszA);
+        comFuncs.pCoTaskMemFree(pszB);
+        return less;
+    });
+    printBenchResult("sort GetDisplayName+wcscmp", itemCount, timer.seconds());
+
+    IShellItemArray* pArray = nullptr;
+    createShellItemArray(items, &pArray);
+    int status = 0;
+    unsigned cores = static_cast<unsigned>(benchArg(args, 2, std::max(1u, std::thread::hardware_concurrency())));
+    std::vector<unsigned> threadCounts = { 1 };
+    if (cores > 1) {
+        threadCounts.push_back(cores);
+    }
+    for (unsigned threads : threadCounts) {
+        IShellItemArray* pSorted = nullptr;
+        timer.reset();
+        HRESULT hr = sortShellItemArray(pArray, SICHINT_CANONICAL, &pSorted, threads);
+        printBenchResult("sort keys threads=" + std::to_string(threads), itemCount, timer.seconds());
+        if (FAILED(hr) || getFilePathsFromShellItemArray(pSorted, comFuncs) != expected) {
+            std::cerr << "sort: key order differs from Compare() order" << std::endl;
+            status = 1;
+        }
+        if (pSorted) {
+            pSorted->Release();
+        }
+    }
+
+    pArray->Release();
+    FreeCOMFunctionPointers(comFuncs);
+    return status;
+}
+
+// Items a UI would create for the first screen of a selection
+static const DWORD kLazyArrayPageSize = 64;
+
+// Count plus one page of items, as a dialog or confirmation prompt would read a selection
+static bool readSelectionPage(IShellItemArray* pArray, DWORD expected) {
+    DWORD count = 0;
+    pArray->GetCount(&count);
+    for (DWORD i = 0; i < count && i < kLazyArrayPageSize; ++i) {
+        IShellItem* pItem = nullptr;
+        if (FAILED(pArray->GetItemAt(i, &pItem))) {
+            return false;
+        }
+        pItem->Release();
+    }
+    return count == expected;
+}
+
+// Peak heap use of a 1M-item selection: an array holding one live item per entry vs. a snapshot
+// array captured while streaming over the source items. Measured once for holding the array and
+// reading a page of it, and again after a consumer has copied every path out.
+static int benchLazyArray(const std::vector<std::string>& args) {
+    DWORD itemCount = static_cast<DWORD>(benchArg(args, 1, 1000000));
+    COMFunctionPointers comFuncs = LoadCOMFunctionPointers();
+    IShellItemArray* pSource = createSyntheticShellItemArray(itemCount);
+    int status = 0;
+
+    size_t baseline = benchResetPeakBytes();
+    BenchTimer timer;
+    std::vector<IShellItem*> items(itemCount);
+    for (DWORD i = 0; i < itemCount; ++i) {
+        pSource->GetItemAt(i, &items[i]);
+    }
+    IShellItemArray* pArray = nullptr;
+    createShellItemArray(std::move(items), &pArray);
+    status |= readSelectionPage(pArray, itemCount) ? 0 : 1;
+    printBenchResult("lazyarray items build+page", itemCount, timer.seconds());
+    size_t itemsPeak = benchPeakBytes() - baseline;
+    printBenchPeakBytes(itemsPeak, itemCount);
+    timer.reset();
+    {
+        PathTable paths;
+        getFilePathsFromShellItemArray(pArray, comFuncs, paths);
+        status |= (paths.size() == itemCount) ? 0 : 1;
+    }
+    printBenchResult("lazyarray items paths", itemCount, timer.seconds());
+    size_t itemsPathsPeak = benchPeakBytes() - baseline;
+    printBenchPeakBytes(itemsPathsPeak, itemCount);
+    pArray->Release();
+
+    baseline = benchResetPeakBytes();
+    timer.reset();
+    std::shared_ptr<ShellItemSnapshot> snapshot;
+    ShellItemSnapshot& writable = writableSnapshot(snapshot);
+    writable.names.reserve(itemCount, 0);
+    writable.folderIndex.reserve(itemCount);
+    writable.attributes.reserve(itemCount);
+    for (DWORD i = 0; i < itemCount; ++i) {
+        IShellItem* pItem = nullptr;
+        pSource->GetItemAt(i, &pItem);
+        appendToSnapshot(writable, &pItem, 1);
+        pItem->Release();
+    }
+    createSnapshotShellItemArray(std::move(snapshot), comFuncs.pSHCreateItemFromParsingName, &pArray);
+    status |= readSelectionPage(pArray, itemCount) ? 0 : 1;
+    printBenchResult("lazyarray snapshot build+page", itemCount, timer.seconds());
+    size_t snapshotPeak = benchPeakBytes() - baseline;
+    printBenchPeakBytes(snapshotPeak, itemCount);
+    timer.reset();
+    {
+        PathTable paths;
+        getFilePathsFromShellItemArray(pArray, comFuncs, paths);
+        status |= (paths.size() == itemCount) ? 0 : 1;
+    }
+    printBenchResult("lazyarray snapshot paths", itemCount, timer.seconds());
+    size_t snapshotPathsPeak = benchPeakBytes() - baseline;
+    printBenchPeakBytes(snapshotPathsPeak, itemCount);
+    pArray->Release();
+
+    if (benchCountsAllocations()) {
+        std::cout << std::left << std::setw(40) << "" << std::fixed << std::setprecision(1)
+                  << " peak ratio held=" << (snapshotPeak ? static_cast<double>(itemsPeak) / snapshotPeak : 0.0) << "x"
+                  << " with paths=" << (snapshotPathsPeak ? static_cast<double>(itemsPathsPeak) / snapshotPathsPeak : 0.0) << "x" << std::endl;
+    }
+
+    pSource->Release();
+    FreeCOMFunctionPointers(comFuncs);
+    return status;
+}
+
+// Event sink for the registry stress. Release never frees it, so a callback after the last
+// reference is gone counts as a violation instead of crashing.
+class BenchEventSink : public IFileDialogEvents {
+public:
+    BenchEventSink() : refCount(1), pRegistry(nullptr), removeCookie(0), violations(0), calls(0), work(0) {}
+    virtual ~BenchEventSink() = default;
+
+    // Busy time per OnSelectionChange, like a listener re-reading the selection
+    void setCallbackWork(std::chrono::nanoseconds duration) {
+        work = duration;
+    }
+
+    // Have the next callback Unadvise this sink from inside the dispatch
+    void removeOnNextCall(EventSinkRegistry* pSinks, DWORD cookie) {
+        pRegistry = pSinks;
+        removeCookie.store(cookie);
+    }
+
+    LONG references() const { return refCount.load(); }
+    size_t violationCount() const { return violations.load(); }
+    size_t callCount() const { return calls.load(); }
+
+    // IUnknown methods
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppv) {
+        if (riid == IID_IUnknown || riid == IID_IFileDialogEvents) {
+            *ppv = static_cast<IFileDialogEvents*>(this);
+            AddRef();
+            return S_OK;
+        }
+        *ppv = nullptr;
+        return E_NOINTERFACE;
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() {
+        return ++refCount;
+    }
+
+    ULONG STDMETHODCALLTYPE Release() {
+        return --refCount;
+    }
+
+    // IFileDialogEvents methods
+    HRESULT STDMETHODCALLTYPE OnFileOk(IFileDialog *pfd) { return S_OK; }
+    HRESULT STDMETHODCALLTYPE OnFolderChanging(IFileDialog *pfd, IShellItem *psiFolder) { return S_OK; }
+    HRESULT STDMETHODCALLTYPE OnFolderChange(IFileDialog *pfd) { return S_OK; }
+    HRESULT STDMETHODCALLTYPE OnSelectionChange(IFileDialog *pfd) {
+        if (refCount.load() <= 0) {
+            violations.fetch_add(1);
+        }
+        calls.fetch_add(1, std::memory_order_relaxed);
+        if (work.count()) {
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + work;
+            while (std::chrono::steady_clock::now() < end) {
+            }
+        }
+        DWORD cookie = removeCookie.exchange(0);
+        if (cookie) {
+            pRegistry->unadvise(cookie);
+        }
+        return S_OK;
+    }
+    HRESULT STDMETHODCALLTYPE OnShareViolation(IFileDialog *pfd, IShellItem *psi, FDE_SHAREVIOLATION_RESPONSE *pResponse) { return S_OK; }
+    HRESULT STDMETHODCALLTYPE OnTypeChange(IFileDialog *pfd) { return S_OK; }
+    HRESULT STDMETHODCALLTYPE OnOverwrite(IFileDialog *pfd, IShellItem *psi, FDE_OVERWRITE_RESPONSE *pResponse) { return S_OK; }
+
+private:
+    std::atomic<LONG> refCount;
+    EventSinkRegistry* pRegistry;
+    std::atomic<DWORD> removeCookie;
+    std::atomic<size_t> violations;
+    std::atomic<size_t> calls;
+    std::chrono::nanoseconds work;
+};
+
+// The registry the stand-in used to have, made thread-safe the obvious way: one mutex, held for
+// the whole dispatch
+class LockedEventSinks {
+public:
+    LockedEventSinks() : nextCookie(1) {}
+
+    ~LockedEventSinks() {
+        for (auto& sink : sinks) {
+            sink.second->Release();
+        }
+    }
+
+    HRESULT advise(IUnknown* pfde, DWORD* pdwCookie) {
+        IFileDialogEvents* pEvents = nullptr;
+        HRESULT hr = pfde->QueryInterface(IID_IFileDialogEvents, reinterpret_cast<void**>(&pEvents));
+        if (FAILED(hr)) {
+            return hr;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        *pdwCookie = nextCookie++;
+        sinks.emplace_back(*pdwCookie, pEvents);
+        return S_OK;
+    }
+
+    HRESULT unadvise(DWORD dwCookie) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < sinks.size(); ++i) {
+            if (sinks[i].first == dwCookie) {
+                sinks[i].second->Release();
+                sinks.erase(sinks.begin() + i);
+                return S_OK;
+            }
+        }
+        return E_INVALIDARG;
+    }
+
+    template <typename Fn>
+    HRESULT forEach(Fn fn) {
+        std::lock_guard<std::mutex> lock(mutex);
+        HRESULT result = S_OK;
+        for (auto& sink : sinks) {
+            HRESULT hr = fn(sink.second);
+            if (hr != S_OK && result == S_OK) {
+                result = hr;
+            }
+        }
+        return result;
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<std::pair<DWORD, IFileDialogEvents*>> sinks;
+    DWORD nextCookie;
+};
+
+struct EventSinkStress {
+    size_t dispatches;
+    size_t callbacks;
+    double seconds;
+    uint64_t maxDispatchNanoseconds;
+};
+
+// Dispatcher threads fan OnSelectionChange out to a few permanent sinks while a churn thread
+// advises and unadvises short-lived ones. On EventSinkRegistry every 16th churned sink is left
+// for a dispatcher instead, and Unadvises itself from inside the callback; the mutex version
+// would deadlock on that.
+template <typename Registry>
+static EventSinkStress stressEventSinks(Registry& registry, unsigned dispatchers, size_t churnOps,
+                                        std::vector<std::unique_ptr<BenchEventSink>>& sinks) {
+    const size_t kPermanentSinks = 4;
+    std::vector<DWORD> permanentCookies(kPermanentSinks);
+    for (size_t i = 0; i < kPermanentSinks; ++i) {
+        sinks.emplace_back(new BenchEventSink());
+        registry.advise(sinks.back().get(), &permanentCookies[i]);
+        sinks.back()->Release();
+    }
+    std::vector<std::unique_ptr<BenchEventSink>> churned(churnOps);
+    for (std::unique_ptr<BenchEventSink>& sink : churned) {
+        sink.reset(new BenchEventSink());
+    }
+
+    std::atomic<bool> churning(true);
+    std::atomic<size_t> dispatches(0);
+    std::atomic<size_t> callbacks(0);
+    std::atomic<uint64_t> maxDispatch(0);
+    BenchTimer timer;
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < dispatchers; ++t) {
+        threads.emplace_back([&]() {
+            size_t localDispatches = 0;
+            size_t localCallbacks = 0;
+            uint64_t localMax = 0;
+            while (churning.load(std::memory_order_relaxed)) {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                registry.forEach([&](IFileDialogEvents* pEvents) {
+                    ++localCallbacks;
+                    return pEvents->OnSelectionChange(nullptr);
+                });
+                uint64_t elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count());
+                localMax = std::max(localMax, elapsed);
+                ++localDispatches;
+            }
+            dispatches.fetch_add(localDispatches);
+            callbacks.fetch_add(localCallbacks);
+            uint64_t seen = maxDispatch.load();
+            while (localMax > seen && !maxDispatch.compare_exchange_weak(seen, localMax)) {
+            }
+        });
+    }
+    for (size_t i = 0; i < churnOps; ++i) {
+        DWORD cookie = 0;
+        registry.advise(churned[i].get(), &cookie);
+        churned[i]->Release();
+        if constexpr (std::is_same<Registry, EventSinkRegistry>::value) {
+            if (i % 16 == 0) {
+                churned[i]->removeOnNextCall(&registry, cookie);
+                continue;
+            }
+        }
+        registry.unadvise(cookie);
+    }
+    churning.store(false);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    EventSinkStress stress = { dispatches.load(), callbacks.load(), timer.seconds(), maxDispatch.load() };
+
+    for (DWORD cookie : permanentCookies) {
+        registry.unadvise(cookie);
+    }
+    for (std::unique_ptr<BenchEventSink>& sink : churned) {
+        sinks.push_back(std::move(sink));
+    }
+    return stress;
+}
+
+// Once the registry is gone every sink must be fully released, and none called after that
+static bool checkEventSinks(const std::string& name, const std::vector<std::unique_ptr<BenchEventSink>>& sinks) {
+    size_t leaked = 0;
+    size_t violations = 0;
+    for (const std::unique_ptr<BenchEventSink>& sink : sinks) {
+        leaked += sink->references() != 0;
+        violations += sink->violationCount();
+    }
+    if (leaked || violations) {
+        std::cerr << name << ": " << leaked << " sinks still referenced, " << violations << " callbacks after release" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static void printEventSinkStress(const std::string& name, const EventSinkStress& stress, size_t churnOps) {
+    printBenchResult(name + " dispatch", stress.dispatches, stress.seconds);
+    printBenchResult(name + " advise+unadvise", churnOps, stress.seconds);
+    std::cout << std::left << std::setw(40) << "" << " callbacks=" << stress.callbacks
+              << " max dispatch=" << std::fixed << std::setprecision(1) << stress.maxDispatchNanoseconds / 1e3 << "us" << std::endl;
+}
+
+static int benchEventSinks(const std::vector<std::string>& args) {
+    // Self-unadvising sinks need a dispatcher to call them
+    unsigned dispatchers = std::max<unsigned>(1, static_cast<unsigned>(benchArg(args, 1, std::max(2u, std::thread::hardware_concurrency()))));
+    size_t churnOps = benchArg(args, 2, 200000);
+    int status = 0;
+
+    std::vector<std::unique_ptr<BenchEventSink>> lockedSinks;
+    EventSinkStress locked;
+    {
+        LockedEventSinks registry;
+        locked = stressEventSinks(registry, dispatchers, churnOps, lockedSinks);
+    }
+    printEventSinkStress("eventsinks mutex", locked, churnOps);
+    if (!checkEventSinks("eventsinks mutex", lockedSinks)) {
+        status = 1;
+    }
+
+    std::vector<std::unique_ptr<BenchEventSink>> registrySinks;
+    EventSinkStress lockFree;
+    {
+        EventSinkRegistry registry;
+        lockFree = stressEventSinks(registry, dispatchers, churnOps, registrySinks);
+    }
+    printEventSinkStress("eventsinks registry", lockFree, churnOps);
+    if (!checkEventSinks("eventsinks registry", registrySinks)) {
+        status = 1;
+    }
+    return status;
+}
+
+// producers threads raise OnSelectionChange for events / producers rounds over the dialogs
+static void raiseSelectionStorm(IFileDialogEvents* pSink, const std::vector<IFileDialog*>& dialogs, size_t events, unsigned producers) {
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < producers; ++t) {
+        threads.emplace_back([&, t]() {
+            for (size_t i = t; i < events; i += producers) {
+                pSink->OnSelectionChange(dialogs[i % dialogs.size()]);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+// Selection-change bursts over several dialogs into a listener that takes handlerns per call:
+// synchronous calls against the async queue under different capacities and overflow policies
+static int benchEventStorm(const std::vector<std::string>& args) {
+    size_t events = benchArg(args, 1, 1000000);
+    size_t dialogCount = std::max<size_t>(1, benchArg(args, 2, 64));
+    std::chrono::nanoseconds work(benchArg(args, 3, 2000));
+    unsigned producers = static_cast<unsigned>(std::max<size_t>(1, benchArg(args, 4, 2)));
+    std::vector<IFileDialog*> dialogs(dialogCount, nullptr);
+    for (IFileDialog*& pDialog : dialogs) {
+        StandInCoCreateInstance(CLSID_FileOpenDialog, NULL, CLSCTX_INPROC_SERVER, IID_IFileDialog, reinterpret_cast<void**>(&pDialog));
+    }
+    BenchEventSink target;
+    target.setCallbackWork(work);
+    int status = 0;
+
+    BenchTimer timer;
+    raiseSelectionStorm(&target, dialogs, events, producers);
+    printBenchResult("eventstorm synchronous", events, timer.seconds());
+
+    struct StormConfig {
+        const char* name;
+        size_t capacity;
+        AsyncEventOverflow overflow;
+        long debounceMicroseconds;
+    };
+    const StormConfig configs[] = {
+        { "eventstorm async", 1024, AsyncEventOverflowBlock, 0 },
+        { "eventstorm async capacity=16 block", 16, AsyncEventOverflowBlock, 0 },
+        { "eventstorm async capacity=16 drop", 16, AsyncEventOverflowDropNewest, 0 },
+        { "eventstorm async debounce=1ms", 1024, AsyncEventOverflowBlock, 1000 },
+    };
+    for (const StormConfig& config : configs) {
+        AsyncEventOptions options = { config.capacity, config.overflow, std::chrono::microseconds(config.debounceMicroseconds) };
+        IFileDialogEvents* pSink = nullptr;
+        IAsyncEventQueue* pQueue = nullptr;
+        createAsyncEventSink(&target, options, &pSink);
+        pSink->QueryInterface(IID_IAsyncEventQueue, reinterpret_cast<void**>(&pQueue));
+        size_t callsBefore = target.callCount();
+
+        timer.reset();
+        raiseSelectionStorm(pSink, dialogs, events, producers);
+        double raised = timer.seconds();
+        pQueue->Flush();
+        double drained = timer.seconds();
+        AsyncEventCounters counters = {};
+        pQueue->GetCounters(&counters);
+        size_t calls = target.callCount() - callsBefore;
+
+        printBenchResult(config.name, events, raised);
+        std::cout << std::left << std::setw(40) << "" << " delivered=" << counters.delivered
+                  << " coalesced=" << counters.coalesced << " dropped=" << counters.dropped
+                  << " drained=" << std::fixed << std::setprecision(3) << drained << "s" << std::endl;
+        std::cout << std::left << std::setw(40) << "" << " latency p50=" << std::setprecision(1) << counters.p50LatencyNanoseconds / 1e3
+                  << "us p99=" << counters.p99LatencyNanoseconds / 1e3 << "us max=" << counters.maxLatencyNanoseconds / 1e3 << "us" << std::endl;
+        if (counters.received != events || counters.coalesced + counters.dropped + counters.delivered != counters.received || calls != counters.delivered) {
+            std::cerr << config.name << ": received " << counters.received << ", coalesced " << counters.coalesced << ", dropped "
+                      << counters.dropped << ", delivered " << counters.delivered << ", listener called " << calls << " times" << std::endl;
+            status = 1;
+        }
+        pQueue->Release();
+        pSink->Release();
+    }
+
+    for (IFileDialog* pDialog : dialogs) {
+        if (pDialog) {
+            pDialog->Release();
+        }
+    }
+    return status;
+}
+
+// Task allocations made while benchCountingTaskMemAlloc is interposed, for the counts of code
+// that hands out CoTaskMemAlloc'd strings
+static std::atomic<size_t> taskAllocationCount(0);
+static PFN_CoTaskMemAlloc benchNextTaskMemAlloc = nullptr;
+
+static LPVOID STDMETHODCALLTYPE benchCountingTaskMemAlloc(size_t cb) {
+    taskAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    return benchNextTaskMemAlloc(cb);
+}
+
+// The two result passes of getFileDialogResults (paths into a PathTable, then full records with
+// the parent's name) over synthetic items, and the records pass over a snapshot of them (whose
+// paths pass never creates items), reading names through GetDisplayName copies and then borrowing
+// them through IShellItemDisplayNames. Best of rounds; allocations include the CoTaskMemAlloc'd
+// copies.
+static int benchDisplayNames(const std::vector<std::string>& args) {
+    DWORD itemCount = static_cast<DWORD>(std::max<size_t>(1, benchArg(args, 1, 200000)));
+    size_t rounds = std::max<size_t>(1, benchArg(args, 2, 5));
+    COMFunctionPointers comFuncs = LoadCOMFunctionPointers();
+    benchNextTaskMemAlloc = interposeTaskMemAlloc(benchCountingTaskMemAlloc);
+    auto allocationCount = [] {
+        return benchAllocationCount() + taskAllocationCount.load(std::memory_order_relaxed);
+    };
+    IShellItemArray* pArray = createSyntheticShellItemArray(itemCount);
+    std::shared_ptr<ShellItemSnapshot> snapshot = std::make_shared<ShellItemSnapshot>();
+    for (DWORD i = 0; i < itemCount; ++i) {
+        ComPtr<IShellItem> item;
+        if (SUCCEEDED(pArray->GetItemAt(i, item.put()))) {
+            IShellItem* pItem = item.get();
+            appendToSnapshot(*snapshot, &pItem, 1);
+        }
+    }
+    IShellItemArray* pSnapshotArray = nullptr;
+    createSnapshotShellItemArray(snapshot, nullptr, &pSnapshotArray);
+    int status = 0;
+    bool borrowing = shellItemNameBorrowingEnabled();
+    for (bool borrow : { false, true }) {
+        setShellItemNameBorrowing(borrow);
+        const char* mode = borrow ? "borrowed" : "GetDisplayName";
+        double bestPaths = 0.0;
+        double bestRecords = 0.0;
+        double bestSnapshotRecords = 0.0;
+        size_t pathAllocations = 0;
+        size_t recordAllocations = 0;
+        size_t snapshotRecordAllocations = 0;
+        for (size_t round = 0; round < rounds; ++round) {
+            PathTable paths;
+            size_t allocations = allocationCount();
+            BenchTimer timer;
+            getFilePathsFromShellItemArray(pArray, comFuncs, paths);
+            double seconds = timer.seconds();
+            pathAllocations = allocationCount() - allocations;
+            if (round == 0 || seconds < bestPaths) {
+                bestPaths = seconds;
+            }
+
+            std::vector<ShellItemRecord> records;
+            allocations = allocationCount();
+            timer.reset();
+            extractShellItemRecords(comFuncs, pArray, records);
+            seconds = timer.seconds();
+            recordAllocations = allocationCount() - allocations;
+            if (round == 0 || seconds < bestRecords) {
+                bestRecords = seconds;
+            }
+            if (paths.size() != itemCount || records.size() != itemCount || records.back().path != paths[itemCount - 1] ||
+                records.back().parent.empty()) {
+                status = 1;
+            }
+
+            std::vector<ShellItemRecord> snapshotRecords;
+            allocations = allocationCount();
+            timer.reset();
+            extractShellItemRecords(comFuncs, pSnapshotArray, snapshotRecords);
+            seconds = timer.seconds();
+            snapshotRecordAllocations = allocationCount() - allocations;
+            if (round == 0 || seconds < bestSnapshotRecords) {
+                bestSnapshotRecords = seconds;
+            }
+            if (snapshotRecords.size() != itemCount || snapshotRecords.back().path != paths[itemCount - 1]) {
+                status = 1;
+            }
+        }
+        printBenchResult(std::string("names paths ") + mode, itemCount, bestPaths);
+        printBenchAllocations(pathAllocations, itemCount);
+        printBenchResult(std::string("names records ") + mode, itemCount, bestRecords);
+        printBenchAllocations(recordAllocations, itemCount);
+        printBenchResult(std::string("names snapshot records ") + mode, itemCount, bestSnapshotRecords);
+        printBenchAllocations(snapshotRecordAllocations, itemCount);
+    }
+    setShellItemNameBorrowing(borrowing);
+    pSnapshotArray->Release();
+    pArray->Release();
+    interposeTaskMemAlloc(benchNextTaskMemAlloc);
+    FreeCOMFunctionPointers(comFuncs);
+    return status;
+}
+
+// The data members SyntheticShellItem had before its folders were interned: the whole path per
+// item, and a parent cut from it with a fresh string
+struct BenchFullPathItem {
+    explicit BenchFullPathItem(std::wstring path) : refCount(1), path(std::move(path)), attributes(SFGAO_FILESYSTEM) {
+        key.assign(this->path);
+    }
+    virtual ~BenchFullPathItem() = default;
+
+    BenchFullPathItem* parent() const {
+        size_t slash = path.rfind(L'/');
+        return (slash == std::wstring::npos || slash == 0) ? nullptr : new BenchFullPathItem(path.substr(0, slash));
+    }
+
+    LONG refCount;
+    std::wstring path;
+    SFGAOF attributes;
+    CollationKey key;
+};
+
+// Heap held per live synthetic item (slab allocation off, so every byte is counted) and the cost of
+// walking each item's parent chain to the top, for a wide tree (one folder level) and a deep one
+// (depth levels), against items that carry their full path
+static int benchPathTrie(const std::vector<std::string>& args) {
+    size_t itemCount = std::max<size_t>(1, benchArg(args, 1, 200000));
+    DWORD depth = static_cast<DWORD>(std::max<size_t>(2, benchArg(args, 2, 16)));
+    DWORD perFolder = static_cast<DWORD>(std::max<size_t>(1, benchArg(args, 3, 1000)));
+    COMFunctionPointers comFuncs = LoadCOMFunctionPointers();
+    int status = 0;
+    bool slabs = slabAllocationEnabled();
+    setSlabAllocation(false);
+    for (DWORD shapeDepth : { DWORD(1), depth }) {
+        std::string shape = std::string("pathtrie ") + (shapeDepth == 1 ? "wide" : "deep " + std::to_string(shapeDepth));
+        IShellItemArray* pArray = createSyntheticShellItemArray(static_cast<DWORD>(itemCount), perFolder, shapeDepth);
+        std::vector<IShellItem*> items(itemCount, nullptr);
+
+        size_t trieBytes = pathTrie().bytesUsed();
+        size_t trieNodes = pathTrie().nodeCount();
+        size_t live = benchLiveBytes();
+        BenchTimer timer;
+        for (size_t i = 0; i < itemCount; ++i) {
+            pArray->GetItemAt(static_cast<DWORD>(i), &items[i]);
+        }
+        double seconds = timer.seconds();
+        size_t itemBytes = benchLiveBytes() - live;
+        printBenchResult(shape + " GetItemAt", itemCount, seconds);
+        std::cout << std::left << std::setw(40) << "" << " heap per item=" << benchBytesPerItem(itemBytes, itemCount)
+                  << " trie nodes=" << pathTrie().nodeCount() - trieNodes
+                  << " trie bytes=" << pathTrie().bytesUsed() - trieBytes << std::endl;
+
+        size_t hops = 0;
+        timer.reset();
+        for (IShellItem* pItem : items) {
+            IShellItem* pCurrent = pItem;
+            IShellItem* pParent = nullptr;
+            while (pCurrent && SUCCEEDED(pCurrent->GetParent(&pParent))) {
+                if (pCurrent != pItem) {
+                    pCurrent->Release();
+                }
+                pCurrent = pParent;
+                ++hops;
+            }
+            if (pCurrent != pItem) {
+                pCurrent->Release();
+            }
+        }
+        printBenchResult(shape + " GetParent trie", hops, timer.seconds());
+
+        // The same paths as full-path items
+        std::vector<BenchFullPathItem*> fullItems(itemCount, nullptr);
+        std::vector<std::wstring> paths(itemCount);
+        for (size_t i = 0; i < itemCount; ++i) {
+            LPWSTR pszPath = nullptr;
+            if (items[i] && SUCCEEDED(items[i]->GetDisplayName(SIGDN_FILESYSPATH, &pszPath))) {
+                paths[i] = pszPath;
+                comFuncs.pCoTaskMemFree(pszPath);
+            }
+            if (items[i]) {
+                items[i]->Release();
+            }
+        }
+        live = benchLiveBytes();
+        for (size_t i = 0; i < itemCount; ++i) {
+            fullItems[i] = new BenchFullPathItem(paths[i]);
+        }
+        itemBytes = benchLiveBytes() - live;
+        std::cout << std::left << std::setw(40) << shape + " full path" << " heap per item=" << benchBytesPerItem(itemBytes, itemCount)
+                  << std::endl;
+
+        size_t fullHops = 0;
+        timer.reset();
+        for (BenchFullPathItem* pItem : fullItems) {
+            BenchFullPathItem* pCurrent = pItem;
+            while (BenchFullPathItem* pParent = pCurrent->parent()) {
+                if (pCurrent != pItem) {
+                    delete pCurrent;
+                }
+                pCurrent = pParent;
+                ++fullHops;
+            }
+            if (pCurrent != pItem) {
+                delete pCurrent;
+            }
+        }
+        printBenchResult(shape + " GetParent full path", fullHops, timer.seconds());
+        if (fullHops != hops) {
+            status = 1;
+        }
+        for (BenchFullPathItem* pItem : fullItems) {
+            delete pItem;
+        }
+        pArray->Release();
+    }
+    setSlabAllocation(slabs);
+    FreeCOMFunctionPointers(comFuncs);
+    return status;
+}
+
+// Item churn alone, then getFilePathsFromShellItemArray and extractShellItemRecords, over synthetic
+// items (one per GetItemAt, Next and GetParent) from ::operator new and from their slab allocator.
+// Best of rounds; the first slab round also carves the slabs.
+static int benchItemPool(const std::vector<std::string>& args) {
+    DWORD itemCount = static_cast<DWORD>(std::max<size_t>(1, benchArg(args, 1, 1000000)));
+    size_t rounds = std::max<size_t>(1, benchArg(args, 2, 3));
+    COMFunctionPointers comFuncs = LoadCOMFunctionPointers();
+    IShellItemArray* pArray = createSyntheticShellItemArray(itemCount);
+    int status = 0;
+    for (bool slabs : { false, true }) {
+        setSlabAllocation(slabs);
+        const char* mode = slabs ? "slab" : "heap";
+        double bestItems = 0.0;
+        double bestPaths = 0.0;
+        double bestRecords = 0.0;
+        size_t itemAllocations = 0;
+        size_t pathAllocations = 0;
+        size_t recordAllocations = 0;
+        for (size_t round = 0; round < rounds; ++round) {
+            size_t allocations = benchAllocationCount();
+            BenchTimer timer;
+            for (DWORD i = 0; i < itemCount; ++i) {
+                IShellItem* pItem = nullptr;
+                if (SUCCEEDED(pArray->GetItemAt(i, &pItem))) {
+                    pItem->Release();
+                }
+            }
+            double seconds = timer.seconds();
+            itemAllocations = benchAllocationCount() - allocations;
+            if (round == 0 || seconds < bestItems) {
+                bestItems = seconds;
+            }
+
+            allocations = benchAllocationCount();
+            timer.reset();
+            std::vector<std::wstring> paths = getFilePathsFromShellItemArray(pArray, comFuncs);
+            seconds = timer.seconds();
+            pathAllocations = benchAllocationCount() - allocations;
+            if (round == 0 || seconds < bestPaths) {
+                bestPaths = seconds;
+            }
+            if (paths.size() != itemCount) {
+                status = 1;
+            }
+
+            std::vector<ShellItemRecord> records;
+            allocations = benchAllocationCount();
+            timer.reset();
+            extractShellItemRecords(comFuncs, pArray, records);
+            seconds = timer.seconds();
+            recordAllocations = benchAllocationCount() - allocations;
+            if (round == 0 || seconds < bestRecords) {
+                bestRecords = seconds;
+            }
+            if (records.size() != itemCount) {
+                status = 1;
+            }
+        }
+        printBenchResult(std::string("itempool GetItemAt+Release ") + mode, itemCount, bestItems);
+        printBenchAllocations(itemAllocations, itemCount);
+        printBenchResult(std::string("itempool paths ") + mode, itemCount, bestPaths);
+        printBenchAllocations(pathAllocations, itemCount);
+        printBenchResult(std::string("itempool records ") + mode, itemCount, bestRecords);
+        printBenchAllocations(recordAllocations, itemCount);
+    }
+    setSlabAllocation(true);
+    pArray->Release();
+    FreeCOMFunctionPointers(comFuncs);
+    return status;
+}
+
+// One short session's worth of dialog setup, enough that a fresh dialog grows its strings and lists
+static HRESULT configureBenchDialog(IFileDialog* pDialog) {
+    static const COMDLG_FILTERSPEC filters[] = {
+        { L"Text files", L"*.txt;*.md" },
+        { L"All files", L"*.*" },
+    };
+    DWORD options = 0;
+    HRESULT hr = pDialog->GetOptions(&options);
+    if (SUCCEEDED(hr)) {
+        hr = pDialog->SetOptions(options | FOS_ALLOWMULTISELECT | FOS_FORCESHOWHIDDEN);
+    }
+    if (SUCCEEDED(hr)) {
+        hr = pDialog->SetTitle(L"Pick the files to import into the benchmark project");
+    }
+    if (SUCCEEDED(hr)) {
+        hr = pDialog->SetFileTypes(2, filters);
+    }
+    if (SUCCEEDED(hr)) {
+        hr = pDialog->SetFileTypeIndex(2);
+    }
+    if (SUCCEEDED(hr)) {
+        hr = pDialog->SetFileName(L"a rather long default file name for the benchmark.txt");
+    }
+    return hr;
+}
+
+// A dialog straight from the factory must look new whether or not it was pooled
+static bool isFreshOpenDialog(IFileDialog* pDialog, COMFunctionPointers& comFuncs) {
+    DWORD options = 0;
+    UINT fileTypeIndex = 0;
+    IShellItem* pFolder = nullptr;
+    LPWSTR pszName = nullptr;
+    bool fresh = SUCCEEDED(pDialog->GetOptions(&options)) && options == (FOS_PATHMUSTEXIST | FOS_FILEMUSTEXIST | FOS_NOCHANGEDIR) &&
+                 SUCCEEDED(pDialog->GetFileTypeIndex(&fileTypeIndex)) && fileTypeIndex == 1 &&
+                 FAILED(pDialog->GetFolder(&pFolder)) && SUCCEEDED(pDialog->GetFileName(&pszName)) && pszName[0] == L'\0';
+    if (pFolder) {
+        pFolder->Release();
+    }
+    if (pszName) {
+        comFuncs.pCoTaskMemFree(pszName);
+    }
+    return fresh;
+}
+
+// Create -> configure -> Release through CoCreateInstance and the class-factory registry, with
+// the stand-in dialog pool off (every session constructs and tears down a dialog) and on
+static int benchFactory(const std::vector<std::string>& args) {
+    size_t sessions = std::max<size_t>(1, benchArg(args, 1, 100000));
+    COMFunctionPointers comFuncs = LoadCOMFunctionPointers();
+    int status = 0;
+    const struct {
+        const char* name;
+        size_t capacity;
+    } modes[] = {
+        { "pool off", 0 },
+        { "pool on", 16 },
+    };
+    for (const auto& mode : modes) {
+        setStandInDialogPoolCapacity(mode.capacity);
+        for (bool configure : { false, true }) {
+            std::string name = std::string("factory ") + mode.name + (configure ? " configured" : " bare");
+            size_t allocations = benchAllocationCount();
+            BenchTimer timer;
+            for (size_t i = 0; i < sessions; ++i) {
+                IFileDialog* pDialog = nullptr;
+                HRESULT hr = comFuncs.pCoCreateInstance(CLSID_FileOpenDialog, NULL, CLSCTX_INPROC_SERVER, IID_IFileDialog, reinterpret_cast<void**>(&pDialog));
+                if (SUCCEEDED(hr) && configure) {
+                    hr = configureBenchDialog(pDialog);
+                }
+                if (pDialog) {
+                    pDialog->Release();
+                }
+                if (FAILED(hr)) {
+                    std::cerr << name << ": session " << i << " failed, hr=0x" << std::hex << hr << std::dec << std::endl;
+                    status = 1;
+                    break;
+                }
+            }
+            double seconds = timer.seconds();
+            printBenchResult(name, sessions, seconds);
+            std::cout << std::left << std::setw(40) << "" << " ns per session=" << std::fixed << std::setprecision(0)
+                      << seconds * 1e9 / sessions << std::endl;
+            printBenchAllocations(benchAllocationCount() - allocations, sessions);
+        }
+
+        IFileDialog* pDialog = nullptr;
+        if (FAILED(comFuncs.pCoCreateInstance(CLSID_FileOpenDialog, NULL, CLSCTX_INPROC_SERVER, IID_IFileDialog, reinterpret_cast<void**>(&pDialog))) ||
+            !isFreshOpenDialog(pDialog, comFuncs)) {
+            std::cerr << "factory " << mode.name << ": a created dialog kept state from an earlier session" << std::endl;
+            status = 1;
+        }
+        if (pDialog) {
+            pDialog->Release();
+        }
+    }
+    setStandInDialogPoolCapacity(16);
+    FreeCOMFunctionPointers(comFuncs);
+    return status;
+}
+
+// Six empty interfaces for the QueryInterface bench: enough that a chained if has a visible tail
+struct IBenchQi0 : public IUnknown {};
+struct IBenchQi1 : public IUnknown {};
+struct IBenchQi2 : public IUnknown {};
+struct IBenchQi3 : public IUnknown {};
+struct IBenchQi4 : public IUnknown {};
+struct IBenchQi5 : public IUnknown {};
+static constexpr IID IID_IBenchQi0 = guidFromString("6B1F0C3A-42D7-4E19-9A0B-5C7E2D8F1A30");
+static constexpr IID IID_IBenchQi1 = guidFromString("A93C5E71-0B2D-4C8A-8E4F-1D6B3A9C7E21");
+static constexpr IID IID_IBenchQi2 = guidFromString("1E7D4B92-6C3F-4A05-B7D1-9F2E8C4A6B12");
+static constexpr IID IID_IBenchQi3 = guidFromString("D4A86F2C-3E91-4B7D-A5C0-6E1F9B3D8A03");
+static constexpr IID IID_IBenchQi4 = guidFromString("37C2E9A5-8D14-4F6B-9C3E-2A7D5B1F0E94");
+static constexpr IID IID_IBenchQi5 = guidFromString("F0598B3D-7A26-4C1E-8B9F-4D3C6E2A1B85");
+// IID_IBenchQi0 but for the last byte: the table's slot matches and only the whole-GUID compare
+// rejects it, the dearest miss there is
+static constexpr IID IID_IBenchQiNear = guidFromString("6B1F0C3A-42D7-4E19-9A0B-5C7E2D8F1A31");
+COM_INTERFACE_ID(IBenchQi0, IID_IBenchQi0)
+COM_INTERFACE_ID(IBenchQi1, IID_IBenchQi1)
+COM_INTERFACE_ID(IBenchQi2, IID_IBenchQi2)
+COM_INTERFACE_ID(IBenchQi3, IID_IBenchQi3)
+COM_INTERFACE_ID(IBenchQi4, IID_IBenchQi4)
+COM_INTERFACE_ID(IBenchQi5, IID_IBenchQi5)
+
+// One object, two QueryInterface implementations: the chained if every class used to write, and
+// a QueryInterfaceTable
+template <bool UseTable>
+class BenchQiObject : public IBenchQi0, public IBenchQi1, public IBenchQi2, public IBenchQi3, public IBenchQi4, public IBenchQi5 {
+public:
+    BenchQiObject() : refCount(1) {}
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppv) {
+        if (UseTable) {
+            return QueryInterfaceTable<BenchQiObject, IBenchQi0, IBenchQi1, IBenchQi2, IBenchQi3, IBenchQi4, IBenchQi5>::query(this, riid, ppv);
+        }
+        if (riid == IID_IUnknown || riid == IID_IBenchQi0) {
+            *ppv = static_cast<IBenchQi0*>(this);
+        } else if (riid == IID_IBenchQi1) {
+            *ppv = static_cast<IBenchQi1*>(this);
+        } else if (riid == IID_IBenchQi2) {
+            *ppv = static_cast<IBenchQi2*>(this);
+        } else if (riid == IID_IBenchQi3) {
+            *ppv = static_cast<IBenchQi3*>(this);
+        } else if (riid == IID_IBenchQi4) {
+            *ppv = static_cast<IBenchQi4*>(this);
+        } else if (riid == IID_IBenchQi5) {
+            *ppv = static_cast<IBenchQi5*>(this);
+        } else {
+            *ppv = nullptr;
+            return E_NOINTERFACE;
+        }
+        AddRef();
+        return S_OK;
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() {
+        return InterlockedIncrement(&refCount);
+    }
+
+    ULONG STDMETHODCALLTYPE Release() {
+        ULONG count = InterlockedDecrement(&refCount);
+        if (count == 0) {
+            delete this;
+        }
+        return count;
+    }
+
+protected:
+    virtual ~BenchQiObject() = default;
+
+private:
+    LONG refCount;
+};
+
+// calls QueryInterface(riid) through pUnknown, Releasing every hit; returns the hit count
+static size_t runQueryInterface(IUnknown* pUnknown, REFIID riid, size_t calls) {
+    size_t hits = 0;
+    for (size_t i = 0; i < calls; ++i) {
+        void* pv = nullptr;
+        if (SUCCEEDED(pUnknown->QueryInterface(riid, &pv))) {
+            static_cast<IUnknown*>(pv)->Release();
+            ++hits;
+        }
+    }
+    return hits;
+}
+
+// QueryInterface hit and miss latency, chained if against QueryInterfaceTable, on an object with
+// six interfaces and on a synthetic item (the IShellItemCollation probe sorting makes per item).
+// Hits include the AddRef/Release pair.
+static int benchQueryInterface(const std::vector<std::string>& args) {
+    size_t calls = std::max<size_t>(1, benchArg(args, 1, 10000000));
+    struct Probe {
+        const char* name;
+        const IID* riid;
+        bool hit;
+    };
+    const Probe probes[] = {
+        { "IUnknown", &IID_IUnknown, true },
+        { "first", &IID_IBenchQi0, true },
+        { "last", &IID_IBenchQi5, true },
+        { "miss", &IID_IFileDialog, false },
+        { "near miss", &IID_IBenchQiNear, false },
+    };
+    int status = 0;
+    auto report = [&](const std::string& name, size_t hits, bool hit, double seconds) {
+        printBenchResult(name, calls, seconds);
+        std::cout << std::left << std::setw(40) << "" << " ns per call=" << std::fixed << std::setprecision(2)
+                  << seconds * 1e9 / calls << std::endl;
+        if (hits != (hit ? calls : 0)) {
+            std::cerr << name << ": " << hits << " hits over " << calls << " calls" << std::endl;
+            status = 1;
+        }
+    };
+
+    // Read back through a volatile so neither loop is devirtualized into the other's QueryInterface
+    IUnknown* volatile chained = static_cast<IBenchQi0*>(new BenchQiObject<false>());
+    IUnknown* volatile table = static_cast<IBenchQi0*>(new BenchQiObject<true>());
+    for (const Probe& probe : probes) {
+        BenchTimer timer;
+        size_t hits = runQueryInterface(chained, *probe.riid, calls);
+        report(std::string("qi chained ") + probe.name, hits, probe.hit, timer.seconds());
+        timer.reset();
+        hits = runQueryInterface(table, *probe.riid, calls);
+        report(std::string("qi table ") + probe.name, hits, probe.hit, timer.seconds());
+    }
+    // What every hit pays besides the lookup
+    {
+        IUnknown* pUnknown = table;
+        BenchTimer timer;
+        for (size_t i = 0; i < calls; ++i) {
+            pUnknown->AddRef();
+            pUnknown->Release();
+        }
+        report("qi AddRef+Release alone", 0, false, timer.seconds());
+    }
+    chained->Release();
+    table->Release();
+
+    IShellItemArray* pArray = createSyntheticShellItemArray(1);
+    IShellItem* pItem = nullptr;
+    if (FAILED(pArray->GetItemAt(0, &pItem))) {
+        pArray->Release();
+        return 1;
+    }
+    BenchTimer timer;
+    size_t hits = runQueryInterface(pItem, IID_IShellItemCollation, calls);
+    report("qi synthetic item hit", hits, true, timer.seconds());
+    timer.reset();
+    hits = runQueryInterface(pItem, IID_IFileDialog, calls);
+    report("qi synthetic item miss", hits, false, timer.seconds());
+    pItem->Release();
+    pArray->Release();
+    return status;
+}
+
+// Copyable owning pointer without move support, the way pre-C++11 smart pointers were written:
+// every copy, by-value parameter and container reallocation is an AddRef/Release pair
+template <typename T>
+class CopyingComPtr {
+public:
+    CopyingComPtr() : p(nullptr) {}
+    CopyingComPtr(const CopyingComPtr& other) : p(other.p) {
+        if (p) {
+            p->AddRef();
+        }
+    }
+    CopyingComPtr& operator=(const CopyingComPtr& other) {
+        CopyingComPtr(other).swap(*this);
+        return *this;
+    }
+    ~CopyingComPtr() {
+        if (p) {
+            p->Release();
+        }
+    }
+    T** operator&() { return &p; }
+    T* operator->() const { return p; }
+    void swap(CopyingComPtr& other) { std::swap(p, other.p); }
+
+private:
+    T* p;
+};
+
+// Reads one property, as the result helpers do per item
+static size_t benchPathLength(IShellItem* pItem, COMFunctionPointers& comFuncs) {
+    LPWSTR pszPath = nullptr;
+    size_t length = 0;
+    if (SUCCEEDED(pItem->GetDisplayName(SIGDN_FILESYSPATH, &pszPath))) {
+        length = std::char_traits<wchar_t>::length(pszPath);
+        comFuncs.pCoTaskMemFree(pszPath);
+    }
+    return length;
+}
+
+static size_t benchPathLength(CopyingComPtr<IShellItem> item, COMFunctionPointers& comFuncs) {
+    return benchPathLength(item.operator->(), comFuncs);
+}
+
+static size_t benchPathLength(ComBorrow<IShellItem> item, COMFunctionPointers& comFuncs) {
+    return benchPathLength(item.get(), comFuncs);
+}
+
+// AddRef/Release calls per 1k items made by the result helpers, and by one item-walking loop
+// (fetch, pass to a helper, keep in a vector) written with raw pointers, a copying smart pointer
+// and ComPtr. Counts come from the synthetic items themselves. Fails if a result helper makes more
+// calls than the Releases of the items it fetched (the item and, for records, its parent) plus a
+// few per array.
+static int benchRefCount(const std::vector<std::string>& args) {
+    DWORD itemCount = static_cast<DWORD>(std::max<size_t>(1, benchArg(args, 1, 100000)));
+    COMFunctionPointers comFuncs = LoadCOMFunctionPointers();
+    IShellItemArray* pArray = createSyntheticShellItemArray(itemCount);
+    auto report = [&](const std::string& name, uint64_t calls, double seconds) {
+        printBenchResult(name, itemCount, seconds);
+        std::cout << std::left << std::setw(40) << "" << " refcount calls per 1k items=" << std::fixed << std::setprecision(0)
+                  << calls * 1000.0 / itemCount << std::endl;
+    };
+
+    int status = 0;
+    auto check = [&](const char* name, uint64_t calls, uint64_t callsPerItem) {
+        const uint64_t kCallsPerArray = 16;
+        if (calls > callsPerItem * itemCount + kCallsPerArray) {
+            std::cerr << name << ": expected at most " << callsPerItem << " refcount calls per item, made " << calls
+                      << " for " << itemCount << " items" << std::endl;
+            status = 1;
+        }
+    };
+
+    uint64_t before = syntheticRefCountCalls();
+    BenchTimer timer;
+    std::vector<ShellItemRecord> records;
+    extractShellItemRecords(comFuncs, pArray, records);
+    uint64_t calls = syntheticRefCountCalls() - before;
+    report("refcount extractShellItemRecords", calls, timer.seconds());
+    check("refcount extractShellItemRecords", calls, 2);
+
+    before = syntheticRefCountCalls();
+    timer.reset();
+    std::vector<std::wstring> paths = getFilePathsFromShellItemArray(pArray, comFuncs);
+    calls = syntheticRefCountCalls() - before;
+    report("refcount getFilePathsFromShellItemArray", calls, timer.seconds());
+    check("refcount getFilePathsFromShellItemArray", calls, 1);
+
+    size_t total = 0;
+    before = syntheticRefCountCalls();
+    timer.reset();
+    {
+        std::vector<IShellItem*> kept;
+        for (DWORD i = 0; i < itemCount; ++i) {
+            IShellItem* pItem = nullptr;
+            if (SUCCEEDED(pArray->GetItemAt(i, &pItem))) {
+                total += benchPathLength(pItem, comFuncs);
+                kept.push_back(pItem);
+            }
+        }
+        for (IShellItem* pItem : kept) {
+            pItem->Release();
+        }
+    }
+    report("refcount walk raw pointers", syntheticRefCountCalls() - before, timer.seconds());
+
+    before = syntheticRefCountCalls();
+    timer.reset();
+    {
+        std::vector<CopyingComPtr<IShellItem>> kept;
+        for (DWORD i = 0; i < itemCount; ++i) {
+            CopyingComPtr<IShellItem> item;
+            if (SUCCEEDED(pArray->GetItemAt(i, &item))) {
+                total += benchPathLength(item, comFuncs);
+                kept.push_back(item);
+            }
+        }
+    }
+    report("refcount walk copying pointer", syntheticRefCountCalls() - before, timer.seconds());
+
+    before = syntheticRefCountCalls();
+    timer.reset();
+    {
+        std::vector<ComPtr<IShellItem>> kept;
+        for (DWORD i = 0; i < itemCount; ++i) {
+            ComPtr<IShellItem> item;
+            if (SUCCEEDED(pArray->GetItemAt(i, item.put()))) {
+                total += benchPathLength(ComBorrow<IShellItem>(item), comFuncs);
+                kept.push_back(std::move(item));
+            }
+        }
+    }
+    report("refcount walk ComPtr", syntheticRefCountCalls() - before, timer.seconds());
+
+    pArray->Release();
+    FreeCOMFunctionPointers(comFuncs);
+    return (status == 0 && records.size() == itemCount && paths.size() == itemCount && total > 0) ? 0 : 1;
+}
+
+// Independent create -> configure -> show -> collect sessions through the session pool, against
+// the stand-in dialog over a small real folder, from one worker up to threads (powers of two)
+static int benchSessions(const std::vector<std::string>& args) {
+    size_t sessions = benchArg(args, 1, 20000);
+    unsigned maxThreads = static_cast<unsigned>(benchArg(args, 2, std::max(1u, std::thread::hardware_concurrency())));
+    std::string dir = (std::filesystem::temp_directory_path() / "CIFileDialogTester-sessions").string();
+    std::filesystem::create_directories(dir);
+    const wchar_t* const names[] = { L"a.txt", L"b.dat", L"c.txt", L"d.dat" };
+    for (const wchar_t* name : names) {
+        std::ofstream(std::filesystem::path(dir) / name) << "x";
+    }
+
+    DialogScenario scenario;
+    scenario.name = L"sessions";
+    scenario.dialogType = 1;
+    scenario.folder = utf8ToWide(dir.c_str(), dir.size());
+    scenario.optionStates.assign(kDialogOptionCount, Default);
+    scenario.optionStates[findDialogOption(L"multiselect")] = Enabled;
+    scenario.filters.add(L"All Files", L"*.*");
+    scenario.selection.assign(names, names + 4);
+    scenario.expected = scenario.selection;
+    scenario.expectCancel = false;
+    scenario.repeat = 1;
+    scenario.line = 0;
+
+    COMFunctionPointers comFuncs = LoadCOMFunctionPointers();
+    comFuncs.pCoCreateInstance = StandInCoCreateInstance;
+    int status = 0;
+    double baseRate = 0.0;
+    std::vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(std::max(1u, maxThreads));
+    for (unsigned threads : threadCounts) {
+        std::atomic<size_t> failures(0);
+        SessionPool pool(threads, comFuncs);
+        BenchTimer timer;
+        for (size_t i = 0; i < sessions; ++i) {
+            pool.submit([&](COMFunctionPointers& workerFuncs) {
+                std::vector<std::wstring> results;
+                HRESULT hr = runDialogScenario(workerFuncs, scenario, results);
+                if (!scenarioOutcomeMatches(scenario, hr, results)) {
+                    failures.fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+        }
+        pool.wait();
+        double seconds = timer.seconds();
+        double rate = (seconds > 0.0) ? sessions / seconds : 0.0;
+        if (threads == 1) {
+            baseRate = rate;
+        }
+        printBenchResult("sessions threads=" + std::to_string(threads), sessions, seconds);
+        std::cout << std::left << std::setw(40) << "" << " speedup=" << std::fixed << std::setprecision(2) << (baseRate > 0.0 ? rate / baseRate : 0.0)
+                  << " stolen=" << pool.stolenJobs() << std::endl;
+        if (failures.load() || pool.failedJobs()) {
+            std::cerr << "sessions: " << failures.load() << " sessions did not return the selection, " << pool.failedJobs() << " threw" << std::endl;
+            status = 1;
+        }
+    }
+    FreeCOMFunctionPointers(comFuncs);
+    std::filesystem::remove_all(dir);
+    return status;
+}
+
+// Per-session COM setup. "reload" lets the table's last reference go every session, so each Load
+// loads the modules again, as every session used to; "cached" keeps a reference across sessions.
+static int benchComTable(const std::vector<std::string>& args) {
+    size_t sessions = benchArg(args, 1, 100000);
+    int status = 0;
+
+    BenchTimer timer;
+    COMFunctionPointers first = LoadCOMFunctionPointers();
+    double coldSeconds = timer.seconds();
+    std::cout << std::left << std::setw(40) << "comtable first load" << " source=" << comFunctionTableSource()
+              << " time=" << std::fixed << std::setprecision(1) << coldSeconds * 1e6 << "us" << std::endl;
+    FreeCOMFunctionPointers(first);
+
+    auto runSessions = [&](const std::string& name, size_t sessions, bool openDialog) {
+        BenchTimer timer;
+        for (size_t i = 0; i < sessions; ++i) {
+            COMFunctionPointers comFuncs = LoadCOMFunctionPointers();
+            if (!comFuncs.pCoCreateInstance) {
+                status = 1;
+                return;
+            }
+            if (openDialog) {
+                comFuncs.pCoInitialize(NULL);
+                IFileDialog* pDialog = nullptr;
+                if (SUCCEEDED(comFuncs.pCoCreateInstance(CLSID_FileOpenDialog, NULL, CLSCTX_INPROC_SERVER, IID_IFileDialog, reinterpret_cast<void**>(&pDialog)))) {
+                    pDialog->Release();
+                } else {
+                    status = 1;
+                }
+                comFuncs.pCoUninitialize();
+            }
+            FreeCOMFunctionPointers(comFuncs);
+        }
+        printBenchResult(name, sessions, timer.seconds());
+    };
+
+    // A module load per session is slow enough that a tenth of the sessions shows it
+    runSessions("comtable reload", sessions / 10, false);
+    runSessions("comtable reload + dialog", sessions / 10, true);
+    COMFunctionPointers held = LoadCOMFunctionPointers();
+    runSessions("comtable cached", sessions, false);
+    runSessions("comtable cached + dialog", sessions, true);
+
+    // Every thread must see the same table while others take and drop references
+    unsigned threadCount = std::max(2u, std::thread::hardware_concurrency());
+    std::atomic<size_t> mismatches(0);
+    std::vector<std::thread> threads;
+    timer.reset();
+    for (unsigned t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&]() {
+            for (size_t i = 0; i < sessions / threadCount; ++i) {
+                COMFunctionPointers comFuncs = LoadCOMFunctionPointers();
+                if (comFuncs.pCoCreateInstance != held.pCoCreateInstance || comFuncs.pSHCreateItemFromParsingName != held.pSHCreateItemFromParsingName) {
+                    mismatches.fetch_add(1, std::memory_order_relaxed);
+                }
+                FreeCOMFunctionPointers(comFuncs);
+                FreeCOMFunctionPointers(comFuncs);  // A second Free of the same copy must not drop another reference
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    printBenchResult("comtable cached threads=" + std::to_string(threadCount), sessions / threadCount * threadCount, timer.seconds());
+    FreeCOMFunctionPointers(held);
+    if (mismatches.load() || std::string(comFunctionTableSource()) != "none") {
+        std::cerr << "comtable: " << mismatches.load() << " mismatched tables, source after last Free: " << comFunctionTableSource() << std::endl;
+        status = 1;
+    }
+    return status;
+}
+
+// Feeds the same records to each result sink, against the per-line std::endl output it replaces.
+// Output goes to a temporary file so the terminal's speed does not enter into it.
+static int benchResults(const std::vector<std::string>& args) {
+    DWORD itemCount = static_cast<DWORD>(benchArg(args, 1, 100000));
+    COMFunctionPointers comFuncs = LoadCOMFunctionPointers();
+    IShellItemArray* pArray = createSyntheticShellItemArray(itemCount);
+    std::vector<ShellItemRecord> records;
+    HRESULT hr = extractShellItemRecords(comFuncs, pArray, records);
+    pArray->Release();
+    FreeCOMFunctionPointers(comFuncs);
+    if (FAILED(hr) || records.size() != itemCount) {
+        std::cerr << "results: expected " << itemCount << " records, got " << records.size() << std::endl;
+        return 1;
+    }
+    std::string fileName = (std::filesystem::temp_directory_path() / "CIFileDialogTester-results.out").string();
+    auto fileBytes = [&]() { return static_cast<size_t>(std::filesystem::file_size(fileName)); };
+    auto printBytes = [&](size_t bytes) {
+        std::cout << std::left << std::setw(40) << "" << " bytes=" << bytes << std::endl;
+    };
+
+    {
+        std::wofstream out(fileName, std::ios::trunc);
+        BenchTimer timer;
+        out << L"Number of items selected: " << records.size() << std::endl;
+        for (size_t i = 0; i < records.size(); ++i) {
+            const ShellItemRecord& record = records[i];
+            out << L"Item " << i << L":" << std::endl;
+            out << L" - Display name: " << record.displayName << std::endl;
+            out << L" - File path: " << record.path << std::endl;
+            out << L" - Attributes: " << record.attributes << std::endl;
+            out << L" - Parent: " << record.parent << std::endl;
+            out << L"Selected file: " << record.path << std::endl;
+        }
+        printBenchResult("results endl per line", records.size(), timer.seconds());
+    }
+    printBytes(fileBytes());
+
+    // Drives a sink the way getFileDialogResults does
+    auto feed = [&](ResultSink& sink) {
+        BenchTimer timer;
+        sink.begin(records.size());
+        ResultItem item = {};
+        for (size_t i = 0; i < records.size(); ++i) {
+            item.index = i;
+            item.path = records[i].path;
+            if (sink.verbosity() == ResultVerbosityFull) {
+                item.displayName = records[i].displayName;
+                item.parent = records[i].parent;
+                item.attributes = records[i].attributes;
+            }
+            sink.item(item);
+        }
+        sink.end();
+        return timer.seconds();
+    };
+
+    NullResultSink nullSink;
+    printBenchResult("results null", records.size(), feed(nullSink));
+    int status = nullSink.items() == records.size() ? 0 : 1;
+
+    {
+        std::wofstream out(fileName, std::ios::trunc);
+        TextResultSink sink(out, ResultVerbosityFull);
+        printBenchResult("results text", records.size(), feed(sink));
+    }
+    printBytes(fileBytes());
+
+    struct FileSinkConfig {
+        const char* name;
+        bool binary;
+        ResultVerbosity verbosity;
+    };
+    const FileSinkConfig configs[] = {
+        { "results ndjson", false, ResultVerbosityFull },
+        { "results ndjson paths", false, ResultVerbosityPaths },
+        { "results binary", true, ResultVerbosityFull },
+        { "results binary paths", true, ResultVerbosityPaths },
+    };
+    for (const FileSinkConfig& config : configs) {
+        FILE* file = fopen(fileName.c_str(), "wb");
+        if (!file) {
+            std::cerr << "results: cannot open " << fileName << std::endl;
+            return 1;
+        }
+        double seconds;
+        if (config.binary) {
+            BinaryResultSink sink(file, config.verbosity);
+            seconds = feed(sink);
+        } else {
+            NdjsonResultSink sink(file, config.verbosity);
+            seconds = feed(sink);
+        }
+        fclose(file);
+        printBenchResult(config.name, records.size(), seconds);
+        printBytes(fileBytes());
+    }
+
+    std::filesystem::remove(fileName);
+    return status;
+}
+
+// Failure reporting on a hot path: a formatted wcerr-style line per failure against a trace record,
+// with the file drain running, then a decode of that file checked against what was written and lost
+static int benchTrace(const std::vector<std::string>& args) {
+    size_t records = benchArg(args, 1, 1000000);
+    const HRESULT failure = static_cast<HRESULT>(0x80004005);
+    std::string fileName = (std::filesystem::temp_directory_path() / "CIFileDialogTester-trace.bin").string();
+    int status = 0;
+
+    // Drained phases first, so the rings hold nothing from an earlier phase. A burst outruns the
+    // drain and loses records; flushing every 1024 (a quarter ring) should lose none.
+    BenchTimer timer;
+    const size_t bursts[] = { records, 1024 };
+    for (size_t burst : bursts) {
+        std::string name = burst >= records ? "trace file drain" : "trace file drain flush=" + std::to_string(burst);
+        startTraceFile(fileName);
+        uint64_t lostBefore = traceRecordsLost();
+        size_t allocationsBefore = benchAllocationCount();
+        timer.reset();
+        for (size_t i = 0; i < records; ++i) {
+            trace(kTraceReadItemFailed, failure, i);
+            if ((i + 1) % burst == 0) {
+                flushTrace();
+            }
+        }
+        double seconds = timer.seconds();
+        size_t allocations = benchAllocationCount() - allocationsBefore;
+        stopTrace();
+        uint64_t lost = traceRecordsLost() - lostBefore;
+        printBenchResult(name, records, seconds);
+        std::cout << std::left << std::setw(40) << "" << " lost=" << lost
+                  << " allocations=" << (benchCountsAllocations() ? std::to_string(allocations) : std::string("n/a")) << std::endl;
+
+        std::wostringstream decoded;
+        decodeTraceFile(fileName, decoded);
+        std::wistringstream lines(decoded.str());
+        std::wstring line;
+        size_t kept = 0;
+        while (std::getline(lines, line)) {
+            if (line.find(L": Failed to read item") != std::wstring::npos) {
+                ++kept;
+            }
+        }
+        if (kept + lost != records || (burst < records && lost != 0)) {
+            std::cerr << name << ": wrote " << records << ", decoded " << kept << ", lost " << lost << std::endl;
+            status = 1;
+        }
+    }
+
+    timer.reset();
+    for (size_t i = 0; i < records; ++i) {
+        trace(kTraceReadItemFailed, failure, i);
+    }
+    printBenchResult("trace no drain", records, timer.seconds());
+
+    std::wofstream text(fileName, std::ios::trunc);
+    timer.reset();
+    for (size_t i = 0; i < records; ++i) {
+        text << L"Failed to read item " << i << L". HRESULT: " << failure << std::endl;
+    }
+    printBenchResult("wcerr-style line", records, timer.seconds());
+    text.close();
+
+    std::filesystem::remove(fileName);
+    return status;
+}
+
+#ifndef _WIN32
+// createShellItem over a real directory (one statx per item), then repeated property queries
+// that must be served from the cached metadata
+static int benchPosixItems(const std::vector<std::string>& args) {
+    std::string dir = (args.size() > 1) ? args[1] : "/usr/include";
+    size_t rounds = benchArg(args, 2, 10);
+
+    std::vector<std::wstring> paths;
+    if (DIR* pDir = opendir(dir.c_str())) {
+        while (dirent* pEntry = readdir(pDir)) {
+            std::string name = pEntry->d_name;
+            if (name != "." && name != "..") {
+                std::string path = dir + "/" + name;
+                paths.push_back(utf8ToWide(path.c_str(), path.size()));
+            }
+        }
+        closedir(pDir);
+    }
+    if (paths.empty()) {
+        std::cerr << "posix-items: no entries in " << dir << std::endl;
+        return 1;
+    }
+
+    COMFunctionPointers comFuncs = LoadCOMFunctionPointers();
+    std::vector<IShellItem*> items;
+    items.reserve(paths.size());
+    BenchTimer timer;
+    for (const std::wstring& path : paths) {
+        if (IShellItem* pItem = createShellItem(comFuncs, path)) {
+            items.push_back(pItem);
+        }
+    }
+    printBenchResult("posix-items create", items.size(), timer.seconds());
+
+    size_t folders = 0;
+    timer.reset();
+    for (size_t round = 0; round < rounds; ++round) {
+        for (size_t i = 0; i < items.size(); ++i) {
+            LPWSTR pszName = nullptr;
+            if (SUCCEEDED(items[i]->GetDisplayName(SIGDN_NORMALDISPLAY, &pszName))) {
+                comFuncs.pCoTaskMemFree(pszName);
+            }
+            LPWSTR pszPath = nullptr;
+            if (SUCCEEDED(items[i]->GetDisplayName(SIGDN_FILESYSPATH, &pszPath))) {
+                comFuncs.pCoTaskMemFree(pszPath);
+            }
+            SFGAOF attributes = 0;
+            items[i]->GetAttributes(SFGAO_FILESYSTEM | SFGAO_FOLDER, &attributes);
+            folders += (attributes & SFGAO_FOLDER) ? 1 : 0;
+            int order = 0;
+            items[i]->Compare(items[(i + 1) % items.size()], SICHINT_CANONICAL, &order);
+        }
+    }
+    printBenchResult("posix-items cached queries", items.size() * rounds, timer.seconds());
+
+    for (IShellItem* pItem : items) {
+        pItem->Release();
+    }
+    FreeCOMFunctionPointers(comFuncs);
+    return 0;
+}
+
+// Directory of entries empty files, created on first use
+static bool populateBenchDirectory(const std::string& dir, size_t entries) {
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    for (size_t i = 0; i < entries; ++i) {
+        std::string name = dir + "/entry" + std::to_string(i) + ".dat";
+        int fd = open(name.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        close(fd);
+    }
+    return true;
+}
+
+// Enumerating a directory: getdents64 (readdir outside Linux) snapshot plus batched Next, against
+// readdir with one SHCreateItemFromParsingName per entry; then Clone/Skip cost on the shared snapshot
+static int benchEnumDirectory(const std::vector<std::string>& args) {
+    std::vector<size_t> sizes;
+    bool keep = false;
+    for (size_t i = 1; i < args.size(); ++i) {
+        if (args[i] == "keep") {
+            keep = true;
+        } else if (size_t size = benchArg(args, i, 0)) {
+            sizes.push_back(size);
+        }
+    }
+    if (sizes.empty()) {
+        sizes = { 10000, 100000, 1000000 };
+    }
+
+    COMFunctionPointers comFuncs = LoadCOMFunctionPointers();
+    int status = 0;
+    for (size_t entries : sizes) {
+        std::string dir = (std::filesystem::temp_directory_path() / ("CIFileDialogTester-enum-" + std::to_string(entries))).string();
+        if (!populateBenchDirectory(dir, entries)) {
+            std::cerr << "enumdir: cannot populate " << dir << std::endl;
+            status = 1;
+            break;
+        }
+        std::wstring wideDir = utf8ToWide(dir.c_str(), dir.size());
+        std::string label = "enumdir " + std::to_string(entries);
+
+        BenchTimer timer;
+        std::shared_ptr<const DirectorySnapshot> snapshot;
+        readDirectorySnapshot(wideDir, snapshot);
+        printBenchResult(label + " snapshot", snapshot ? snapshot->entries.size() : 0, timer.seconds());
+
+        IShellItem* batch[256];
+        size_t enumerated = 0;
+        timer.reset();
+        IEnumShellItems* pEnum = nullptr;
+        if (SUCCEEDED(createDirectoryEnumerator(wideDir, &pEnum))) {
+            ULONG fetched = 0;
+            do {
+                pEnum->Next(256, batch, &fetched);
+                for (ULONG i = 0; i < fetched; ++i) {
+                    batch[i]->Release();
+                }
+                enumerated += fetched;
+            } while (fetched == 256);
+            pEnum->Release();
+        }
+        printBenchResult(label + " Next(256)", enumerated, timer.seconds());
+
+        size_t created = 0;
+        timer.reset();
+        if (DIR* pDir = opendir(dir.c_str())) {
+            while (dirent* pEntry = readdir(pDir)) {
+                std::string name = pEntry->d_name;
+                if (name == "." || name == "..") {
+                    continue;
+                }
+                std::string path = dir + "/" + name;
+                if (IShellItem* pItem = createShellItem(comFuncs, utf8ToWide(path.c_str(), path.size()))) {
+                    pItem->Release();
+                    ++created;
+                }
+            }
+            closedir(pDir);
+        }
+        printBenchResult(label + " readdir+parse", created, timer.seconds());
+
+        const size_t operations = 1000000;
+        timer.reset();
+        createDirectoryEnumerator(snapshot, &pEnum);
+        for (size_t i = 0; i < operations; ++i) {
+            IEnumShellItems* pClone = nullptr;
+            pEnum->Skip(7);
+            if (pEnum->Skip(0) == S_FALSE || i % 1024 == 0) {
+                pEnum->Reset();
+            }
+            pEnum->Clone(&pClone);
+            pClone->Release();
+        }
+        pEnum->Release();
+        printBenchResult(label + " Skip+Clone", operations, timer.seconds());
+
+        if (enumerated != entries || created != entries) {
+            std::cerr << "enumdir: expected " << entries << " entries, enumerated " << enumerated << ", created " << created << std::endl;
+            status = 1;
+        }
+        if (!keep) {
+            std::error_code ec;
+            std::filesystem::remove_all(dir, ec);
+        }
+    }
+    FreeCOMFunctionPointers(comFuncs);
+    return status;
+}
+
+static void printBenchLatency(const std::string& name, double firstItemSeconds, double completeSeconds) {
+    std::cout << std::left << std::setw(40) << name << std::fixed << std::setprecision(3)
+              << " first item=" << firstItemSeconds * 1000.0 << "ms"
+              << " complete=" << completeSeconds * 1000.0 << "ms" << std::endl;
+}
+
+// Time-to-first-item and time-to-complete for a folder listing: serial enumeration at Show time,
+// prefetch started at SetFolder with setupms of other configuration work before Show, and how
+// quickly a superseded prefetch winds down
+static int benchPrefetch(const std::vector<std::string>& args) {
+    size_t entries = benchArg(args, 1, 100000);
+    size_t setupMilliseconds = benchArg(args, 2, 20);
+    std::string dir = (std::filesystem::temp_directory_path() / ("CIFileDialogTester-prefetch-" + std::to_string(entries))).string();
+    if (!populateBenchDirectory(dir, entries)) {
+        std::cerr << "prefetch: cannot populate " << dir << std::endl;
+        return 1;
+    }
+    std::wstring wideDir = utf8ToWide(dir.c_str(), dir.size());
+    COMFunctionPointers comFuncs = LoadCOMFunctionPointers();
+    IShellItem* pFolder = createShellItem(comFuncs, wideDir);
+    if (!pFolder) {
+        std::filesystem::remove_all(dir);
+        return 1;
+    }
+    std::cout << "prefetch workers=" << folderPrefetchWorkers() << std::endl;
+
+    // Serial: nothing happens until Show, which then walks the folder itself
+    BenchTimer timer;
+    double firstItem = -1.0;
+    size_t listed = 0;
+    IEnumShellItems* pEnum = nullptr;
+    if (SUCCEEDED(pFolder->BindToHandler(NULL, BHID_EnumItems, IID_IEnumShellItems, reinterpret_cast<void**>(&pEnum)))) {
+        IShellItem* batch[256];
+        ULONG fetched = 0;
+        do {
+            pEnum->Next(256, batch, &fetched);
+            if (fetched && firstItem < 0.0) {
+                firstItem = timer.seconds();
+            }
+            for (ULONG i = 0; i < fetched; ++i) {
+                batch[i]->Release();
+            }
+            listed += fetched;
+        } while (fetched == 256);
+        pEnum->Release();
+    }
+    printBenchLatency("prefetch serial at Show", firstItem, timer.seconds());
+
+    std::shared_ptr<FolderPrefetch> prefetch = startFolderPrefetch(pFolder);
+    prefetch->waitForCompletion();
+    FolderPrefetchMetrics metrics = prefetch->metrics();
+    printBenchLatency("prefetch pool", metrics.firstItemSeconds, metrics.completeSeconds);
+    size_t prefetched = metrics.itemCount;
+
+    // Through the stand-in dialog: SetFolder, other setup work, then Show
+    setStandInFolderPrefetch(true);
+    IFileDialog* pDialog = nullptr;
+    StandInCoCreateInstance(CLSID_FileOpenDialog, NULL, CLSCTX_INPROC_SERVER, IID_IFileDialog, reinterpret_cast<void**>(&pDialog));
+    pDialog->SetFolder(pFolder);
+    std::this_thread::sleep_for(std::chrono::milliseconds(setupMilliseconds));
+    timer.reset();
+    pDialog->Show(NULL);
+    double showWait = timer.seconds();
+    IStandInDialogControl* pControl = nullptr;
+    pDialog->QueryInterface(IID_IStandInDialogControl, reinterpret_cast<void**>(&pControl));
+    pControl->GetPrefetchMetrics(&metrics);
+    pControl->Release();
+    setStandInFolderPrefetch(false);
+    std::cout << std::left << std::setw(40) << "prefetch dialog Show" << std::fixed << std::setprecision(3)
+              << " wait=" << showWait * 1000.0 << "ms after " << setupMilliseconds << "ms setup;"
+              << " first item=" << metrics.firstItemSeconds * 1000.0 << "ms after SetFolder" << std::endl;
+
+    // Cancellation: a second SetFolder supersedes the first prefetch
+    prefetch = startFolderPrefetch(pFolder);
+    timer.reset();
+    prefetch->cancel();
+    HRESULT cancelHr = prefetch->waitForCompletion();
+    std::cout << std::left << std::setw(40) << "prefetch cancel" << std::fixed << std::setprecision(3)
+              << " returned after " << timer.seconds() * 1000.0 << "ms"
+              << (cancelHr == E_ABORT ? " (E_ABORT)" : " (unexpected HRESULT)") << std::endl;
+    prefetch.reset();
+    pDialog->Release();
+    pFolder->Release();
+    FreeCOMFunctionPointers(comFuncs);
+
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    if (listed != entries || prefetched != entries) {
+        std::cerr << "prefetch: expected " << entries << " entries, serial " << listed << ", prefetched " << prefetched << std::endl;
+        return 1;
+    }
+    return 0;
+}
+#endif // _WIN32
+
+static const BenchEntry benchmarks[] = {
+    { "extract", "extract [items=1000000]", benchExtract },
+    { "pathtable", "pathtable [items=1000000]", benchPathTable },
+    { "filters", "filters [names=1000000]", benchFilters },
+    { "recent", "recent [entries=10000] [queries=100000]", benchRecent },
+    { "lazyarray", "lazyarray [items=1000000]", benchLazyArray },
+    { "sort", "sort [items=1000000] [threads=cores]", benchSort },
+    { "eventsinks", "eventsinks [dispatchers=cores] [churn=200000]", benchEventSinks },
+    { "eventstorm", "eventstorm [events=1000000] [dialogs=64] [handlerns=2000] [producers=2]", benchEventStorm },
+    { "comtable", "comtable [sessions=100000]", benchComTable },
+    { "sessions", "sessions [sessions=20000] [threads=cores]", benchSessions },
+    { "itempool", "itempool [items=1000000] [rounds=3]", benchItemPool },
+    { "pathtrie", "pathtrie [items=200000] [depth=16] [perfolder=1000]", benchPathTrie },
+    { "names", "names [items=200000] [rounds=5]", benchDisplayNames },
+    { "factory", "factory [sessions=100000]", benchFactory },
+    { "qi", "qi [calls=10000000]", benchQueryInterface },
+    { "refcount", "refcount [items=100000]", benchRefCount },
+    { "results", "results [items=100000]", benchResults },
+    { "trace", "trace [records=1000000]", benchTrace },
+#ifndef _WIN32
+    { "posix-items", "posix-items [dir=/usr/include] [rounds=10]", benchPosixItems },
+    { "enumdir", "enumdir [entries...=10000 100000 1000000] [keep]", benchEnumDirectory },
+    { "prefetch", "prefetch [entries=100000] [setupms=20]", benchPrefetch },
+#endif
+};
+
+int runBenchmark(const std::vector<std::string>& args) {
+    if (!args.empty()) {
+        for (const BenchEntry& entry : benchmarks) {
+            if (args[0] == entry.name) {
+                return entry.run(args);
+            }
+        }
+        std::cerr << "Unknown benchmark: " << args[0] << std::endl;
+    }
+
+    std::cerr << "Usage: CIFileDialogTester --bench <name> [args]" << std::endl;
+    for (const BenchEntry& entry : benchmarks) {
+        std::cerr << "  " << entry.usage << std::endl;
+    }
+    return args.empty() ? 0 : 1;
+}
@@ -0,0 +1,54 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Wall-clock stopwatch for the benchmark modes
+class BenchTimer {
+public:
+    BenchTimer() : start(std::chrono::steady_clock::now()) {}
+
+    void reset() {
+        start = std::chrono::steady_clock::now();
+    }
+
+    double seconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+// Print one result line: name, item count, elapsed time and throughput
+void printBenchResult(const std::string& name, size_t items, double seconds);
+
+// Whether the figures below are counted. Only CIFileDialogBench replaces the global allocation
+// functions with counting versions (BenchAllocationCounter.cpp); in CIFileDialogTester they are
+// all 0 and the print helpers say so.
+bool benchCountsAllocations();
+
+// Number of global operator new calls made by this process so far; take the difference around
+// the code being measured
+size_t benchAllocationCount();
+
+// Print an allocation count line below a result line
+void printBenchAllocations(size_t allocations, size_t items);
+
+// Heap bytes requested through global operator new and not yet freed, as counted by the same
+// replacement functions.
+// benchResetPeakBytes restarts the high-water mark at the current live size and returns it.
+size_t benchLiveBytes();
+size_t benchResetPeakBytes();
+size_t benchPeakBytes();
+
+// Print a peak heap line below a result line
+void printBenchPeakBytes(size_t bytes, size_t items);
+
+// Run the benchmark named args[0] with the remaining args. Lists benchmarks when args is empty.
+// Returns a process exit code.
+int runBenchmark(const std::vector<std::string>& args);
+
+#endif // BENCH_H
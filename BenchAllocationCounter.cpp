@@ -0,0 +1,186 @@
+// Allocation and heap figures for --bench. Only CIFileDialogBench is built with
+// BENCH_COUNT_ALLOCATIONS (see CMakeLists.txt): there every replaceable global operator new and
+// delete goes through the counting pair below. CIFileDialogTester keeps the runtime's allocator
+// untouched and reports no figures.
+#include "Bench.h"
+
+#ifdef BENCH_COUNT_ALLOCATIONS
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<size_t> allocationCount(0);
+static std::atomic<size_t> liveBytes(0);
+static std::atomic<size_t> peakBytes(0);
+
+// Written just below every block, so a free needs neither its size nor its alignment, and no
+// allocator-specific size query
+struct CountedBlockHeader {
+    void* raw;    // What malloc returned
+    size_t size;  // Bytes asked for
+};
+
+// Every replaceable allocation function below funnels into these two, so memory the library gets
+// from a form the program never names (std::stable_sort's nothrow buffer, over-aligned types) is
+// counted and, above all, comes back to the matching free
+static void* countedAllocate(size_t size, size_t alignment) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    alignment = std::max(alignment, alignof(std::max_align_t));
+    void* raw = std::malloc(size + sizeof(CountedBlockHeader) + alignment - 1);
+    if (!raw) {
+        return nullptr;
+    }
+    uintptr_t block = (reinterpret_cast<uintptr_t>(raw) + sizeof(CountedBlockHeader) + alignment - 1) & ~(uintptr_t(alignment) - 1);
+    CountedBlockHeader* header = reinterpret_cast<CountedBlockHeader*>(block) - 1;
+    header->raw = raw;
+    header->size = size;
+    size_t live = liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    size_t peak = peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+    return reinterpret_cast<void*>(block);
+}
+
+static void countedFree(void* p) {
+    if (!p) {
+        return;
+    }
+    CountedBlockHeader* header = static_cast<CountedBlockHeader*>(p) - 1;
+    liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+    std::free(header->raw);
+}
+
+void* operator new(size_t size) {
+    if (void* p = countedAllocate(size, 0)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    if (void* p = countedAllocate(size, static_cast<size_t>(alignment))) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return countedAllocate(size, 0);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return countedAllocate(size, 0);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return countedAllocate(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return countedAllocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* p) noexcept {
+    countedFree(p);
+}
+
+void operator delete[](void* p) noexcept {
+    countedFree(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    countedFree(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    countedFree(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    countedFree(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    countedFree(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    countedFree(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept {
+    countedFree(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    countedFree(p);
+}
+
+void operator delete[](void* p, size_t, std::align_val_t) noexcept {
+    countedFree(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    countedFree(p);
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    countedFree(p);
+}
+
+bool benchCountsAllocations() {
+    return true;
+}
+
+size_t benchAllocationCount() {
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+size_t benchLiveBytes() {
+    return liveBytes.load(std::memory_order_relaxed);
+}
+
+size_t benchResetPeakBytes() {
+    size_t live = liveBytes.load(std::memory_order_relaxed);
+    peakBytes.store(live, std::memory_order_relaxed);
+    return live;
+}
+
+size_t benchPeakBytes() {
+    return peakBytes.load(std::memory_order_relaxed);
+}
+
+#else
+
+bool benchCountsAllocations() {
+    return false;
+}
+
+size_t benchAllocationCount() {
+    return 0;
+}
+
+size_t benchLiveBytes() {
+    return 0;
+}
+
+size_t benchResetPeakBytes() {
+    return 0;
+}
+
+size_t benchPeakBytes() {
+    return 0;
+}
+
+#endif // BENCH_COUNT_ALLOCATIONS
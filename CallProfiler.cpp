@@ -0,0 +1,218 @@
+#include "CallProfiler.h"
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Log-linear buckets: values below 16 ns get one bucket each, then every power of two is split
+// into 16 sub-buckets, so a bucket's width is at most 1/16 of its values. Durations are clamped to
+// 2^40 ns (about 18 minutes).
+static const unsigned kSubBucketBits = 4;
+static const uint64_t kSubBuckets = uint64_t(1) << kSubBucketBits;
+static const unsigned kMaxExponent = 40;
+static const size_t kBucketCount = (kMaxExponent - kSubBucketBits + 1) * kSubBuckets;
+const size_t kLatencyBucketCount = kBucketCount;
+
+static unsigned highestBit(uint64_t value) {
+#ifdef _MSC_VER
+    unsigned long index = 0;
+    _BitScanReverse64(&index, value);
+    return static_cast<unsigned>(index);
+#else
+    return 63 - static_cast<unsigned>(__builtin_clzll(value));
+#endif
+}
+
+size_t latencyBucket(uint64_t value) {
+    value = std::min(value, (uint64_t(1) << kMaxExponent) - 1);
+    if (value < kSubBuckets) {
+        return static_cast<size_t>(value);
+    }
+    unsigned exponent = highestBit(value);
+    return static_cast<size_t>((exponent - kSubBucketBits + 1) * kSubBuckets + (value >> (exponent - kSubBucketBits)) - kSubBuckets);
+}
+
+// Largest value that lands in bucket index
+uint64_t latencyBucketUpperBound(size_t index) {
+    if (index < kSubBuckets) {
+        return index;
+    }
+    uint64_t shift = index / kSubBuckets - 1;
+    uint64_t subBucket = kSubBuckets + index % kSubBuckets;
+    return ((subBucket + 1) << shift) - 1;
+}
+
+// Counters written only by the owning thread; relaxed load + store keeps them race-free to read
+struct MethodCounters {
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> totalNanoseconds;
+    std::atomic<uint64_t> maxNanoseconds;
+    std::atomic<uint64_t> buckets[kBucketCount];
+};
+
+struct ProfileShard {
+    MethodCounters methods[kProfiledMethodCount];
+};
+
+static void addTo(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+class ProfileRegistry {
+public:
+    // Never destroyed: pool threads may still record while statics are torn down
+    static ProfileRegistry& instance() {
+        static ProfileRegistry* registry = new ProfileRegistry();
+        return *registry;
+    }
+
+    ProfileShard* addShard() {
+        std::lock_guard<std::mutex> lock(mutex);
+        shards.push_back(std::unique_ptr<ProfileShard>(new ProfileShard()));
+        return shards.back().get();
+    }
+
+    template <typename Fn>
+    void forEachShard(Fn fn) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const std::unique_ptr<ProfileShard>& shard : shards) {
+            fn(*shard);
+        }
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ProfileShard>> shards;  // Kept after their thread exits
+};
+
+static thread_local ProfileShard* threadShard = nullptr;
+
+#define PROFILED_METHOD_NAME(iface, method) #iface "::" #method,
+static const char* const kProfiledMethodNames[] = {
+    PROFILED_METHODS(PROFILED_METHOD_NAME)
+};
+#undef PROFILED_METHOD_NAME
+
+const char* profiledMethodName(ProfiledMethod method) {
+    return kProfiledMethodNames[method];
+}
+
+void recordProfiledCall(ProfiledMethod method, uint64_t nanoseconds) {
+    if (!threadShard) {
+        threadShard = ProfileRegistry::instance().addShard();
+    }
+    MethodCounters& counters = threadShard->methods[method];
+    addTo(counters.calls, 1);
+    addTo(counters.totalNanoseconds, nanoseconds);
+    addTo(counters.buckets[latencyBucket(nanoseconds)], 1);
+    if (nanoseconds > counters.maxNanoseconds.load(std::memory_order_relaxed)) {
+        counters.maxNanoseconds.store(nanoseconds, std::memory_order_relaxed);
+    }
+}
+
+uint64_t latencyPercentile(const uint64_t* buckets, double fraction, uint64_t maxNanoseconds) {
+    uint64_t counted = 0;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        counted += buckets[i];
+    }
+    if (!counted) {
+        return 0;
+    }
+    uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(fraction * counted + 0.5), 1);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::min(latencyBucketUpperBound(i), maxNanoseconds);
+        }
+    }
+    return maxNanoseconds;
+}
+
+ProfiledMethodSummary summarizeProfiledMethod(ProfiledMethod method) {
+    ProfiledMethodSummary summary = {};
+    std::vector<uint64_t> buckets(kBucketCount, 0);
+    ProfileRegistry::instance().forEachShard([&](ProfileShard& shard) {
+        MethodCounters& counters = shard.methods[method];
+        summary.calls += counters.calls.load(std::memory_order_relaxed);
+        summary.totalNanoseconds += counters.totalNanoseconds.load(std::memory_order_relaxed);
+        summary.maxNanoseconds = std::max(summary.maxNanoseconds, counters.maxNanoseconds.load(std::memory_order_relaxed));
+        for (size_t i = 0; i < kBucketCount; ++i) {
+            buckets[i] += counters.buckets[i].load(std::memory_order_relaxed);
+        }
+    });
+
+    // Histogram totals can trail calls by a racing record; rank against what the buckets hold
+    summary.p50Nanoseconds = latencyPercentile(buckets.data(), 0.50, summary.maxNanoseconds);
+    summary.p90Nanoseconds = latencyPercentile(buckets.data(), 0.90, summary.maxNanoseconds);
+    summary.p99Nanoseconds = latencyPercentile(buckets.data(), 0.99, summary.maxNanoseconds);
+    return summary;
+}
+
+// 850ns, 12.3us, 4.56ms, 1.23s
+static std::wstring formatDuration(uint64_t nanoseconds) {
+    std::wostringstream out;
+    out << std::fixed;
+    if (nanoseconds < 1000) {
+        out << nanoseconds << L"ns";
+    } else if (nanoseconds < 1000000) {
+        out << std::setprecision(1) << nanoseconds / 1e3 << L"us";
+    } else if (nanoseconds < 1000000000) {
+        out << std::setprecision(2) << nanoseconds / 1e6 << L"ms";
+    } else {
+        out << std::setprecision(2) << nanoseconds / 1e9 << L"s";
+    }
+    return out.str();
+}
+
+void printCallProfile(std::wostream& out) {
+    std::vector<std::pair<ProfiledMethod, ProfiledMethodSummary>> rows;
+    for (int method = 0; method < kProfiledMethodCount; ++method) {
+        ProfiledMethodSummary summary = summarizeProfiledMethod(static_cast<ProfiledMethod>(method));
+        if (summary.calls) {
+            rows.emplace_back(static_cast<ProfiledMethod>(method), summary);
+        }
+    }
+    std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+        return a.second.totalNanoseconds > b.second.totalNanoseconds;
+    });
+
+    out << std::left << std::setw(40) << L"method" << std::right
+        << std::setw(12) << L"calls" << std::setw(10) << L"total" << std::setw(10) << L"mean"
+        << std::setw(10) << L"p50" << std::setw(10) << L"p90" << std::setw(10) << L"p99" << std::setw(10) << L"max" << std::endl;
+    for (const auto& row : rows) {
+        const ProfiledMethodSummary& summary = row.second;
+        std::string name = profiledMethodName(row.first);
+        out << std::left << std::setw(40) << std::wstring(name.begin(), name.end()) << std::right
+            << std::setw(12) << summary.calls
+            << std::setw(10) << formatDuration(summary.totalNanoseconds)
+            << std::setw(10) << formatDuration(summary.totalNanoseconds / summary.calls)
+            << std::setw(10) << formatDuration(summary.p50Nanoseconds)
+            << std::setw(10) << formatDuration(summary.p90Nanoseconds)
+            << std::setw(10) << formatDuration(summary.p99Nanoseconds)
+            << std::setw(10) << formatDuration(summary.maxNanoseconds) << std::endl;
+    }
+    if (rows.empty()) {
+        out << L"(no profiled calls)" << std::endl;
+    }
+}
+
+void resetCallProfile() {
+    ProfileRegistry::instance().forEachShard([](ProfileShard& shard) {
+        for (MethodCounters& counters : shard.methods) {
+            counters.calls.store(0, std::memory_order_relaxed);
+            counters.totalNanoseconds.store(0, std::memory_order_relaxed);
+            counters.maxNanoseconds.store(0, std::memory_order_relaxed);
+            for (std::atomic<uint64_t>& bucket : counters.buckets) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+    });
+}
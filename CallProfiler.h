@@ -0,0 +1,106 @@
+#ifndef CALL_PROFILER_H
+#define CALL_PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include "IFileDialog.h"
+
+// Every method the profiling proxies time, as X(interface, method)
+#define PROFILED_METHODS(X) \
+    X(IShellItem, BindToHandler) \
+    X(IShellItem, GetParent) \
+    X(IShellItem, GetDisplayName) \
+    X(IShellItem, GetAttributes) \
+    X(IShellItem, Compare) \
+    X(IShellItemArray, GetCount) \
+    X(IShellItemArray, GetItemAt) \
+    X(IShellItemArray, EnumItems) \
+    X(IEnumShellItems, Next) \
+    X(IEnumShellItems, Skip) \
+    X(IEnumShellItems, Reset) \
+    X(IEnumShellItems, Clone) \
+    X(IModalWindow, Show) \
+    X(IFileDialog, SetFileTypes) \
+    X(IFileDialog, SetFileTypeIndex) \
+    X(IFileDialog, GetFileTypeIndex) \
+    X(IFileDialog, Advise) \
+    X(IFileDialog, Unadvise) \
+    X(IFileDialog, SetOptions) \
+    X(IFileDialog, GetOptions) \
+    X(IFileDialog, SetDefaultFolder) \
+    X(IFileDialog, SetFolder) \
+    X(IFileDialog, GetFolder) \
+    X(IFileDialog, GetCurrentSelection) \
+    X(IFileDialog, SetFileName) \
+    X(IFileDialog, GetFileName) \
+    X(IFileDialog, SetTitle) \
+    X(IFileDialog, SetOkButtonLabel) \
+    X(IFileDialog, SetFileNameLabel) \
+    X(IFileDialog, GetResult) \
+    X(IFileDialog, AddPlace) \
+    X(IFileDialog, SetDefaultExtension) \
+    X(IFileDialog, Close) \
+    X(IFileDialog, SetClientGuid) \
+    X(IFileDialog, ClearClientData) \
+    X(IFileDialog, SetFilter) \
+    X(IFileOpenDialog, GetResults) \
+    X(IFileOpenDialog, GetSelectedItems) \
+    X(IFileSaveDialog, SetSaveAsItem) \
+    X(IFileSaveDialog, SetProperties) \
+    X(IFileSaveDialog, SetCollectedProperties) \
+    X(IFileSaveDialog, GetProperties) \
+    X(IFileSaveDialog, ApplyProperties)
+
+#define PROFILED_METHOD_ID(iface, method) k##iface##_##method,
+enum ProfiledMethod {
+    PROFILED_METHODS(PROFILED_METHOD_ID)
+    kProfiledMethodCount
+};
+#undef PROFILED_METHOD_ID
+
+// "IShellItem::GetDisplayName"
+const char* profiledMethodName(ProfiledMethod method);
+
+// Add one call of the given duration to the calling thread's histogram for method. Threads only
+// ever write their own counters, so recording takes no lock and no atomic read-modify-write.
+void recordProfiledCall(ProfiledMethod method, uint64_t nanoseconds);
+
+// Time call() and record it under method
+template <typename Call>
+inline HRESULT profileCall(ProfiledMethod method, Call call) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    HRESULT hr = call();
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+    recordProfiledCall(method, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    return hr;
+}
+
+// Log-linear latency buckets shared with other latency counters: values below 16 ns get one
+// bucket each, then every power of two is split into 16, so a bucket is within 1/16 of its values
+extern const size_t kLatencyBucketCount;
+size_t latencyBucket(uint64_t nanoseconds);
+uint64_t latencyBucketUpperBound(size_t bucket);
+
+// Upper bound of the bucket holding the given fraction (0.5 for p50) of counted values, capped at max
+uint64_t latencyPercentile(const uint64_t* buckets, double fraction, uint64_t maxNanoseconds);
+
+// Merged view of one method across threads
+struct ProfiledMethodSummary {
+    uint64_t calls;
+    uint64_t totalNanoseconds;
+    uint64_t maxNanoseconds;
+    uint64_t p50Nanoseconds;  // Percentiles are bucket upper bounds, within 1/16 of the true value
+    uint64_t p90Nanoseconds;
+    uint64_t p99Nanoseconds;
+};
+
+ProfiledMethodSummary summarizeProfiledMethod(ProfiledMethod method);
+
+// Table of every method called since the last reset, slowest total first
+void printCallProfile(std::wostream& out);
+
+// Zero every thread's counters. Only meaningful while no profiled calls are in flight.
+void resetCallProfile();
+
+#endif // CALL_PROFILER_H
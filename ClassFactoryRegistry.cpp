@@ -0,0 +1,88 @@
+#include "ClassFactoryRegistry.h"
+
+ClassFactoryRegistry::~ClassFactoryRegistry() {
+    for (const Entry& entry : entries) {
+        entry.pFactory->Release();
+    }
+}
+
+HRESULT ClassFactoryRegistry::registerClass(REFCLSID rclsid, IClassFactory* pFactory) {
+    if (!pFactory) {
+        return E_POINTER;
+    }
+    pFactory->AddRef();
+    IClassFactory* pReplaced = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Entry& entry : entries) {
+            if (guidEquals(entry.clsid, rclsid)) {
+                pReplaced = entry.pFactory;
+                entry.pFactory = pFactory;
+                break;
+            }
+        }
+        if (!pReplaced) {
+            entries.push_back(Entry{rclsid, pFactory});
+        }
+    }
+    // Outside the lock: a factory's last Release may tear down objects that create others
+    if (pReplaced) {
+        pReplaced->Release();
+    }
+    return S_OK;
+}
+
+HRESULT ClassFactoryRegistry::revokeClass(REFCLSID rclsid) {
+    IClassFactory* pRevoked = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (guidEquals(entries[i].clsid, rclsid)) {
+                pRevoked = entries[i].pFactory;
+                entries.erase(entries.begin() + i);
+                break;
+            }
+        }
+    }
+    if (!pRevoked) {
+        return REGDB_E_CLASSNOTREG;
+    }
+    pRevoked->Release();
+    return S_OK;
+}
+
+HRESULT ClassFactoryRegistry::getClassObject(REFCLSID rclsid, IClassFactory** ppFactory) {
+    if (!ppFactory) {
+        return E_POINTER;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const Entry& entry : entries) {
+        if (guidEquals(entry.clsid, rclsid)) {
+            entry.pFactory->AddRef();
+            *ppFactory = entry.pFactory;
+            return S_OK;
+        }
+    }
+    *ppFactory = nullptr;
+    return REGDB_E_CLASSNOTREG;
+}
+
+HRESULT ClassFactoryRegistry::createInstance(REFCLSID rclsid, IUnknown* pUnkOuter, REFIID riid, void** ppv) {
+    if (!ppv) {
+        return E_POINTER;
+    }
+    IClassFactory* pFactory = nullptr;
+    HRESULT hr = getClassObject(rclsid, &pFactory);
+    if (FAILED(hr)) {
+        *ppv = nullptr;
+        return hr;
+    }
+    hr = pFactory->CreateInstance(pUnkOuter, riid, ppv);
+    pFactory->Release();
+    return hr;
+}
+
+ClassFactoryRegistry& classFactoryRegistry() {
+    static ClassFactoryRegistry registry;
+    return registry;
+}
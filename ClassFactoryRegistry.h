@@ -0,0 +1,61 @@
+#ifndef CLASS_FACTORY_REGISTRY_H
+#define CLASS_FACTORY_REGISTRY_H
+
+#include <mutex>
+#include <vector>
+#include "IFileDialog.h"
+
+#ifndef CLASS_E_NOAGGREGATION
+#define CLASS_E_NOAGGREGATION ((HRESULT)0x80040110L)
+#endif
+
+#ifndef REGDB_E_CLASSNOTREG
+#define REGDB_E_CLASSNOTREG ((HRESULT)0x80040154L)
+#endif
+
+// Unknwn.h stands in for the SDK header, so IClassFactory comes from here
+#ifndef __IClassFactory_INTERFACE_DEFINED__
+#define __IClassFactory_INTERFACE_DEFINED__
+#define DEFINE_IClassFactory_METHODS \
+    virtual HRESULT STDMETHODCALLTYPE CreateInstance(IUnknown *pUnkOuter, REFIID riid, void **ppvObject) = 0; \
+    virtual HRESULT STDMETHODCALLTYPE LockServer(BOOL fLock) = 0;
+
+interface IClassFactory;  // Forward declaration of the interface
+static constexpr IID IID_IClassFactory = guidFromString("00000001-0000-0000-C000-000000000046");
+typedef interface IClassFactory IClassFactory;
+DEFINE_INTERFACE(IClassFactory, IUnknown, DEFINE_IClassFactory_METHODS)
+#endif // __IClassFactory_INTERFACE_DEFINED__
+COM_INTERFACE_ID(IClassFactory, guidFromString("00000001-0000-0000-C000-000000000046"))
+
+// In-process class objects by CLSID: what CoRegisterClassObject and the class lookup in
+// CoCreateInstance do, for classes served without a registry or a DLL. The stand-in
+// CoCreateInstance creates everything through the process-wide instance, so a local
+// implementation registered here is what any CLSID resolves to on Linux.
+class ClassFactoryRegistry {
+public:
+    ClassFactoryRegistry() = default;
+    ~ClassFactoryRegistry();  // Releases every factory
+    ClassFactoryRegistry(const ClassFactoryRegistry&) = delete;
+    ClassFactoryRegistry& operator=(const ClassFactoryRegistry&) = delete;
+
+    // AddRefs pFactory, replacing (and releasing) any factory already registered for rclsid
+    HRESULT registerClass(REFCLSID rclsid, IClassFactory* pFactory);
+
+    // REGDB_E_CLASSNOTREG when nothing is registered for rclsid
+    HRESULT revokeClass(REFCLSID rclsid);
+    HRESULT getClassObject(REFCLSID rclsid, IClassFactory** ppFactory);
+    HRESULT createInstance(REFCLSID rclsid, IUnknown* pUnkOuter, REFIID riid, void** ppv);
+
+private:
+    struct Entry {
+        CLSID clsid;
+        IClassFactory* pFactory;
+    };
+
+    std::mutex mutex;
+    std::vector<Entry> entries;
+};
+
+ClassFactoryRegistry& classFactoryRegistry();
+
+#endif // CLASS_FACTORY_REGISTRY_H
@@ -0,0 +1,345 @@
+#include "CollationKey.h"
+#include "ShellItemArray.h"
+#include "ShellItemExtractor.h"
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <thread>
+#include <vector>
+
+// Below this many items per core, splitting the sort costs more than it saves
+static const size_t kMinItemsPerSortRun = 16384;
+
+// UTF-8 form of one wchar_t unit, byte order matching unit order. UTF-16 surrogates are encoded
+// on their own, as wcscmp compares them.
+static void appendUnit(std::string& out, uint32_t unit) {
+    if (unit < 0x80) {
+        out.push_back(static_cast<char>(unit));
+    } else if (unit < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (unit >> 6)));
+        out.push_back(static_cast<char>(0x80 | (unit & 0x3F)));
+    } else if (unit < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (unit >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((unit >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (unit & 0x3F)));
+    } else {
+        unit = std::min<uint32_t>(unit, 0x1FFFFF);
+        out.push_back(static_cast<char>(0xF0 | (unit >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((unit >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((unit >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (unit & 0x3F)));
+    }
+}
+
+static void appendBigEndian(std::string& out, uint64_t value) {
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<char>((value >> shift) & 0xFF));
+    }
+}
+
+void CollationKey::assign(const wchar_t* path, size_t length, size_t nameOffset) {
+    bytes.resize(identityLength);
+    bytes.reserve(identityLength + length + 1);
+    this->nameOffset = 0;
+    for (size_t i = 0; i < length; ++i) {
+        if (i == nameOffset) {
+            this->nameOffset = static_cast<uint32_t>(bytes.size() - identityLength);
+        }
+        appendUnit(bytes, static_cast<uint32_t>(path[i]));
+    }
+    pathLength = static_cast<uint32_t>(bytes.size() - identityLength);
+    if (nameOffset >= length) {
+        this->nameOffset = pathLength;
+    }
+    bytes.push_back('\0');
+}
+
+void CollationKey::assign(std::wstring_view path) {
+    size_t separator = path.find_last_of(L"/\\");
+    size_t nameStart = (separator == std::wstring_view::npos || path.size() == 1) ? 0 : separator + 1;
+    assign(path.data(), path.size(), nameStart);
+}
+
+void CollationKey::setIdentity(uint64_t high, uint64_t low) {
+    std::string identity;
+    appendBigEndian(identity, high);
+    appendBigEndian(identity, low);
+    bytes.replace(0, identityLength, identity);
+    identityLength = static_cast<uint32_t>(identity.size());
+}
+
+void CollationKey::appendField(uint64_t value) {
+    appendBigEndian(bytes, value);
+}
+
+void CollationKey::appendField(int64_t value) {
+    appendBigEndian(bytes, static_cast<uint64_t>(value) ^ (uint64_t(1) << 63));
+}
+
+std::string_view CollationKey::displayKey() const {
+    return std::string_view(bytes.data() + identityLength + nameOffset, pathLength - nameOffset);
+}
+
+std::string_view CollationKey::allFieldsKey() const {
+    return std::string_view(bytes.data() + identityLength, bytes.size() - identityLength);
+}
+
+std::string_view CollationKey::key(DWORD hint, bool useIdentity) const {
+    if (hint & SICHINT_ALLFIELDS) {
+        return allFieldsKey();
+    }
+    if (hint & SICHINT_CANONICAL) {
+        return useIdentity ? identityKey() : pathKey();
+    }
+    return displayKey();
+}
+
+static int compareBytes(std::string_view a, std::string_view b) {
+    int order = a.compare(b);
+    return (order < 0) ? -1 : (order > 0) ? 1 : 0;
+}
+
+int compareCollationKeys(const CollationKey& a, const CollationKey& b, DWORD hint) {
+    bool useIdentity = a.hasIdentity() && b.hasIdentity();
+    int order = compareBytes(a.key(hint, useIdentity), b.key(hint, useIdentity));
+    if (order != 0 && !(hint & (SICHINT_ALLFIELDS | SICHINT_CANONICAL)) && (hint & SICHINT_TEST_FILESYSPATH_IF_NOT_EQUAL) &&
+        a.pathKey() == b.pathKey()) {
+        order = 0;
+    }
+    return order;
+}
+
+HRESULT compareWithCollationKey(const CollationKey& key, IShellItem* psi, DWORD hint, int* piOrder) {
+    const CollationKey* pOther = nullptr;
+    IShellItemCollation* pCollation = nullptr;
+    if (SUCCEEDED(psi->QueryInterface(IID_IShellItemCollation, reinterpret_cast<void**>(&pCollation)))) {
+        pCollation->GetCollationKey(&pOther);
+        pCollation->Release();
+    }
+
+    CollationKey otherKey;
+    if (!pOther) {
+        // Foreign item: key its file system path
+        LPWSTR pszOther = nullptr;
+        HRESULT hr = psi->GetDisplayName(SIGDN_FILESYSPATH, &pszOther);
+        if (FAILED(hr)) {
+            return hr;
+        }
+        otherKey.assign(pszOther);
+        taskMemFree(pszOther);
+        pOther = &otherKey;
+    }
+    *piOrder = compareCollationKeys(key, *pOther, hint);
+    return (*piOrder == 0) ? S_OK : S_FALSE;
+}
+
+// 32 bytes, with the first sixteen key bytes inline so most comparisons never touch the key itself
+struct SortEntry {
+    uint64_t prefix[2];  // Key bytes 0-15, big-endian and zero-padded
+    const char* key;
+    uint32_t length;
+    uint32_t index;      // Position in the input, the final tie-breaker
+};
+
+static const uint32_t kSortPrefixBytes = 16;
+
+static bool entryLess(const SortEntry& a, const SortEntry& b) {
+    if (a.prefix[0] != b.prefix[0]) {
+        return a.prefix[0] < b.prefix[0];
+    }
+    if (a.prefix[1] != b.prefix[1]) {
+        return a.prefix[1] < b.prefix[1];
+    }
+    uint32_t common = std::min(a.length, b.length);
+    uint32_t skip = std::min(common, kSortPrefixBytes);
+    int order = std::memcmp(a.key + skip, b.key + skip, common - skip);
+    if (order != 0) {
+        return order < 0;
+    }
+    if (a.length != b.length) {
+        return a.length < b.length;
+    }
+    return a.index < b.index;
+}
+
+static uint64_t keyPrefix(const char* key, uint32_t length, uint32_t offset) {
+    uint64_t prefix = 0;
+    for (uint32_t i = offset; i < offset + 8; ++i) {
+        prefix = (prefix << 8) | ((i < length) ? static_cast<uint8_t>(key[i]) : 0);
+    }
+    return prefix;
+}
+
+// Run task(0) .. task(count - 1), one per thread, the last on the calling thread
+template <typename Task>
+static void runInParallel(size_t count, Task task) {
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i + 1 < count; ++i) {
+        threads.emplace_back(task, i);
+    }
+    task(count - 1);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+// Sort runs on their own cores, then merge neighbouring runs pairwise until one is left
+static void parallelSort(std::vector<SortEntry>& entries, unsigned threads) {
+    size_t runs = std::max<size_t>(1, std::min<size_t>(threads, entries.size() / kMinItemsPerSortRun));
+    std::vector<size_t> bounds(runs + 1);
+    for (size_t i = 0; i <= runs; ++i) {
+        bounds[i] = entries.size() * i / runs;
+    }
+    runInParallel(runs, [&](size_t run) {
+        for (size_t i = bounds[run]; i < bounds[run + 1]; ++i) {
+            entries[i].prefix[0] = keyPrefix(entries[i].key, entries[i].length, 0);
+            entries[i].prefix[1] = keyPrefix(entries[i].key, entries[i].length, 8);
+        }
+        std::sort(entries.begin() + bounds[run], entries.begin() + bounds[run + 1], entryLess);
+    });
+    if (runs == 1) {
+        return;
+    }
+
+    std::vector<SortEntry> buffer(entries.size());
+    std::vector<SortEntry>* source = &entries;
+    std::vector<SortEntry>* target = &buffer;
+    while (bounds.size() > 2) {
+        size_t pairs = (bounds.size() - 1) / 2;
+        bool odd = (bounds.size() - 1) % 2 != 0;
+        runInParallel(pairs + (odd ? 1 : 0), [&](size_t pair) {
+            size_t first = bounds[2 * pair];
+            if (pair == pairs) {
+                // Unpaired last run
+                std::copy(source->begin() + first, source->end(), target->begin() + first);
+                return;
+            }
+            size_t middle = bounds[2 * pair + 1];
+            size_t last = bounds[2 * pair + 2];
+            std::merge(source->begin() + first, source->begin() + middle, source->begin() + middle, source->begin() + last,
+                       target->begin() + first, entryLess);
+        });
+        std::vector<size_t> merged;
+        for (size_t i = 0; i < bounds.size(); i += 2) {
+            merged.push_back(bounds[i]);
+        }
+        if (merged.back() != entries.size()) {
+            merged.push_back(entries.size());
+        }
+        bounds.swap(merged);
+        std::swap(source, target);
+    }
+    if (source != &entries) {
+        entries.swap(buffer);
+    }
+}
+
+// Every item of pItemArray, in order, with one reference each
+static HRESULT collectItems(IShellItemArray* pItemArray, std::vector<IShellItem*>& items) {
+    DWORD itemCount = 0;
+    HRESULT hr = pItemArray->GetCount(&itemCount);
+    if (FAILED(hr)) {
+        return hr;
+    }
+    items.reserve(itemCount);
+
+    IEnumShellItems* pEnum = nullptr;
+    if (SUCCEEDED(pItemArray->EnumItems(&pEnum))) {
+        ULONG fetched = 0;
+        do {
+            size_t size = items.size();
+            items.resize(size + kShellItemBatchSize);
+            hr = pEnum->Next(kShellItemBatchSize, items.data() + size, &fetched);
+            items.resize(size + (SUCCEEDED(hr) ? fetched : 0));
+        } while (hr == S_OK && fetched == kShellItemBatchSize);
+        pEnum->Release();
+        return FAILED(hr) ? hr : S_OK;
+    }
+
+    for (DWORD i = 0; i < itemCount; ++i) {
+        IShellItem* pItem = nullptr;
+        hr = pItemArray->GetItemAt(i, &pItem);
+        if (FAILED(hr)) {
+            return hr;
+        }
+        items.push_back(pItem);
+    }
+    return S_OK;
+}
+
+HRESULT sortShellItemArray(IShellItemArray* pItemArray, DWORD hint, IShellItemArray** ppSorted, unsigned threads) {
+    if (!pItemArray || !ppSorted) {
+        return E_POINTER;
+    }
+    *ppSorted = nullptr;
+
+    std::vector<IShellItem*> items;
+    HRESULT hr = collectItems(pItemArray, items);
+    if (FAILED(hr)) {
+        for (IShellItem* pItem : items) {
+            pItem->Release();
+        }
+        return hr;
+    }
+
+    // Keys of items without IShellItemCollation, built from their paths
+    std::deque<CollationKey> ownKeys;
+    std::vector<const CollationKey*> keys(items.size());
+    bool useIdentity = true;
+    for (size_t i = 0; i < items.size() && SUCCEEDED(hr); ++i) {
+        IShellItemCollation* pCollation = nullptr;
+        if (SUCCEEDED(items[i]->QueryInterface(IID_IShellItemCollation, reinterpret_cast<void**>(&pCollation)))) {
+            pCollation->GetCollationKey(&keys[i]);
+            pCollation->Release();
+        }
+        if (!keys[i]) {
+            LPWSTR pszFilePath = nullptr;
+            hr = items[i]->GetDisplayName(SIGDN_FILESYSPATH, &pszFilePath);
+            if (SUCCEEDED(hr)) {
+                ownKeys.emplace_back();
+                ownKeys.back().assign(pszFilePath);
+                taskMemFree(pszFilePath);
+                keys[i] = &ownKeys.back();
+            }
+        }
+        useIdentity = useIdentity && keys[i] && keys[i]->hasIdentity();
+    }
+    if (FAILED(hr)) {
+        for (IShellItem* pItem : items) {
+            pItem->Release();
+        }
+        return hr;
+    }
+
+    // Bytes every key starts with (a shared folder, usually) cannot order anything; skip them so the
+    // inline prefixes hold bytes that differ
+    size_t common = items.empty() ? 0 : keys[0]->key(hint, useIdentity).size();
+    for (size_t i = 1; i < items.size() && common > 0; ++i) {
+        std::string_view first = keys[0]->key(hint, useIdentity);
+        std::string_view key = keys[i]->key(hint, useIdentity);
+        size_t limit = std::min(common, key.size());
+        size_t length = 0;
+        while (length < limit && first[length] == key[length]) {
+            ++length;
+        }
+        common = length;
+    }
+
+    std::vector<SortEntry> entries(items.size());
+    for (size_t i = 0; i < items.size(); ++i) {
+        std::string_view key = keys[i]->key(hint, useIdentity).substr(common);
+        entries[i].key = key.data();
+        entries[i].length = static_cast<uint32_t>(key.size());
+        entries[i].index = static_cast<uint32_t>(i);
+    }
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    parallelSort(entries, threads);
+
+    std::vector<IShellItem*> sorted(items.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        sorted[i] = items[entries[i].index];
+    }
+    return createShellItemArray(std::move(sorted), ppSorted);
+}
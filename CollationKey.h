@@ -0,0 +1,65 @@
+#ifndef COLLATION_KEY_H
+#define COLLATION_KEY_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "IFileDialog.h"
+
+// Binary sort key of a shell item, built once so IShellItem::Compare and sorting are byte
+// comparisons. The path is encoded one wchar_t at a time in UTF-8 form, which keeps wcscmp order
+// under memcmp; display order compares the leaf's bytes, SICHINT_ALLFIELDS the path followed by the
+// appended fields, and SICHINT_CANONICAL the file identity when there is one, else the path.
+class CollationKey {
+public:
+    CollationKey() : identityLength(0), pathLength(0), nameOffset(0) {}
+
+    // path is SIGDN_FILESYSPATH; name starts at nameOffset within it
+    void assign(const wchar_t* path, size_t length, size_t nameOffset);
+    // Same, taking the leaf to start after the last '/' or '\\'
+    void assign(std::wstring_view path);
+
+    // Canonical identity (device and inode on POSIX): items with equal identities compare equal
+    void setIdentity(uint64_t high, uint64_t low);
+    // Tie-breakers for SICHINT_ALLFIELDS, most significant first. Call after assign.
+    void appendField(uint64_t value);
+    void appendField(int64_t value);
+
+    bool hasIdentity() const { return identityLength != 0; }
+    std::string_view identityKey() const { return std::string_view(bytes.data(), identityLength); }
+    std::string_view pathKey() const { return std::string_view(bytes.data() + identityLength, pathLength); }
+    std::string_view displayKey() const;
+    std::string_view allFieldsKey() const;
+
+    // The key a Compare with hint orders by, given whether both sides have an identity
+    std::string_view key(DWORD hint, bool useIdentity) const;
+
+private:
+    std::string bytes;  // Identity, then the path, a zero byte and the appended fields
+    uint32_t identityLength;
+    uint32_t pathLength;
+    uint32_t nameOffset;  // Byte offset of the leaf within the path
+};
+
+// Lets Compare and sortShellItemArray read an item's key instead of its display names. The key
+// stays valid for the lifetime of the item.
+#define DEFINE_IShellItemCollation_METHODS \
+    virtual HRESULT STDMETHODCALLTYPE GetCollationKey(const CollationKey **ppKey) = 0;
+
+interface IShellItemCollation;  // Forward declaration of the interface
+static constexpr IID IID_IShellItemCollation = guidFromString("9D2E6A14-5B7C-4F38-A16E-3C8F0B52D749");
+COM_INTERFACE_ID(IShellItemCollation, IID_IShellItemCollation)
+typedef interface IShellItemCollation IShellItemCollation;
+DEFINE_INTERFACE(IShellItemCollation, IUnknown, DEFINE_IShellItemCollation_METHODS)
+
+// Order two keys the way IShellItem::Compare does for hint (-1, 0 or 1)
+int compareCollationKeys(const CollationKey& a, const CollationKey& b, DWORD hint);
+
+// IShellItem::Compare for an item owning key: psi's key when it has one, else its SIGDN_FILESYSPATH
+HRESULT compareWithCollationKey(const CollationKey& key, IShellItem* psi, DWORD hint, int* piOrder);
+
+// New array holding pItemArray's items ordered by their keys under hint, equal keys keeping their
+// original order. Keys are gathered once; the sort runs on up to threads cores (0: all of them).
+HRESULT sortShellItemArray(IShellItemArray* pItemArray, DWORD hint, IShellItemArray** ppSorted, unsigned threads = 0);
+
+#endif // COLLATION_KEY_H
@@ -0,0 +1,83 @@
+#ifndef COM_GUID_H
+#define COM_GUID_H
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include "Unknwn.h"
+
+// Hex digit value, or an exception (a compile error when constant-evaluated)
+constexpr uint32_t guidHexDigit(char c) {
+    return (c >= '0' && c <= '9') ? static_cast<uint32_t>(c - '0')
+         : (c >= 'a' && c <= 'f') ? static_cast<uint32_t>(c - 'a' + 10)
+         : (c >= 'A' && c <= 'F') ? static_cast<uint32_t>(c - 'A' + 10)
+         : throw std::invalid_argument("guidFromString: not a hex digit");
+}
+
+constexpr uint32_t guidHex(const char* text, size_t digits) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < digits; ++i) {
+        value = (value << 4) | guidHexDigit(text[i]);
+    }
+    return value;
+}
+
+// GUID from its registry form, "43826D1E-E718-42EE-BC55-A1E261C37BFE" with or without braces,
+// as __declspec(uuid) takes it. Meant for constexpr IIDs, so a typo fails the build.
+template <size_t N>
+constexpr GUID guidFromString(const char (&text)[N]) {
+    static_assert(N == 37 || N == 39, "guidFromString expects XXXXXXXX-XXXX-XXXX-XXXX-XXXXXXXXXXXX");
+    const char* s = text + (N == 39 ? 1 : 0);
+    if ((N == 39 && (text[0] != '{' || text[37] != '}')) || s[8] != '-' || s[13] != '-' || s[18] != '-' || s[23] != '-') {
+        throw std::invalid_argument("guidFromString: malformed GUID");
+    }
+    GUID guid{};
+    guid.Data1 = guidHex(s, 8);
+    guid.Data2 = static_cast<uint16_t>(guidHex(s + 9, 4));
+    guid.Data3 = static_cast<uint16_t>(guidHex(s + 14, 4));
+    guid.Data4[0] = static_cast<uint8_t>(guidHex(s + 19, 2));
+    guid.Data4[1] = static_cast<uint8_t>(guidHex(s + 21, 2));
+    for (size_t i = 0; i < 6; ++i) {
+        guid.Data4[2 + i] = static_cast<uint8_t>(guidHex(s + 24 + 2 * i, 2));
+    }
+    return guid;
+}
+
+constexpr bool guidEqualsConstexpr(const GUID& a, const GUID& b) {
+    if (a.Data1 != b.Data1 || a.Data2 != b.Data2 || a.Data3 != b.Data3) {
+        return false;
+    }
+    for (size_t i = 0; i < 8; ++i) {
+        if (a.Data4[i] != b.Data4[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Whole-GUID compare as two 64-bit words: two loads and compares a side, no per-field branches
+inline bool guidEquals(const GUID& a, const GUID& b) {
+    static_assert(sizeof(GUID) == 16, "GUID is expected to be 16 bytes");
+    uint64_t wa[2];
+    uint64_t wb[2];
+    std::memcpy(wa, &a, sizeof(wa));
+    std::memcpy(wb, &b, sizeof(wb));
+    return ((wa[0] ^ wb[0]) | (wa[1] ^ wb[1])) == 0;
+}
+
+// IID_IUnknown as a constant, for tables built at compile time
+constexpr GUID kIidIUnknown = guidFromString("00000000-0000-0000-C000-000000000046");
+
+// The IID of an interface type, for templates that are handed interfaces rather than IIDs
+template <typename Interface>
+struct ComInterfaceId;
+
+#define COM_INTERFACE_ID(Interface, iid) \
+    template <> struct ComInterfaceId<Interface> { static constexpr GUID value = iid; };
+
+template <>
+struct ComInterfaceId<IUnknown> {
+    static constexpr GUID value = kIidIUnknown;
+};
+
+#endif // COM_GUID_H
@@ -0,0 +1,116 @@
+#ifndef COM_PTR_H
+#define COM_PTR_H
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include "Unknwn.h"
+
+// Owning pointer to a COM interface: Release on destruction, nothing else behind the caller's back.
+// Move-only, so a reference changes hands without touching the object's count; the AddRefs that
+// remain are the ones written out (retain, copy). Works with any type exposing AddRef/Release,
+// including the hand-rolled interfaces in IFileDialog.h.
+template <typename T>
+class ComPtr {
+public:
+    ComPtr() noexcept : p(nullptr) {}
+    ComPtr(std::nullptr_t) noexcept : p(nullptr) {}
+    ComPtr(ComPtr&& other) noexcept : p(other.p) { other.p = nullptr; }
+    template <typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+    ComPtr(ComPtr<U>&& other) noexcept : p(other.detach()) {}
+    ComPtr(const ComPtr&) = delete;
+    ComPtr& operator=(const ComPtr&) = delete;
+
+    ~ComPtr() {
+        if (p) {
+            p->Release();
+        }
+    }
+
+    ComPtr& operator=(ComPtr&& other) noexcept {
+        if (this != &other) {
+            reset(other.detach());
+        }
+        return *this;
+    }
+
+    ComPtr& operator=(std::nullptr_t) noexcept {
+        reset();
+        return *this;
+    }
+
+    // Take over a reference the caller already owns (a factory's or out parameter's result)
+    static ComPtr attach(T* owned) noexcept {
+        ComPtr ptr;
+        ptr.p = owned;
+        return ptr;
+    }
+
+    // Start owning a borrowed pointer: one AddRef
+    static ComPtr retain(T* borrowed) noexcept {
+        if (borrowed) {
+            borrowed->AddRef();
+        }
+        return attach(borrowed);
+    }
+
+    ComPtr copy() const noexcept { return retain(p); }
+
+    T* get() const noexcept { return p; }
+    T* operator->() const noexcept { return p; }
+    T& operator*() const noexcept { return *p; }
+    explicit operator bool() const noexcept { return p != nullptr; }
+
+    // Hand the reference to the caller, who must Release it
+    T* detach() noexcept {
+        T* owned = p;
+        p = nullptr;
+        return owned;
+    }
+
+    void reset(T* owned = nullptr) noexcept {
+        T* previous = p;
+        p = owned;
+        if (previous) {
+            previous->Release();
+        }
+    }
+
+    // Out-parameter adapters: drop what is held, then let the callee store a new reference
+    T** put() noexcept {
+        reset();
+        return &p;
+    }
+
+    void** putVoid() noexcept {
+        return reinterpret_cast<void**>(put());
+    }
+
+    // QueryInterface into another ComPtr
+    template <typename U>
+    HRESULT as(REFIID riid, ComPtr<U>& out) const noexcept {
+        return p ? p->QueryInterface(riid, out.putVoid()) : E_POINTER;
+    }
+
+private:
+    T* p;
+};
+
+// A non-owning parameter: accepts a raw pointer or a ComPtr without any reference count traffic.
+// Valid only while the caller's reference is; keep it with ComPtr<T>::retain.
+template <typename T>
+class ComBorrow {
+public:
+    ComBorrow(T* p) noexcept : p(p) {}
+    template <typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+    ComBorrow(const ComPtr<U>& owner) noexcept : p(owner.get()) {}
+
+    T* get() const noexcept { return p; }
+    T* operator->() const noexcept { return p; }
+    explicit operator bool() const noexcept { return p != nullptr; }
+
+private:
+    T* p;
+};
+
+#endif // COM_PTR_H
@@ -0,0 +1,282 @@
+#include "ConfigFuzzer.h"
+#include "IFileDialog.h"
+#include "DialogOptions.h"
+#include "StandInFileDialog.h"
+#include "SyntheticShellItems.h"
+#include "FilterSet.h"
+#include "Bench.h"
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <random>
+#include <iostream>
+#include <iomanip>
+
+static const int kMaxRandomFilters = 25;  // Same bound as manageFilters(randomize)
+static const unsigned kItemPoolSize = 64;
+static const int kMaxSelection = 8;
+static const uint64_t kCasesPerClaim = 256;
+static const uint64_t kMaxReportedFailures = 20;
+
+void generateFuzzCase(uint64_t seed, FuzzCase& fuzzCase) {
+    FuzzRng rng(seed);
+    fuzzCase.seed = seed;
+    fuzzCase.dialogType = rng.range(1, 3);
+    fuzzCase.optionStates.resize(kDialogOptionCount);
+    for (int& state : fuzzCase.optionStates) {
+        state = rng.range(-1, 1);
+    }
+    fuzzCase.filterCount = rng.range(1, kMaxRandomFilters);
+    fuzzCase.fileTypeIndex = static_cast<unsigned>(rng.range(1, fuzzCase.filterCount + 1));
+    fuzzCase.selection.resize(rng.range(0, kMaxSelection));
+    for (unsigned& index : fuzzCase.selection) {
+        index = static_cast<unsigned>(rng.range(0, kItemPoolSize - 1));
+    }
+}
+
+// Seed of case number index in a run started from baseSeed
+static uint64_t fuzzCaseSeed(uint64_t baseSeed, uint64_t index) {
+    return FuzzRng(baseSeed + index * 0x9E3779B97F4A7C15ull).next();
+}
+
+// "All Files" followed by every "Random Filter N" entry; a case uses a prefix of it
+static const FilterSet& fuzzFilterTable() {
+    static const FilterSet table = [] {
+        FilterSet filters;
+        filters.add(L"All Files", L"*.*");
+        for (int i = 0; i < kMaxRandomFilters; ++i) {
+            filters.add(L"Random Filter " + std::to_wstring(i + 1), L"*." + std::to_wstring(i + 1));
+        }
+        return filters;
+    }();
+    return table;
+}
+
+// Per-thread state, reused across cases so the loop itself does not allocate
+struct FuzzWorker {
+    COMFunctionPointers comFuncs;
+    std::vector<IShellItem*> pool;
+    std::vector<std::wstring> poolPaths;
+    FilterSet filters;
+    std::vector<IShellItem*> picked;
+    PathTable results;
+
+    explicit FuzzWorker(const COMFunctionPointers& comFuncs) : comFuncs(comFuncs) {
+        IShellItemArray* pArray = createSyntheticShellItemArray(kItemPoolSize, 16);
+        for (DWORD i = 0; i < kItemPoolSize; ++i) {
+            IShellItem* pItem = nullptr;
+            pArray->GetItemAt(i, &pItem);
+            LPWSTR pszFilePath = nullptr;
+            pItem->GetDisplayName(SIGDN_FILESYSPATH, &pszFilePath);
+            poolPaths.push_back(pszFilePath);
+            comFuncs.pCoTaskMemFree(pszFilePath);
+            pool.push_back(pItem);
+        }
+        pArray->Release();
+    }
+
+    ~FuzzWorker() {
+        for (IShellItem* pItem : pool) {
+            pItem->Release();
+        }
+    }
+};
+
+// Drive one case through the dialog helpers. Returns an empty string on success, or what went wrong.
+static std::string checkFuzzCase(FuzzWorker& worker, const FuzzCase& fuzzCase, IFileDialog* pFileDialog) {
+    const FilterSet& allFilters = fuzzFilterTable();
+    worker.filters.clear();
+    for (int i = 0; i <= fuzzCase.filterCount; ++i) {
+        worker.filters.add(allFilters.name(i), allFilters.spec(i));
+    }
+    DWORD options = applyOptionStates(kBaseDialogOptions, fuzzCase.optionStates);
+    configureFileDialog(worker.comFuncs, pFileDialog, worker.filters, L"", options);
+
+    DWORD actualOptions = 0;
+    if (FAILED(pFileDialog->GetOptions(&actualOptions)) || actualOptions != options) {
+        return "GetOptions does not return the configured options";
+    }
+    UINT fileTypeIndex = 0;
+    pFileDialog->SetFileTypeIndex(fuzzCase.fileTypeIndex);
+    if (FAILED(pFileDialog->GetFileTypeIndex(&fileTypeIndex)) || fileTypeIndex != fuzzCase.fileTypeIndex) {
+        return "GetFileTypeIndex does not return the configured index";
+    }
+
+    IStandInDialogControl* pControl = nullptr;
+    if (FAILED(pFileDialog->QueryInterface(IID_IStandInDialogControl, reinterpret_cast<void**>(&pControl)))) {
+        return "dialog does not support IStandInDialogControl";
+    }
+    worker.picked.clear();
+    for (unsigned index : fuzzCase.selection) {
+        worker.picked.push_back(worker.pool[index]);
+    }
+    pControl->SetSelection(static_cast<UINT>(worker.picked.size()), worker.picked.data());
+    pControl->Release();
+
+    size_t expectedCount = 0;
+    if (!fuzzCase.selection.empty()) {
+        expectedCount = (options & FOS_ALLOWMULTISELECT) ? fuzzCase.selection.size() : 1;
+    }
+    HRESULT hr = pFileDialog->Show(NULL);
+    if (expectedCount == 0) {
+        return (hr == kDialogCancelled) ? std::string() : "Show did not cancel an empty selection";
+    }
+    if (FAILED(hr)) {
+        return "Show failed";
+    }
+
+    worker.results.clear();
+    if (fuzzCase.dialogType == 2) {
+        IShellItem* pResult = nullptr;
+        if (FAILED(pFileDialog->GetResult(&pResult))) {
+            return "GetResult failed";
+        }
+        LPWSTR pszFilePath = nullptr;
+        if (SUCCEEDED(pResult->GetDisplayName(SIGDN_FILESYSPATH, &pszFilePath))) {
+            worker.results.append(pszFilePath, std::char_traits<wchar_t>::length(pszFilePath));
+            worker.comFuncs.pCoTaskMemFree(pszFilePath);
+        }
+        pResult->Release();
+        expectedCount = 1;
+    } else {
+        IShellItemArray* pResults = nullptr;
+        if (FAILED(static_cast<IFileOpenDialog*>(pFileDialog)->GetResults(&pResults))) {
+            return "GetResults failed";
+        }
+        getFilePathsFromShellItemArray(pResults, worker.comFuncs, worker.results);
+        pResults->Release();
+    }
+
+    if (worker.results.size() != expectedCount) {
+        return "wrong number of results";
+    }
+    for (size_t i = 0; i < expectedCount; ++i) {
+        if (worker.results[i] != worker.poolPaths[fuzzCase.selection[i]]) {
+            return "results do not match the selection";
+        }
+    }
+    return std::string();
+}
+
+static std::string runFuzzCase(FuzzWorker& worker, const FuzzCase& fuzzCase) {
+    IFileDialog* pFileDialog = nullptr;
+    createFileDialog(worker.comFuncs, &pFileDialog, fuzzCase.dialogType);
+    if (!pFileDialog) {
+        return "createFileDialog returned no dialog";
+    }
+    std::string failure = checkFuzzCase(worker, fuzzCase, pFileDialog);
+    pFileDialog->Release();
+    return failure;
+}
+
+static void printFuzzCase(const FuzzCase& fuzzCase) {
+    std::wcout << L"seed=0x" << std::hex << fuzzCase.seed << std::dec << L" type=" << fuzzCase.dialogType
+               << L" filters=" << (fuzzCase.filterCount + 1) << L" fileTypeIndex=" << fuzzCase.fileTypeIndex << std::endl;
+    for (size_t i = 0; i < kDialogOptionCount; ++i) {
+        int state = fuzzCase.optionStates[i];
+        std::wcout << L"  " << kDialogOptions[i].key << L" = " << (state == Enabled ? L"on" : state == Disabled ? L"off" : L"default") << std::endl;
+    }
+    std::wcout << L"  selection:";
+    for (unsigned index : fuzzCase.selection) {
+        std::wcout << L" " << index;
+    }
+    std::wcout << std::endl;
+}
+
+static bool parseSeed(const std::string& text, uint64_t& seed) {
+    try {
+        seed = std::stoull(text, nullptr, 0);
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+int runFuzzer(const std::vector<std::string>& args) {
+    uint64_t cases = 1000000;
+    unsigned threadCount = std::thread::hardware_concurrency();
+    uint64_t baseSeed = (static_cast<uint64_t>(std::random_device()()) << 32) | std::random_device()();
+    bool replay = false;
+    for (size_t i = 0; i + 1 < args.size(); i += 2) {
+        bool ok = true;
+        if (args[i] == "--cases") {
+            ok = parseSeed(args[i + 1], cases);
+        } else if (args[i] == "--threads") {
+            uint64_t value = 0;
+            ok = parseSeed(args[i + 1], value);
+            threadCount = static_cast<unsigned>(value);
+        } else if (args[i] == "--seed") {
+            ok = parseSeed(args[i + 1], baseSeed);
+        } else if (args[i] == "--replay") {
+            ok = parseSeed(args[i + 1], baseSeed);
+            replay = true;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            std::wcerr << L"Usage: CIFileDialogTester --fuzz [--cases N] [--threads N] [--seed S] [--replay S]" << std::endl;
+            return 2;
+        }
+    }
+    if (threadCount == 0) {
+        threadCount = 1;
+    }
+
+    COMFunctionPointers comFuncs = LoadCOMFunctionPointers();
+    comFuncs.pCoCreateInstance = StandInCoCreateInstance;
+    if (!comFuncs.pCoTaskMemFree) {
+        std::wcerr << L"Failed to load one or more COM functions." << std::endl;
+        return 2;
+    }
+
+    if (replay) {
+        FuzzWorker worker(comFuncs);
+        FuzzCase fuzzCase;
+        generateFuzzCase(baseSeed, fuzzCase);
+        printFuzzCase(fuzzCase);
+        std::string failure = runFuzzCase(worker, fuzzCase);
+        std::wcout << (failure.empty() ? L"PASS" : L"FAIL: ") << failure.c_str() << std::endl;
+        return failure.empty() ? 0 : 1;
+    }
+
+    std::wcout << L"Fuzzing " << cases << L" cases on " << threadCount << L" threads, base seed 0x" << std::hex << baseSeed << std::dec << std::endl;
+    std::atomic<uint64_t> nextCase(0);
+    std::atomic<uint64_t> failures(0);
+    std::mutex reportMutex;
+    auto fuzzThread = [&]() {
+        FuzzWorker worker(comFuncs);
+        FuzzCase fuzzCase;
+        while (true) {
+            uint64_t first = nextCase.fetch_add(kCasesPerClaim, std::memory_order_relaxed);
+            if (first >= cases) {
+                break;
+            }
+            uint64_t last = (first + kCasesPerClaim < cases) ? first + kCasesPerClaim : cases;
+            for (uint64_t i = first; i < last; ++i) {
+                generateFuzzCase(fuzzCaseSeed(baseSeed, i), fuzzCase);
+                std::string failure = runFuzzCase(worker, fuzzCase);
+                if (!failure.empty() && failures.fetch_add(1) < kMaxReportedFailures) {
+                    std::lock_guard<std::mutex> lock(reportMutex);
+                    std::wcout << L"FAIL seed=0x" << std::hex << fuzzCase.seed << std::dec << L": " << failure.c_str()
+                               << L" (reproduce with --fuzz --replay 0x" << std::hex << fuzzCase.seed << std::dec << L")" << std::endl;
+                }
+            }
+        }
+    };
+
+    BenchTimer timer;
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < threadCount; ++i) {
+        threads.emplace_back(fuzzThread);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double seconds = timer.seconds();
+    FreeCOMFunctionPointers(comFuncs);
+
+    double perMinute = (seconds > 0.0) ? cases / seconds * 60.0 : 0.0;
+    std::wcout << cases << L" cases, " << failures.load() << L" failed, " << std::fixed << std::setprecision(3) << seconds << L"s, "
+               << std::setprecision(0) << perMinute << L" cases/min" << std::endl;
+    return failures.load() ? 1 : 0;
+}
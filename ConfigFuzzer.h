@@ -0,0 +1,47 @@
+#ifndef CONFIG_FUZZER_H
+#define CONFIG_FUZZER_H
+
+#include <cstdint>
+#include <vector>
+#include <string>
+
+// Small, fast PRNG (splitmix64). One per thread; a case is fully determined by its seed.
+class FuzzRng {
+public:
+    explicit FuzzRng(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in [low, high]
+    int range(int low, int high) {
+        return low + static_cast<int>(next() % static_cast<uint64_t>(high - low + 1));
+    }
+
+private:
+    uint64_t state;
+};
+
+// One randomized dialog configuration, the same shape the "Randomize all options" menu produces
+struct FuzzCase {
+    uint64_t seed;
+    int dialogType;                 // 1 open, 2 save, 3 base
+    std::vector<int> optionStates;  // One OptionState per kDialogOptions entry
+    int filterCount;                // "All Files" plus this many "Random Filter N" entries
+    unsigned fileTypeIndex;         // 1-based
+    std::vector<unsigned> selection;  // Indexes into the synthetic item pool
+};
+
+// Fill fuzzCase from seed alone
+void generateFuzzCase(uint64_t seed, FuzzCase& fuzzCase);
+
+// Entry point for: CIFileDialogTester --fuzz [--cases N] [--threads N] [--seed S] [--replay S]
+// Runs generated cases on all cores against the stand-in dialog; every failure prints the seed that
+// reproduces it with --replay.
+int runFuzzer(const std::vector<std::string>& args);
+
+#endif // CONFIG_FUZZER_H
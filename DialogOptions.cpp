@@ -0,0 +1,34 @@
+#include "DialogOptions.h"
+
+const DialogOption kDialogOptions[] = {
+    { L"Allow multiple selection", L"multiselect", FOS_ALLOWMULTISELECT, false },
+    { L"Do not add to recent", L"dontaddtorecent", FOS_DONTADDTORECENT, false },
+    { L"Show hidden files", L"showhidden", FOS_FORCESHOWHIDDEN, false },
+    { L"No change dir", L"nochangedir", FOS_NOCHANGEDIR, false },
+    { L"Confirm overwrite", L"overwriteprompt", FOS_OVERWRITEPROMPT, true },
+    { L"Hide MRU places", L"hidemruplaces", FOS_HIDEMRUPLACES, false },
+    { L"Hide pinned places", L"hidepinnedplaces", FOS_HIDEPINNEDPLACES, false },
+    { L"Share aware", L"shareaware", FOS_SHAREAWARE, false }
+};
+
+const size_t kDialogOptionCount = sizeof(kDialogOptions) / sizeof(kDialogOptions[0]);
+
+int findDialogOption(const std::wstring& key) {
+    for (size_t i = 0; i < kDialogOptionCount; ++i) {
+        if (key == kDialogOptions[i].key) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+DWORD applyOptionStates(DWORD options, const std::vector<int>& optionStates) {
+    for (size_t i = 0; i < optionStates.size() && i < kDialogOptionCount; ++i) {
+        if (optionStates[i] == Enabled) {
+            options |= kDialogOptions[i].flag;
+        } else if (optionStates[i] == Disabled) {
+            options &= ~kDialogOptions[i].flag;
+        }
+    }
+    return options;
+}
@@ -0,0 +1,30 @@
+#ifndef DIALOG_OPTIONS_H
+#define DIALOG_OPTIONS_H
+
+#include <vector>
+#include "IFileDialog.h"
+
+enum OptionState { Default = 0, Enabled = 1, Disabled = -1 };
+
+// One toggle offered by the tester menus
+struct DialogOption {
+    const wchar_t* name;   // Menu label
+    const wchar_t* key;    // Short name used by scenario files
+    DWORD flag;
+    bool isSaveDialogOnly;
+};
+
+// Options every dialog starts from before the toggles are applied
+const DWORD kBaseDialogOptions = FOS_FILEMUSTEXIST | FOS_PATHMUSTEXIST | FOS_FORCEFILESYSTEM;
+
+// The toggles, in menu order
+extern const DialogOption kDialogOptions[];
+extern const size_t kDialogOptionCount;
+
+// Index into kDialogOptions for key, or -1
+int findDialogOption(const std::wstring& key);
+
+// Set or clear each toggle's flag on options according to optionStates (one OptionState per toggle)
+DWORD applyOptionStates(DWORD options, const std::vector<int>& optionStates);
+
+#endif // DIALOG_OPTIONS_H
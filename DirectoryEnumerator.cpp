@@ -0,0 +1,219 @@
+#include "DirectoryEnumerator.h"
+#include "QueryInterfaceTable.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#include "PosixShellItem.h"
+#include "ProjUtil.h"
+#include "PathTrie.h"
+
+#ifdef __linux__
+// Buffer handed to each getdents64() call; large enough for thousands of entries per syscall
+static const size_t kDirentBufferSize = 1 << 20;
+
+// Kernel record layout for getdents64
+struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+#endif // __linux__
+
+DirectorySnapshot::~DirectorySnapshot() {
+    if (dirFd >= 0) {
+        close(dirFd);
+    }
+}
+
+// Add one directory entry, leaving out "." and ".."
+static void appendEntry(DirectorySnapshot& snapshot, const char* name, uint64_t inode, uint8_t type) {
+    if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+        return;
+    }
+    size_t length = std::strlen(name);
+    DirectorySnapshot::Entry entry;
+    entry.nameOffset = static_cast<uint32_t>(snapshot.names.size());
+    entry.nameLength = static_cast<uint32_t>(length);
+    entry.inode = inode;
+    entry.type = type;
+    snapshot.names.insert(snapshot.names.end(), name, name + length + 1);
+    snapshot.entries.push_back(entry);
+}
+
+#ifdef __linux__
+static HRESULT readEntries(DirectorySnapshot& snapshot) {
+    std::vector<char> buffer(kDirentBufferSize);
+    while (true) {
+        long bytes = syscall(SYS_getdents64, snapshot.dirFd, buffer.data(), buffer.size());
+        if (bytes < 0) {
+            return hresultFromErrno(errno);
+        }
+        if (bytes == 0) {
+            return S_OK;
+        }
+        for (long offset = 0; offset < bytes;) {
+            const LinuxDirent64* pEntry = reinterpret_cast<const LinuxDirent64*>(buffer.data() + offset);
+            offset += pEntry->d_reclen;
+            appendEntry(snapshot, pEntry->d_name, pEntry->d_ino, pEntry->d_type);
+        }
+    }
+}
+#else
+// No getdents64 outside Linux: readdir() over a duplicate, since closedir() closes the descriptor
+static HRESULT readEntries(DirectorySnapshot& snapshot) {
+    int fd = dup(snapshot.dirFd);
+    if (fd < 0) {
+        return hresultFromErrno(errno);
+    }
+    DIR* dir = fdopendir(fd);
+    if (!dir) {
+        HRESULT hr = hresultFromErrno(errno);
+        close(fd);
+        return hr;
+    }
+    HRESULT hr = S_OK;
+    while (true) {
+        errno = 0;
+        const struct dirent* pEntry = readdir(dir);
+        if (!pEntry) {
+            hr = hresultFromErrno(errno);
+            break;
+        }
+#ifdef DT_UNKNOWN
+        appendEntry(snapshot, pEntry->d_name, pEntry->d_ino, pEntry->d_type);
+#else
+        appendEntry(snapshot, pEntry->d_name, pEntry->d_ino, 0);
+#endif // DT_UNKNOWN
+    }
+    closedir(dir);
+    return hr;
+}
+#endif // __linux__
+
+HRESULT readDirectorySnapshot(const std::wstring& path, std::shared_ptr<const DirectorySnapshot>& snapshot) {
+    std::shared_ptr<DirectorySnapshot> result = std::make_shared<DirectorySnapshot>();
+    std::string nativePath = wideToUtf8(path.c_str(), path.size());
+    result->dirFd = open(nativePath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (result->dirFd < 0) {
+        return hresultFromErrno(errno);
+    }
+    result->folder = pathTrie().intern(path);
+    if (!result->folder) {
+        return E_INVALIDARG;
+    }
+
+    HRESULT hr = readEntries(*result);
+    if (FAILED(hr)) {
+        return hr;
+    }
+    result->names.shrink_to_fit();
+    result->entries.shrink_to_fit();
+    snapshot = std::move(result);
+    return S_OK;
+}
+
+class DirectoryEnumShellItems : public IEnumShellItems {
+public:
+    DirectoryEnumShellItems(std::shared_ptr<const DirectorySnapshot> snapshot, size_t cursor)
+        : refCount(1), snapshot(std::move(snapshot)), cursor(cursor) {}
+
+    // IUnknown methods
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppv) {
+        return QueryInterfaceTable<DirectoryEnumShellItems, IEnumShellItems>::query(this, riid, ppv);
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() {
+        return InterlockedIncrement(&refCount);
+    }
+
+    ULONG STDMETHODCALLTYPE Release() {
+        ULONG count = InterlockedDecrement(&refCount);
+        if (count == 0) {
+            delete this;
+        }
+        return count;
+    }
+
+    // IEnumShellItems methods
+    HRESULT STDMETHODCALLTYPE Next(ULONG celt, IShellItem **rgelt, ULONG *pceltFetched) {
+        if (!rgelt || (!pceltFetched && celt != 1)) {
+            return E_INVALIDARG;
+        }
+        const std::vector<DirectorySnapshot::Entry>& entries = snapshot->entries;
+        ULONG fetched = 0;
+        while (fetched < celt && cursor < entries.size()) {
+            const DirectorySnapshot::Entry& entry = entries[cursor++];
+            const char* name = snapshot->names.data() + entry.nameOffset;
+            PosixItemInfo info;
+            if (FAILED(queryPosixItemInfoAt(snapshot->dirFd, name, info))) {
+                continue;  // Gone since the snapshot
+            }
+            if (SUCCEEDED(createPosixShellItem(snapshot->folder, utf8ToWide(name, entry.nameLength), info, &rgelt[fetched]))) {
+                ++fetched;
+            }
+        }
+        if (pceltFetched) {
+            *pceltFetched = fetched;
+        }
+        return (fetched == celt) ? S_OK : S_FALSE;
+    }
+
+    HRESULT STDMETHODCALLTYPE Skip(ULONG celt) {
+        size_t remaining = snapshot->entries.size() - cursor;
+        cursor += (celt < remaining) ? celt : remaining;
+        return (celt <= remaining) ? S_OK : S_FALSE;
+    }
+
+    HRESULT STDMETHODCALLTYPE Reset() {
+        cursor = 0;
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE Clone(IEnumShellItems **ppenum) {
+        if (!ppenum) {
+            return E_POINTER;
+        }
+        *ppenum = new DirectoryEnumShellItems(snapshot, cursor);
+        return S_OK;
+    }
+
+protected:
+    virtual ~DirectoryEnumShellItems() {}
+
+private:
+    LONG refCount;
+    std::shared_ptr<const DirectorySnapshot> snapshot;
+    size_t cursor;
+};
+
+HRESULT createDirectoryEnumerator(std::shared_ptr<const DirectorySnapshot> snapshot, IEnumShellItems** ppenum) {
+    if (!ppenum) {
+        return E_POINTER;
+    }
+    *ppenum = new DirectoryEnumShellItems(std::move(snapshot), 0);
+    return S_OK;
+}
+
+HRESULT createDirectoryEnumerator(const std::wstring& path, IEnumShellItems** ppenum) {
+    if (!ppenum) {
+        return E_POINTER;
+    }
+    *ppenum = nullptr;
+    std::shared_ptr<const DirectorySnapshot> snapshot;
+    HRESULT hr = readDirectorySnapshot(path, snapshot);
+    if (FAILED(hr)) {
+        return hr;
+    }
+    return createDirectoryEnumerator(std::move(snapshot), ppenum);
+}
+
+#endif // _WIN32
@@ -0,0 +1,44 @@
+#ifndef DIRECTORY_ENUMERATOR_H
+#define DIRECTORY_ENUMERATOR_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "IFileDialog.h"
+
+#ifndef _WIN32
+
+struct PathNode;
+
+// Immutable listing of one directory, read with large getdents64() batches on Linux and readdir()
+// elsewhere. Enumerators share it, so Clone and Skip never touch the filesystem again.
+struct DirectorySnapshot {
+    struct Entry {
+        uint32_t nameOffset;  // Into names; null-terminated UTF-8
+        uint32_t nameLength;
+        uint64_t inode;
+        uint8_t type;         // DT_* from the directory entry
+    };
+
+    DirectorySnapshot() : folder(nullptr), dirFd(-1) {}
+    ~DirectorySnapshot();
+
+    const PathNode* folder;   // The directory, interned in pathTrie()
+    int dirFd;                // Kept open for statx()/fstatat() relative to the directory
+    std::vector<char> names;
+    std::vector<Entry> entries;
+};
+
+// Read path (absolute) into a snapshot; "." and ".." are left out
+HRESULT readDirectorySnapshot(const std::wstring& path, std::shared_ptr<const DirectorySnapshot>& snapshot);
+
+// IEnumShellItems over a snapshot. Next(celt) fills the whole array in one call, creating POSIX shell
+// items from one queryPosixItemInfoAt() each relative to the open directory. Skip, Reset and Clone
+// only move or copy the cursor. Entries deleted since the snapshot was taken are passed over.
+HRESULT createDirectoryEnumerator(std::shared_ptr<const DirectorySnapshot> snapshot, IEnumShellItems** ppenum);
+HRESULT createDirectoryEnumerator(const std::wstring& path, IEnumShellItems** ppenum);
+
+#endif // _WIN32
+
+#endif // DIRECTORY_ENUMERATOR_H
@@ -0,0 +1,173 @@
+#include "EventSinkRegistry.h"
+#include <algorithm>
+
+EventSinkRegistry::EventSinkRegistry()
+    : current(new SinkList()), epoch(0), retiredPending(false), retiredCount(0), sinkCount(0), nextCookie(1) {
+    for (unsigned slot = 0; slot < 2; ++slot) {
+        readers[slot].store(0);
+        drainedThrough[slot].store(0);
+    }
+}
+
+EventSinkRegistry::~EventSinkRegistry() {
+    std::vector<Retired> reclaimable(retired.begin(), retired.end());
+    reclaim(reclaimable);
+    SinkList* list = current.load();
+    for (const Sink& sink : list->sinks) {
+        sink.pEvents->Release();
+    }
+    delete list;
+}
+
+// The epoch can flip between reading it and registering; retry so the counter being drained
+// gains no newcomers
+unsigned EventSinkRegistry::enterRead() {
+    for (;;) {
+        unsigned observed = epoch.load(std::memory_order_seq_cst);
+        unsigned slot = observed & 1;
+        readers[slot].fetch_add(1, std::memory_order_seq_cst);
+        if (epoch.load(std::memory_order_seq_cst) == observed) {
+            return slot;
+        }
+        exitRead(slot);
+    }
+}
+
+void EventSinkRegistry::exitRead(unsigned slot) {
+    // Read before leaving: only what was retired while this reader was counted is drained by it
+    uint64_t retiredBefore = retiredCount.load(std::memory_order_seq_cst);
+    if (readers[slot].fetch_sub(1, std::memory_order_seq_cst) == 1) {
+        markDrained(slot, retiredBefore);
+        if (!retiredPending.load(std::memory_order_seq_cst)) {
+            return;
+        }
+        // Free what waited on this reader, unless a writer is busy (it will try)
+        std::vector<Retired> reclaimable;
+        {
+            std::unique_lock<std::mutex> lock(writeMutex, std::try_to_lock);
+            if (!lock.owns_lock()) {
+                return;
+            }
+            takeReclaimable(reclaimable);
+        }
+        reclaim(reclaimable);
+    }
+}
+
+HRESULT EventSinkRegistry::advise(IUnknown* pfde, DWORD* pdwCookie) {
+    if (!pdwCookie) {
+        return E_POINTER;
+    }
+    IFileDialogEvents* pEvents = nullptr;
+    HRESULT hr = pfde ? pfde->QueryInterface(IID_IFileDialogEvents, reinterpret_cast<void**>(&pEvents)) : E_INVALIDARG;
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    std::vector<Retired> reclaimable;
+    {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        // Cookies are never 0 and never one still advised, even after wrapping
+        while (nextCookie == 0 || positions.count(nextCookie)) {
+            ++nextCookie;
+        }
+        DWORD cookie = nextCookie++;
+        const SinkList* list = current.load(std::memory_order_relaxed);
+        SinkList* next = new SinkList(*list);
+        next->sinks.push_back({ pEvents, cookie });
+        positions[cookie] = next->sinks.size() - 1;
+        publish(next, nullptr);
+        takeReclaimable(reclaimable);
+        *pdwCookie = cookie;
+    }
+    reclaim(reclaimable);
+    return S_OK;
+}
+
+HRESULT EventSinkRegistry::unadvise(DWORD dwCookie) {
+    std::vector<Retired> reclaimable;
+    {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        std::unordered_map<DWORD, size_t>::iterator found = positions.find(dwCookie);
+        if (found == positions.end()) {
+            return E_INVALIDARG;
+        }
+        size_t index = found->second;
+        positions.erase(found);
+
+        const SinkList* list = current.load(std::memory_order_relaxed);
+        SinkList* next = new SinkList();
+        next->sinks.reserve(list->sinks.size() - 1);
+        next->sinks.insert(next->sinks.end(), list->sinks.begin(), list->sinks.begin() + index);
+        next->sinks.insert(next->sinks.end(), list->sinks.begin() + index + 1, list->sinks.end());
+        for (size_t i = index; i < next->sinks.size(); ++i) {
+            positions[next->sinks[i].cookie] = i;
+        }
+        publish(next, list->sinks[index].pEvents);
+        takeReclaimable(reclaimable);
+    }
+    reclaim(reclaimable);
+    return S_OK;
+}
+
+void EventSinkRegistry::unadviseAll() {
+    std::vector<DWORD> cookies;
+    {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        cookies.reserve(positions.size());
+        for (const std::pair<const DWORD, size_t>& position : positions) {
+            cookies.push_back(position.first);
+        }
+    }
+    for (DWORD cookie : cookies) {
+        unadvise(cookie);
+    }
+}
+
+size_t EventSinkRegistry::size() const {
+    return sinkCount.load(std::memory_order_relaxed);
+}
+
+void EventSinkRegistry::publish(SinkList* next, IFileDialogEvents* pRemoved) {
+    SinkList* previous = current.exchange(next, std::memory_order_seq_cst);
+    sinkCount.store(next->sinks.size(), std::memory_order_relaxed);
+    epoch.fetch_add(1, std::memory_order_seq_cst);
+    uint64_t sequence = retiredCount.load(std::memory_order_relaxed) + 1;
+    retired.push_back({ previous, pRemoved, sequence });
+    retiredCount.store(sequence, std::memory_order_seq_cst);
+    retiredPending.store(true, std::memory_order_seq_cst);
+}
+
+void EventSinkRegistry::markDrained(unsigned slot, uint64_t sequence) {
+    uint64_t marked = drainedThrough[slot].load(std::memory_order_seq_cst);
+    while (marked < sequence && !drainedThrough[slot].compare_exchange_weak(marked, sequence, std::memory_order_seq_cst)) {
+    }
+}
+
+// A reader that loaded a retired list registered before the list was replaced and stays counted
+// until it leaves, so a zero seen afterwards in its counter means it is gone
+void EventSinkRegistry::takeReclaimable(std::vector<Retired>& reclaimable) {
+    uint64_t sequence = retiredCount.load(std::memory_order_seq_cst);
+    for (unsigned slot = 0; slot < 2; ++slot) {
+        if (readers[slot].load(std::memory_order_seq_cst) == 0) {
+            markDrained(slot, sequence);
+        }
+    }
+    uint64_t drained = std::min(drainedThrough[0].load(std::memory_order_seq_cst), drainedThrough[1].load(std::memory_order_seq_cst));
+    while (!retired.empty() && retired.front().sequence <= drained) {
+        reclaimable.push_back(retired.front());
+        retired.pop_front();
+    }
+    retiredPending.store(!retired.empty(), std::memory_order_seq_cst);
+}
+
+// Outside writeMutex: a sink's last Release may well Unadvise something
+void EventSinkRegistry::reclaim(std::vector<Retired>& reclaimable) {
+    for (Retired& entry : reclaimable) {
+        delete entry.list;
+        if (entry.pSink) {
+            entry.pSink->Release();
+        }
+    }
+    reclaimable.clear();
+}
@@ -0,0 +1,100 @@
+#ifndef EVENT_SINK_REGISTRY_H
+#define EVENT_SINK_REGISTRY_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "IFileDialog.h"
+
+// The IFileDialogEvents sinks of one dialog, behind Advise/Unadvise cookies.
+//
+// Dispatch never locks: forEach reads an immutable snapshot of the sink list, published by
+// advise/unadvise with copy-on-write. Readers announce themselves in one of two counters picked
+// by the current epoch, and every publish flips the epoch so the counter in use before it drains.
+// A replaced list (and an unadvised sink's reference) is freed once each counter has been seen
+// at zero since it was replaced: no reader that could have loaded it is left. The last reader out
+// of a counter records that without locking; writers free in retirement order. Writers never wait
+// for readers, so a sink may Advise or Unadvise from inside its own callback; whatever cannot be
+// freed yet is freed by a later writer, or by the last reader out of an epoch.
+class EventSinkRegistry {
+public:
+    EventSinkRegistry();
+    ~EventSinkRegistry();  // Releases every sink; no dispatch may still be running
+
+    EventSinkRegistry(const EventSinkRegistry&) = delete;
+    EventSinkRegistry& operator=(const EventSinkRegistry&) = delete;
+
+    // QueryInterface pfde for IFileDialogEvents and keep that reference until unadvise
+    HRESULT advise(IUnknown* pfde, DWORD* pdwCookie);
+
+    // E_INVALIDARG for a cookie that is not advised
+    HRESULT unadvise(DWORD dwCookie);
+
+    // Unadvise every sink, as a dialog going back to its pool does
+    void unadviseAll();
+
+    size_t size() const;
+
+    // Call fn for every sink advised when the dispatch started, in Advise order; returns the
+    // first non-S_OK answer, or S_OK
+    template <typename Fn>
+    HRESULT forEach(Fn fn) {
+        unsigned slot = enterRead();
+        const SinkList* list = current.load(std::memory_order_seq_cst);
+        HRESULT result = S_OK;
+        for (const Sink& sink : list->sinks) {
+            HRESULT hr = fn(sink.pEvents);
+            if (hr != S_OK && result == S_OK) {
+                result = hr;
+            }
+        }
+        exitRead(slot);
+        return result;
+    }
+
+private:
+    struct Sink {
+        IFileDialogEvents* pEvents;
+        DWORD cookie;
+    };
+
+    // Immutable once published
+    struct SinkList {
+        std::vector<Sink> sinks;
+    };
+
+    // Freed once both reader counters were seen at zero after it was replaced
+    struct Retired {
+        SinkList* list;
+        IFileDialogEvents* pSink;  // Reference dropped by unadvise, or nullptr
+        uint64_t sequence;
+    };
+
+    unsigned enterRead();
+    void exitRead(unsigned slot);
+
+    // Writer side, writeMutex held
+    void publish(SinkList* next, IFileDialogEvents* pRemoved);
+    void takeReclaimable(std::vector<Retired>& reclaimable);
+
+    void markDrained(unsigned slot, uint64_t sequence);
+    static void reclaim(std::vector<Retired>& reclaimable);
+
+    std::atomic<SinkList*> current;
+    std::atomic<unsigned> epoch;
+    std::atomic<long> readers[2];
+    std::atomic<bool> retiredPending;
+    std::atomic<uint64_t> retiredCount;     // Sequence of the latest retirement
+    std::atomic<uint64_t> drainedThrough[2];  // Retirements the counter was seen at zero after
+    std::atomic<size_t> sinkCount;
+
+    std::mutex writeMutex;
+    std::unordered_map<DWORD, size_t> positions;  // Cookie to index in current
+    std::deque<Retired> retired;  // In sequence order
+    DWORD nextCookie;
+};
+
+#endif // EVENT_SINK_REGISTRY_H
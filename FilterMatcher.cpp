@@ -0,0 +1,392 @@
+#include "FilterMatcher.h"
+#include <algorithm>
+#include <map>
+#include <cwctype>
+
+static const uint32_t kNoMask = 0xFFFFFFFFu;
+static const size_t kMaxDfaStates = 4096;
+static const size_t kMaxPackedExtension = 7;
+
+static wchar_t foldChar(wchar_t ch) {
+    if (static_cast<uint32_t>(ch) < 0x80) {
+        return (ch >= L'A' && ch <= L'Z') ? static_cast<wchar_t>(ch + (L'a' - L'A')) : ch;
+    }
+    return static_cast<wchar_t>(std::towlower(ch));
+}
+
+static std::wstring foldString(std::wstring_view s) {
+    std::wstring folded(s);
+    for (wchar_t& ch : folded) {
+        ch = foldChar(ch);
+    }
+    return folded;
+}
+
+// Lower-case the ASCII letters in 8 packed bytes at once
+static uint64_t asciiLower8(uint64_t x) {
+    const uint64_t ones = 0x0101010101010101ull;
+    uint64_t low7 = x & (0x7F * ones);
+    uint64_t atLeastA = low7 + (0x80 - 'A') * ones;      // High bit set where byte >= 'A'
+    uint64_t aboveZ = low7 + (0x80 - 'Z' - 1) * ones;    // High bit set where byte > 'Z'
+    uint64_t upper = atLeastA & ~aboveZ & ~x & (0x80 * ones);
+    return x | (upper >> 2);                               // 0x80 >> 2 == 0x20
+}
+
+// Pack a short ASCII extension into a case-folded key; the top byte holds length + 1 so the empty
+// extension ("*.") still gets a non-zero key
+static bool packExtension(std::wstring_view extension, uint64_t& key) {
+    if (extension.size() > kMaxPackedExtension) {
+        return false;
+    }
+    uint64_t packed = 0;
+    uint32_t any = 0;
+    for (size_t i = 0; i < extension.size(); ++i) {
+        uint32_t ch = static_cast<uint32_t>(extension[i]);
+        any |= ch;
+        packed |= static_cast<uint64_t>(ch & 0xFF) << (8 * i);
+    }
+    if (any & ~0x7Fu) {
+        return false;
+    }
+    key = asciiLower8(packed) | (static_cast<uint64_t>(extension.size() + 1) << 56);
+    return true;
+}
+
+static size_t extensionHash(uint64_t key, size_t slotMask) {
+    return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & slotMask;
+}
+
+// Extension of a leaf name: after the last '.', or empty when there is none
+static std::wstring_view nameExtension(std::wstring_view name) {
+    size_t dot = name.rfind(L'.');
+    return (dot == std::wstring_view::npos) ? std::wstring_view() : name.substr(dot + 1);
+}
+
+static std::wstring_view trimPattern(std::wstring_view pattern) {
+    while (!pattern.empty() && (pattern.front() == L' ' || pattern.front() == L'\t')) {
+        pattern.remove_prefix(1);
+    }
+    while (!pattern.empty() && (pattern.back() == L' ' || pattern.back() == L'\t')) {
+        pattern.remove_suffix(1);
+    }
+    return pattern;
+}
+
+FilterMatcher::FilterMatcher(const COMDLG_FILTERSPEC* filters, UINT filterCount)
+    : filterTotal(filterCount), words((filterCount + 63) / 64), matchAllMask(kNoMask),
+      extensionCount(0), hasExtensions(false), classCount(1), dfaOverflow(false) {
+    if (words == 0) {
+        words = 1;
+    }
+    std::fill(asciiClass, asciiClass + 128, static_cast<uint16_t>(0));
+
+    std::map<uint64_t, uint32_t> packedExtensions;
+    for (UINT filter = 0; filter < filterCount; ++filter) {
+        std::wstring_view spec = filters[filter].pszSpec ? filters[filter].pszSpec : L"";
+        while (!spec.empty()) {
+            size_t separator = spec.find(L';');
+            std::wstring_view pattern = trimPattern(spec.substr(0, separator));
+            spec = (separator == std::wstring_view::npos) ? std::wstring_view() : spec.substr(separator + 1);
+            if (pattern.empty()) {
+                continue;
+            }
+
+            if (pattern.find_first_not_of(L'*') == std::wstring_view::npos || pattern == L"*.*") {
+                if (matchAllMask == kNoMask) {
+                    matchAllMask = newMask();
+                }
+                setBit(matchAllMask, filter);
+            } else if (pattern.size() >= 2 && pattern[0] == L'*' && pattern[1] == L'.' &&
+                       pattern.find_first_of(L"*?.", 2) == std::wstring_view::npos) {
+                std::wstring_view extension = pattern.substr(2);
+                uint64_t key;
+                if (packExtension(extension, key)) {
+                    auto it = packedExtensions.find(key);
+                    if (it == packedExtensions.end()) {
+                        it = packedExtensions.emplace(key, newMask()).first;
+                    }
+                    setBit(it->second, filter);
+                } else {
+                    std::wstring folded = foldString(extension);
+                    auto it = longExtensions.find(folded);
+                    if (it == longExtensions.end()) {
+                        it = longExtensions.emplace(folded, newMask()).first;
+                    }
+                    setBit(it->second, filter);
+                }
+                hasExtensions = true;
+            } else {
+                patterns.push_back({ foldString(pattern), filter });
+            }
+        }
+    }
+
+    // Open-addressing table at no more than half load
+    size_t slotCount = 8;
+    while (slotCount < packedExtensions.size() * 2) {
+        slotCount *= 2;
+    }
+    extensionSlots.assign(slotCount, ExtensionSlot{ 0, 0 });
+    for (const auto& entry : packedExtensions) {
+        size_t slot = extensionHash(entry.first, slotCount - 1);
+        while (extensionSlots[slot].key != 0) {
+            slot = (slot + 1) & (slotCount - 1);
+        }
+        extensionSlots[slot] = ExtensionSlot{ entry.first, entry.second };
+    }
+    extensionCount = packedExtensions.size();
+
+    if (!patterns.empty()) {
+        buildDfa();
+    }
+}
+
+uint32_t FilterMatcher::newMask() {
+    uint32_t offset = static_cast<uint32_t>(masks.size());
+    masks.resize(masks.size() + words, 0);
+    return offset;
+}
+
+void FilterMatcher::orMask(uint32_t mask, uint64_t* out) const {
+    for (size_t i = 0; i < words; ++i) {
+        out[i] |= masks[mask + i];
+    }
+}
+
+uint16_t FilterMatcher::charClass(wchar_t ch) const {
+    wchar_t folded = foldChar(ch);
+    if (static_cast<uint32_t>(folded) < 0x80) {
+        return asciiClass[folded];
+    }
+    auto it = wideClass.find(folded);
+    return (it == wideClass.end()) ? 0 : it->second;
+}
+
+// Subset construction over all general patterns at once. NFA state ids are (pattern, position)
+// pairs laid out back to back; state 0 of the DFA is the dead state, state 1 the start.
+void FilterMatcher::buildDfa() {
+    std::vector<uint32_t> base;
+    std::vector<uint32_t> nfaPattern;
+    std::vector<uint32_t> nfaPosition;
+    for (uint32_t p = 0; p < patterns.size(); ++p) {
+        base.push_back(static_cast<uint32_t>(nfaPattern.size()));
+        for (uint32_t i = 0; i <= patterns[p].tokens.size(); ++i) {
+            nfaPattern.push_back(p);
+            nfaPosition.push_back(i);
+        }
+        // Every distinct literal gets its own input class; class 0 is "anything else"
+        for (wchar_t token : patterns[p].tokens) {
+            if (token == L'*' || token == L'?' || charClass(token) != 0) {
+                continue;
+            }
+            uint16_t cls = static_cast<uint16_t>(classCount++);
+            if (static_cast<uint32_t>(token) < 0x80) {
+                asciiClass[token] = cls;
+            } else {
+                wideClass[token] = cls;
+            }
+        }
+    }
+
+    auto closure = [&](std::vector<uint32_t>& set) {
+        for (size_t k = 0; k < set.size(); ++k) {
+            uint32_t id = set[k];
+            const std::wstring& tokens = patterns[nfaPattern[id]].tokens;
+            if (nfaPosition[id] < tokens.size() && tokens[nfaPosition[id]] == L'*') {
+                set.push_back(id + 1);
+            }
+        }
+        std::sort(set.begin(), set.end());
+        set.erase(std::unique(set.begin(), set.end()), set.end());
+    };
+
+    std::map<std::vector<uint32_t>, uint32_t> stateIds;
+    std::vector<std::vector<uint32_t>> states;
+    states.push_back({});
+    stateIds[states[0]] = 0;
+    std::vector<uint32_t> start(base.begin(), base.end());
+    closure(start);
+    stateIds[start] = 1;
+    states.push_back(start);
+
+    for (size_t s = 0; s < states.size(); ++s) {
+        transitions.resize((s + 1) * classCount, 0);
+        for (size_t cls = 0; cls < classCount; ++cls) {
+            std::vector<uint32_t> next;
+            for (uint32_t id : states[s]) {
+                const std::wstring& tokens = patterns[nfaPattern[id]].tokens;
+                uint32_t position = nfaPosition[id];
+                if (position == tokens.size()) {
+                    continue;
+                }
+                wchar_t token = tokens[position];
+                if (token == L'*') {
+                    next.push_back(id);
+                } else if (token == L'?' || charClass(token) == cls) {
+                    next.push_back(id + 1);
+                }
+            }
+            closure(next);
+            auto it = stateIds.find(next);
+            if (it == stateIds.end()) {
+                if (states.size() >= kMaxDfaStates) {
+                    // Too many states; globMatch handles the general patterns instead
+                    dfaOverflow = true;
+                    transitions.clear();
+                    acceptMask.clear();
+                    return;
+                }
+                it = stateIds.emplace(next, static_cast<uint32_t>(states.size())).first;
+                states.push_back(next);
+            }
+            transitions[s * classCount + cls] = it->second;
+        }
+    }
+
+    acceptMask.assign(states.size(), -1);
+    for (size_t s = 0; s < states.size(); ++s) {
+        for (uint32_t id : states[s]) {
+            const GlobPattern& pattern = patterns[nfaPattern[id]];
+            if (nfaPosition[id] == pattern.tokens.size()) {
+                if (acceptMask[s] < 0) {
+                    acceptMask[s] = newMask();
+                }
+                setBit(static_cast<uint32_t>(acceptMask[s]), pattern.filter);
+            }
+        }
+    }
+}
+
+void FilterMatcher::matchMask(std::wstring_view name, uint64_t* out) const {
+    if (matchAllMask != kNoMask) {
+        orMask(matchAllMask, out);
+    }
+
+    if (hasExtensions) {
+        std::wstring_view extension = nameExtension(name);
+        uint64_t key;
+        if (packExtension(extension, key)) {
+            size_t slotMask = extensionSlots.size() - 1;
+            for (size_t slot = extensionHash(key, slotMask); extensionSlots[slot].key != 0; slot = (slot + 1) & slotMask) {
+                if (extensionSlots[slot].key == key) {
+                    orMask(extensionSlots[slot].mask, out);
+                    break;
+                }
+            }
+        } else if (!longExtensions.empty()) {
+            auto it = longExtensions.find(foldString(extension));
+            if (it != longExtensions.end()) {
+                orMask(it->second, out);
+            }
+        }
+    }
+
+    if (patterns.empty()) {
+        return;
+    }
+    if (dfaOverflow) {
+        for (const GlobPattern& pattern : patterns) {
+            if (globMatch(pattern.tokens, name)) {
+                out[pattern.filter / 64] |= 1ull << (pattern.filter % 64);
+            }
+        }
+        return;
+    }
+    uint32_t state = 1;
+    for (wchar_t ch : name) {
+        state = transitions[state * classCount + charClass(ch)];
+        if (state == 0) {
+            return;
+        }
+    }
+    if (acceptMask[state] >= 0) {
+        orMask(static_cast<uint32_t>(acceptMask[state]), out);
+    }
+}
+
+bool FilterMatcher::matches(size_t filterIndex, std::wstring_view name) const {
+    if (filterIndex >= filterTotal) {
+        return false;
+    }
+    uint64_t stackMask[4] = {};
+    std::vector<uint64_t> heapMask;
+    uint64_t* mask = stackMask;
+    if (words > 4) {
+        heapMask.assign(words, 0);
+        mask = heapMask.data();
+    }
+    matchMask(name, mask);
+    return (mask[filterIndex / 64] >> (filterIndex % 64)) & 1;
+}
+
+// Position of the lowest set bit across the mask words, or -1
+static int lowestBit(const uint64_t* mask, size_t words) {
+    for (size_t w = 0; w < words; ++w) {
+        if (mask[w]) {
+            uint64_t bits = mask[w];
+            int bit = 0;
+            while (!(bits & 1)) {
+                bits >>= 1;
+                ++bit;
+            }
+            return static_cast<int>(w * 64) + bit;
+        }
+    }
+    return -1;
+}
+
+int FilterMatcher::firstMatch(std::wstring_view name) const {
+    std::vector<int> out;
+    classifyListing(&name, 1, out);
+    return out[0];
+}
+
+void FilterMatcher::matchListing(size_t filterIndex, const std::wstring_view* names, size_t count, std::vector<uint8_t>& out) const {
+    out.assign(count, 0);
+    if (filterIndex >= filterTotal) {
+        return;
+    }
+    std::vector<uint64_t> mask(words);
+    size_t word = filterIndex / 64;
+    uint64_t bit = 1ull << (filterIndex % 64);
+    for (size_t i = 0; i < count; ++i) {
+        std::fill(mask.begin(), mask.end(), 0);
+        matchMask(names[i], mask.data());
+        out[i] = (mask[word] & bit) ? 1 : 0;
+    }
+}
+
+void FilterMatcher::classifyListing(const std::wstring_view* names, size_t count, std::vector<int>& out) const {
+    out.resize(count);
+    std::vector<uint64_t> mask(words);
+    for (size_t i = 0; i < count; ++i) {
+        std::fill(mask.begin(), mask.end(), 0);
+        matchMask(names[i], mask.data());
+        out[i] = lowestBit(mask.data(), words);
+    }
+}
+
+bool FilterMatcher::globMatch(std::wstring_view pattern, std::wstring_view name) {
+    size_t p = 0;
+    size_t n = 0;
+    size_t starP = std::wstring_view::npos;
+    size_t starN = 0;
+    while (n < name.size()) {
+        if (p < pattern.size() && pattern[p] == L'*') {
+            starP = p++;
+            starN = n;
+        } else if (p < pattern.size() && (pattern[p] == L'?' || foldChar(pattern[p]) == foldChar(name[n]))) {
+            ++p;
+            ++n;
+        } else if (starP != std::wstring_view::npos) {
+            p = starP + 1;
+            n = ++starN;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == L'*') {
+        ++p;
+    }
+    return p == pattern.size();
+}
@@ -0,0 +1,78 @@
+#ifndef FILTER_MATCHER_H
+#define FILTER_MATCHER_H
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "IFileDialog.h"
+
+// COMDLG_FILTERSPEC set compiled for matching file names, with Windows semantics: matching is
+// case-insensitive, a spec holds ';'-separated patterns, and "*" / "*.*" match every name.
+//  - "*.ext" patterns (the common case) go into one extension hash table. Extensions of up to
+//    7 ASCII characters are packed and case-folded 8 characters at a time (SWAR).
+//  - Every other glob ('*' and '?') is compiled into one shared DFA over the literal characters
+//    the patterns use.
+// A name's result is a bit mask over the filters, so one pass answers for all file types.
+class FilterMatcher {
+public:
+    FilterMatcher(const COMDLG_FILTERSPEC* filters, UINT filterCount);
+
+    size_t filterCount() const { return filterTotal; }
+
+    // Whether name (a leaf file name) matches filter filterIndex (0-based)
+    bool matches(size_t filterIndex, std::wstring_view name) const;
+
+    // Index of the first filter name matches, or -1
+    int firstMatch(std::wstring_view name) const;
+
+    // Batch forms over a whole listing. For matchListing, out[i] is 1 when names[i] matches
+    // filterIndex (the dialog's active file type); for classifyListing, out[i] is firstMatch(names[i]).
+    void matchListing(size_t filterIndex, const std::wstring_view* names, size_t count, std::vector<uint8_t>& out) const;
+    void classifyListing(const std::wstring_view* names, size_t count, std::vector<int>& out) const;
+
+    // Reference matcher for a single pattern, used when the DFA grows too large
+    static bool globMatch(std::wstring_view pattern, std::wstring_view name);
+
+private:
+    struct ExtensionSlot {
+        uint64_t key;     // 0 marks an empty slot
+        uint32_t mask;    // Offset into masks
+    };
+
+    struct GlobPattern {
+        std::wstring tokens;  // Case-folded
+        size_t filter;
+    };
+
+    uint32_t newMask();
+    void setBit(uint32_t mask, size_t filter) { masks[mask + filter / 64] |= 1ull << (filter % 64); }
+    void orMask(uint32_t mask, uint64_t* out) const;
+
+    void buildDfa();
+    uint16_t charClass(wchar_t ch) const;
+
+    // ORs the masks of every filter name matches into out (words entries)
+    void matchMask(std::wstring_view name, uint64_t* out) const;
+
+    size_t filterTotal;
+    size_t words;                  // uint64_t words per mask
+    std::vector<uint64_t> masks;   // Flat mask storage
+    uint32_t matchAllMask;
+
+    std::vector<ExtensionSlot> extensionSlots;  // Open addressing, power-of-two size
+    size_t extensionCount;
+    std::unordered_map<std::wstring, uint32_t> longExtensions;  // Non-ASCII or longer than 7
+    bool hasExtensions;
+
+    std::vector<GlobPattern> patterns;
+    uint16_t asciiClass[128];
+    std::unordered_map<wchar_t, uint16_t> wideClass;
+    size_t classCount;
+    std::vector<uint32_t> transitions;  // [state * classCount + class]
+    std::vector<int64_t> acceptMask;    // Mask offset per DFA state, -1 when not accepting
+    bool dfaOverflow;
+};
+
+#endif // FILTER_MATCHER_H
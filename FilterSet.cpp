@@ -0,0 +1,129 @@
+#include "FilterSet.h"
+#include <algorithm>
+
+static const uint32_t kEmptySlot = 0xFFFFFFFFu;
+static const size_t kMinSlots = 16;
+// Arena size below which superseded strings are never worth reclaiming
+static const size_t kCompactThreshold = 4096;
+
+// FNV-1a over the UTF-16/32 code units
+static size_t hashString(std::wstring_view s) {
+    uint32_t hash = 2166136261u;
+    for (wchar_t ch : s) {
+        hash = (hash ^ static_cast<uint32_t>(ch)) * 16777619u;
+    }
+    return hash;
+}
+
+void FilterSet::reserve(size_t filterCount, size_t charCount) {
+    entries.reserve(filterCount);
+    specs.reserve(filterCount);
+    const wchar_t* before = arena.data();
+    arena.reserve(charCount + 2 * filterCount);
+    if (arena.data() != before) {
+        rebind();
+    }
+    while (slots.size() < 4 * filterCount) {
+        growSlots();
+    }
+}
+
+void FilterSet::add(std::wstring_view name, std::wstring_view spec) {
+    Entry entry;
+    entry.name = intern(name);
+    entry.spec = intern(spec);
+    entries.push_back(entry);
+    specs.push_back({ arena.data() + entry.name, arena.data() + entry.spec });
+    entryChars += name.size() + spec.size();
+}
+
+void FilterSet::set(size_t index, std::wstring_view name, std::wstring_view spec) {
+    size_t oldChars = this->name(index).size() + this->spec(index).size();
+    Entry entry;
+    entry.name = intern(name);
+    entry.spec = intern(spec);
+    entries[index] = entry;
+    specs[index] = { arena.data() + entry.name, arena.data() + entry.spec };
+    entryChars = entryChars - oldChars + name.size() + spec.size();
+
+    if (arena.size() > kCompactThreshold && arena.size() > 2 * (entryChars + 2 * entries.size())) {
+        compact();
+    }
+}
+
+void FilterSet::clear() {
+    arena.clear();
+    entries.clear();
+    specs.clear();
+    std::fill(slots.begin(), slots.end(), kEmptySlot);
+    entryChars = 0;
+    internedCount = 0;
+}
+
+uint32_t FilterSet::intern(std::wstring_view s) {
+    // s may point into the arena, which the append below can move
+    if (!arena.empty() && s.data() >= arena.data() && s.data() < arena.data() + arena.size()) {
+        std::wstring copy(s);
+        return intern(copy);
+    }
+
+    if ((internedCount + 1) * 2 > slots.size()) {
+        growSlots();
+    }
+    size_t slotMask = slots.size() - 1;
+    size_t slot = hashString(s) & slotMask;
+    for (; slots[slot] != kEmptySlot; slot = (slot + 1) & slotMask) {
+        if (view(slots[slot]) == s) {
+            return slots[slot];
+        }
+    }
+
+    uint32_t offset = static_cast<uint32_t>(arena.size());
+    const wchar_t* before = arena.data();
+    arena.insert(arena.end(), s.begin(), s.end());
+    arena.push_back(L'\0');
+    if (arena.data() != before) {
+        rebind();
+    }
+    slots[slot] = offset;
+    ++internedCount;
+    return offset;
+}
+
+void FilterSet::growSlots() {
+    std::vector<uint32_t> old;
+    old.swap(slots);
+    slots.assign(std::max(kMinSlots, old.size() * 2), kEmptySlot);
+    size_t slotMask = slots.size() - 1;
+    for (uint32_t offset : old) {
+        if (offset == kEmptySlot) {
+            continue;
+        }
+        size_t slot = hashString(view(offset)) & slotMask;
+        while (slots[slot] != kEmptySlot) {
+            slot = (slot + 1) & slotMask;
+        }
+        slots[slot] = offset;
+    }
+}
+
+// Point the COMDLG_FILTERSPEC view back into the arena after it moved
+void FilterSet::rebind() {
+    for (size_t i = 0; i < entries.size(); ++i) {
+        specs[i] = { arena.data() + entries[i].name, arena.data() + entries[i].spec };
+    }
+}
+
+// Re-intern the live strings into a fresh arena, dropping the ones set() superseded
+void FilterSet::compact() {
+    std::vector<wchar_t> old;
+    old.swap(arena);
+    arena.reserve(entryChars + 2 * entries.size());
+    std::fill(slots.begin(), slots.end(), kEmptySlot);
+    internedCount = 0;
+    for (Entry& entry : entries) {
+        entry.name = intern(std::wstring_view(old.data() + entry.name));
+        entry.spec = intern(std::wstring_view(old.data() + entry.spec));
+    }
+    rebind();
+}
@@ -0,0 +1,60 @@
+#ifndef FILTER_SET_H
+#define FILTER_SET_H
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <string_view>
+#include "IFileDialog.h"
+
+// Owning list of file type filters. Every name and spec lives in one null-terminated arena and
+// identical strings are stored once, so a session's filters cost no per-filter allocations.
+// data() is a contiguous COMDLG_FILTERSPEC array pointing into the arena, ready for SetFileTypes.
+// Move-only: pointers handed out stay valid until the set is modified or destroyed.
+class FilterSet {
+public:
+    FilterSet() : entryChars(0), internedCount(0) {}
+    FilterSet(FilterSet&& other) noexcept = default;
+    FilterSet& operator=(FilterSet&& other) noexcept = default;
+    FilterSet(const FilterSet&) = delete;
+    FilterSet& operator=(const FilterSet&) = delete;
+
+    // Pre-size for filterCount filters totalling charCount characters of names and specs
+    void reserve(size_t filterCount, size_t charCount);
+    void add(std::wstring_view name, std::wstring_view spec);
+    // Replace filter index; superseded strings are reclaimed once they dominate the arena
+    void set(size_t index, std::wstring_view name, std::wstring_view spec);
+    void clear();
+
+    size_t size() const { return specs.size(); }
+    bool empty() const { return specs.empty(); }
+    UINT count() const { return static_cast<UINT>(specs.size()); }
+    const COMDLG_FILTERSPEC* data() const { return specs.data(); }
+    const COMDLG_FILTERSPEC& operator[](size_t index) const { return specs[index]; }
+    std::wstring_view name(size_t index) const { return view(entries[index].name); }
+    std::wstring_view spec(size_t index) const { return view(entries[index].spec); }
+
+    // Arena size in characters, terminators included
+    size_t arenaChars() const { return arena.size(); }
+
+private:
+    struct Entry {
+        uint32_t name;  // Arena offsets
+        uint32_t spec;
+    };
+
+    std::wstring_view view(uint32_t offset) const { return std::wstring_view(arena.data() + offset); }
+    uint32_t intern(std::wstring_view s);
+    void growSlots();
+    void rebind();
+    void compact();
+
+    std::vector<wchar_t> arena;
+    std::vector<Entry> entries;
+    std::vector<COMDLG_FILTERSPEC> specs;  // Parallel to entries
+    std::vector<uint32_t> slots;           // Intern table of arena offsets, open addressing
+    size_t entryChars;                     // Characters referenced by entries, duplicates counted
+    size_t internedCount;
+};
+
+#endif // FILTER_SET_H
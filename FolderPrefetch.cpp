@@ -0,0 +1,203 @@
+#include "FolderPrefetch.h"
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <thread>
+
+// Items per Next() call
+static const ULONG kPrefetchChunkSize = 256;
+static const size_t kMaxPrefetchWorkers = 8;
+
+// Fixed set of worker threads shared by every prefetch. Each worker initializes COM for itself.
+class PrefetchPool {
+public:
+    static PrefetchPool& instance() {
+        static PrefetchPool pool;
+        return pool;
+    }
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        wake.notify_one();
+    }
+
+    size_t workerCount() const { return workers.size(); }
+
+private:
+    PrefetchPool() : stopping(false) {
+        size_t count = std::min<size_t>(kMaxPrefetchWorkers, std::max(2u, std::thread::hardware_concurrency()));
+        for (size_t i = 0; i < count; ++i) {
+            workers.emplace_back([this] { run(); });
+        }
+    }
+
+    ~PrefetchPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            tasks.clear();
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    void run() {
+        COMFunctionPointers comFuncs = LoadCOMFunctionPointers();
+        if (comFuncs.pCoInitialize) {
+            comFuncs.pCoInitialize(NULL);
+        }
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping) {
+                    break;
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+        if (comFuncs.pCoUninitialize) {
+            comFuncs.pCoUninitialize();
+        }
+        FreeCOMFunctionPointers(comFuncs);
+    }
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::function<void()>> tasks;
+    std::vector<std::thread> workers;
+    bool stopping;
+};
+
+size_t folderPrefetchWorkers() {
+    return PrefetchPool::instance().workerCount();
+}
+
+static void runFolderPrefetch(const std::shared_ptr<FolderPrefetch>& prefetch) {
+    if (prefetch->isCancelled()) {
+        prefetch->finish(E_ABORT, std::vector<IShellItem*>());
+        return;
+    }
+    IEnumShellItems* pEnum = nullptr;
+    HRESULT hr = prefetch->folder()->BindToHandler(NULL, BHID_EnumItems, IID_IEnumShellItems, reinterpret_cast<void**>(&pEnum));
+    if (FAILED(hr)) {
+        prefetch->finish(hr, std::vector<IShellItem*>());
+        return;
+    }
+
+    std::vector<IShellItem*> listing;
+    ULONG fetched = 0;
+    do {
+        size_t size = listing.size();
+        listing.resize(size + kPrefetchChunkSize);
+        hr = pEnum->Next(kPrefetchChunkSize, listing.data() + size, &fetched);
+        listing.resize(size + fetched);
+        if (fetched) {
+            prefetch->itemsArrived();
+        }
+    } while (hr == S_OK && fetched == kPrefetchChunkSize && !prefetch->isCancelled());
+    pEnum->Release();
+    prefetch->finish(FAILED(hr) ? hr : S_OK, std::move(listing));
+}
+
+FolderPrefetch::FolderPrefetch(IShellItem* pFolder)
+    : pFolder(pFolder), start(std::chrono::steady_clock::now()), cancelled(false), complete(false), result(S_OK),
+      firstItemSeconds(-1.0), completeSeconds(-1.0) {
+    pFolder->AddRef();
+}
+
+FolderPrefetch::~FolderPrefetch() {
+    for (IShellItem* pItem : items) {
+        pItem->Release();
+    }
+    pFolder->Release();
+}
+
+double FolderPrefetch::elapsed() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void FolderPrefetch::cancel() {
+    cancelled.store(true, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mutex);
+    changed.notify_all();
+}
+
+void FolderPrefetch::itemsArrived() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (firstItemSeconds < 0.0) {
+        firstItemSeconds = elapsed();
+        changed.notify_all();
+    }
+}
+
+void FolderPrefetch::finish(HRESULT hr, std::vector<IShellItem*>&& listing) {
+    std::lock_guard<std::mutex> lock(mutex);
+    complete = true;
+    completeSeconds = elapsed();
+    if (isCancelled()) {
+        result = E_ABORT;
+        for (IShellItem* pItem : listing) {
+            pItem->Release();
+        }
+    } else {
+        result = hr;
+        items = std::move(listing);
+    }
+    changed.notify_all();
+}
+
+HRESULT FolderPrefetch::waitForFirstItem() {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this] { return firstItemSeconds >= 0.0 || complete || isCancelled(); });
+    if (isCancelled()) {
+        return E_ABORT;
+    }
+    return complete ? result : S_OK;
+}
+
+HRESULT FolderPrefetch::waitForCompletion() {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this] { return complete || isCancelled(); });
+    return complete ? result : E_ABORT;
+}
+
+FolderPrefetchMetrics FolderPrefetch::metrics() {
+    std::lock_guard<std::mutex> lock(mutex);
+    FolderPrefetchMetrics metrics;
+    metrics.firstItemSeconds = firstItemSeconds;
+    metrics.completeSeconds = complete ? completeSeconds : -1.0;
+    metrics.itemCount = items.size();
+    metrics.hr = complete ? result : E_PENDING;
+    metrics.cancelled = isCancelled();
+    return metrics;
+}
+
+HRESULT FolderPrefetch::getItems(std::vector<IShellItem*>& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!complete) {
+        return E_PENDING;
+    }
+    if (FAILED(result)) {
+        return result;
+    }
+    out = items;
+    for (IShellItem* pItem : out) {
+        pItem->AddRef();
+    }
+    return S_OK;
+}
+
+std::shared_ptr<FolderPrefetch> startFolderPrefetch(IShellItem* pFolder) {
+    std::shared_ptr<FolderPrefetch> prefetch = std::make_shared<FolderPrefetch>(pFolder);
+    PrefetchPool::instance().submit([prefetch] { runFolderPrefetch(prefetch); });
+    return prefetch;
+}
@@ -0,0 +1,66 @@
+#ifndef FOLDER_PREFETCH_H
+#define FOLDER_PREFETCH_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "IFileDialog.h"
+
+struct FolderPrefetchMetrics {
+    double firstItemSeconds;  // From start to the first item; -1 until there is one
+    double completeSeconds;   // From start to the end of the listing; -1 until then
+    size_t itemCount;
+    HRESULT hr;
+    bool cancelled;
+};
+
+// A folder's contents being enumerated in the background (BHID_EnumItems, batched Next). Each
+// prefetch is one task on the prefetch pool, so concurrent prefetches of different folders run side
+// by side without one folder's listing queueing work ahead of the others.
+class FolderPrefetch {
+public:
+    explicit FolderPrefetch(IShellItem* pFolder);
+    ~FolderPrefetch();
+
+    IShellItem* folder() const { return pFolder; }
+
+    // Ask the workers to stop at their next batch; waiters are released
+    void cancel();
+    bool isCancelled() const { return cancelled.load(std::memory_order_relaxed); }
+
+    HRESULT waitForFirstItem();
+    HRESULT waitForCompletion();
+    FolderPrefetchMetrics metrics();
+
+    // The whole listing in enumeration order, once complete. The caller gets one reference per item.
+    HRESULT getItems(std::vector<IShellItem*>& items);
+
+    // Called by the prefetch workers
+    void itemsArrived();
+    void finish(HRESULT hr, std::vector<IShellItem*>&& listing);
+
+private:
+    double elapsed() const;
+
+    IShellItem* pFolder;
+    std::chrono::steady_clock::time_point start;
+    std::atomic<bool> cancelled;
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool complete;
+    HRESULT result;
+    double firstItemSeconds;
+    double completeSeconds;
+    std::vector<IShellItem*> items;
+};
+
+// Start enumerating pFolder on the process-wide prefetch pool
+std::shared_ptr<FolderPrefetch> startFolderPrefetch(IShellItem* pFolder);
+
+// Workers in the prefetch pool
+size_t folderPrefetchWorkers();
+
+#endif // FOLDER_PREFETCH_H
@@ -1,8 +1,16 @@
 #include "IFileDialog.h"
 #include "ProjWinUtils.h"
-#include <iostream>
+#include "ShellItemExtractor.h"
+#include "FilterSet.h"
+#include "SnapshotShellItemArray.h"
+#include "ResultSink.h"
+#include "ComPtr.h"
+#include "QueryInterfaceTable.h"
+#include "ShellItemDisplayNames.h"
 #include <vector>
 #include <string>
+#include <stdexcept>
+#include <algorithm>
 
 class FileDialogEventHandler : public IFileDialogEvents {
 public:
@@ -10,13 +18,7 @@ public:
 
     // IUnknown methods
     HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppv) {
-        if (riid == IID_IUnknown || riid == IID_IFileDialogEvents) {
-            *ppv = static_cast<IFileDialogEvents*>(this);
-            AddRef();
-            return S_OK;
-        }
-        *ppv = nullptr;
-        return E_NOINTERFACE;
+        return QueryInterfaceTable<FileDialogEventHandler, IFileDialogEvents>::query(this, riid, ppv);
     }
 
     ULONG STDMETHODCALLTYPE AddRef() {
@@ -47,145 +49,91 @@ private:
     LONG refCount;
 };
 
+// Class and interface per dialogType, 1 to 4
+static const struct {
+    const CLSID* clsid;
+    const IID* iid;
+} kDialogClasses[] = {
+    { &CLSID_FileOpenDialog, &IID_IFileOpenDialog },
+    { &CLSID_FileSaveDialog, &IID_IFileSaveDialog },
+    { &CLSID_FileDialog, &IID_IFileDialog },
+    { &CLSID_FileOpenDialog, &IID_IFileOpenDialog },
+};
+
 void createFileDialog(COMFunctionPointers& comFuncs, IFileDialog** ppFileDialog, int dialogType) {
-    HRESULT hr;
-    if (dialogType == 1 || dialogType == 4) {
-        hr = comFuncs.pCoCreateInstance(CLSID_FileOpenDialog, NULL, CLSCTX_INPROC_SERVER, IID_IFileOpenDialog, reinterpret_cast<void**>(ppFileDialog));
-    } else if (dialogType == 2) {
-        hr = comFuncs.pCoCreateInstance(CLSID_FileSaveDialog, NULL, CLSCTX_INPROC_SERVER, IID_IFileSaveDialog, reinterpret_cast<void**>(ppFileDialog));
-    } else if (dialogType == 3) {
-        hr = comFuncs.pCoCreateInstance(CLSID_FileDialog, NULL, CLSCTX_INPROC_SERVER, IID_IFileDialog, reinterpret_cast<void**>(ppFileDialog));
-    } else {
+    if (dialogType < 1 || dialogType > static_cast<int>(sizeof(kDialogClasses) / sizeof(kDialogClasses[0]))) {
         throw std::runtime_error("Invalid dialog type.");
     }
-    COM_REQUIRE_SUCCESS(hr, comFuncs, L"Failed to create file dialog", return);
+    const auto& dialogClass = kDialogClasses[dialogType - 1];
+    HRESULT hr = comFuncs.pCoCreateInstance(*dialogClass.clsid, NULL, CLSCTX_INPROC_SERVER, *dialogClass.iid, reinterpret_cast<void**>(ppFileDialog));
+    COM_REQUIRE_SUCCESS(hr, kTraceCreateDialogFailed, return);
 }
 
 void showDialog(COMFunctionPointers& comFuncs, IFileDialog* pFileOpenDialog, HWND hwndOwner) {
     HRESULT hr = pFileOpenDialog->Show(hwndOwner);
-    COM_REQUIRE_SUCCESS(hr, comFuncs, L"Failed to show the file open dialog", return);
+    COM_REQUIRE_SUCCESS(hr, kTraceShowFailed, return);
 }
 
-std::vector<std::wstring> getFileDialogResults(COMFunctionPointers& comFuncs, IFileOpenDialog* pFileOpenDialog) {
-    std::vector<std::wstring> results;
-    IShellItemArray* pResultsArray = nullptr;
-    HRESULT hr = pFileOpenDialog->GetResults(&pResultsArray);
+HRESULT getFileDialogResults(COMFunctionPointers& comFuncs, IFileOpenDialog* pFileOpenDialog, ResultSink& sink) {
+    ComPtr<IShellItemArray> resultsArray;
+    HRESULT hr = pFileOpenDialog->GetResults(resultsArray.put());
     if (FAILED(hr)) {
-        std::wcerr << L"Failed to get dialog results. HRESULT: " << hr << std::endl;
-        comFuncs.pCoUninitialize();
-        return results;
+        trace(kTraceGetResultsFailed, hr);
+        return hr;
     }
 
     DWORD itemCount = 0;
-    hr = pResultsArray->GetCount(&itemCount);
+    hr = resultsArray->GetCount(&itemCount);
     if (FAILED(hr)) {
-        std::wcerr << L"Failed to get item count. HRESULT: " << hr << std::endl;
-        pResultsArray->Release();
-        comFuncs.pCoUninitialize();
-        return results;
+        trace(kTraceGetCountFailed, hr);
+        return hr;
     }
 
-    std::wcout << L"Number of items selected: " << itemCount << std::endl;
-
-    IEnumShellItems* pEnumShellItems = nullptr;
-    hr = pResultsArray->EnumItems(&pEnumShellItems);
-    if (SUCCEEDED(hr) && pEnumShellItems) {
-        IShellItem* pEnumItem = nullptr;
-        ULONG fetched = 0;
-        while (pEnumShellItems->Next(1, &pEnumItem, &fetched) == S_OK && fetched > 0) {
-            std::wcout << L"Enumerating item: " << std::endl;
-            LPWSTR pszName = nullptr;
-            hr = pEnumItem->GetDisplayName(SIGDN_NORMALDISPLAY, &pszName);
-            if (SUCCEEDED(hr)) {
-                std::wcout << L" - Display name: " << pszName << std::endl;
-                comFuncs.pCoTaskMemFree(pszName);
-            }
-
-            LPWSTR pszFilePath = nullptr;
-            hr = pEnumItem->GetDisplayName(SIGDN_FILESYSPATH, &pszFilePath);
-            if (SUCCEEDED(hr)) {
-                std::wcout << L" - File path: " << pszFilePath << std::endl;
-                comFuncs.pCoTaskMemFree(pszFilePath);
-            }
-
-            SFGAOF attributes;
-            hr = pEnumItem->GetAttributes(SFGAO_FILESYSTEM | SFGAO_FOLDER, &attributes);
-            if (SUCCEEDED(hr)) {
-                std::wcout << L" - Attributes: " << attributes << std::endl;
-            }
-
-            IShellItem* pParentItem = nullptr;
-            hr = pEnumItem->GetParent(&pParentItem);
-            if (SUCCEEDED(hr) && pParentItem) {
-                LPWSTR pszParentName = nullptr;
-                hr = pParentItem->GetDisplayName(SIGDN_NORMALDISPLAY, &pszParentName);
-                if (SUCCEEDED(hr)) {
-                    std::wcout << L" - Parent: " << pszParentName << std::endl;
-                    comFuncs.pCoTaskMemFree(pszParentName);
-                }
-                pParentItem->Release();
-            }
-
-            pEnumItem->Release();
+    sink.begin(itemCount);
+    ResultItem item = {};
+    if (sink.verbosity() == ResultVerbosityPaths) {
+        PathTable paths;
+        hr = getFilePathsFromShellItemArray(resultsArray.get(), comFuncs, paths);
+        for (size_t i = 0; i < paths.size(); ++i) {
+            item.index = i;
+            item.path = paths[i];
+            sink.item(item);
         }
-        pEnumShellItems->Release();
-    }
-
-    for (DWORD i = 0; i < itemCount; ++i) {
-        IShellItem* pItem = nullptr;
-        hr = pResultsArray->GetItemAt(i, &pItem);
+    } else if (sink.verbosity() == ResultVerbosityFull) {
+        std::vector<ShellItemRecord> records;
+        hr = extractShellItemRecords(comFuncs, resultsArray.get(), records);
         if (FAILED(hr)) {
-            std::wcerr << L"Failed to get item at index " << i << L". HRESULT: " << hr << std::endl;
-            continue;
-        }
-
-        LPWSTR pszFilePath = nullptr;
-        hr = pItem->GetDisplayName(SIGDN_FILESYSPATH, &pszFilePath);
-        if (SUCCEEDED(hr)) {
-            results.push_back(std::wstring(pszFilePath));
-            std::wcout << L"Item " << i << L" file path: " << pszFilePath << std::endl;
-            comFuncs.pCoTaskMemFree(pszFilePath);
-        } else {
-            std::wcerr << L"Failed to get file path for item " << i << L". HRESULT: " << hr << std::endl;
+            trace(kTraceEnumerateFailed, hr);
         }
-
-        SFGAOF sfgaoAttribs = 0;
-        hr = pItem->GetAttributes(SFGAO_FILESYSTEM, &sfgaoAttribs);
-        if (SUCCEEDED(hr)) {
-            std::wcout << L"Item " << i << L" attributes: " << sfgaoAttribs << std::endl;
-        } else {
-            std::wcerr << L"Failed to get attributes for item " << i << L". HRESULT: " << hr << std::endl;
-        }
-
-        IShellItem* pParentItem = nullptr;
-        hr = pItem->GetParent(&pParentItem);
-        if (SUCCEEDED(hr) && pParentItem) {
-            LPWSTR pszParentName = nullptr;
-            hr = pParentItem->GetDisplayName(SIGDN_NORMALDISPLAY, &pszParentName);
-            if (SUCCEEDED(hr)) {
-                std::wcout << L"Item " << i << L" parent: " << pszParentName << std::endl;
-                comFuncs.pCoTaskMemFree(pszParentName);
-            } else {
-                std::wcerr << L"Failed to get parent display name for item " << i << L". HRESULT: " << hr << std::endl;
+        for (size_t i = 0; i < records.size(); ++i) {
+            const ShellItemRecord& record = records[i];
+            if (FAILED(record.hr)) {
+                trace(kTraceReadItemFailed, record.hr, i);
             }
-            pParentItem->Release();
-        } else {
-            std::wcerr << L"Failed to get parent item for item " << i << L". HRESULT: " << hr << std::endl;
-        }
-
-        int comparisonResult;
-        hr = pItem->Compare(pItem, SICHINT_CANONICAL, &comparisonResult);
-        if (SUCCEEDED(hr)) {
-            std::wcout << L"Item " << i << L" comparison result (self): " << comparisonResult << std::endl;
-        } else {
-            std::wcerr << L"Failed to compare item " << i << L" with itself. HRESULT: " << hr << std::endl;
+            if (record.path.empty()) {
+                continue;
+            }
+            item.index = i;
+            item.path = record.path;
+            item.displayName = record.displayName;
+            item.parent = record.parent;
+            item.attributes = record.attributes;
+            sink.item(item);
         }
-
-        pItem->Release();
     }
+    sink.end();
+    return hr;
+}
 
-    pResultsArray->Release();
-    return results;
+// Lean variant of getFileDialogResults: collects only the file paths, into a single arena
+HRESULT getFileDialogResults(COMFunctionPointers& comFuncs, IFileOpenDialog* pFileOpenDialog, PathTable& results) {
+    ComPtr<IShellItemArray> resultsArray;
+    HRESULT hr = pFileOpenDialog->GetResults(resultsArray.put());
+    if (FAILED(hr)) {
+        trace(kTraceGetResultsFailed, hr);
+        return hr;
+    }
+    return getFilePathsFromShellItemArray(resultsArray.get(), comFuncs, results);
 }
 
 void setDialogAttributes(IFileDialog* pFileDialog, const std::wstring& title, const std::wstring& okButtonLabel, const std::wstring& fileNameLabel) {
@@ -203,18 +151,17 @@ void setDialogAttributes(IFileDialog* pFileDialog, const std::wstring& title, co
 }
 
 // Configure the file dialog
-void configureFileDialog(COMFunctionPointers& comFuncs, IFileDialog* pFileDialog, const std::vector<COMDLG_FILTERSPEC>& filters, const std::wstring& defaultFolder, DWORD options, bool forceFileSystem, bool allowMultiselect) {
+void configureFileDialog(COMFunctionPointers& comFuncs, IFileDialog* pFileDialog, const FilterSet& filters, const std::wstring& defaultFolder, DWORD options, bool forceFileSystem, bool allowMultiselect) {
     if (!filters.empty()) {
-        HRESULT hr = pFileDialog->SetFileTypes(static_cast<UINT>(filters.size()), filters.data());
-        COM_REQUIRE_SUCCESS(hr, comFuncs, L"Failed to set file types", return);
+        HRESULT hr = pFileDialog->SetFileTypes(filters.count(), filters.data());
+        COM_REQUIRE_SUCCESS(hr, kTraceSetFileTypesFailed, return);
     }
 
     if (!defaultFolder.empty()) {
-        IShellItem* pFolder = createShellItem(comFuncs, defaultFolder);
-        if (pFolder) {
-            HRESULT hr = pFileDialog->SetFolder(pFolder);
-            COM_REQUIRE_SUCCESS(hr, comFuncs, L"Failed to set default folder", return);
-            pFolder->Release();
+        ComPtr<IShellItem> folder = ComPtr<IShellItem>::attach(createShellItem(comFuncs, defaultFolder));
+        if (folder) {
+            HRESULT hr = pFileDialog->SetFolder(folder.get());
+            COM_REQUIRE_SUCCESS(hr, kTraceSetFolderFailed, return);
         }
     }
 
@@ -227,7 +174,7 @@ void configureFileDialog(COMFunctionPointers& comFuncs, IFileDialog* pFileDialog
     }
 
     HRESULT hr = pFileDialog->SetOptions(options);
-    COM_REQUIRE_SUCCESS(hr, comFuncs, L"Failed to set dialog options", return);
+    COM_REQUIRE_SUCCESS(hr, kTraceSetOptionsFailed, return);
 }
 
 
@@ -236,41 +183,89 @@ IShellItem* createShellItem(COMFunctionPointers& comFuncs, const std::wstring& p
     IShellItem* pItem = nullptr;
     HRESULT hr = comFuncs.pSHCreateItemFromParsingName(path.c_str(), NULL, IID_IShellItem, reinterpret_cast<void**>(&pItem));
     if (FAILED(hr)) {
-        std::wcerr << L"Failed to create shell item from path: " << path << std::endl;
+        trace(kTraceCreateItemFailed, hr);
     }
     return pItem;
 }
 
-// Helper function to get file paths from IShellItemArray
-std::vector<std::wstring> getFilePathsFromShellItemArray(IShellItemArray* pItemArray, COMFunctionPointers& comFuncs) {
-    std::vector<std::wstring> filePaths;
+// Walk pItemArray and pass each item's SIGDN_FILESYSPATH to append, which must copy it. Items with
+// IShellItemDisplayNames lend the path instead of allocating a copy.
+template <typename AppendPath>
+static HRESULT forEachFilePath(IShellItemArray* pItemArray, COMFunctionPointers& comFuncs, AppendPath append) {
     DWORD itemCount = 0;
     HRESULT hr = pItemArray->GetCount(&itemCount);
     if (FAILED(hr)) {
-        std::wcerr << L"Failed to get item count from shell item array" << std::endl;
-        return filePaths;
+        trace(kTraceGetCountFailed, hr);
+        return hr;
     }
 
+    ShellItemNameReader reader(comFuncs.pCoTaskMemFree);
     for (DWORD i = 0; i < itemCount; ++i) {
-        IShellItem* pItem = nullptr;
-        hr = pItemArray->GetItemAt(i, &pItem);
+        ComPtr<IShellItem> item;
+        hr = pItemArray->GetItemAt(i, item.put());
         if (FAILED(hr)) {
-            std::wcerr << L"Failed to get item from shell item array" << std::endl;
+            trace(kTraceGetItemFailed, hr, i);
             continue;
         }
 
-        LPWSTR pszFilePath = nullptr;
-        hr = pItem->GetDisplayName(SIGDN_FILESYSPATH, &pszFilePath);
+        reader.reset(item.get());
+        std::wstring_view filePath;
+        hr = reader.read(SIGDN_FILESYSPATH, filePath);
         if (FAILED(hr)) {
-            std::wcerr << L"Failed to get display name from shell item" << std::endl;
-            pItem->Release();
+            trace(kTraceGetDisplayNameFailed, hr, i);
             continue;
         }
 
-        filePaths.push_back(std::wstring(pszFilePath));
-        comFuncs.pCoTaskMemFree(pszFilePath);
-        pItem->Release();
+        append(filePath);
     }
+    return S_OK;
+}
 
+// Helper function to get file paths from IShellItemArray
+std::vector<std::wstring> getFilePathsFromShellItemArray(IShellItemArray* pItemArray, COMFunctionPointers& comFuncs) {
+    std::vector<std::wstring> filePaths;
+    forEachFilePath(pItemArray, comFuncs, [&filePaths](std::wstring_view filePath) {
+        filePaths.push_back(std::wstring(filePath));
+    });
     return filePaths;
 }
+
+// Same as above, but all paths share one arena instead of one allocation each
+HRESULT getFilePathsFromShellItemArray(IShellItemArray* pItemArray, COMFunctionPointers& comFuncs, PathTable& filePaths) {
+    // Snapshot-backed arrays hand over their paths without creating an item per entry
+    ComPtr<IShellItemSnapshotSource> source;
+    if (SUCCEEDED(pItemArray->QueryInterface(IID_IShellItemSnapshotSource, source.putVoid()))) {
+        std::shared_ptr<const ShellItemSnapshot> snapshot;
+        HRESULT hr = source->GetSnapshot(&snapshot);
+        source = nullptr;
+        if (SUCCEEDED(hr)) {
+            // Exact: every path is its folder followed by its name
+            size_t chars = filePaths.payloadChars() + snapshot->names.payloadChars();
+            for (uint32_t folder : snapshot->folderIndex) {
+                chars += snapshot->folders[folder].size();
+            }
+            filePaths.reserve(filePaths.size() + snapshot->size(), chars);
+            std::wstring path;
+            for (size_t i = 0; i < snapshot->size(); ++i) {
+                path.clear();
+                snapshot->appendPath(i, path);
+                filePaths.append(path);
+            }
+            return S_OK;
+        }
+    }
+
+    DWORD itemCount = 0;
+    if (FAILED(pItemArray->GetCount(&itemCount))) {
+        itemCount = 0;
+    }
+    size_t firstIndex = filePaths.size();
+    return forEachFilePath(pItemArray, comFuncs, [&filePaths, firstIndex, itemCount](std::wstring_view filePath) {
+        size_t length = filePath.size();
+        if (filePaths.size() == firstIndex) {
+            // Size the arena from the first path so it is not regrown (and recopied) on the way
+            filePaths.reserve(firstIndex + itemCount, filePaths.payloadChars() + (length + length / 4) * itemCount);
+        }
+        filePaths.append(filePath);
+    });
+}
@@ -3,6 +3,12 @@
 
 #include <vector>
 #include <string>
+#include "PathTable.h"
+#include "Trace.h"
+#include "ComGuid.h"
+
+class FilterSet;
+class ResultSink;
 
 // **
 // **
@@ -58,13 +64,11 @@
     };
 
 #ifndef COM_REQUIRE_SUCCESS
-#define COM_REQUIRE_SUCCESS(hr, comFuncPtrs, msg, ...) \
+// Traces a failure and runs the rest (usually return). COM stays initialized: the apartment belongs
+// to whoever called CoInitialize, which may be a pool thread running many sessions.
+#define COM_REQUIRE_SUCCESS(hr, traceEvent, ...) \
     if (FAILED(hr)) { \
-        std::cerr << msg << std::endl; \
-        if (comFuncPtrs.pCoUninitialize) { \
-            comFuncPtrs.pCoUninitialize(); \
-        } \
-        FreeCOMFunctionPointers(comFuncPtrs); \
+        trace(traceEvent, hr); \
         __VA_ARGS__; \
     }
 #endif // COM_REQUIRE_SUCCESS
@@ -207,7 +211,8 @@ typedef interface IShellItem IShellItem;
 struct __declspec(uuid("43826D1E-E718-42EE-BC55-A1E261C37BFE")) IShellItem : public IUnknown {
     DEFINE_IShellItem_METHODS
 };
-static const IID IID_IShellItem = {0x43826d1e, 0xe718, 0x42ee, {0xbc, 0x55, 0xa1, 0xe2, 0x61, 0xc3, 0x7b, 0xfe}};
+static constexpr IID IID_IShellItem = guidFromString("43826D1E-E718-42EE-BC55-A1E261C37BFE");
+COM_INTERFACE_ID(IShellItem, IID_IShellItem)
 #endif // __IShellItem_INTERFACE_DEFINED__
 
 #ifdef __IShellItemFilter_FWD_DEFINED__
@@ -218,7 +223,8 @@ DEFINE_INTERFACE(IShellItemFilter, IUnknown, DEFINE_IShellItemFilter_METHODS)
 
 #ifdef __IFileDialog_FWD_DEFINED__
 interface IFileDialog;  // Forward declaration of the interface
-static const IID IID_IFileDialog = {0x4292C689, 0x9298, 0x4A37, {0xB8, 0xF0, 0x03, 0x83, 0x5B, 0x7B, 0x6E, 0xE6}};
+static constexpr IID IID_IFileDialog = guidFromString("4292C689-9298-4A37-B8F0-03835B7B6EE6");
+COM_INTERFACE_ID(IFileDialog, IID_IFileDialog)
 
 
 #define FOS_OVERWRITEPROMPT 0x2
@@ -249,7 +255,8 @@ DEFINE_INTERFACE(IFileDialog, IModalWindow, DEFINE_IFileDialog_METHODS)
 
 #ifdef __IFileDialogEvents_FWD_DEFINED__
 interface IFileDialogEvents;  // Forward declaration of the interface
-static const IID IID_IFileDialogEvents = {0x973510db, 0x7d7f, 0x452b, {0x89, 0x75, 0x74, 0xa8, 0x58, 0x28, 0xd3, 0x54}};
+static constexpr IID IID_IFileDialogEvents = guidFromString("973510DB-7D7F-452B-8975-74A85828D354");
+COM_INTERFACE_ID(IFileDialogEvents, IID_IFileDialogEvents)
 #define __IFileDialogEvents_INTERFACE_DEFINED__
 typedef interface IFileDialogEvents IFileDialogEvents;
 DEFINE_INTERFACE(IFileDialogEvents, IUnknown, DEFINE_IFileDialogEvents_METHODS)
@@ -257,7 +264,8 @@ DEFINE_INTERFACE(IFileDialogEvents, IUnknown, DEFINE_IFileDialogEvents_METHODS)
 
 #ifdef __IFileOpenDialog_FWD_DEFINED__
 interface IFileOpenDialog;  // Forward declaration of the interface
-static const IID IID_IFileOpenDialog = {0xd57c7288, 0xd4ad, 0x4768, {0xbe, 0x02, 0x9d, 0x96, 0x95, 0x32, 0xd9, 0x60}};
+static constexpr IID IID_IFileOpenDialog = guidFromString("D57C7288-D4AD-4768-BE02-9D969532D960");
+COM_INTERFACE_ID(IFileOpenDialog, IID_IFileOpenDialog)
 #define __IFileOpenDialog_INTERFACE_DEFINED__
 typedef interface IFileOpenDialog IFileOpenDialog;
 DEFINE_INTERFACE(IFileOpenDialog, IFileDialog, DEFINE_IFileOpenDialog_METHODS)
@@ -265,7 +273,8 @@ DEFINE_INTERFACE(IFileOpenDialog, IFileDialog, DEFINE_IFileOpenDialog_METHODS)
 
 #ifdef __IFileSaveDialog_FWD_DEFINED__
 interface IFileSaveDialog;  // Forward declaration of the interface
-static const IID IID_IFileSaveDialog = {0x84bccd23, 0x5fde, 0x4cdb, {0xae, 0xa4, 0xaf, 0x64, 0xb8, 0x3d, 0x78, 0xab}};
+static constexpr IID IID_IFileSaveDialog = guidFromString("84BCCD23-5FDE-4CDB-AEA4-AF64B83D78AB");
+COM_INTERFACE_ID(IFileSaveDialog, IID_IFileSaveDialog)
 #define __IFileSaveDialog_INTERFACE_DEFINED__
 typedef interface IFileSaveDialog IFileSaveDialog;
 DEFINE_INTERFACE(IFileSaveDialog, IFileDialog, DEFINE_IFileSaveDialog_METHODS)
@@ -276,10 +285,14 @@ DEFINE_INTERFACE(IFileSaveDialog, IFileDialog, DEFINE_IFileSaveDialog_METHODS)
 #else // __shobjidl_h__
 
 // Other COM constants
-static const IID IID_IShellItemArray = {0xb63ea76d, 0x1f85, 0x456f, {0xa1, 0x9c, 0x48, 0x15, 0x9e, 0xfa, 0x85, 0x8b}};
-static const CLSID CLSID_FileDialog = {0x3D9C8F03, 0x50D4, 0x4E40, {0xBB, 0x11, 0x70, 0xE7, 0x4D, 0x3F, 0x10, 0xF3}};
-static const CLSID CLSID_FileOpenDialog = {0xdc1c5a9c, 0xe88a, 0x4dde, {0xa5, 0xa1, 0x60, 0xf8, 0x2a, 0x20, 0xae, 0xf7}};
-static const CLSID CLSID_FileSaveDialog = {0xc0b4e2f3, 0xba21, 0x4773, {0x8d, 0xba, 0x33, 0x5e, 0xc9, 0x46, 0xeb, 0x8b}};
+static constexpr IID IID_IShellItemArray = guidFromString("B63EA76D-1F85-456F-A19C-48159EFA858B");
+COM_INTERFACE_ID(IShellItemArray, IID_IShellItemArray)
+static constexpr IID IID_IEnumShellItems = guidFromString("70629033-E363-4A28-A567-0DB78006E6D7");
+COM_INTERFACE_ID(IEnumShellItems, IID_IEnumShellItems)
+static constexpr GUID BHID_EnumItems = guidFromString("94F60519-2850-4924-AA5A-D15E84868039");
+static constexpr CLSID CLSID_FileDialog = guidFromString("3D9C8F03-50D4-4E40-BB11-70E74D3F10F3");
+static constexpr CLSID CLSID_FileOpenDialog = guidFromString("DC1C5A9C-E88A-4DDE-A5A1-60F82A20AEF7");
+static constexpr CLSID CLSID_FileSaveDialog = guidFromString("C0B4E2F3-BA21-4773-8DBA-335EC946EB8B");
 
 typedef int GETPROPERTYSTOREFLAGS;
 typedef ULONG SFGAOF;
@@ -323,9 +336,11 @@ typedef void (STDMETHODCALLTYPE *PFN_CoTaskMemFree)(LPVOID);
 void createFileDialog(COMFunctionPointers& comFuncs, IFileDialog** ppFileDialog, int isSaveDialog);
 void showDialog(COMFunctionPointers& comFuncs, IFileDialog* pFileOpenDialog, HWND hwndOwner = NULL);
 IShellItem* createShellItem(COMFunctionPointers& comFuncs, const std::wstring& path);
-std::vector<std::wstring> getFilePathsFromShellItemArray(IShellItemArray* pItemArray);
-std::vector<std::wstring> getFileDialogResults(COMFunctionPointers& comFuncs, IFileOpenDialog* pFileOpenDialog);
-void configureFileDialog(COMFunctionPointers& comFuncs, IFileDialog* pFileDialog, const std::vector<COMDLG_FILTERSPEC>& filters, const std::wstring& defaultFolder, DWORD options, bool forceFileSystem = false, bool allowMultiselect = false);
+std::vector<std::wstring> getFilePathsFromShellItemArray(IShellItemArray* pItemArray, COMFunctionPointers& comFuncs);
+HRESULT getFilePathsFromShellItemArray(IShellItemArray* pItemArray, COMFunctionPointers& comFuncs, PathTable& filePaths);
+HRESULT getFileDialogResults(COMFunctionPointers& comFuncs, IFileOpenDialog* pFileOpenDialog, ResultSink& sink);  // Reads no more than sink.verbosity() asks for
+HRESULT getFileDialogResults(COMFunctionPointers& comFuncs, IFileOpenDialog* pFileOpenDialog, PathTable& results);
+void configureFileDialog(COMFunctionPointers& comFuncs, IFileDialog* pFileDialog, const FilterSet& filters, const std::wstring& defaultFolder, DWORD options, bool forceFileSystem = false, bool allowMultiselect = false);
 
 LPCWSTR string_to_LPCWSTR(const std::wstring& s);  // Helper to convert std::wstring to LPCWSTR
 std::wstring LPCWSTR_to_string(LPCWSTR s);  // Helper to convert LPCWSTR to std::wstring
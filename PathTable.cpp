@@ -0,0 +1,35 @@
+#include "PathTable.h"
+
+void PathTable::reserve(size_t pathCount, size_t charCount) {
+    entries.reserve(pathCount);
+    arena.reserve(charCount + pathCount);
+}
+
+void PathTable::append(const wchar_t* path, size_t length) {
+    entries.push_back({ arena.size(), length });
+    arena.insert(arena.end(), path, path + length);
+    arena.push_back(L'\0');
+}
+
+void PathTable::clear() {
+    arena.clear();
+    entries.clear();
+}
+
+std::vector<std::wstring> PathTable::toVector() const {
+    std::vector<std::wstring> paths;
+    paths.reserve(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        paths.emplace_back((*this)[i]);
+    }
+    return paths;
+}
+
+PathTable::Storage PathTable::release() {
+    Storage storage;
+    storage.arena = std::move(arena);
+    storage.entries = std::move(entries);
+    arena.clear();
+    entries.clear();
+    return storage;
+}
@@ -0,0 +1,59 @@
+#ifndef PATH_TABLE_H
+#define PATH_TABLE_H
+
+#include <vector>
+#include <string>
+#include <string_view>
+
+// Result paths stored back to back in one wide-character arena, indexed by an offset/length table.
+// Each path is null-terminated inside the arena, so c_str() can go straight to Win32 APIs.
+// Move-only: views and pointers handed out stay valid until the table is modified or destroyed.
+class PathTable {
+public:
+    struct Entry {
+        size_t offset;
+        size_t length;  // Without the terminating null
+    };
+
+    // Raw buffers, for callers taking ownership through release()
+    struct Storage {
+        std::vector<wchar_t> arena;
+        std::vector<Entry> entries;
+    };
+
+    PathTable() = default;
+    PathTable(PathTable&& other) noexcept = default;
+    PathTable& operator=(PathTable&& other) noexcept = default;
+    PathTable(const PathTable&) = delete;
+    PathTable& operator=(const PathTable&) = delete;
+
+    // Pre-size for pathCount paths totalling charCount characters (terminators excluded)
+    void reserve(size_t pathCount, size_t charCount);
+    void append(const wchar_t* path, size_t length);
+    void append(std::wstring_view path) { append(path.data(), path.size()); }
+    void clear();
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    // Arena characters, terminators included
+    size_t totalChars() const { return arena.size(); }
+    // Characters of the paths alone, as reserve() counts them
+    size_t payloadChars() const { return arena.size() - entries.size(); }
+
+    std::wstring_view operator[](size_t index) const {
+        return std::wstring_view(arena.data() + entries[index].offset, entries[index].length);
+    }
+    const wchar_t* c_str(size_t index) const { return arena.data() + entries[index].offset; }
+
+    // Copy out as owning strings, for callers of the vector-based API
+    std::vector<std::wstring> toVector() const;
+
+    // Hand the buffers to the caller without copying. The table is left empty.
+    Storage release();
+
+private:
+    std::vector<wchar_t> arena;
+    std::vector<Entry> entries;
+};
+
+#endif // PATH_TABLE_H
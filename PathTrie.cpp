@@ -0,0 +1,163 @@
+#include "PathTrie.h"
+#include <cstring>
+
+// Names go into blocks of this many characters; a longer name gets a block of its own
+static const size_t kNameBlockChars = 1024;
+
+static const wchar_t kRootName[] = L"/";
+
+PathTrie::PathTrie() : rootNode{nullptr, kRootName, 1, 1, 0} {}
+
+const wchar_t* PathTrie::storeName(Shard& shard, std::wstring_view name) {
+    if (name.size() > shard.nameRemaining) {
+        size_t chars = name.size() > kNameBlockChars ? name.size() : kNameBlockChars;
+        shard.nameBlocks.emplace_back(new wchar_t[chars]);
+        shard.nameFree = shard.nameBlocks.back().get();
+        shard.nameRemaining = chars;
+        shard.nameChars += chars;
+    }
+    wchar_t* stored = shard.nameFree;
+    std::memcpy(stored, name.data(), name.size() * sizeof(wchar_t));
+    shard.nameFree += name.size();
+    shard.nameRemaining -= name.size();
+    return stored;
+}
+
+const PathNode* PathTrie::child(const PathNode* parent, std::wstring_view name) {
+    size_t hash = std::hash<std::wstring_view>()(name) ^ (reinterpret_cast<uintptr_t>(parent) * size_t(0x9E3779B97F4A7C15ull));
+    // The table picks buckets from the low bits, so the shard comes from higher ones
+    Shard& shard = shards[(hash >> 24) & (kShards - 1)];
+    Key key{parent, name, hash};
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.children.find(key);
+    if (it != shard.children.end()) {
+        return it->second;
+    }
+    key.name = std::wstring_view(storeName(shard, name), name.size());
+    uint32_t length = static_cast<uint32_t>(pathLength(parent, name));
+    shard.nodes.push_back(PathNode{parent, key.name.data(), static_cast<uint32_t>(name.size()), length, parent->depth + 1});
+    const PathNode* node = &shard.nodes.back();
+    shard.children.emplace(key, node);
+    return node;
+}
+
+const PathNode* PathTrie::intern(std::wstring_view path) {
+    if (path.empty() || path[0] != L'/') {
+        return nullptr;
+    }
+    const PathNode* node = &rootNode;
+    size_t start = 1;
+    while (start < path.size()) {
+        size_t end = path.find(L'/', start);
+        if (end == std::wstring_view::npos) {
+            end = path.size();
+        }
+        if (end > start) {
+            node = child(node, path.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return node;
+}
+
+bool PathTrie::split(std::wstring_view path, const PathNode*& folder, std::wstring_view& leaf) {
+    if (path.empty() || path[0] != L'/') {
+        return false;
+    }
+    while (path.size() > 1 && path.back() == L'/') {
+        path.remove_suffix(1);
+    }
+    if (path.size() == 1) {
+        folder = nullptr;
+        leaf = path;
+        return true;
+    }
+    size_t slash = path.rfind(L'/');
+    folder = (slash == 0) ? &rootNode : intern(path.substr(0, slash));
+    leaf = path.substr(slash + 1);
+    return true;
+}
+
+size_t PathTrie::nodeCount() const {
+    size_t count = 1;
+    for (const Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        count += shard.nodes.size();
+    }
+    return count;
+}
+
+size_t PathTrie::bytesUsed() const {
+    size_t bytes = sizeof(*this);
+    for (const Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        bytes += shard.nodes.size() * sizeof(PathNode);
+        bytes += shard.nameChars * sizeof(wchar_t);
+        // A hash node holds the next pointer, the key and the value; each bucket is a pointer
+        bytes += shard.children.size() * (sizeof(void*) + sizeof(Key) + sizeof(const PathNode*));
+        bytes += shard.children.bucket_count() * sizeof(void*);
+    }
+    return bytes;
+}
+
+size_t PathTrie::pathLength(const PathNode* folder, std::wstring_view name) {
+    if (!folder) {
+        return name.size();
+    }
+    if (name.empty()) {
+        return folder->pathLength;
+    }
+    // The root's path already ends in '/'
+    return folder->pathLength + (folder->parent ? 1 : 0) + name.size();
+}
+
+void PathTrie::copyPath(const PathNode* folder, std::wstring_view name, wchar_t* buffer) {
+    size_t position = pathLength(folder, name);
+    buffer[position] = L'\0';
+    if (!name.empty()) {
+        position -= name.size();
+        std::memcpy(buffer + position, name.data(), name.size() * sizeof(wchar_t));
+        if (folder && folder->parent) {
+            buffer[--position] = L'/';
+        }
+    }
+    // Back to front, one component per hop
+    for (const PathNode* node = folder; node; node = node->parent) {
+        position -= node->nameLength;
+        std::memcpy(buffer + position, node->name, node->nameLength * sizeof(wchar_t));
+        if (node->parent && node->parent->parent) {
+            buffer[--position] = L'/';
+        }
+    }
+}
+
+void PathTrie::assignPath(const PathNode* folder, std::wstring_view name, std::wstring& path) {
+    path.resize(pathLength(folder, name));
+    copyPath(folder, name, &path[0]);
+}
+
+std::wstring PathTrie::path(const PathNode* folder, std::wstring_view name) {
+    std::wstring result;
+    assignPath(folder, name, result);
+    return result;
+}
+
+const wchar_t* CachedTriePath::get(const PathNode* folder, std::wstring_view name) {
+    wchar_t* cached = path.load(std::memory_order_acquire);
+    if (cached) {
+        return cached;
+    }
+    wchar_t* built = new wchar_t[PathTrie::pathLength(folder, name) + 1];
+    PathTrie::copyPath(folder, name, built);
+    if (path.compare_exchange_strong(cached, built, std::memory_order_acq_rel, std::memory_order_acquire)) {
+        return built;
+    }
+    delete[] built;
+    return cached;
+}
+
+PathTrie& pathTrie() {
+    // Never destroyed: items released during static destruction still read their nodes
+    static PathTrie* trie = new PathTrie();
+    return *trie;
+}
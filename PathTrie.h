@@ -0,0 +1,119 @@
+#ifndef PATH_TRIE_H
+#define PATH_TRIE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// One interned folder. Nodes live until the process exits, so a node pointer is a stable id:
+// every item in a folder holds the same one, and the folder's parent is one pointer away.
+struct PathNode {
+    const PathNode* parent;  // nullptr for the root
+    const wchar_t* name;     // Last component, not null-terminated ("/" for the root)
+    uint32_t nameLength;
+    uint32_t pathLength;     // Characters in the full path
+    uint32_t depth;          // 0 for the root
+};
+
+// Absolute '/'-separated folder paths interned one component at a time, so items in a tree share
+// their parent chains instead of each holding a full path. An item keeps its folder's node and its
+// own leaf name; GetParent follows node->parent without parsing, and full paths are rebuilt only
+// when asked for, straight into the caller's buffer.
+//
+// Lookups hash (parent, name) to one of kShards shards, each with its own mutex, child table and
+// storage, so threads interning different folders rarely meet. Leaves are not interned: a tree's
+// files would otherwise stay resident after their items are gone.
+class PathTrie {
+public:
+    static const size_t kShards = 64;
+
+    PathTrie();
+    PathTrie(const PathTrie&) = delete;
+    PathTrie& operator=(const PathTrie&) = delete;
+
+    const PathNode* root() const { return &rootNode; }
+
+    // The node for the single component name under parent, created on first use
+    const PathNode* child(const PathNode* parent, std::wstring_view name);
+    // The node for an absolute folder path, skipping empty components; nullptr for a relative path
+    const PathNode* intern(std::wstring_view path);
+
+    size_t nodeCount() const;
+    // Bytes held by nodes, names and child tables (estimated for the tables)
+    size_t bytesUsed() const;
+
+    // Length of the path of the entry called name in folder, or of folder itself when name is
+    // empty. A null folder means name is the whole path.
+    static size_t pathLength(const PathNode* folder, std::wstring_view name);
+    // Writes that path and a terminating null to buffer, which holds pathLength + 1 characters
+    static void copyPath(const PathNode* folder, std::wstring_view name, wchar_t* buffer);
+    // Same, into path (its capacity is reused)
+    static void assignPath(const PathNode* folder, std::wstring_view name, std::wstring& path);
+    static std::wstring path(const PathNode* folder, std::wstring_view name = std::wstring_view());
+
+    static std::wstring_view name(const PathNode* node) {
+        return std::wstring_view(node->name, node->nameLength);
+    }
+
+    // Splits an absolute path into its interned folder and leaf name. "/" itself has no folder
+    // (nullptr) and the leaf "/". False for a relative path.
+    bool split(std::wstring_view path, const PathNode*& folder, std::wstring_view& leaf);
+
+private:
+    struct Key {
+        const PathNode* parent;
+        std::wstring_view name;
+        size_t hash;
+
+        bool operator==(const Key& other) const {
+            return parent == other.parent && name == other.name;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const { return key.hash; }
+    };
+
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;  // Guards what follows
+        std::unordered_map<Key, const PathNode*, KeyHash> children;
+        std::deque<PathNode> nodes;  // Never reallocated, so node pointers stay valid
+        std::vector<std::unique_ptr<wchar_t[]>> nameBlocks;
+        wchar_t* nameFree = nullptr;
+        size_t nameRemaining = 0;
+        size_t nameChars = 0;  // Capacity of all blocks
+    };
+
+    static const wchar_t* storeName(Shard& shard, std::wstring_view name);  // shard.mutex held
+
+    PathNode rootNode;
+    Shard shards[kShards];
+};
+
+// The process-wide trie the POSIX and synthetic shell items intern their folders in
+PathTrie& pathTrie();
+
+// An entry's full path, built on first use and kept until destruction. Threads racing to build it
+// publish one copy; the others discard theirs.
+class CachedTriePath {
+public:
+    CachedTriePath() : path(nullptr) {}
+    ~CachedTriePath() { delete[] path.load(std::memory_order_relaxed); }
+    CachedTriePath(const CachedTriePath&) = delete;
+    CachedTriePath& operator=(const CachedTriePath&) = delete;
+
+    // Null-terminated path of name in folder (as PathTrie::copyPath writes it)
+    const wchar_t* get(const PathNode* folder, std::wstring_view name);
+
+private:
+    std::atomic<wchar_t*> path;
+};
+
+#endif // PATH_TRIE_H
@@ -0,0 +1,317 @@
+#include "PosixShellItem.h"
+#include "QueryInterfaceTable.h"
+#include "SlabAllocator.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <climits>
+#include <cwchar>
+#include <mutex>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#endif
+#include <unistd.h>
+#include "ProjUtil.h"
+#include "DirectoryEnumerator.h"
+#include "CollationKey.h"
+#include "PathTrie.h"
+#include "ShellItemDisplayNames.h"
+
+HRESULT hresultFromErrno(int err) {
+    switch (err) {
+        case 0: return S_OK;
+        case ENOENT: return static_cast<HRESULT>(0x80070002L);  // ERROR_FILE_NOT_FOUND
+        case ENOTDIR: return static_cast<HRESULT>(0x80070003L);  // ERROR_PATH_NOT_FOUND
+        case EACCES:
+        case EPERM: return static_cast<HRESULT>(0x80070005L);  // E_ACCESSDENIED
+        case ENAMETOOLONG: return static_cast<HRESULT>(0x800700CEL);  // ERROR_FILENAME_EXCED_RANGE
+        case ENOMEM: return E_OUTOFMEMORY;
+        case EINVAL: return E_INVALIDARG;
+        default: return E_FAIL;
+    }
+}
+
+HRESULT queryPosixItemInfo(const std::string& nativePath, PosixItemInfo& info) {
+    return queryPosixItemInfoAt(AT_FDCWD, nativePath.c_str(), info);
+}
+
+HRESULT queryPosixItemInfoAt(int dirFd, const char* name, PosixItemInfo& info) {
+#ifdef __linux__
+    struct statx stx;
+    if (statx(dirFd, name, 0, STATX_TYPE | STATX_MODE | STATX_INO | STATX_SIZE | STATX_MTIME, &stx) != 0) {
+        return hresultFromErrno(errno);
+    }
+    info.mode = stx.stx_mode;
+    info.inode = stx.stx_ino;
+    info.device = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+    info.size = stx.stx_size;
+    info.mtimeSec = stx.stx_mtime.tv_sec;
+    info.mtimeNsec = stx.stx_mtime.tv_nsec;
+#else
+    // No statx outside Linux; fstatat fills the same fields
+    struct stat st;
+    if (fstatat(dirFd, name, &st, 0) != 0) {
+        return hresultFromErrno(errno);
+    }
+    info.mode = st.st_mode;
+    info.inode = st.st_ino;
+    info.device = st.st_dev;
+    info.size = st.st_size;
+#ifdef __APPLE__
+    info.mtimeSec = st.st_mtimespec.tv_sec;
+    info.mtimeNsec = st.st_mtimespec.tv_nsec;
+#else
+    info.mtimeSec = st.st_mtim.tv_sec;
+    info.mtimeNsec = st.st_mtim.tv_nsec;
+#endif // __APPLE__
+#endif // __linux__
+    return S_OK;
+}
+
+// Scratch for the one full path an item's key is built from
+static thread_local std::wstring keyPath;
+
+class PosixShellItem : public IShellItem, public IShellItemCollation, public IShellItemDisplayNames, public SlabAllocated<PosixShellItem> {
+public:
+    // An entry of folder, or "/" when folder is null
+    PosixShellItem(const PathNode* folder, std::wstring name, const PosixItemInfo& info)
+        : refCount(1), folder(folder), ownedName(std::move(name)), name(ownedName), info(info) {}
+
+    // A directory, whose name the trie already holds
+    PosixShellItem(const PathNode* node, const PosixItemInfo& info)
+        : refCount(1), folder(node->parent), name(PathTrie::name(node)), info(info) {}
+
+    // IUnknown methods
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppv) {
+        return QueryInterfaceTable<PosixShellItem, IShellItem, IShellItemCollation, IShellItemDisplayNames>::query(this, riid, ppv);
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() {
+        return InterlockedIncrement(&refCount);
+    }
+
+    ULONG STDMETHODCALLTYPE Release() {
+        ULONG count = InterlockedDecrement(&refCount);
+        if (count == 0) {
+            delete this;
+        }
+        return count;
+    }
+
+    // IShellItem methods
+    HRESULT STDMETHODCALLTYPE BindToHandler(IUnknown *pbc, REFGUID bhid, REFIID riid, void **ppv) {
+        *ppv = nullptr;
+        if (bhid != BHID_EnumItems) {
+            return E_NOTIMPL;
+        }
+        if (!S_ISDIR(info.mode)) {
+            return E_INVALIDARG;
+        }
+        if (riid != IID_IEnumShellItems) {
+            return E_NOINTERFACE;
+        }
+        return createDirectoryEnumerator(PathTrie::path(folder, name), reinterpret_cast<IEnumShellItems**>(ppv));
+    }
+
+    // The parent's node is one hop away; only its statx remains
+    HRESULT STDMETHODCALLTYPE GetParent(IShellItem **ppsi) {
+        *ppsi = nullptr;
+        if (!folder) {
+            return E_FAIL;  // The root has no parent
+        }
+        std::wstring parentPath = PathTrie::path(folder);
+        PosixItemInfo parentInfo;
+        HRESULT hr = queryPosixItemInfo(wideToUtf8(parentPath.c_str(), parentPath.size()), parentInfo);
+        if (FAILED(hr)) {
+            return hr;
+        }
+        *ppsi = new PosixShellItem(folder, parentInfo);
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetDisplayName(int sigdnName, LPWSTR *ppszName) {
+        switch (shellItemNameForm(sigdnName)) {
+            case ShellItemNamePath: {
+                // Rebuilt from the folder chain into the caller's buffer
+                size_t length = PathTrie::pathLength(folder, name);
+                *ppszName = static_cast<LPWSTR>(taskMemAlloc((length + 1) * sizeof(wchar_t)));
+                if (*ppszName) {
+                    PathTrie::copyPath(folder, name, *ppszName);
+                }
+                break;
+            }
+            case ShellItemNameLeaf:
+                *ppszName = coTaskMemDup(name.data(), name.size());
+                break;
+            default:
+                *ppszName = nullptr;
+                return E_INVALIDARG;
+        }
+        return *ppszName ? S_OK : E_OUTOFMEMORY;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetAttributes(ULONG sfgaoMask, ULONG *psfgaoAttribs) {
+        ULONG attributes = SFGAO_FILESYSTEM;
+        if (S_ISDIR(info.mode)) {
+            attributes |= SFGAO_FOLDER;
+        }
+        *psfgaoAttribs = attributes & sfgaoMask;
+        return (*psfgaoAttribs == sfgaoMask) ? S_OK : S_FALSE;
+    }
+
+    HRESULT STDMETHODCALLTYPE Compare(IShellItem *psi, DWORD hint, int *piOrder) {
+        return compareWithCollationKey(collationKey(), psi, hint, piOrder);
+    }
+
+    // IShellItemCollation methods
+    HRESULT STDMETHODCALLTYPE GetCollationKey(const CollationKey **ppKey) {
+        *ppKey = &collationKey();
+        return S_OK;
+    }
+
+    // IShellItemDisplayNames methods
+    HRESULT STDMETHODCALLTYPE BorrowDisplayName(int sigdnName, LPCWSTR *ppszName, size_t *pcchName) {
+        switch (shellItemNameForm(sigdnName)) {
+            case ShellItemNamePath:
+                *ppszName = path.get(folder, name);
+                *pcchName = PathTrie::pathLength(folder, name);
+                return S_OK;
+            case ShellItemNameLeaf:
+                *ppszName = name.data();
+                *pcchName = name.size();
+                return S_OK;
+            default:
+                *ppszName = nullptr;
+                *pcchName = 0;
+                return E_INVALIDARG;
+        }
+    }
+
+    HRESULT STDMETHODCALLTYPE BorrowItemDisplayName(IShellItem *pItem, int sigdnName, LPCWSTR *ppszName, size_t *pcchName) {
+        PosixShellItem* pOther = sameClassShellItem(this, pItem);
+        if (!pOther) {
+            *ppszName = nullptr;
+            *pcchName = 0;
+            return E_NOINTERFACE;
+        }
+        return pOther->BorrowDisplayName(sigdnName, ppszName, pcchName);
+    }
+
+protected:
+    virtual ~PosixShellItem() = default;
+
+private:
+    // Built on first use, so GetParent chains and items never compared skip it
+    const CollationKey& collationKey() {
+        std::call_once(keyOnce, [this] {
+            PathTrie::assignPath(folder, name, keyPath);
+            // Hard links and alternate spellings of one file compare equal canonically
+            key.setIdentity(info.device, info.inode);
+            key.assign(keyPath.c_str(), keyPath.size(), folder ? keyPath.size() - name.size() : 0);
+            key.appendField(static_cast<int64_t>(info.mtimeSec));
+            key.appendField(static_cast<uint64_t>(info.mtimeNsec));
+            key.appendField(static_cast<uint64_t>(info.size));
+        });
+        return key;
+    }
+
+    LONG refCount;
+    const PathNode* folder;  // Interned in pathTrie(); nullptr for the root
+    std::wstring ownedName;  // Storage for a name the trie does not hold
+    std::wstring_view name;  // ownedName, or a directory's name in the trie; "/" for the root
+    PosixItemInfo info;
+    std::once_flag keyOnce;
+    CollationKey key;
+    CachedTriePath path;  // Built on the first borrow; GetDisplayName copies from the folder chain
+};
+
+HRESULT createPosixShellItem(const std::wstring& path, IShellItem** ppsi) {
+    PosixItemInfo info;
+    HRESULT hr = queryPosixItemInfo(wideToUtf8(path.c_str(), path.size()), info);
+    if (FAILED(hr)) {
+        *ppsi = nullptr;
+        return hr;
+    }
+    return createPosixShellItem(path, info, ppsi);
+}
+
+HRESULT createPosixShellItem(const std::wstring& path, const PosixItemInfo& info, IShellItem** ppsi) {
+    const PathNode* folder = nullptr;
+    std::wstring_view leaf;
+    if (!pathTrie().split(path, folder, leaf)) {
+        *ppsi = nullptr;
+        return E_INVALIDARG;
+    }
+    return createPosixShellItem(folder, std::wstring(leaf), info, ppsi);
+}
+
+HRESULT createPosixShellItem(const PathNode* folder, std::wstring name, const PosixItemInfo& info, IShellItem** ppsi) {
+    *ppsi = new PosixShellItem(folder, std::move(name), info);
+    return S_OK;
+}
+
+void normalizePosixPath(std::wstring& path) {
+    if (path.find(L"//") == std::wstring::npos && path.find(L"/.") == std::wstring::npos && (path.size() == 1 || path.back() != L'/')) {
+        return;
+    }
+    std::wstring normal;
+    normal.reserve(path.size());
+    size_t pos = 0;
+    while (pos < path.size()) {
+        while (pos < path.size() && path[pos] == L'/') {
+            ++pos;
+        }
+        size_t end = path.find(L'/', pos);
+        if (end == std::wstring::npos) {
+            end = path.size();
+        }
+        std::wstring_view part(path.data() + pos, end - pos);
+        if (part == L"..") {
+            // ".." of the root is the root
+            size_t slash = normal.rfind(L'/');
+            normal.resize(slash == std::wstring::npos ? 0 : slash);
+        } else if (!part.empty() && part != L".") {
+            normal += L'/';
+            normal += part;
+        }
+        pos = end;
+    }
+    if (normal.empty()) {
+        normal = L"/";
+    }
+    path.swap(normal);
+}
+
+HRESULT STDMETHODCALLTYPE PosixSHCreateItemFromParsingName(LPCWSTR pszPath, LPVOID pbc, REFIID riid, void** ppv) {
+    if (!ppv) {
+        return E_POINTER;
+    }
+    *ppv = nullptr;
+    if (!pszPath || !*pszPath) {
+        return E_INVALIDARG;
+    }
+
+    std::wstring path(pszPath);
+    if (path[0] != L'/') {
+        char cwd[PATH_MAX];
+        if (!getcwd(cwd, sizeof(cwd))) {
+            return hresultFromErrno(errno);
+        }
+        std::wstring base = utf8ToWide(cwd, std::char_traits<char>::length(cwd));
+        path = (base == L"/") ? base + path : base + L"/" + path;
+    }
+    normalizePosixPath(path);
+
+    IShellItem* pItem = nullptr;
+    HRESULT hr = createPosixShellItem(path, &pItem);
+    if (FAILED(hr)) {
+        return hr;
+    }
+    hr = pItem->QueryInterface(riid, ppv);
+    pItem->Release();
+    return hr;
+}
+
+#endif // _WIN32
@@ -0,0 +1,50 @@
+#ifndef POSIX_SHELL_ITEM_H
+#define POSIX_SHELL_ITEM_H
+
+#include <cstdint>
+#include <string>
+#include "IFileDialog.h"
+
+#ifndef _WIN32
+
+struct PathNode;
+
+// Metadata cached per item, captured by a single statx() call (fstatat() outside Linux)
+struct PosixItemInfo {
+    uint32_t mode;
+    uint64_t inode;
+    uint64_t device;
+    uint64_t size;
+    int64_t mtimeSec;
+    uint32_t mtimeNsec;
+};
+
+// Map an errno value to the HRESULT the Windows shell reports for the same condition
+HRESULT hresultFromErrno(int err);
+
+// One statx() of nativePath (UTF-8), following symlinks; fstatat() where there is no statx
+HRESULT queryPosixItemInfo(const std::string& nativePath, PosixItemInfo& info);
+// Same, for name relative to an open directory (AT_FDCWD for the current one)
+HRESULT queryPosixItemInfoAt(int dirFd, const char* name, PosixItemInfo& info);
+
+// IShellItem over the POSIX filesystem. GetDisplayName, GetAttributes, GetParent (apart from the
+// parent's own statx) and Compare are answered from the cached info, with no further syscalls.
+// path must be absolute. Overloads without info stat the path; those with it trust info.
+HRESULT createPosixShellItem(const std::wstring& path, IShellItem** ppsi);
+HRESULT createPosixShellItem(const std::wstring& path, const PosixItemInfo& info, IShellItem** ppsi);
+// The entry name in a folder interned in pathTrie(), without parsing a path (a null folder means
+// name is "/"); trusts info
+HRESULT createPosixShellItem(const PathNode* folder, std::wstring name, const PosixItemInfo& info, IShellItem** ppsi);
+
+// Collapse repeated and trailing slashes, drop "." and resolve ".." against the preceding name,
+// without touching the filesystem (as PathCchCanonicalize does). path must be absolute.
+void normalizePosixPath(std::wstring& path);
+
+// Drop-in for SHCreateItemFromParsingName, used as COMFunctionPointers::pSHCreateItemFromParsingName
+// on non-Windows builds. Relative paths are resolved against the current directory, and the result
+// goes through normalizePosixPath before it is split into the path trie.
+HRESULT STDMETHODCALLTYPE PosixSHCreateItemFromParsingName(LPCWSTR pszPath, LPVOID pbc, REFIID riid, void** ppv);
+
+#endif // _WIN32
+
+#endif // POSIX_SHELL_ITEM_H
@@ -0,0 +1,437 @@
+#include "ProfilingProxies.h"
+
+// Proxy base: reference counting and QueryInterface for the proxied interfaces
+template <typename Interface>
+class ProfilingProxy : public Interface {
+public:
+    explicit ProfilingProxy(Interface* pInner) : refCount(1), pInner(pInner) {
+        pInner->AddRef();
+    }
+
+    // IUnknown methods
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppv) {
+        if (riid == IID_IUnknown || proxies(riid)) {
+            *ppv = static_cast<Interface*>(this);
+            this->AddRef();
+            return S_OK;
+        }
+        return pInner->QueryInterface(riid, ppv);
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() {
+        return InterlockedIncrement(&refCount);
+    }
+
+    ULONG STDMETHODCALLTYPE Release() {
+        ULONG count = InterlockedDecrement(&refCount);
+        if (count == 0) {
+            delete this;
+        }
+        return count;
+    }
+
+    Interface* inner() const { return pInner; }
+
+protected:
+    virtual ~ProfilingProxy() {
+        pInner->Release();
+    }
+
+    virtual bool proxies(REFIID riid) const = 0;
+
+    LONG refCount;
+    Interface* pInner;
+};
+
+// Replace *pp with a Proxy around it, unless it already is one
+template <typename Proxy, typename Interface>
+static void wrapOut(Interface** pp) {
+    if (*pp && !dynamic_cast<Proxy*>(*pp)) {
+        Interface* pRaw = *pp;
+        *pp = new Proxy(pRaw);
+        pRaw->Release();
+    }
+}
+
+class ProfilingShellItem : public ProfilingProxy<IShellItem> {
+public:
+    explicit ProfilingShellItem(IShellItem* pInner) : ProfilingProxy<IShellItem>(pInner) {}
+
+    // IShellItem methods
+    HRESULT STDMETHODCALLTYPE BindToHandler(IUnknown *pbc, REFGUID bhid, REFIID riid, void **ppv);
+
+    HRESULT STDMETHODCALLTYPE GetParent(IShellItem **ppsi) {
+        HRESULT hr = profileCall(kIShellItem_GetParent, [&] { return pInner->GetParent(ppsi); });
+        if (SUCCEEDED(hr)) {
+            wrapOut<ProfilingShellItem>(ppsi);
+        }
+        return hr;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetDisplayName(int sigdnName, LPWSTR *ppszName) {
+        return profileCall(kIShellItem_GetDisplayName, [&] { return pInner->GetDisplayName(sigdnName, ppszName); });
+    }
+
+    HRESULT STDMETHODCALLTYPE GetAttributes(ULONG sfgaoMask, ULONG *psfgaoAttribs) {
+        return profileCall(kIShellItem_GetAttributes, [&] { return pInner->GetAttributes(sfgaoMask, psfgaoAttribs); });
+    }
+
+    HRESULT STDMETHODCALLTYPE Compare(IShellItem *psi, DWORD hint, int *piOrder) {
+        // Hand the inner item its own kind, so it can take its fast path
+        ProfilingShellItem* pProxy = dynamic_cast<ProfilingShellItem*>(psi);
+        IShellItem* pOther = pProxy ? pProxy->inner() : psi;
+        return profileCall(kIShellItem_Compare, [&] { return pInner->Compare(pOther, hint, piOrder); });
+    }
+
+protected:
+    bool proxies(REFIID riid) const {
+        return riid == IID_IShellItem;
+    }
+};
+
+class ProfilingEnumShellItems : public ProfilingProxy<IEnumShellItems> {
+public:
+    explicit ProfilingEnumShellItems(IEnumShellItems* pInner) : ProfilingProxy<IEnumShellItems>(pInner) {}
+
+    // IEnumShellItems methods
+    HRESULT STDMETHODCALLTYPE Next(ULONG celt, IShellItem **rgelt, ULONG *pceltFetched) {
+        ULONG fetched = 0;
+        HRESULT hr = profileCall(kIEnumShellItems_Next, [&] { return pInner->Next(celt, rgelt, &fetched); });
+        if (SUCCEEDED(hr)) {
+            for (ULONG i = 0; i < fetched; ++i) {
+                wrapOut<ProfilingShellItem>(&rgelt[i]);
+            }
+        }
+        if (pceltFetched) {
+            *pceltFetched = fetched;
+        }
+        return hr;
+    }
+
+    HRESULT STDMETHODCALLTYPE Skip(ULONG celt) {
+        return profileCall(kIEnumShellItems_Skip, [&] { return pInner->Skip(celt); });
+    }
+
+    HRESULT STDMETHODCALLTYPE Reset() {
+        return profileCall(kIEnumShellItems_Reset, [&] { return pInner->Reset(); });
+    }
+
+    HRESULT STDMETHODCALLTYPE Clone(IEnumShellItems **ppenum) {
+        HRESULT hr = profileCall(kIEnumShellItems_Clone, [&] { return pInner->Clone(ppenum); });
+        if (SUCCEEDED(hr)) {
+            wrapOut<ProfilingEnumShellItems>(ppenum);
+        }
+        return hr;
+    }
+
+protected:
+    bool proxies(REFIID riid) const {
+        return riid == IID_IEnumShellItems;
+    }
+};
+
+HRESULT STDMETHODCALLTYPE ProfilingShellItem::BindToHandler(IUnknown *pbc, REFGUID bhid, REFIID riid, void **ppv) {
+    HRESULT hr = profileCall(kIShellItem_BindToHandler, [&] { return pInner->BindToHandler(pbc, bhid, riid, ppv); });
+    if (SUCCEEDED(hr) && riid == IID_IEnumShellItems) {
+        wrapOut<ProfilingEnumShellItems>(reinterpret_cast<IEnumShellItems**>(ppv));
+    }
+    return hr;
+}
+
+class ProfilingShellItemArray : public ProfilingProxy<IShellItemArray> {
+public:
+    explicit ProfilingShellItemArray(IShellItemArray* pInner) : ProfilingProxy<IShellItemArray>(pInner) {}
+
+    // IShellItemArray methods
+    HRESULT STDMETHODCALLTYPE GetCount(DWORD *pdwNumItems) {
+        return profileCall(kIShellItemArray_GetCount, [&] { return pInner->GetCount(pdwNumItems); });
+    }
+
+    HRESULT STDMETHODCALLTYPE GetItemAt(DWORD dwIndex, IShellItem **ppsi) {
+        HRESULT hr = profileCall(kIShellItemArray_GetItemAt, [&] { return pInner->GetItemAt(dwIndex, ppsi); });
+        if (SUCCEEDED(hr)) {
+            wrapOut<ProfilingShellItem>(ppsi);
+        }
+        return hr;
+    }
+
+    HRESULT STDMETHODCALLTYPE EnumItems(IEnumShellItems **ppenumShellItems) {
+        HRESULT hr = profileCall(kIShellItemArray_EnumItems, [&] { return pInner->EnumItems(ppenumShellItems); });
+        if (SUCCEEDED(hr)) {
+            wrapOut<ProfilingEnumShellItems>(ppenumShellItems);
+        }
+        return hr;
+    }
+
+protected:
+    bool proxies(REFIID riid) const {
+        return riid == IID_IShellItemArray;
+    }
+};
+
+template <typename Base>
+class ProfilingFileDialog : public ProfilingProxy<Base> {
+public:
+    explicit ProfilingFileDialog(Base* pInner) : ProfilingProxy<Base>(pInner) {}
+
+    // IModalWindow methods
+    HRESULT STDMETHODCALLTYPE Show(HWND hwndOwner) {
+        return profileCall(kIModalWindow_Show, [&] { return this->pInner->Show(hwndOwner); });
+    }
+
+    // IFileDialog methods
+    HRESULT STDMETHODCALLTYPE SetFileTypes(UINT cFileTypes, const COMDLG_FILTERSPEC *rgFilterSpec) {
+        return profileCall(kIFileDialog_SetFileTypes, [&] { return this->pInner->SetFileTypes(cFileTypes, rgFilterSpec); });
+    }
+
+    HRESULT STDMETHODCALLTYPE SetFileTypeIndex(UINT iFileType) {
+        return profileCall(kIFileDialog_SetFileTypeIndex, [&] { return this->pInner->SetFileTypeIndex(iFileType); });
+    }
+
+    HRESULT STDMETHODCALLTYPE GetFileTypeIndex(UINT *piFileType) {
+        return profileCall(kIFileDialog_GetFileTypeIndex, [&] { return this->pInner->GetFileTypeIndex(piFileType); });
+    }
+
+    HRESULT STDMETHODCALLTYPE Advise(IUnknown *pfde, DWORD *pdwCookie) {
+        return profileCall(kIFileDialog_Advise, [&] { return this->pInner->Advise(pfde, pdwCookie); });
+    }
+
+    HRESULT STDMETHODCALLTYPE Unadvise(DWORD dwCookie) {
+        return profileCall(kIFileDialog_Unadvise, [&] { return this->pInner->Unadvise(dwCookie); });
+    }
+
+    HRESULT STDMETHODCALLTYPE SetOptions(DWORD fos) {
+        return profileCall(kIFileDialog_SetOptions, [&] { return this->pInner->SetOptions(fos); });
+    }
+
+    HRESULT STDMETHODCALLTYPE GetOptions(DWORD *pfos) {
+        return profileCall(kIFileDialog_GetOptions, [&] { return this->pInner->GetOptions(pfos); });
+    }
+
+    HRESULT STDMETHODCALLTYPE SetDefaultFolder(IShellItem *psi) {
+        return profileCall(kIFileDialog_SetDefaultFolder, [&] { return this->pInner->SetDefaultFolder(psi); });
+    }
+
+    HRESULT STDMETHODCALLTYPE SetFolder(IShellItem *psi) {
+        return profileCall(kIFileDialog_SetFolder, [&] { return this->pInner->SetFolder(psi); });
+    }
+
+    HRESULT STDMETHODCALLTYPE GetFolder(IShellItem **ppsi) {
+        HRESULT hr = profileCall(kIFileDialog_GetFolder, [&] { return this->pInner->GetFolder(ppsi); });
+        if (SUCCEEDED(hr)) {
+            wrapOut<ProfilingShellItem>(ppsi);
+        }
+        return hr;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetCurrentSelection(IShellItem **ppsi) {
+        HRESULT hr = profileCall(kIFileDialog_GetCurrentSelection, [&] { return this->pInner->GetCurrentSelection(ppsi); });
+        if (SUCCEEDED(hr)) {
+            wrapOut<ProfilingShellItem>(ppsi);
+        }
+        return hr;
+    }
+
+    HRESULT STDMETHODCALLTYPE SetFileName(LPCWSTR pszName) {
+        return profileCall(kIFileDialog_SetFileName, [&] { return this->pInner->SetFileName(pszName); });
+    }
+
+    HRESULT STDMETHODCALLTYPE GetFileName(LPWSTR *pszName) {
+        return profileCall(kIFileDialog_GetFileName, [&] { return this->pInner->GetFileName(pszName); });
+    }
+
+    HRESULT STDMETHODCALLTYPE SetTitle(LPCWSTR pszTitle) {
+        return profileCall(kIFileDialog_SetTitle, [&] { return this->pInner->SetTitle(pszTitle); });
+    }
+
+    HRESULT STDMETHODCALLTYPE SetOkButtonLabel(LPCWSTR pszText) {
+        return profileCall(kIFileDialog_SetOkButtonLabel, [&] { return this->pInner->SetOkButtonLabel(pszText); });
+    }
+
+    HRESULT STDMETHODCALLTYPE SetFileNameLabel(LPCWSTR pszLabel) {
+        return profileCall(kIFileDialog_SetFileNameLabel, [&] { return this->pInner->SetFileNameLabel(pszLabel); });
+    }
+
+    HRESULT STDMETHODCALLTYPE GetResult(IShellItem **ppsi) {
+        HRESULT hr = profileCall(kIFileDialog_GetResult, [&] { return this->pInner->GetResult(ppsi); });
+        if (SUCCEEDED(hr)) {
+            wrapOut<ProfilingShellItem>(ppsi);
+        }
+        return hr;
+    }
+
+    HRESULT STDMETHODCALLTYPE AddPlace(IShellItem *psi, int fdap) {
+        return profileCall(kIFileDialog_AddPlace, [&] { return this->pInner->AddPlace(psi, fdap); });
+    }
+
+    HRESULT STDMETHODCALLTYPE SetDefaultExtension(LPCWSTR pszDefaultExtension) {
+        return profileCall(kIFileDialog_SetDefaultExtension, [&] { return this->pInner->SetDefaultExtension(pszDefaultExtension); });
+    }
+
+    HRESULT STDMETHODCALLTYPE Close(HRESULT hr) {
+        return profileCall(kIFileDialog_Close, [&] { return this->pInner->Close(hr); });
+    }
+
+    HRESULT STDMETHODCALLTYPE SetClientGuid(REFGUID guid) {
+        return profileCall(kIFileDialog_SetClientGuid, [&] { return this->pInner->SetClientGuid(guid); });
+    }
+
+    HRESULT STDMETHODCALLTYPE ClearClientData() {
+        return profileCall(kIFileDialog_ClearClientData, [&] { return this->pInner->ClearClientData(); });
+    }
+
+    HRESULT STDMETHODCALLTYPE SetFilter(IShellItemFilter *pFilter) {
+        return profileCall(kIFileDialog_SetFilter, [&] { return this->pInner->SetFilter(pFilter); });
+    }
+
+protected:
+    bool proxies(REFIID riid) const {
+        return riid == IID_IFileDialog;
+    }
+};
+
+class ProfilingFileOpenDialog : public ProfilingFileDialog<IFileOpenDialog> {
+public:
+    explicit ProfilingFileOpenDialog(IFileOpenDialog* pInner) : ProfilingFileDialog<IFileOpenDialog>(pInner) {}
+
+    // IFileOpenDialog methods
+    HRESULT STDMETHODCALLTYPE GetResults(IShellItemArray **ppenum) {
+        HRESULT hr = profileCall(kIFileOpenDialog_GetResults, [&] { return pInner->GetResults(ppenum); });
+        if (SUCCEEDED(hr)) {
+            wrapOut<ProfilingShellItemArray>(ppenum);
+        }
+        return hr;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetSelectedItems(IShellItemArray **ppsai) {
+        HRESULT hr = profileCall(kIFileOpenDialog_GetSelectedItems, [&] { return pInner->GetSelectedItems(ppsai); });
+        if (SUCCEEDED(hr)) {
+            wrapOut<ProfilingShellItemArray>(ppsai);
+        }
+        return hr;
+    }
+
+protected:
+    bool proxies(REFIID riid) const {
+        return riid == IID_IFileOpenDialog || riid == IID_IFileDialog;
+    }
+};
+
+class ProfilingFileSaveDialog : public ProfilingFileDialog<IFileSaveDialog> {
+public:
+    explicit ProfilingFileSaveDialog(IFileSaveDialog* pInner) : ProfilingFileDialog<IFileSaveDialog>(pInner) {}
+
+    // IFileSaveDialog methods
+    HRESULT STDMETHODCALLTYPE SetSaveAsItem(IShellItem* psi) {
+        return profileCall(kIFileSaveDialog_SetSaveAsItem, [&] { return pInner->SetSaveAsItem(psi); });
+    }
+
+    HRESULT STDMETHODCALLTYPE SetProperties(IUnknown* pStore) {
+        return profileCall(kIFileSaveDialog_SetProperties, [&] { return pInner->SetProperties(pStore); });
+    }
+
+    HRESULT STDMETHODCALLTYPE SetCollectedProperties(IUnknown* pStore, BOOL fAppendDefault) {
+        return profileCall(kIFileSaveDialog_SetCollectedProperties, [&] { return pInner->SetCollectedProperties(pStore, fAppendDefault); });
+    }
+
+    HRESULT STDMETHODCALLTYPE GetProperties(IUnknown** ppStore) {
+        return profileCall(kIFileSaveDialog_GetProperties, [&] { return pInner->GetProperties(ppStore); });
+    }
+
+    HRESULT STDMETHODCALLTYPE ApplyProperties(IShellItem* psi, IUnknown* pStore, HWND hwnd, IUnknown* pSink) {
+        return profileCall(kIFileSaveDialog_ApplyProperties, [&] { return pInner->ApplyProperties(psi, pStore, hwnd, pSink); });
+    }
+
+protected:
+    bool proxies(REFIID riid) const {
+        return riid == IID_IFileSaveDialog || riid == IID_IFileDialog;
+    }
+};
+
+// Proxy for a dialog requested as IFileDialog: as open or save dialog when the object is one
+static HRESULT createProfilingDialog(IFileDialog* pInner, void** ppv) {
+    IFileOpenDialog* pOpen = nullptr;
+    IFileSaveDialog* pSave = nullptr;
+    if (SUCCEEDED(pInner->QueryInterface(IID_IFileOpenDialog, reinterpret_cast<void**>(&pOpen)))) {
+        *ppv = static_cast<IFileDialog*>(new ProfilingFileOpenDialog(pOpen));
+        pOpen->Release();
+    } else if (SUCCEEDED(pInner->QueryInterface(IID_IFileSaveDialog, reinterpret_cast<void**>(&pSave)))) {
+        *ppv = static_cast<IFileDialog*>(new ProfilingFileSaveDialog(pSave));
+        pSave->Release();
+    } else {
+        *ppv = static_cast<IFileDialog*>(new ProfilingFileDialog<IFileDialog>(pInner));
+    }
+    return S_OK;
+}
+
+HRESULT createProfilingProxy(REFIID riid, void* pInner, void** ppv) {
+    if (!ppv) {
+        return E_POINTER;
+    }
+    *ppv = nullptr;
+    if (!pInner) {
+        return E_INVALIDARG;
+    }
+    if (riid == IID_IShellItem) {
+        *ppv = static_cast<IShellItem*>(new ProfilingShellItem(static_cast<IShellItem*>(pInner)));
+    } else if (riid == IID_IShellItemArray) {
+        *ppv = static_cast<IShellItemArray*>(new ProfilingShellItemArray(static_cast<IShellItemArray*>(pInner)));
+    } else if (riid == IID_IEnumShellItems) {
+        *ppv = static_cast<IEnumShellItems*>(new ProfilingEnumShellItems(static_cast<IEnumShellItems*>(pInner)));
+    } else if (riid == IID_IFileOpenDialog) {
+        *ppv = static_cast<IFileOpenDialog*>(new ProfilingFileOpenDialog(static_cast<IFileOpenDialog*>(pInner)));
+    } else if (riid == IID_IFileSaveDialog) {
+        *ppv = static_cast<IFileSaveDialog*>(new ProfilingFileSaveDialog(static_cast<IFileSaveDialog*>(pInner)));
+    } else if (riid == IID_IFileDialog) {
+        return createProfilingDialog(static_cast<IFileDialog*>(pInner), ppv);
+    } else {
+        return E_NOINTERFACE;
+    }
+    return S_OK;
+}
+
+// The entry points enableCallProfiling replaced
+static PFN_CoCreateInstance pProfiledCoCreateInstance = nullptr;
+static PFN_SHCreateItemFromParsingName pProfiledSHCreateItemFromParsingName = nullptr;
+
+// Hand out a proxy for pObject (of type riid) in *ppv, or pObject itself when there is no proxy
+static HRESULT wrapCreated(REFIID riid, void* pObject, void** ppv) {
+    HRESULT hr = createProfilingProxy(riid, pObject, ppv);
+    if (hr == E_NOINTERFACE) {
+        *ppv = pObject;
+        return S_OK;
+    }
+    static_cast<IUnknown*>(pObject)->Release();
+    return hr;
+}
+
+static HRESULT STDMETHODCALLTYPE ProfilingCoCreateInstance(REFCLSID rclsid, LPUNKNOWN pUnkOuter, DWORD dwClsContext, REFIID riid, LPVOID* ppv) {
+    void* pObject = nullptr;
+    HRESULT hr = pProfiledCoCreateInstance(rclsid, pUnkOuter, dwClsContext, riid, &pObject);
+    if (FAILED(hr)) {
+        *ppv = nullptr;
+        return hr;
+    }
+    return wrapCreated(riid, pObject, ppv);
+}
+
+static HRESULT STDMETHODCALLTYPE ProfilingSHCreateItemFromParsingName(LPCWSTR pszPath, LPVOID pbc, REFIID riid, void** ppv) {
+    void* pObject = nullptr;
+    HRESULT hr = pProfiledSHCreateItemFromParsingName(pszPath, pbc, riid, &pObject);
+    if (FAILED(hr)) {
+        *ppv = nullptr;
+        return hr;
+    }
+    return wrapCreated(riid, pObject, ppv);
+}
+
+void enableCallProfiling(COMFunctionPointers& comFuncs) {
+    if (comFuncs.pCoCreateInstance && comFuncs.pCoCreateInstance != ProfilingCoCreateInstance) {
+        pProfiledCoCreateInstance = comFuncs.pCoCreateInstance;
+        comFuncs.pCoCreateInstance = ProfilingCoCreateInstance;
+    }
+    if (comFuncs.pSHCreateItemFromParsingName && comFuncs.pSHCreateItemFromParsingName != ProfilingSHCreateItemFromParsingName) {
+        pProfiledSHCreateItemFromParsingName = comFuncs.pSHCreateItemFromParsingName;
+        comFuncs.pSHCreateItemFromParsingName = ProfilingSHCreateItemFromParsingName;
+    }
+}
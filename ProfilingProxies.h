@@ -0,0 +1,23 @@
+#ifndef PROFILING_PROXIES_H
+#define PROFILING_PROXIES_H
+
+#include "IFileDialog.h"
+#include "CallProfiler.h"
+
+// Forwarding proxies that time every method of IFileDialog, IFileOpenDialog, IFileSaveDialog,
+// IShellItem, IShellItemArray and IEnumShellItems into the call profiler. Interfaces handed out by
+// a proxied call (GetResults, GetItemAt, Next, GetParent, BindToHandler(BHID_EnumItems), ...) are
+// proxied in turn, so one wrapped dialog profiles the whole session. QueryInterface for anything
+// else is answered by the wrapped object itself, unprofiled.
+//
+// pInner must be an interface pointer of type riid; the proxy takes its own reference. A dialog
+// requested as IID_IFileDialog is proxied as open or save dialog when the object is one.
+// Returns E_NOINTERFACE for interfaces that have no proxy.
+HRESULT createProfilingProxy(REFIID riid, void* pInner, void** ppv);
+
+// Route comFuncs.pCoCreateInstance and pSHCreateItemFromParsingName through the proxies, so
+// dialogs and items created through them are profiled. Process-wide: the original entry points
+// are remembered for every caller of the profiling versions.
+void enableCallProfiling(COMFunctionPointers& comFuncs);
+
+#endif // PROFILING_PROXIES_H
@@ -2,8 +2,12 @@
 #include <string>
 #include <random>
 #include <stdexcept>
-#include <windows.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <mutex>
 #include "ProjUtil.h"
+#include "RecentItems.h"
 
 std::wstring trim(const std::wstring& str) {
     auto start = std::find_if(str.begin(), str.end(), [](unsigned char ch) {
@@ -15,27 +19,79 @@ std::wstring trim(const std::wstring& str) {
     return (start < end) ? std::wstring(start, end) : std::wstring();
 }
 
-// Helper function to get recent files paths from registry
-std::vector<std::wstring> getRecentFilesPaths() {
-    std::vector<std::wstring> recentPaths;
-    HKEY hKey;
-
-    // Open the registry key
-    if (RegOpenKeyExW(HKEY_CURRENT_USER, L"Software\\Microsoft\\Windows\\CurrentVersion\\RecentDocs", 0, KEY_READ, &hKey) == ERROR_SUCCESS) {
-        wchar_t valueName[256];
-        DWORD valueNameSize = sizeof(valueName) / sizeof(valueName[0]);
-        DWORD index = 0;
+std::string wideToUtf8(const wchar_t* str, size_t length) {
+    std::string out;
+    out.reserve(length);
+    appendUtf8(out, str, length);
+    return out;
+}
 
-        // Enumerate the values in the registry key
-        while (RegEnumValueW(hKey, index++, valueName, &valueNameSize, NULL, NULL, NULL, NULL) == ERROR_SUCCESS) {
-            std::wstring path(valueName);
-            recentPaths.push_back(path);
+void appendUtf8(std::string& out, const wchar_t* str, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        uint32_t cp = static_cast<uint32_t>(str[i]);
+        // Combine UTF-16 surrogate pairs (wchar_t is 16-bit on Windows)
+        if (cp >= 0xD800 && cp <= 0xDBFF && i + 1 < length) {
+            uint32_t low = static_cast<uint32_t>(str[i + 1]);
+            if (low >= 0xDC00 && low <= 0xDFFF) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                ++i;
+            }
+        }
+        if (cp < 0x80) {
+            out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+}
 
-            // Reset the size for the next call
-            valueNameSize = sizeof(valueName) / sizeof(valueName[0]);
+std::wstring utf8ToWide(const char* str, size_t length) {
+    std::wstring out;
+    out.reserve(length);
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(str);
+    for (size_t i = 0; i < length;) {
+        uint32_t cp = p[i];
+        size_t extra = (cp >= 0xF0) ? 3 : (cp >= 0xE0) ? 2 : (cp >= 0xC0) ? 1 : 0;
+        if (i + extra >= length) {
+            out += static_cast<wchar_t>(0xFFFD);  // Truncated sequence
+            break;
+        }
+        if (extra) {
+            cp &= 0x3Fu >> extra;
+            for (size_t k = 1; k <= extra; ++k) {
+                cp = (cp << 6) | (p[i + k] & 0x3F);
+            }
+        } else if (cp >= 0x80) {
+            cp = 0xFFFD;  // Stray continuation byte
+        }
+        i += extra + 1;
+        if (sizeof(wchar_t) == 2 && cp >= 0x10000) {
+            cp -= 0x10000;
+            out += static_cast<wchar_t>(0xD800 + (cp >> 10));
+            out += static_cast<wchar_t>(0xDC00 + (cp & 0x3FF));
+        } else {
+            out += static_cast<wchar_t>(cp);
         }
-        // Close the registry key
-        RegCloseKey(hKey);
     }
-    return recentPaths;
+    return out;
+}
+
+// Helper function to get recent files paths (RecentDocs registry key on Windows, recently-used.xbel
+// elsewhere). The index is loaded once and only re-read when the source changes.
+std::vector<std::wstring> getRecentFilesPaths() {
+    static std::mutex indexMutex;
+    static RecentItemsIndex index(createDefaultRecentItemsBackend());
+    std::lock_guard<std::mutex> lock(indexMutex);
+    index.refresh();
+    return index.allPaths();
 }
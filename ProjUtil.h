@@ -6,6 +6,12 @@
 
 std::wstring trim(const std::wstring& str);
 
-// Helper function to get recent files paths from registry
+// UTF-8 <-> wide conversion for native (non-Windows) filesystem paths
+std::string wideToUtf8(const wchar_t* str, size_t length);
+std::wstring utf8ToWide(const char* str, size_t length);
+// Same encoding as wideToUtf8, appended to out without a temporary
+void appendUtf8(std::string& out, const wchar_t* str, size_t length);
+
+// Helper function to get recent files paths (see RecentItemsIndex for searching them)
 std::vector<std::wstring> getRecentFilesPaths();
 #endif // PROJ_UTIL_H
@@ -1,4 +1,16 @@
 #include "ProjWinUtils.h"
+#include <atomic>
+#include <mutex>
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#include <unistd.h>
+#include "PosixShellItem.h"
+#include "StandInFileDialog.h"
+
+// Provided by uuid.lib on Windows
+EXTERN_C const IID IID_IUnknown = kIidIUnknown;
+#endif
 
 // Helper to convert std::wstring to LPCWSTR
 LPCWSTR string_to_LPCWSTR(const std::wstring& s) {
@@ -10,33 +22,196 @@ std::wstring LPCWSTR_to_string(LPCWSTR s) {
     return std::wstring(s);
 }
 
-// Load COM function pointers
-COMFunctionPointers LoadCOMFunctionPointers() {
-    COMFunctionPointers comFuncPtrs = {0};
+// Helper to copy a string into task memory, as GetDisplayName callers expect
+LPWSTR coTaskMemDup(const wchar_t* s, size_t length) {
+    LPWSTR copy = static_cast<LPWSTR>(taskMemAlloc((length + 1) * sizeof(wchar_t)));
+    if (copy) {
+        std::char_traits<wchar_t>::copy(copy, s, length);
+        copy[length] = L'\0';
+    }
+    return copy;
+}
+
+#ifndef _WIN32
+// Exports of the stand-in module, in COMFunctionPointers order
+static const char* const kStandInModuleName = "libCIFileDialogStandIn.so";
+static const char* const kStandInExports[] = {
+    "StandInModuleCoCreateInstance",
+    "StandInModuleCoUninitialize",
+    "StandInModuleCoTaskMemFree",
+    "StandInModuleCoInitialize",
+    "StandInModuleSHCreateItemFromParsingName",
+    "StandInModuleCoTaskMemAlloc"
+};
+
+// The module is looked for next to the executable, not on the library path
+static std::string standInModulePath() {
+    char exe[4096];
+    ssize_t length = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    if (length <= 0) {
+        return kStandInModuleName;
+    }
+    std::string path(exe, static_cast<size_t>(length));
+    size_t slash = path.rfind('/');
+    return path.substr(0, slash + 1) + kStandInModuleName;
+}
+#endif // _WIN32
+
+// Task allocator entry points of the loaded table, read by taskMemAlloc and taskMemFree without
+// taking the table's lock
+#ifndef _WIN32
+static const PFN_CoTaskMemAlloc kUnloadedTaskMemAlloc = CoTaskMemAlloc;
+static const PFN_CoTaskMemFree kUnloadedTaskMemFree = CoTaskMemFree;
+#else
+static const PFN_CoTaskMemAlloc kUnloadedTaskMemAlloc = nullptr;
+static const PFN_CoTaskMemFree kUnloadedTaskMemFree = nullptr;
+#endif // _WIN32
+static std::atomic<PFN_CoTaskMemAlloc> loadedTaskMemAlloc(kUnloadedTaskMemAlloc);
+static std::atomic<PFN_CoTaskMemFree> loadedTaskMemFree(kUnloadedTaskMemFree);
+
+LPVOID STDMETHODCALLTYPE taskMemAlloc(size_t cb) {
+    PFN_CoTaskMemAlloc pAlloc = loadedTaskMemAlloc.load(std::memory_order_acquire);
+    return pAlloc ? pAlloc(cb) : nullptr;
+}
+
+void STDMETHODCALLTYPE taskMemFree(LPVOID pv) {
+    PFN_CoTaskMemFree pFree = loadedTaskMemFree.load(std::memory_order_acquire);
+    if (pFree) {
+        pFree(pv);
+    }
+}
+
+PFN_CoTaskMemAlloc interposeTaskMemAlloc(PFN_CoTaskMemAlloc pAlloc) {
+    return loadedTaskMemAlloc.exchange(pAlloc, std::memory_order_acq_rel);
+}
 
-    comFuncPtrs.hOle32 = LoadLibraryW(L"ole32.dll");
-    comFuncPtrs.hShell32 = LoadLibraryW(L"shell32.dll");
+// The process-wide table behind LoadCOMFunctionPointers. Never destroyed, so copies stay usable
+// by threads still running at exit.
+class COMFunctionTable {
+public:
+    static COMFunctionTable& instance() {
+        static COMFunctionTable* table = new COMFunctionTable();
+        return *table;
+    }
+
+    COMFunctionPointers acquire() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (references++ == 0) {
+            load();
+            publishTaskAllocator();
+        }
+        COMFunctionPointers copy = table;
+        copy.leased = true;
+        return copy;
+    }
+
+    void release() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (references > 0 && --references == 0) {
+            unload();
+            publishTaskAllocator();
+        }
+    }
+
+    const char* source() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return references ? loadedFrom : "none";
+    }
+
+private:
+    COMFunctionTable() : table(), references(0), loadedFrom("none") {}
+
+    void load() {
+        table = COMFunctionPointers();
+#ifndef _WIN32
+        if (void* module = dlopen(standInModulePath().c_str(), RTLD_NOW | RTLD_LOCAL)) {
+            void* entries[sizeof(kStandInExports) / sizeof(kStandInExports[0])];
+            bool complete = true;
+            for (size_t i = 0; i < sizeof(kStandInExports) / sizeof(kStandInExports[0]); ++i) {
+                entries[i] = dlsym(module, kStandInExports[i]);
+                complete = complete && entries[i];
+            }
+            if (complete) {
+                table.hOle32 = module;
+                table.pCoCreateInstance = reinterpret_cast<PFN_CoCreateInstance>(entries[0]);
+                table.pCoUninitialize = reinterpret_cast<PFN_CoUninitialize>(entries[1]);
+                table.pCoTaskMemFree = reinterpret_cast<PFN_CoTaskMemFree>(entries[2]);
+                table.pCoInitialize = reinterpret_cast<PFN_CoInitialize>(entries[3]);
+                table.pSHCreateItemFromParsingName = reinterpret_cast<PFN_SHCreateItemFromParsingName>(entries[4]);
+                table.pCoTaskMemAlloc = reinterpret_cast<PFN_CoTaskMemAlloc>(entries[5]);
+                loadedFrom = "stand-in module";
+                return;
+            }
+            dlclose(module);
+        }
+        // No ole32/shell32 here; the task allocator, POSIX shell items and stand-in dialogs are in-process.
+        table.pCoCreateInstance = StandInCoCreateInstance;
+        table.pCoUninitialize = StandInCoUninitialize;
+        table.pCoTaskMemFree = CoTaskMemFree;
+        table.pCoInitialize = StandInCoInitialize;
+        table.pSHCreateItemFromParsingName = PosixSHCreateItemFromParsingName;
+        table.pCoTaskMemAlloc = CoTaskMemAlloc;
+        loadedFrom = "in-process";
+#else
+        table.hOle32 = LoadLibraryW(L"ole32.dll");
+        table.hShell32 = LoadLibraryW(L"shell32.dll");
 
-    if (comFuncPtrs.hOle32) {
-        comFuncPtrs.pCoCreateInstance = (PFN_CoCreateInstance)GetProcAddress(comFuncPtrs.hOle32, "CoCreateInstance");
-        comFuncPtrs.pCoUninitialize = (PFN_CoUninitialize)GetProcAddress(comFuncPtrs.hOle32, "CoUninitialize");
-        comFuncPtrs.pCoTaskMemFree = (PFN_CoTaskMemFree)GetProcAddress(comFuncPtrs.hOle32, "CoTaskMemFree");
-        comFuncPtrs.pCoInitialize = (PFN_CoInitialize)GetProcAddress(comFuncPtrs.hOle32, "CoInitialize");
+        if (table.hOle32) {
+            table.pCoCreateInstance = (PFN_CoCreateInstance)GetProcAddress(table.hOle32, "CoCreateInstance");
+            table.pCoUninitialize = (PFN_CoUninitialize)GetProcAddress(table.hOle32, "CoUninitialize");
+            table.pCoTaskMemFree = (PFN_CoTaskMemFree)GetProcAddress(table.hOle32, "CoTaskMemFree");
+            table.pCoInitialize = (PFN_CoInitialize)GetProcAddress(table.hOle32, "CoInitialize");
+            table.pCoTaskMemAlloc = (PFN_CoTaskMemAlloc)GetProcAddress(table.hOle32, "CoTaskMemAlloc");
+        }
+
+        if (table.hShell32) {
+            table.pSHCreateItemFromParsingName = (PFN_SHCreateItemFromParsingName)GetProcAddress(table.hShell32, "SHCreateItemFromParsingName");
+        }
+        loadedFrom = "ole32/shell32";
+#endif // _WIN32
+    }
+
+    void unload() {
+#ifndef _WIN32
+        if (table.hOle32) {
+            dlclose(table.hOle32);
+        }
+#else
+        if (table.hOle32) {
+            FreeLibrary(table.hOle32);
+        }
+        if (table.hShell32) {
+            FreeLibrary(table.hShell32);
+        }
+#endif // _WIN32
+        table = COMFunctionPointers();
+        loadedFrom = "none";
     }
 
-    if (comFuncPtrs.hShell32) {
-        comFuncPtrs.pSHCreateItemFromParsingName = (PFN_SHCreateItemFromParsingName)GetProcAddress(comFuncPtrs.hShell32, "SHCreateItemFromParsingName");
+    void publishTaskAllocator() {
+        loadedTaskMemAlloc.store(table.pCoTaskMemAlloc ? table.pCoTaskMemAlloc : kUnloadedTaskMemAlloc, std::memory_order_release);
+        loadedTaskMemFree.store(table.pCoTaskMemFree ? table.pCoTaskMemFree : kUnloadedTaskMemFree, std::memory_order_release);
     }
 
-    return comFuncPtrs;
+    std::mutex mutex;
+    COMFunctionPointers table;
+    long references;
+    const char* loadedFrom;
+};
+
+// Load COM function pointers
+COMFunctionPointers LoadCOMFunctionPointers() {
+    return COMFunctionTable::instance().acquire();
 }
 
 // Free COM libraries
 void FreeCOMFunctionPointers(COMFunctionPointers& comFuncPtrs) {
-    if (comFuncPtrs.hOle32) {
-        FreeLibrary(comFuncPtrs.hOle32);
-    }
-    if (comFuncPtrs.hShell32) {
-        FreeLibrary(comFuncPtrs.hShell32);
+    if (comFuncPtrs.leased) {
+        comFuncPtrs.leased = false;
+        COMFunctionTable::instance().release();
     }
 }
+
+const char* comFunctionTableSource() {
+    return COMFunctionTable::instance().source();
+}
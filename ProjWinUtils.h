@@ -2,7 +2,7 @@
 #define WINUTILS_H
 
 #include <string>
-#if !defined(__unknwn_h__)
+#if !defined(__unknwn_h__) && defined(_WIN32)
 #include <unknwn.h>  // For IUnknown
 #else
 #include "Unknwn.h" // Our custom .h
@@ -14,6 +14,7 @@ typedef void (STDMETHODCALLTYPE *PFN_CoUninitialize)();
 typedef HRESULT (STDMETHODCALLTYPE *PFN_CoCreateInstance)(REFCLSID, LPUNKNOWN, DWORD, REFIID, LPVOID*);
 typedef HRESULT (STDMETHODCALLTYPE *PFN_SHCreateItemFromParsingName)(LPCWSTR, LPVOID, REFIID, void**);
 typedef void (STDMETHODCALLTYPE *PFN_CoTaskMemFree)(LPVOID);
+typedef LPVOID (STDMETHODCALLTYPE *PFN_CoTaskMemAlloc)(size_t);
 
 // Structure to hold the function pointers and module handles
 struct COMFunctionPointers {
@@ -24,14 +25,33 @@ struct COMFunctionPointers {
     PFN_CoTaskMemFree pCoTaskMemFree;
     PFN_CoInitialize pCoInitialize;
     PFN_SHCreateItemFromParsingName pSHCreateItemFromParsingName;
+    PFN_CoTaskMemAlloc pCoTaskMemAlloc;
+    bool leased;  // Holds a reference on the process-wide table until FreeCOMFunctionPointers
 };
 
 // Raw Windows definitions and functions
 LPCWSTR string_to_LPCWSTR(const std::wstring& s);
 std::wstring LPCWSTR_to_string(LPCWSTR s);
+LPWSTR coTaskMemDup(const wchar_t* s, size_t length);  // Copy into a taskMemAlloc'd, null-terminated string
 
-// Function declarations for COM handling
+// The task allocator of the process-wide table below, for code with no COMFunctionPointers copy of
+// its own: the in-process items filling GetDisplayName, and the helpers freeing what they return.
+// While no table is loaded these use the in-process stand-ins on POSIX; on Windows taskMemAlloc
+// then returns nullptr.
+LPVOID STDMETHODCALLTYPE taskMemAlloc(size_t cb);
+void STDMETHODCALLTYPE taskMemFree(LPVOID pv);
+// Sends taskMemAlloc through pAlloc, which forwards to the entry point returned, until the table
+// is next loaded or unloaded; passing that entry point back undoes it. For the benchmarks, which
+// count task allocations this way.
+PFN_CoTaskMemAlloc interposeTaskMemAlloc(PFN_CoTaskMemAlloc pAlloc);
+
+// Function declarations for COM handling. The table is loaded once and shared by the whole process:
+// LoadCOMFunctionPointers returns a copy and takes a reference, FreeCOMFunctionPointers gives it
+// back (once per copy; later calls are no-ops), and the modules are unloaded with the last reference.
+// On POSIX the entry points come from the stand-in module next to the executable (see
+// StandInModule.cpp), or from the in-process stand-ins when it cannot be loaded.
 COMFunctionPointers LoadCOMFunctionPointers();
 void FreeCOMFunctionPointers(COMFunctionPointers& comFuncPtrs);
+const char* comFunctionTableSource();  // Where the current table came from; "none" when unloaded
 
 #endif // WINUTILS_H
@@ -0,0 +1,109 @@
+#ifndef QUERY_INTERFACE_TABLE_H
+#define QUERY_INTERFACE_TABLE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "ComGuid.h"
+
+// Perfect hash over the Data1 words of a class's IIDs: slot = (Data1 * multiplier) >> (32 - bits).
+// Data1 is the random part of a generated IID, so a multiplicative hash spreads it well.
+struct QiHashParams {
+    unsigned bits;
+    uint32_t multiplier;
+};
+
+constexpr uint32_t qiSlot(uint32_t data1, QiHashParams params) {
+    return (data1 * params.multiplier) >> (32 - params.bits);
+}
+
+// Smallest table, then first multiplier, that gives every IID its own slot
+template <size_t N>
+constexpr QiHashParams qiFindHash(const std::array<GUID, N>& ids) {
+    static_assert(N >= 2 && N <= 127, "QueryInterfaceTable supports 1 to 126 interfaces");
+    for (size_t i = 0; i < N; ++i) {
+        for (size_t j = i + 1; j < N; ++j) {
+            if (guidEqualsConstexpr(ids[i], ids[j])) {
+                throw std::logic_error("QueryInterfaceTable: interface listed twice");
+            }
+            if (ids[i].Data1 == ids[j].Data1) {
+                throw std::logic_error("QueryInterfaceTable: IIDs share Data1, no hash separates them");
+            }
+        }
+    }
+    const uint32_t multipliers[] = {0x9E3779B1u, 0x85EBCA6Bu, 0xC2B2AE35u, 0x27D4EB2Fu, 0x165667B1u, 0xD3A2646Du, 0xFD7046C5u, 0xB55A4F09u};
+    unsigned bits = 1;
+    while ((size_t(1) << bits) < N) {
+        ++bits;
+    }
+    for (; bits <= 8; ++bits) {
+        for (uint32_t multiplier : multipliers) {
+            bool used[256] = {};
+            bool collision = false;
+            for (size_t i = 0; i < N && !collision; ++i) {
+                uint32_t slot = qiSlot(static_cast<uint32_t>(ids[i].Data1), QiHashParams{bits, multiplier});
+                collision = used[slot];
+                used[slot] = true;
+            }
+            if (!collision) {
+                return QiHashParams{bits, multiplier};
+            }
+        }
+    }
+    throw std::logic_error("QueryInterfaceTable: no perfect hash within 256 slots");
+}
+
+// Entry index per slot, -1 where no IID hashes
+template <size_t Size, size_t N>
+constexpr std::array<int8_t, Size> qiBuildSlots(const std::array<GUID, N>& ids, QiHashParams params) {
+    std::array<int8_t, Size> slots{};
+    for (size_t i = 0; i < Size; ++i) {
+        slots[i] = -1;
+    }
+    for (size_t i = 0; i < N; ++i) {
+        slots[qiSlot(static_cast<uint32_t>(ids[i].Data1), params)] = static_cast<int8_t>(i);
+    }
+    return slots;
+}
+
+template <typename Class, typename Interface>
+void* qiCast(Class* self) {
+    return static_cast<Interface*>(self);
+}
+
+// QueryInterface for Class from the list of interfaces it implements, all laid out at compile
+// time: a hit or a miss costs one multiply, one slot load and at most one whole-GUID compare,
+// however many interfaces there are. IUnknown answers with First, so identity holds. Every
+// interface needs a COM_INTERFACE_ID.
+//
+//     HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppv) {
+//         return QueryInterfaceTable<Item, IShellItem, IShellItemCollation>::query(this, riid, ppv);
+//     }
+template <typename Class, typename First, typename... Rest>
+class QueryInterfaceTable {
+public:
+    // S_OK with an AddRef'd *ppv, or E_NOINTERFACE with *ppv cleared
+    static HRESULT query(Class* self, REFIID riid, void **ppv) {
+        if (!ppv) {
+            return E_POINTER;
+        }
+        int index = slots[qiSlot(static_cast<uint32_t>(riid.Data1), params)];
+        if (index < 0 || !guidEquals(riid, ids[index])) {
+            *ppv = nullptr;
+            return E_NOINTERFACE;
+        }
+        *ppv = casts[index](self);
+        self->AddRef();
+        return S_OK;
+    }
+
+private:
+    typedef void* (*Cast)(Class*);
+
+    static constexpr std::array<GUID, 2 + sizeof...(Rest)> ids = {{kIidIUnknown, ComInterfaceId<First>::value, ComInterfaceId<Rest>::value...}};
+    static constexpr QiHashParams params = qiFindHash(ids);
+    static constexpr std::array<int8_t, (size_t(1) << params.bits)> slots = qiBuildSlots<(size_t(1) << params.bits)>(ids, params);
+    static constexpr Cast casts[2 + sizeof...(Rest)] = {&qiCast<Class, First>, &qiCast<Class, First>, &qiCast<Class, Rest>...};
+};
+
+#endif // QUERY_INTERFACE_TABLE_H
@@ -0,0 +1,431 @@
+#include "RecentItems.h"
+#include "ProjUtil.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <cstdlib>
+#include <cstring>
+#include <cwctype>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+static uint64_t packTrigram(const wchar_t* text) {
+    return (static_cast<uint64_t>(text[0] & 0x1FFFFF) << 42) | (static_cast<uint64_t>(text[1] & 0x1FFFFF) << 21) | (text[2] & 0x1FFFFF);
+}
+
+static std::wstring foldPath(std::wstring_view path) {
+    std::wstring out(path);
+    for (wchar_t& ch : out) {
+        ch = static_cast<wchar_t>(std::towlower(ch));
+    }
+    return out;
+}
+
+// Value of attribute name inside one XML start tag, or empty
+static std::string_view xmlAttribute(std::string_view tag, std::string_view name) {
+    size_t pos = 0;
+    while ((pos = tag.find(name, pos)) != std::string_view::npos) {
+        size_t quote = pos + name.size();
+        bool atBoundary = (pos == 0 || tag[pos - 1] == ' ' || tag[pos - 1] == '\t' || tag[pos - 1] == '\n' || tag[pos - 1] == '\r');
+        if (atBoundary && quote + 1 < tag.size() && tag[quote] == '=' && (tag[quote + 1] == '"' || tag[quote + 1] == '\'')) {
+            size_t end = tag.find(tag[quote + 1], quote + 2);
+            if (end == std::string_view::npos) {
+                return std::string_view();
+            }
+            return tag.substr(quote + 2, end - quote - 2);
+        }
+        pos = quote;
+    }
+    return std::string_view();
+}
+
+static int hexDigit(char ch) {
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+}
+
+// file:// URI (XML-escaped, percent-encoded) to a native UTF-8 path; false for other schemes
+static bool fileUriToPath(std::string_view uri, std::string& path) {
+    std::string text;
+    for (size_t i = 0; i < uri.size(); ++i) {
+        if (uri[i] == '&') {
+            static const std::pair<const char*, char> entities[] = {
+                { "&amp;", '&' }, { "&lt;", '<' }, { "&gt;", '>' }, { "&quot;", '"' }, { "&apos;", '\'' }
+            };
+            bool decoded = false;
+            for (const auto& entity : entities) {
+                size_t length = std::strlen(entity.first);
+                if (uri.compare(i, length, entity.first) == 0) {
+                    text += entity.second;
+                    i += length - 1;
+                    decoded = true;
+                    break;
+                }
+            }
+            if (decoded) {
+                continue;
+            }
+        }
+        text += uri[i];
+    }
+
+    const std::string scheme = "file://";
+    if (text.compare(0, scheme.size(), scheme) != 0) {
+        return false;
+    }
+    size_t start = text.find('/', scheme.size());  // Skip an authority such as "localhost"
+    if (start == std::string::npos) {
+        return false;
+    }
+
+    path.clear();
+    for (size_t i = start; i < text.size(); ++i) {
+        int high, low;
+        if (text[i] == '%' && i + 2 < text.size() && (high = hexDigit(text[i + 1])) >= 0 && (low = hexDigit(text[i + 2])) >= 0) {
+            path += static_cast<char>(high * 16 + low);
+            i += 2;
+        } else {
+            path += text[i];
+        }
+    }
+#ifdef _WIN32
+    // file:///C:/dir/file -> C:\dir\file
+    if (path.size() > 2 && path[0] == '/' && path[2] == ':') {
+        path.erase(0, 1);
+    }
+    std::replace(path.begin(), path.end(), '/', '\\');
+#endif
+    return true;
+}
+
+// recently-used.xbel as written by GLib/GTK: one <bookmark href="file://..." visited="..."> per item
+class XbelRecentItemsBackend : public RecentItemsBackend {
+public:
+    explicit XbelRecentItemsBackend(const std::string& fileName) : fileName(fileName) {}
+
+    bool changeStamp(uint64_t& stamp) {
+        std::error_code ec;
+        auto written = std::filesystem::last_write_time(fileName, ec);
+        if (ec) {
+            return false;
+        }
+        uintmax_t size = std::filesystem::file_size(fileName, ec);
+        if (ec) {
+            return false;
+        }
+        stamp = static_cast<uint64_t>(written.time_since_epoch().count()) * 0x9E3779B97F4A7C15ull ^ static_cast<uint64_t>(size);
+        return true;
+    }
+
+    bool load(std::vector<std::wstring>& paths) {
+        std::ifstream file(fileName, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        std::ostringstream contents;
+        contents << file.rdbuf();
+        const std::string text = contents.str();
+
+        // ISO 8601 timestamps in one format, so they order as strings
+        std::vector<std::pair<std::string_view, std::wstring>> items;
+        std::string path;
+        size_t pos = 0;
+        while ((pos = text.find("<bookmark", pos)) != std::string::npos) {
+            size_t end = text.find('>', pos);
+            if (end == std::string::npos) {
+                break;
+            }
+            std::string_view tag(text.data() + pos, end - pos);
+            pos = end;
+            if (tag.size() > 9 && tag[9] != ' ' && tag[9] != '\t' && tag[9] != '\n' && tag[9] != '\r') {
+                continue;  // <bookmark:applications> and friends
+            }
+            if (!fileUriToPath(xmlAttribute(tag, "href"), path)) {
+                continue;
+            }
+            std::string_view visited = xmlAttribute(tag, "visited");
+            if (visited.empty()) {
+                visited = xmlAttribute(tag, "modified");
+            }
+            items.emplace_back(visited, utf8ToWide(path.c_str(), path.size()));
+        }
+
+        std::stable_sort(items.begin(), items.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+        paths.clear();
+        paths.reserve(items.size());
+        for (auto& item : items) {
+            paths.push_back(std::move(item.second));
+        }
+        return true;
+    }
+
+private:
+    std::string fileName;
+};
+
+std::unique_ptr<RecentItemsBackend> createXbelRecentItemsBackend(const std::string& fileName) {
+    return std::unique_ptr<RecentItemsBackend>(new XbelRecentItemsBackend(fileName));
+}
+
+#ifdef _WIN32
+static const wchar_t* const kRecentDocsKey = L"Software\\Microsoft\\Windows\\CurrentVersion\\RecentDocs";
+
+// HKCU RecentDocs: numbered REG_BINARY values starting with the document's name, ordered by the
+// MRUListEx value (DWORD indexes, most recent first, terminated by 0xFFFFFFFF)
+class RegistryRecentItemsBackend : public RecentItemsBackend {
+public:
+    bool changeStamp(uint64_t& stamp) {
+        HKEY hKey;
+        if (RegOpenKeyExW(HKEY_CURRENT_USER, kRecentDocsKey, 0, KEY_READ, &hKey) != ERROR_SUCCESS) {
+            return false;
+        }
+        FILETIME lastWrite;
+        LONG status = RegQueryInfoKeyW(hKey, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, &lastWrite);
+        RegCloseKey(hKey);
+        if (status != ERROR_SUCCESS) {
+            return false;
+        }
+        stamp = (static_cast<uint64_t>(lastWrite.dwHighDateTime) << 32) | lastWrite.dwLowDateTime;
+        return true;
+    }
+
+    bool load(std::vector<std::wstring>& paths) {
+        HKEY hKey;
+        if (RegOpenKeyExW(HKEY_CURRENT_USER, kRecentDocsKey, 0, KEY_READ, &hKey) != ERROR_SUCCESS) {
+            return false;
+        }
+        DWORD maxDataSize = 0;
+        if (RegQueryInfoKeyW(hKey, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, &maxDataSize, NULL, NULL) != ERROR_SUCCESS) {
+            RegCloseKey(hKey);
+            return false;
+        }
+
+        // Sized from the key itself rather than a fixed buffer
+        std::vector<BYTE> data(maxDataSize + sizeof(wchar_t));
+        std::vector<DWORD> order;
+        DWORD size = static_cast<DWORD>(data.size());
+        if (RegQueryValueExW(hKey, L"MRUListEx", NULL, NULL, data.data(), &size) == ERROR_SUCCESS) {
+            for (DWORD offset = 0; offset + sizeof(DWORD) <= size; offset += sizeof(DWORD)) {
+                DWORD index;
+                std::memcpy(&index, data.data() + offset, sizeof(DWORD));
+                if (index == 0xFFFFFFFF) {
+                    break;
+                }
+                order.push_back(index);
+            }
+        }
+
+        paths.clear();
+        for (DWORD index : order) {
+            DWORD type = 0;
+            size = static_cast<DWORD>(data.size());
+            if (RegQueryValueExW(hKey, std::to_wstring(index).c_str(), NULL, &type, data.data(), &size) != ERROR_SUCCESS || type != REG_BINARY) {
+                continue;
+            }
+            const wchar_t* name = reinterpret_cast<const wchar_t*>(data.data());
+            size_t length = wcsnlen(name, size / sizeof(wchar_t));
+            if (length) {
+                paths.emplace_back(name, length);
+            }
+        }
+        RegCloseKey(hKey);
+        return true;
+    }
+};
+
+std::unique_ptr<RecentItemsBackend> createRegistryRecentItemsBackend() {
+    return std::unique_ptr<RecentItemsBackend>(new RegistryRecentItemsBackend());
+}
+#endif // _WIN32
+
+std::unique_ptr<RecentItemsBackend> createDefaultRecentItemsBackend() {
+#ifdef _WIN32
+    return createRegistryRecentItemsBackend();
+#else
+    std::string dataHome;
+    if (const char* xdgDataHome = std::getenv("XDG_DATA_HOME")) {
+        dataHome = xdgDataHome;
+    }
+    if (dataHome.empty()) {
+        const char* home = std::getenv("HOME");
+        dataHome = std::string(home ? home : "") + "/.local/share";
+    }
+    return createXbelRecentItemsBackend(dataHome + "/recently-used.xbel");
+#endif
+}
+
+RecentItemsIndex::RecentItemsIndex(std::unique_ptr<RecentItemsBackend> backend)
+    : backend(std::move(backend)), loaded(false), stamp(0), added(0), removed(0) {}
+
+bool RecentItemsIndex::refresh() {
+    uint64_t current = 0;
+    if (!backend->changeStamp(current)) {
+        // Source gone: forget what it held
+        std::vector<std::wstring> none;
+        bool changed = !paths.empty();
+        apply(none);
+        loaded = false;
+        return changed;
+    }
+    if (loaded && current == stamp) {
+        return false;
+    }
+
+    std::vector<std::wstring> fresh;
+    if (!backend->load(fresh)) {
+        return false;
+    }
+    loaded = true;
+    stamp = current;
+    bool reordered = (fresh != paths);
+    apply(fresh);
+    return reordered;
+}
+
+void RecentItemsIndex::apply(std::vector<std::wstring>& fresh) {
+    static const uint32_t kUnclaimed = UINT32_MAX;
+    for (uint32_t slot : order) {
+        entries[slot].rank = kUnclaimed;
+    }
+
+    // Each fresh path claims an unclaimed slot holding it, or gets a new one
+    std::vector<uint32_t> freshOrder(fresh.size());
+    std::vector<uint32_t> addedSlots;
+    for (uint32_t rank = 0; rank < fresh.size(); ++rank) {
+        uint32_t slot = kUnclaimed;
+        auto range = slotsByPath.equal_range(fresh[rank]);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (entries[it->second].rank == kUnclaimed) {
+                slot = it->second;
+                break;
+            }
+        }
+        if (slot == kUnclaimed) {
+            if (freeSlots.empty()) {
+                slot = static_cast<uint32_t>(entries.size());
+                entries.emplace_back();
+            } else {
+                slot = freeSlots.back();
+                freeSlots.pop_back();
+            }
+            entries[slot].folded = foldPath(fresh[rank]);
+            entries[slot].live = true;
+            slotsByPath.emplace(fresh[rank], slot);
+            addedSlots.push_back(slot);
+        }
+        entries[slot].rank = rank;
+        freshOrder[rank] = slot;
+    }
+
+    // Slots nobody claimed are gone; they are reused from the next reload on
+    std::vector<uint32_t> removedSlots;
+    for (uint32_t rank = 0; rank < order.size(); ++rank) {
+        uint32_t slot = order[rank];
+        if (entries[slot].rank != kUnclaimed) {
+            continue;
+        }
+        auto range = slotsByPath.equal_range(paths[rank]);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == slot) {
+                slotsByPath.erase(it);
+                break;
+            }
+        }
+        entries[slot].folded = std::wstring();
+        entries[slot].live = false;
+        removedSlots.push_back(slot);
+    }
+    freeSlots.insert(freeSlots.end(), removedSlots.begin(), removedSlots.end());
+    added = addedSlots.size();
+    removed = removedSlots.size();
+    paths.swap(fresh);
+    order.swap(freshOrder);
+
+    // Drop the removed slots from the sorted list and the trigram table, then merge in the added
+    if (removed) {
+        sorted.erase(std::remove_if(sorted.begin(), sorted.end(), [&](uint32_t slot) { return !entries[slot].live; }), sorted.end());
+        trigrams.erase(std::remove_if(trigrams.begin(), trigrams.end(), [&](const Trigram& t) { return !entries[t.slot].live; }), trigrams.end());
+    }
+    if (added) {
+        auto byFolded = [&](uint32_t x, uint32_t y) { return entries[x].folded < entries[y].folded; };
+        std::sort(addedSlots.begin(), addedSlots.end(), byFolded);
+        size_t middle = sorted.size();
+        sorted.insert(sorted.end(), addedSlots.begin(), addedSlots.end());
+        std::inplace_merge(sorted.begin(), sorted.begin() + middle, sorted.end(), byFolded);
+
+        middle = trigrams.size();
+        for (uint32_t slot : addedSlots) {
+            const std::wstring& path = entries[slot].folded;
+            for (size_t i = 0; i + 3 <= path.size(); ++i) {
+                trigrams.push_back({ packTrigram(path.data() + i), slot });
+            }
+        }
+        std::sort(trigrams.begin() + middle, trigrams.end());
+        trigrams.erase(std::unique(trigrams.begin() + middle, trigrams.end(), [](const Trigram& x, const Trigram& y) {
+            return x.gram == y.gram && x.slot == y.slot;
+        }), trigrams.end());
+        std::inplace_merge(trigrams.begin(), trigrams.begin() + middle, trigrams.end());
+    }
+    if (paths.empty()) {
+        // Nothing left: give the memory back
+        entries = std::vector<Entry>();
+        freeSlots = std::vector<uint32_t>();
+        sorted = std::vector<uint32_t>();
+        trigrams = std::vector<Trigram>();
+    }
+}
+
+void RecentItemsIndex::prefixSearch(std::wstring_view prefix, std::vector<size_t>& out, size_t limit) const {
+    out.clear();
+    std::wstring key = foldPath(prefix);
+    auto it = std::lower_bound(sorted.begin(), sorted.end(), key, [&](uint32_t slot, const std::wstring& k) { return entries[slot].folded < k; });
+    for (; it != sorted.end() && entries[*it].folded.compare(0, key.size(), key) == 0; ++it) {
+        out.push_back(entries[*it].rank);
+    }
+    std::sort(out.begin(), out.end());
+    if (out.size() > limit) {
+        out.resize(limit);
+    }
+}
+
+void RecentItemsIndex::substringSearch(std::wstring_view text, std::vector<size_t>& out, size_t limit) const {
+    out.clear();
+    std::wstring key = foldPath(text);
+    if (key.size() < 3) {
+        for (size_t index = 0; index < order.size() && out.size() < limit; ++index) {
+            if (entries[order[index]].folded.find(key) != std::wstring::npos) {
+                out.push_back(index);
+            }
+        }
+        return;
+    }
+
+    // Candidates are the paths holding the query's least common trigram
+    auto rarest = std::make_pair(trigrams.end(), trigrams.end());
+    size_t rarestCount = SIZE_MAX;
+    for (size_t i = 0; i + 3 <= key.size() && rarestCount; ++i) {
+        uint64_t gram = packTrigram(key.data() + i);
+        auto range = std::equal_range(trigrams.begin(), trigrams.end(), Trigram{ gram, 0 },
+                                      [](const Trigram& x, const Trigram& y) { return x.gram < y.gram; });
+        size_t count = static_cast<size_t>(range.second - range.first);
+        if (count < rarestCount) {
+            rarest = range;
+            rarestCount = count;
+        }
+    }
+    // Postings are in slot order, so every match is collected before taking the most recent
+    for (auto it = rarest.first; it != rarest.second; ++it) {
+        const Entry& entry = entries[it->slot];
+        if (entry.folded.find(key) != std::wstring::npos) {
+            out.push_back(entry.rank);
+        }
+    }
+    std::sort(out.begin(), out.end());
+    if (out.size() > limit) {
+        out.resize(limit);
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef RECENT_ITEMS_H
+#define RECENT_ITEMS_H
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <unordered_map>
+
+// Where recent documents come from: the RecentDocs registry key on Windows, the XDG
+// recently-used.xbel file elsewhere
+class RecentItemsBackend {
+public:
+    virtual ~RecentItemsBackend() {}
+
+    // Cheap token that changes whenever the source does (last-write time, size). False when the
+    // source is missing.
+    virtual bool changeStamp(uint64_t& stamp) = 0;
+
+    // Every recent path, most recent first
+    virtual bool load(std::vector<std::wstring>& paths) = 0;
+};
+
+std::unique_ptr<RecentItemsBackend> createXbelRecentItemsBackend(const std::string& fileName);
+#ifdef _WIN32
+std::unique_ptr<RecentItemsBackend> createRegistryRecentItemsBackend();
+#endif
+// Registry on Windows; $XDG_DATA_HOME/recently-used.xbel (or ~/.local/share) elsewhere
+std::unique_ptr<RecentItemsBackend> createDefaultRecentItemsBackend();
+
+// Recent paths loaded once and searchable without touching the backend again. refresh() only
+// reloads when the backend's change stamp moved, and then applies just what was added and removed
+// to the sorted list and the trigram table; a pure reorder only renumbers. Queries are
+// case-insensitive:
+//  - prefix search is a binary search over the case-folded paths kept in sorted order
+//  - substring search looks up the rarest trigram of the query in a sorted trigram table and
+//    verifies only those paths; queries shorter than three characters scan all paths
+// Both return indexes into the recency order (0 = most recent), most recent first.
+class RecentItemsIndex {
+public:
+    explicit RecentItemsIndex(std::unique_ptr<RecentItemsBackend> backend);
+
+    // Reload if the backend changed since the last call. Returns whether the contents changed.
+    bool refresh();
+
+    size_t size() const { return paths.size(); }
+    const std::wstring& path(size_t index) const { return paths[index]; }
+    const std::vector<std::wstring>& allPaths() const { return paths; }
+
+    void prefixSearch(std::wstring_view prefix, std::vector<size_t>& out, size_t limit = SIZE_MAX) const;
+    void substringSearch(std::wstring_view text, std::vector<size_t>& out, size_t limit = SIZE_MAX) const;
+
+    // What the last reload changed, by path
+    size_t lastAdded() const { return added; }
+    size_t lastRemoved() const { return removed; }
+
+private:
+    // One loaded path. Slots keep their number while the path stays, whatever its recency, and
+    // are reused once it goes.
+    struct Entry {
+        std::wstring folded;  // Case-folded path
+        uint32_t rank;        // Index in the recency order
+        bool live;
+    };
+
+    struct Trigram {
+        uint64_t gram;   // Three case-folded characters, 21 bits each
+        uint32_t slot;   // Entry of the path containing it
+        bool operator<(const Trigram& other) const { return gram < other.gram || (gram == other.gram && slot < other.slot); }
+    };
+
+    void apply(std::vector<std::wstring>& fresh);
+
+    std::unique_ptr<RecentItemsBackend> backend;
+    bool loaded;
+    uint64_t stamp;
+
+    std::vector<std::wstring> paths;    // Recency order
+    std::vector<uint32_t> order;        // Slot of each path, in recency order
+    std::vector<Entry> entries;
+    std::vector<uint32_t> freeSlots;
+    std::unordered_multimap<std::wstring, uint32_t> slotsByPath;  // A path listed twice has two slots
+    std::vector<uint32_t> sorted;       // Live slots ordered by folded text
+    std::vector<Trigram> trigrams;      // Each distinct (trigram, slot) pair of the live slots, sorted
+    size_t added;
+    size_t removed;
+};
+
+#endif // RECENT_ITEMS_H
@@ -0,0 +1,142 @@
+#include "ResultSink.h"
+#include "ProjUtil.h"
+#include <cstring>
+
+void NullResultSink::item(const ResultItem& item) {
+    ++itemCount;
+    characters += item.path.size() + item.displayName.size() + item.parent.size();
+}
+
+void TextResultSink::begin(size_t itemCount) {
+    out << L"Number of items selected: " << itemCount << L'\n';
+}
+
+void TextResultSink::item(const ResultItem& item) {
+    if (verbosity() == ResultVerbosityFull) {
+        out << L"Item " << item.index << L":\n";
+        out << L" - Display name: " << item.displayName << L'\n';
+        out << L" - File path: " << item.path << L'\n';
+        out << L" - Attributes: " << item.attributes << L'\n';
+        out << L" - Parent: " << item.parent << L'\n';
+    } else {
+        out << L"Selected file: " << item.path << L'\n';
+    }
+}
+
+void TextResultSink::end() {
+    out.flush();
+}
+
+BufferedResultSink::BufferedResultSink(FILE* file, ResultVerbosity verbosity, size_t blockBytes)
+    : ResultSink(verbosity), file(file), blockBytes(blockBytes ? blockBytes : 1) {
+    buffer.reserve(this->blockBytes + 4096);
+}
+
+BufferedResultSink::~BufferedResultSink() {
+    end();
+}
+
+void BufferedResultSink::end() {
+    if (!buffer.empty()) {
+        fwrite(buffer.data(), 1, buffer.size(), file);
+        buffer.clear();
+    }
+    fflush(file);
+}
+
+void BufferedResultSink::appendString(std::wstring_view s) {
+    appendUtf8(buffer, s.data(), s.size());
+}
+
+void BufferedResultSink::appendRaw(const void* data, size_t bytes) {
+    buffer.append(static_cast<const char*>(data), bytes);
+}
+
+// Whole blocks only, so the FILE's own buffering is bypassed for large outputs
+void BufferedResultSink::commit() {
+    if (buffer.size() >= blockBytes) {
+        size_t whole = buffer.size() - buffer.size() % blockBytes;
+        fwrite(buffer.data(), 1, whole, file);
+        buffer.erase(0, whole);
+    }
+}
+
+void NdjsonResultSink::begin(size_t itemCount) {
+    buffer += "{\"count\":";
+    buffer += std::to_string(itemCount);
+    buffer += "}\n";
+    commit();
+}
+
+void NdjsonResultSink::item(const ResultItem& item) {
+    buffer += "{\"index\":";
+    buffer += std::to_string(item.index);
+    buffer += ",\"path\":";
+    appendJsonString(item.path);
+    if (verbosity() == ResultVerbosityFull) {
+        buffer += ",\"name\":";
+        appendJsonString(item.displayName);
+        buffer += ",\"attributes\":";
+        buffer += std::to_string(item.attributes);
+        buffer += ",\"parent\":";
+        appendJsonString(item.parent);
+    }
+    buffer += "}\n";
+    commit();
+}
+
+// Runs without anything to escape are encoded in one go
+void NdjsonResultSink::appendJsonString(std::wstring_view s) {
+    static const char hex[] = "0123456789abcdef";
+    buffer += '"';
+    size_t run = 0;
+    for (size_t i = 0; i < s.size(); ++i) {
+        wchar_t c = s[i];
+        if (c >= 0x20 && c != L'"' && c != L'\\') {
+            continue;
+        }
+        appendString(s.substr(run, i - run));
+        run = i + 1;
+        switch (c) {
+            case L'"': buffer += "\\\""; break;
+            case L'\\': buffer += "\\\\"; break;
+            case L'\n': buffer += "\\n"; break;
+            case L'\r': buffer += "\\r"; break;
+            case L'\t': buffer += "\\t"; break;
+            default:
+                buffer += "\\u00";
+                buffer += hex[(c >> 4) & 0xf];
+                buffer += hex[c & 0xf];
+        }
+    }
+    appendString(s.substr(run));
+    buffer += '"';
+}
+
+void BinaryResultSink::begin(size_t itemCount) {
+    uint64_t count = itemCount;
+    appendRaw("CIFDRES1", 8);
+    appendUint32(static_cast<uint32_t>(verbosity()));
+    appendRaw(&count, sizeof(count));
+    commit();
+}
+
+void BinaryResultSink::item(const ResultItem& item) {
+    appendUint32(static_cast<uint32_t>(item.index));
+    appendUint32(static_cast<uint32_t>(item.attributes));
+    appendLengthPrefixed(item.path);
+    if (verbosity() == ResultVerbosityFull) {
+        appendLengthPrefixed(item.displayName);
+        appendLengthPrefixed(item.parent);
+    }
+    commit();
+}
+
+// The length is patched in once the string is encoded
+void BinaryResultSink::appendLengthPrefixed(std::wstring_view s) {
+    size_t lengthAt = buffer.size();
+    appendUint32(0);
+    appendString(s);
+    uint32_t length = static_cast<uint32_t>(buffer.size() - lengthAt - sizeof(uint32_t));
+    std::memcpy(&buffer[lengthAt], &length, sizeof(length));
+}
@@ -0,0 +1,124 @@
+#ifndef RESULT_SINK_H
+#define RESULT_SINK_H
+
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include "IFileDialog.h"
+
+// How much of each selected item a sink asks for; getFileDialogResults reads no more than that
+enum ResultVerbosity {
+    ResultVerbosityCount,  // Only the number of items
+    ResultVerbosityPaths,  // File paths
+    ResultVerbosityFull    // Paths, display names, attributes and parents
+};
+
+// One selected item. Views are valid for the duration of the item() call only.
+struct ResultItem {
+    size_t index;
+    std::wstring_view path;
+    std::wstring_view displayName;  // Empty below ResultVerbosityFull
+    std::wstring_view parent;       // Empty below ResultVerbosityFull
+    SFGAOF attributes;              // 0 below ResultVerbosityFull
+};
+
+// Receives a dialog's results: begin(count), item() per item with a path, then end()
+class ResultSink {
+public:
+    explicit ResultSink(ResultVerbosity verbosity) : level(verbosity) {}
+    virtual ~ResultSink() {}
+
+    ResultVerbosity verbosity() const { return level; }
+
+    virtual void begin(size_t itemCount) = 0;
+    virtual void item(const ResultItem& item) = 0;
+    virtual void end() = 0;  // Writes out anything still buffered
+
+private:
+    ResultVerbosity level;
+};
+
+// Discards everything; counts what it was given (for benchmarks)
+class NullResultSink : public ResultSink {
+public:
+    explicit NullResultSink(ResultVerbosity verbosity = ResultVerbosityFull) : ResultSink(verbosity), itemCount(0), characters(0) {}
+
+    void begin(size_t) override {}
+    void item(const ResultItem& item) override;
+    void end() override {}
+
+    size_t items() const { return itemCount; }
+    size_t totalChars() const { return characters; }
+
+private:
+    size_t itemCount;
+    size_t characters;
+};
+
+// Human-readable lines, as the interactive tester prints them; flushed once, at end()
+class TextResultSink : public ResultSink {
+public:
+    TextResultSink(std::wostream& out, ResultVerbosity verbosity) : ResultSink(verbosity), out(out) {}
+
+    void begin(size_t itemCount) override;
+    void item(const ResultItem& item) override;
+    void end() override;
+
+private:
+    std::wostream& out;
+};
+
+// Block-buffered byte output shared by the machine-readable sinks. The FILE is not closed.
+class BufferedResultSink : public ResultSink {
+public:
+    static const size_t kDefaultBlockBytes = 64 * 1024;
+
+    BufferedResultSink(FILE* file, ResultVerbosity verbosity, size_t blockBytes);
+    ~BufferedResultSink() override;
+
+    void end() override;
+
+protected:
+    void appendString(std::wstring_view s);  // UTF-8
+    void appendRaw(const void* data, size_t bytes);
+    void commit();  // Writes the buffer out once a block has filled
+
+    std::string buffer;
+
+private:
+    FILE* file;
+    size_t blockBytes;
+};
+
+// Newline-delimited JSON, UTF-8: {"count":N} first, then one object per item with
+// "index" and "path", plus "name", "attributes" and "parent" at ResultVerbosityFull
+class NdjsonResultSink : public BufferedResultSink {
+public:
+    NdjsonResultSink(FILE* file, ResultVerbosity verbosity, size_t blockBytes = kDefaultBlockBytes)
+        : BufferedResultSink(file, verbosity, blockBytes) {}
+
+    void begin(size_t itemCount) override;
+    void item(const ResultItem& item) override;
+
+private:
+    void appendJsonString(std::wstring_view s);
+};
+
+// Compact binary, native little-endian: the 8 bytes "CIFDRES1", uint32 verbosity, uint64 count, then
+// per item uint32 index, uint32 attributes and length-prefixed (uint32 bytes) UTF-8 strings: the path,
+// then the display name and parent at ResultVerbosityFull
+class BinaryResultSink : public BufferedResultSink {
+public:
+    BinaryResultSink(FILE* file, ResultVerbosity verbosity, size_t blockBytes = kDefaultBlockBytes)
+        : BufferedResultSink(file, verbosity, blockBytes) {}
+
+    void begin(size_t itemCount) override;
+    void item(const ResultItem& item) override;
+
+private:
+    void appendUint32(uint32_t value) { appendRaw(&value, sizeof(value)); }
+    void appendLengthPrefixed(std::wstring_view s);
+};
+
+#endif // RESULT_SINK_H
@@ -0,0 +1,354 @@
+#include "ScenarioRunner.h"
+#include "DialogOptions.h"
+#include "StandInFileDialog.h"
+#include "ProjUtil.h"
+#include "Bench.h"
+#include "ProfilingProxies.h"
+#include "SessionPool.h"
+#include "ComPtr.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <cwctype>
+
+static std::wstring toLower(std::wstring s) {
+    std::transform(s.begin(), s.end(), s.begin(), [](wchar_t ch) { return static_cast<wchar_t>(std::towlower(ch)); });
+    return s;
+}
+
+static bool isAbsolutePath(const std::wstring& path) {
+    return (!path.empty() && (path[0] == L'/' || path[0] == L'\\')) || (path.size() > 1 && path[1] == L':');
+}
+
+// Names in select/expect are relative to the scenario folder unless absolute
+static std::wstring resolveScenarioPath(const std::wstring& folder, const std::wstring& name) {
+    if (isAbsolutePath(name) || folder.empty()) {
+        return name;
+    }
+#ifdef _WIN32
+    const wchar_t separator = L'\\';
+#else
+    const wchar_t separator = L'/';
+#endif
+    wchar_t last = folder.back();
+    return (last == L'/' || last == L'\\') ? folder + name : folder + separator + name;
+}
+
+// Drops a trailing comment: a '#' or ';' that follows whitespace. One inside a value (as in the
+// filter spec "*.txt;*.md") is kept.
+static std::wstring stripTrailingComment(const std::wstring& line) {
+    for (size_t i = 1; i < line.size(); ++i) {
+        if ((line[i] == L'#' || line[i] == L';') && std::iswspace(line[i - 1])) {
+            return line.substr(0, i);
+        }
+    }
+    return line;
+}
+
+bool parseScenarioFile(const std::string& fileName, std::vector<DialogScenario>& scenarios, std::string& error) {
+    std::ifstream file(fileName);
+    if (!file) {
+        error = "Cannot open scenario file " + fileName;
+        return false;
+    }
+
+    std::string rawLine;
+    size_t lineNumber = 0;
+    auto fail = [&](const std::string& message) {
+        error = fileName + ":" + std::to_string(lineNumber) + ": " + message;
+        return false;
+    };
+
+    while (std::getline(file, rawLine)) {
+        ++lineNumber;
+        std::wstring line = trim(utf8ToWide(rawLine.c_str(), rawLine.size()));
+        if (line.empty() || line[0] == L'#' || line[0] == L';') {
+            continue;
+        }
+        line = trim(stripTrailingComment(line));
+
+        if (line[0] == L'[') {
+            if (line.back() != L']') {
+                return fail("unterminated scenario header");
+            }
+            DialogScenario scenario;
+            scenario.name = line.substr(1, line.size() - 2);
+            scenario.dialogType = 1;
+            scenario.optionStates.assign(kDialogOptionCount, Default);
+            scenario.expectCancel = false;
+            scenario.repeat = 1;
+            scenario.line = lineNumber;
+            scenarios.push_back(std::move(scenario));
+            continue;
+        }
+
+        size_t equals = line.find(L'=');
+        if (equals == std::wstring::npos) {
+            return fail("expected key = value");
+        }
+        if (scenarios.empty()) {
+            return fail("setting before the first [scenario] header");
+        }
+        DialogScenario& scenario = scenarios.back();
+        std::wstring key = toLower(trim(line.substr(0, equals)));
+        std::wstring value = trim(line.substr(equals + 1));
+
+        if (key == L"type") {
+            std::wstring type = toLower(value);
+            if (type == L"open" || type == L"1") {
+                scenario.dialogType = 1;
+            } else if (type == L"save" || type == L"2") {
+                scenario.dialogType = 2;
+            } else if (type == L"base" || type == L"3") {
+                scenario.dialogType = 3;
+            } else {
+                return fail("type must be open, save or base");
+            }
+        } else if (key == L"title") {
+            scenario.title = value;
+        } else if (key == L"folder") {
+            scenario.folder = value;
+        } else if (key == L"filter") {
+            size_t bar = value.find(L'|');
+            if (bar == std::wstring::npos) {
+                return fail("filter must be name|spec");
+            }
+            scenario.filters.add(trim(value.substr(0, bar)), trim(value.substr(bar + 1)));
+        } else if (key == L"filename") {
+            scenario.fileName = value;
+        } else if (key == L"select") {
+            scenario.selection.push_back(value);
+        } else if (key == L"expect") {
+            if (toLower(value) == L"cancel") {
+                scenario.expectCancel = true;
+            } else {
+                scenario.expected.push_back(value);
+            }
+        } else if (key == L"repeat") {
+            try {
+                scenario.repeat = static_cast<size_t>(std::stoull(value));
+            } catch (const std::exception&) {
+                scenario.repeat = 0;
+            }
+            if (scenario.repeat == 0) {
+                return fail("repeat must be a positive number");
+            }
+        } else {
+            int option = findDialogOption(key);
+            if (option < 0) {
+                return fail("unknown setting");
+            }
+            std::wstring state = toLower(value);
+            if (state == L"on" || state == L"enabled") {
+                scenario.optionStates[option] = Enabled;
+            } else if (state == L"off" || state == L"disabled") {
+                scenario.optionStates[option] = Disabled;
+            } else if (state == L"default") {
+                scenario.optionStates[option] = Default;
+            } else {
+                return fail("option state must be on, off or default");
+            }
+        }
+    }
+    return true;
+}
+
+HRESULT runDialogScenario(COMFunctionPointers& comFuncs, const DialogScenario& scenario, std::vector<std::wstring>& results) {
+    results.clear();
+    ComPtr<IFileDialog> dialog;
+    createFileDialog(comFuncs, dialog.put(), scenario.dialogType);
+    if (!dialog) {
+        return E_FAIL;
+    }
+
+    configureFileDialog(comFuncs, dialog.get(), scenario.filters, scenario.folder, applyOptionStates(kBaseDialogOptions, scenario.optionStates));
+    if (!scenario.title.empty()) {
+        dialog->SetTitle(scenario.title.c_str());
+    }
+    if (!scenario.fileName.empty()) {
+        dialog->SetFileName(scenario.fileName.c_str());
+    }
+
+    ComPtr<IStandInDialogControl> control;
+    if (SUCCEEDED(dialog.as(IID_IStandInDialogControl, control))) {
+        std::vector<IShellItem*> items;
+        for (const std::wstring& name : scenario.selection) {
+            if (IShellItem* pItem = createShellItem(comFuncs, resolveScenarioPath(scenario.folder, name))) {
+                items.push_back(pItem);
+            }
+        }
+        control->SetSelection(static_cast<UINT>(items.size()), items.data());
+        for (IShellItem* pItem : items) {
+            pItem->Release();
+        }
+    }
+
+    HRESULT hr = dialog->Show(NULL);
+    if (SUCCEEDED(hr)) {
+        if (scenario.dialogType == 2) {
+            ComPtr<IShellItem> result;
+            if (SUCCEEDED(dialog->GetResult(result.put()))) {
+                LPWSTR pszFilePath = nullptr;
+                if (SUCCEEDED(result->GetDisplayName(SIGDN_FILESYSPATH, &pszFilePath))) {
+                    results.push_back(pszFilePath);
+                    comFuncs.pCoTaskMemFree(pszFilePath);
+                }
+            }
+        } else {
+            PathTable paths;
+            getFileDialogResults(comFuncs, static_cast<IFileOpenDialog*>(dialog.get()), paths);
+            results = paths.toVector();
+        }
+    }
+    return hr;
+}
+
+bool scenarioOutcomeMatches(const DialogScenario& scenario, HRESULT hr, const std::vector<std::wstring>& results) {
+    if (scenario.expectCancel) {
+        return hr == kDialogCancelled;
+    }
+    if (FAILED(hr) || results.size() != scenario.expected.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (results[i] != resolveScenarioPath(scenario.folder, scenario.expected[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int runScenarios(const std::vector<std::string>& args) {
+    std::string fileName;
+    bool verbose = false;
+    bool profile = false;
+    unsigned threadCount = 1;
+    bool usage = false;
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string& arg = args[i];
+        if (arg == "--verbose") {
+            verbose = true;
+        } else if (arg == "--profile") {
+            profile = true;
+        } else if (arg == "--threads" && i + 1 < args.size()) {
+            try {
+                threadCount = static_cast<unsigned>(std::stoul(args[++i]));
+            } catch (const std::exception&) {
+                usage = true;
+            }
+        } else {
+            fileName = arg;
+        }
+    }
+    if (fileName.empty() || usage) {
+        std::wcerr << L"Usage: CIFileDialogTester --scenario <file> [--verbose] [--profile] [--threads N]" << std::endl;
+        return 2;
+    }
+
+    std::vector<DialogScenario> scenarios;
+    std::string error;
+    if (!parseScenarioFile(fileName, scenarios, error)) {
+        std::wcerr << utf8ToWide(error.c_str(), error.size()) << std::endl;
+        return 2;
+    }
+
+    COMFunctionPointers comFuncs = LoadCOMFunctionPointers();
+    comFuncs.pCoCreateInstance = StandInCoCreateInstance;
+    if (!comFuncs.pCoTaskMemFree || !comFuncs.pSHCreateItemFromParsingName) {
+        std::wcerr << L"Failed to load one or more COM functions." << std::endl;
+        FreeCOMFunctionPointers(comFuncs);
+        return 2;
+    }
+    if (profile) {
+        enableCallProfiling(comFuncs);
+    }
+    if (comFuncs.pCoInitialize) {
+        comFuncs.pCoInitialize(NULL);
+    }
+    // Runs of a scenario go through the pool when asked for more than one thread (0: one per core)
+    std::unique_ptr<SessionPool> pool;
+    if (threadCount != 1) {
+        pool.reset(new SessionPool(threadCount, comFuncs));
+    }
+    std::mutex failureMutex;
+
+    size_t totalRuns = 0;
+    size_t failedScenarios = 0;
+    BenchTimer totalTimer;
+    for (const DialogScenario& scenario : scenarios) {
+        size_t failedRuns = 0;
+        HRESULT lastHr = S_OK;
+        std::vector<std::wstring> results;
+        std::vector<std::wstring> lastFailure;
+        std::vector<std::wstring> firstResults;  // Only the first run writes it
+        BenchTimer timer;
+        if (pool) {
+            for (size_t run = 0; run < scenario.repeat; ++run) {
+                pool->submit([&, run](COMFunctionPointers& workerFuncs) {
+                    std::vector<std::wstring> runResults;
+                    HRESULT hr = runDialogScenario(workerFuncs, scenario, runResults);
+                    if (run == 0 && verbose) {
+                        firstResults = runResults;
+                    }
+                    if (!scenarioOutcomeMatches(scenario, hr, runResults)) {
+                        std::lock_guard<std::mutex> lock(failureMutex);
+                        ++failedRuns;
+                        lastHr = hr;
+                        lastFailure.swap(runResults);
+                    }
+                });
+            }
+            pool->wait();
+        } else {
+            for (size_t run = 0; run < scenario.repeat; ++run) {
+                HRESULT hr = runDialogScenario(comFuncs, scenario, results);
+                if (run == 0 && verbose) {
+                    firstResults = results;
+                }
+                if (!scenarioOutcomeMatches(scenario, hr, results)) {
+                    ++failedRuns;
+                    lastHr = hr;
+                    lastFailure.swap(results);
+                }
+            }
+        }
+        double seconds = timer.seconds();
+        totalRuns += scenario.repeat;
+
+        double rate = (seconds > 0.0) ? scenario.repeat / seconds : 0.0;
+        std::wcout << (failedRuns ? L"FAIL  " : L"PASS  ") << scenario.name
+                   << L"  runs=" << scenario.repeat
+                   << L" time=" << std::fixed << std::setprecision(3) << seconds << L"s"
+                   << L" rate=" << std::setprecision(0) << rate << L" scenarios/s" << std::endl;
+        for (const std::wstring& path : firstResults) {
+            std::wcout << L"      result: " << path << std::endl;
+        }
+        if (failedRuns) {
+            ++failedScenarios;
+            std::wcout << L"      line " << scenario.line << L": " << failedRuns << L" of " << scenario.repeat
+                       << L" runs failed; last HRESULT 0x" << std::hex << static_cast<unsigned long>(static_cast<DWORD>(lastHr)) << std::dec
+                       << L", " << lastFailure.size() << L" result(s)" << std::endl;
+            for (const std::wstring& path : lastFailure) {
+                std::wcout << L"      got: " << path << std::endl;
+            }
+        }
+    }
+    double totalSeconds = totalTimer.seconds();
+    pool.reset();
+
+    if (comFuncs.pCoUninitialize) {
+        comFuncs.pCoUninitialize();
+    }
+    FreeCOMFunctionPointers(comFuncs);
+
+    double totalRate = (totalSeconds > 0.0) ? totalRuns / totalSeconds : 0.0;
+    std::wcout << scenarios.size() << L" scenarios, " << totalRuns << L" runs, " << failedScenarios << L" failed, "
+               << std::fixed << std::setprecision(3) << totalSeconds << L"s, "
+               << std::setprecision(0) << totalRate << L" scenarios/s" << std::endl;
+    if (profile) {
+        std::wcout << std::endl;
+        printCallProfile(std::wcout);
+    }
+    return failedScenarios ? 1 : 0;
+}
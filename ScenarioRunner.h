@@ -0,0 +1,44 @@
+#ifndef SCENARIO_RUNNER_H
+#define SCENARIO_RUNNER_H
+
+#include <vector>
+#include <string>
+#include <utility>
+#include "IFileDialog.h"
+#include "FilterSet.h"
+
+// One dialog session, as read from a scenario file
+struct DialogScenario {
+    std::wstring name;
+    int dialogType;                 // 1 open, 2 save, 3 base, as in the interactive menu
+    std::wstring title;
+    std::wstring folder;
+    std::vector<int> optionStates;  // One OptionState per kDialogOptions entry
+    FilterSet filters;
+    std::wstring fileName;          // Put in the file name box; a save dialog returns it when nothing is picked
+    std::vector<std::wstring> selection;  // What the stand-in user picks; relative to folder unless absolute
+    std::vector<std::wstring> expected;   // Expected result paths, in order
+    bool expectCancel;
+    size_t repeat;
+    size_t line;                    // Line of the [name] header
+};
+
+// Parse a scenario file. Lines starting with '#' or ';' are comments, as is the rest of a line
+// from a '#' or ';' that follows whitespace. On failure error names the offending line.
+bool parseScenarioFile(const std::string& fileName, std::vector<DialogScenario>& scenarios, std::string& error);
+
+// Run one session through createFileDialog/configureFileDialog/Show/getFileDialogResults.
+// comFuncs.pCoCreateInstance should produce dialogs supporting IStandInDialogControl.
+// Returns the Show() HRESULT; results receives the collected paths.
+HRESULT runDialogScenario(COMFunctionPointers& comFuncs, const DialogScenario& scenario, std::vector<std::wstring>& results);
+
+// Whether a run's outcome is what the scenario expects
+bool scenarioOutcomeMatches(const DialogScenario& scenario, HRESULT hr, const std::vector<std::wstring>& results);
+
+// Entry point for: CIFileDialogTester --scenario <file> [--verbose] [--profile]
+// Runs every scenario in the file against the stand-in dialog and reports timing and throughput.
+// --verbose also lists each scenario's results from its first run.
+// --profile wraps the dialogs and items in profiling proxies and prints per-method latencies at the end.
+int runScenarios(const std::vector<std::string>& args);
+
+#endif // SCENARIO_RUNNER_H
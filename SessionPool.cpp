@@ -0,0 +1,105 @@
+#include "SessionPool.h"
+#include <algorithm>
+
+// Pool and index of the worker running on this thread, so its own submissions stay local
+static thread_local const SessionPool* currentPool = nullptr;
+static thread_local unsigned currentWorker = 0;
+
+SessionPool::SessionPool(unsigned threadCount, const COMFunctionPointers& comFuncs)
+    : comFuncs(comFuncs), queued(0), unfinished(0), nextWorker(0), stolen(0), failed(0), stopping(false) {
+    this->comFuncs.leased = false;  // Workers take their own references
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < threadCount; ++i) {
+        workers.push_back(std::unique_ptr<Worker>(new Worker()));
+    }
+    for (unsigned i = 0; i < threadCount; ++i) {
+        workers[i]->thread = std::thread([this, i]() { run(i); });
+    }
+}
+
+SessionPool::~SessionPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        stopping = true;
+    }
+    idle.notify_all();
+    for (std::unique_ptr<Worker>& worker : workers) {
+        worker->thread.join();
+    }
+}
+
+void SessionPool::submit(Job job) {
+    unsigned index = (currentPool == this) ? currentWorker : nextWorker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+    unfinished.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mutex);
+        workers[index]->jobs.push_back(std::move(job));
+    }
+    queued.fetch_add(1, std::memory_order_seq_cst);
+    // Taking idleMutex orders this against a worker checking queued before it sleeps
+    { std::lock_guard<std::mutex> lock(idleMutex); }
+    idle.notify_one();
+}
+
+void SessionPool::wait() {
+    std::unique_lock<std::mutex> lock(idleMutex);
+    drained.wait(lock, [this]() { return unfinished.load(std::memory_order_acquire) == 0; });
+}
+
+// Own deque from the back, then the others' from the front, starting with the next worker
+bool SessionPool::take(unsigned index, Job& job) {
+    for (size_t offset = 0; offset < workers.size(); ++offset) {
+        Worker& worker = *workers[(index + offset) % workers.size()];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.jobs.empty()) {
+            continue;
+        }
+        if (offset == 0) {
+            job = std::move(worker.jobs.back());
+            worker.jobs.pop_back();
+        } else {
+            job = std::move(worker.jobs.front());
+            worker.jobs.pop_front();
+            stolen.fetch_add(1, std::memory_order_relaxed);
+        }
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void SessionPool::run(unsigned index) {
+    currentPool = this;
+    currentWorker = index;
+    COMFunctionPointers reference = LoadCOMFunctionPointers();
+    COMFunctionPointers workerFuncs = comFuncs;
+    {
+        ComApartment apartment(workerFuncs);
+        Job job;
+        for (;;) {
+            if (!take(index, job)) {
+                std::unique_lock<std::mutex> lock(idleMutex);
+                idle.wait(lock, [this]() { return stopping || queued.load(std::memory_order_seq_cst) > 0; });
+                if (stopping && queued.load(std::memory_order_seq_cst) == 0) {
+                    break;
+                }
+                continue;
+            }
+            try {
+                job(workerFuncs);
+            } catch (...) {
+                failed.fetch_add(1, std::memory_order_relaxed);
+            }
+            job = nullptr;
+            if (unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(idleMutex);
+                drained.notify_all();
+            }
+        }
+    }
+    FreeCOMFunctionPointers(reference);
+    currentPool = nullptr;
+}
@@ -0,0 +1,81 @@
+#ifndef SESSION_POOL_H
+#define SESSION_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "IFileDialog.h"
+
+// CoInitialize for the life of a scope, and CoUninitialize only if that succeeded
+class ComApartment {
+public:
+    explicit ComApartment(const COMFunctionPointers& comFuncs)
+        : pCoUninitialize(comFuncs.pCoUninitialize), hr(comFuncs.pCoInitialize ? comFuncs.pCoInitialize(NULL) : E_FAIL) {}
+    ~ComApartment() {
+        if (SUCCEEDED(hr) && pCoUninitialize) {
+            pCoUninitialize();
+        }
+    }
+    ComApartment(const ComApartment&) = delete;
+    ComApartment& operator=(const ComApartment&) = delete;
+
+    HRESULT result() const { return hr; }
+
+private:
+    PFN_CoUninitialize pCoUninitialize;
+    HRESULT hr;
+};
+
+// Runs independent dialog sessions on a fixed set of worker threads. Each worker holds its own
+// reference on the COM function table and one apartment for its whole life, so jobs neither load
+// nor initialize COM. Every worker has a deque: it runs its newest job first and, once that runs
+// dry, steals the oldest job of another worker. Jobs submitted from a worker go to its own deque.
+class SessionPool {
+public:
+    // Receives the worker's copy of the table (comFuncs with the worker's own reference)
+    typedef std::function<void(COMFunctionPointers& comFuncs)> Job;
+
+    // comFuncs is what jobs are given, so overrides such as a stand-in pCoCreateInstance or
+    // profiling proxies carry over. A threadCount of 0 means one per core.
+    SessionPool(unsigned threadCount, const COMFunctionPointers& comFuncs);
+    ~SessionPool();  // Finishes what was submitted
+    SessionPool(const SessionPool&) = delete;
+    SessionPool& operator=(const SessionPool&) = delete;
+
+    void submit(Job job);
+    void wait();  // Until every job submitted so far has run
+
+    unsigned threads() const { return static_cast<unsigned>(workers.size()); }
+    uint64_t stolenJobs() const { return stolen.load(std::memory_order_relaxed); }
+    uint64_t failedJobs() const { return failed.load(std::memory_order_relaxed); }  // Jobs that threw
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+        std::thread thread;
+    };
+
+    void run(unsigned index);
+    bool take(unsigned index, Job& job);
+
+    COMFunctionPointers comFuncs;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<size_t> queued;       // In some deque
+    std::atomic<size_t> unfinished;   // Submitted and not yet run to completion
+    std::atomic<unsigned> nextWorker;
+    std::atomic<uint64_t> stolen;
+    std::atomic<uint64_t> failed;
+    std::mutex idleMutex;
+    std::condition_variable idle;     // Workers with nothing to run or steal
+    std::condition_variable drained;  // wait()
+    bool stopping;
+};
+
+#endif // SESSION_POOL_H
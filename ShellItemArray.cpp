@@ -0,0 +1,133 @@
+#include "ShellItemArray.h"
+#include "QueryInterfaceTable.h"
+
+class ShellItemArray : public IShellItemArray {
+public:
+    explicit ShellItemArray(std::vector<IShellItem*> items) : refCount(1), items(std::move(items)) {}
+
+    // IUnknown methods
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppv) {
+        return QueryInterfaceTable<ShellItemArray, IShellItemArray>::query(this, riid, ppv);
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() {
+        return InterlockedIncrement(&refCount);
+    }
+
+    ULONG STDMETHODCALLTYPE Release() {
+        ULONG count = InterlockedDecrement(&refCount);
+        if (count == 0) {
+            delete this;
+        }
+        return count;
+    }
+
+    // IShellItemArray methods
+    HRESULT STDMETHODCALLTYPE GetCount(DWORD *pdwNumItems) {
+        *pdwNumItems = static_cast<DWORD>(items.size());
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetItemAt(DWORD dwIndex, IShellItem **ppsi) {
+        if (dwIndex >= items.size()) {
+            *ppsi = nullptr;
+            return E_INVALIDARG;
+        }
+        *ppsi = items[dwIndex];
+        (*ppsi)->AddRef();
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE EnumItems(IEnumShellItems **ppenumShellItems);
+
+protected:
+    virtual ~ShellItemArray() {
+        for (IShellItem* pItem : items) {
+            pItem->Release();
+        }
+    }
+
+private:
+    LONG refCount;
+    std::vector<IShellItem*> items;
+};
+
+class EnumShellItems : public IEnumShellItems {
+public:
+    EnumShellItems(IShellItemArray* pArray, DWORD cursor) : refCount(1), pArray(pArray), cursor(cursor), count(0) {
+        pArray->AddRef();
+        pArray->GetCount(&count);
+    }
+
+    // IUnknown methods
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppv) {
+        return QueryInterfaceTable<EnumShellItems, IEnumShellItems>::query(this, riid, ppv);
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() {
+        return InterlockedIncrement(&refCount);
+    }
+
+    ULONG STDMETHODCALLTYPE Release() {
+        ULONG count = InterlockedDecrement(&refCount);
+        if (count == 0) {
+            delete this;
+        }
+        return count;
+    }
+
+    // IEnumShellItems methods
+    HRESULT STDMETHODCALLTYPE Next(ULONG celt, IShellItem **rgelt, ULONG *pceltFetched) {
+        if (!pceltFetched && celt != 1) {
+            return E_INVALIDARG;
+        }
+        ULONG fetched = 0;
+        while (fetched < celt && cursor < count) {
+            pArray->GetItemAt(cursor++, &rgelt[fetched++]);
+        }
+        if (pceltFetched) {
+            *pceltFetched = fetched;
+        }
+        return (fetched == celt) ? S_OK : S_FALSE;
+    }
+
+    HRESULT STDMETHODCALLTYPE Skip(ULONG celt) {
+        DWORD remaining = count - cursor;
+        cursor += (celt < remaining) ? celt : remaining;
+        return (celt <= remaining) ? S_OK : S_FALSE;
+    }
+
+    HRESULT STDMETHODCALLTYPE Reset() {
+        cursor = 0;
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE Clone(IEnumShellItems **ppenum) {
+        *ppenum = new EnumShellItems(pArray, cursor);
+        return S_OK;
+    }
+
+protected:
+    virtual ~EnumShellItems() {
+        pArray->Release();
+    }
+
+private:
+    LONG refCount;
+    IShellItemArray* pArray;
+    DWORD cursor;
+    DWORD count;
+};
+
+HRESULT STDMETHODCALLTYPE ShellItemArray::EnumItems(IEnumShellItems **ppenumShellItems) {
+    *ppenumShellItems = new EnumShellItems(this, 0);
+    return S_OK;
+}
+
+HRESULT createShellItemArray(std::vector<IShellItem*> items, IShellItemArray** ppsia) {
+    if (!ppsia) {
+        return E_POINTER;
+    }
+    *ppsia = new ShellItemArray(std::move(items));
+    return S_OK;
+}
@@ -0,0 +1,11 @@
+#ifndef SHELL_ITEM_ARRAY_H
+#define SHELL_ITEM_ARRAY_H
+
+#include <vector>
+#include "IFileDialog.h"
+
+// IShellItemArray over already-created items. Takes over one reference per item; the array and
+// its enumerators AddRef the items they hand out.
+HRESULT createShellItemArray(std::vector<IShellItem*> items, IShellItemArray** ppsia);
+
+#endif // SHELL_ITEM_ARRAY_H
@@ -0,0 +1,108 @@
+#include "ShellItemDisplayNames.h"
+#include <atomic>
+
+static std::atomic<bool> nameBorrowing(true);
+
+void setShellItemNameBorrowing(bool enabled) {
+    nameBorrowing.store(enabled, std::memory_order_relaxed);
+}
+
+bool shellItemNameBorrowingEnabled() {
+    return nameBorrowing.load(std::memory_order_relaxed);
+}
+
+ShellItemNameForm shellItemNameForm(int sigdnName) {
+    switch (sigdnName) {
+        case SIGDN_FILESYSPATH:
+        case SIGDN_DESKTOPABSOLUTEPARSING:
+        case SIGDN_DESKTOPABSOLUTEEDITING:
+            return ShellItemNamePath;
+        case SIGDN_NORMALDISPLAY:
+        case SIGDN_PARENTRELATIVEPARSING:
+        case SIGDN_PARENTRELATIVEEDITING:
+        case SIGDN_PARENTRELATIVE:
+        case SIGDN_PARENTRELATIVEFORUI:
+        case SIGDN_PARENTRELATIVEFORADDRESSBAR:
+            return ShellItemNameLeaf;
+        default:
+            return ShellItemNameUnsupported;
+    }
+}
+
+ShellItemNameReader::~ShellItemNameReader() {
+    reset(nullptr);
+    if (pLender) {
+        pLender->Release();
+    }
+}
+
+void ShellItemNameReader::freeOwned() {
+    if (pszOwned) {
+        pFree(pszOwned);
+        pszOwned = nullptr;
+    }
+}
+
+void ShellItemNameReader::reset(IShellItem* pItem) {
+    freeOwned();
+    if (pItemNames) {
+        pItemNames->Release();
+        pItemNames = nullptr;
+    }
+    this->pItem = pItem;
+    borrowing = pItem && nameBorrowing.load(std::memory_order_relaxed);
+}
+
+HRESULT ShellItemNameReader::borrow(int sigdnName, LPCWSTR* ppszName, size_t* pcchName) {
+    if (pLender) {
+        HRESULT hr = pLender->BorrowItemDisplayName(pItem, sigdnName, ppszName, pcchName);
+        if (hr != E_NOINTERFACE) {
+            return hr;
+        }
+    }
+    if (pItemNames) {
+        return pItemNames->BorrowDisplayName(sigdnName, ppszName, pcchName);
+    }
+    IShellItemDisplayNames* pNames = nullptr;
+    if (FAILED(pItem->QueryInterface(IID_IShellItemDisplayNames, reinterpret_cast<void**>(&pNames)))) {
+        return E_NOINTERFACE;
+    }
+    HRESULT hr = pNames->BorrowItemDisplayName(pItem, sigdnName, ppszName, pcchName);
+    if (hr != E_NOINTERFACE) {
+        // A new class: it lends for the items that follow
+        if (pLender) {
+            pLender->Release();
+        }
+        pLender = pNames;
+        return hr;
+    }
+    // pItem forwards to another object (a wrapper), which can lend for this item only
+    pItemNames = pNames;
+    return pItemNames->BorrowDisplayName(sigdnName, ppszName, pcchName);
+}
+
+HRESULT ShellItemNameReader::read(int sigdnName, std::wstring_view& name) {
+    freeOwned();
+    if (!pItem) {
+        return E_POINTER;
+    }
+    if (borrowing) {
+        LPCWSTR pszName = nullptr;
+        size_t length = 0;
+        HRESULT hr = borrow(sigdnName, &pszName, &length);
+        if (hr != E_NOINTERFACE) {
+            if (SUCCEEDED(hr)) {
+                name = std::wstring_view(pszName, length);
+            }
+            return hr;
+        }
+        borrowing = false;
+    }
+    HRESULT hr = pItem->GetDisplayName(sigdnName, &pszOwned);
+    if (FAILED(hr)) {
+        pszOwned = nullptr;
+        return hr;
+    }
+    name = std::wstring_view(pszOwned);
+    return hr;
+}
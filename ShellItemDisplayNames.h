@@ -0,0 +1,79 @@
+#ifndef SHELL_ITEM_DISPLAY_NAMES_H
+#define SHELL_ITEM_DISPLAY_NAMES_H
+
+#include <string_view>
+#include "IFileDialog.h"
+
+// The two strings every SIGDN an in-process item supports comes down to
+enum ShellItemNameForm {
+    ShellItemNameUnsupported,
+    ShellItemNamePath,  // SIGDN_FILESYSPATH, SIGDN_DESKTOPABSOLUTEPARSING/EDITING
+    ShellItemNameLeaf,  // SIGDN_NORMALDISPLAY and the SIGDN_PARENTRELATIVE forms
+};
+
+ShellItemNameForm shellItemNameForm(int sigdnName);
+
+// Lets result handling read an item's display names in place instead of through GetDisplayName's
+// CoTaskMemAlloc'd copies. Each form is computed at most once per item; the borrowed characters
+// stay valid for the lifetime of the item and are not necessarily null-terminated.
+// BorrowItemDisplayName lends pItem's names instead when pItem is an item of the same class, and
+// fails with E_NOINTERFACE for anything else, so one interface pointer serves a whole array
+// without a QueryInterface (and its AddRef and Release) per item.
+#define DEFINE_IShellItemDisplayNames_METHODS \
+    virtual HRESULT STDMETHODCALLTYPE BorrowDisplayName(int sigdnName, LPCWSTR *ppszName, size_t *pcchName) = 0; \
+    virtual HRESULT STDMETHODCALLTYPE BorrowItemDisplayName(IShellItem *pItem, int sigdnName, LPCWSTR *ppszName, size_t *pcchName) = 0;
+
+interface IShellItemDisplayNames;  // Forward declaration of the interface
+static constexpr IID IID_IShellItemDisplayNames = guidFromString("EF001E92-27A3-439D-8F88-FB1F76A653C0");
+COM_INTERFACE_ID(IShellItemDisplayNames, IID_IShellItemDisplayNames)
+typedef interface IShellItemDisplayNames IShellItemDisplayNames;
+DEFINE_INTERFACE(IShellItemDisplayNames, IUnknown, DEFINE_IShellItemDisplayNames_METHODS)
+
+// pItem as a Class when it is an object of the same class as self, else nullptr, for
+// BorrowItemDisplayName. An interface pointer's first word is its vtable, which every object of one
+// class shares and no other class has, so a wrapper forwarding QueryInterface to a Class is never
+// taken for one.
+template <typename Class>
+Class* sameClassShellItem(Class* self, IShellItem* pItem) {
+    IShellItem* pOwn = self;
+    if (pItem && *reinterpret_cast<void* const*>(pItem) == *reinterpret_cast<void* const*>(pOwn)) {
+        return static_cast<Class*>(pItem);
+    }
+    return nullptr;
+}
+
+// Turns borrowing in ShellItemNameReader on or off (on by default); off, every name is read
+// through GetDisplayName as before
+void setShellItemNameBorrowing(bool enabled);
+bool shellItemNameBorrowingEnabled();
+
+// Reads one item's display names: borrowed through IShellItemDisplayNames when the item has it,
+// else copied by GetDisplayName and freed with pFree on the next read. A name stays valid until
+// the next read or reset. The first item of a class to lend is queried once and kept (with its
+// reference) until destruction; later items of that class borrow through it, with no reference
+// counting of their own.
+class ShellItemNameReader {
+public:
+    explicit ShellItemNameReader(PFN_CoTaskMemFree pFree)
+        : pFree(pFree), pItem(nullptr), pLender(nullptr), pItemNames(nullptr), borrowing(false), pszOwned(nullptr) {}
+    ~ShellItemNameReader();
+    ShellItemNameReader(const ShellItemNameReader&) = delete;
+    ShellItemNameReader& operator=(const ShellItemNameReader&) = delete;
+
+    // Reads from pItem from now on (borrowed, so pItem must outlive the reads)
+    void reset(IShellItem* pItem);
+    HRESULT read(int sigdnName, std::wstring_view& name);
+
+private:
+    void freeOwned();
+    HRESULT borrow(int sigdnName, LPCWSTR* ppszName, size_t* pcchName);
+
+    PFN_CoTaskMemFree pFree;
+    IShellItem* pItem;
+    IShellItemDisplayNames* pLender;     // Lends for every item of its class
+    IShellItemDisplayNames* pItemNames;  // pItem's own, when pLender cannot lend for it
+    bool borrowing;                      // False once pItem turned out not to lend
+    LPWSTR pszOwned;
+};
+
+#endif // SHELL_ITEM_DISPLAY_NAMES_H
@@ -0,0 +1,103 @@
+#include "ShellItemExtractor.h"
+#include "ComPtr.h"
+#include "ShellItemDisplayNames.h"
+
+// Fill one record from an item. Every property is requested exactly once; names are borrowed
+// from items that lend them, so only the record's own strings are allocated.
+static void fillShellItemRecord(ShellItemNameReader& reader, ComBorrow<IShellItem> item, ShellItemRecord& record) {
+    record.attributes = 0;
+    record.hr = S_OK;
+
+    reader.reset(item.get());
+    std::wstring_view name;
+    HRESULT hr = reader.read(SIGDN_FILESYSPATH, name);
+    if (SUCCEEDED(hr)) {
+        record.path.assign(name);
+    } else {
+        record.hr = hr;
+    }
+
+    hr = reader.read(SIGDN_NORMALDISPLAY, name);
+    if (SUCCEEDED(hr)) {
+        record.displayName.assign(name);
+    } else if (SUCCEEDED(record.hr)) {
+        record.hr = hr;
+    }
+
+    hr = item->GetAttributes(SFGAO_FILESYSTEM | SFGAO_FOLDER, &record.attributes);
+    if (FAILED(hr) && SUCCEEDED(record.hr)) {
+        record.hr = hr;
+    }
+
+    ComPtr<IShellItem> parent;
+    hr = item->GetParent(parent.put());
+    if (SUCCEEDED(hr) && parent) {
+        reader.reset(parent.get());
+        if (SUCCEEDED(reader.read(SIGDN_NORMALDISPLAY, name))) {
+            record.parent.assign(name);
+        }
+    }
+    reader.reset(nullptr);
+}
+
+HRESULT extractShellItemRecords(COMFunctionPointers& comFuncs, IShellItemArray* pItemArray, std::vector<ShellItemRecord>& records, ULONG batchSize) {
+    if (!pItemArray) {
+        return E_POINTER;
+    }
+    if (batchSize == 0) {
+        batchSize = 1;
+    }
+
+    DWORD itemCount = 0;
+    HRESULT hr = pItemArray->GetCount(&itemCount);
+    if (FAILED(hr)) {
+        return hr;
+    }
+    records.reserve(records.size() + itemCount);
+    ShellItemNameReader reader(comFuncs.pCoTaskMemFree);
+
+    ComPtr<IEnumShellItems> enumShellItems;
+    hr = pItemArray->EnumItems(enumShellItems.put());
+    if (SUCCEEDED(hr) && enumShellItems) {
+        std::vector<IShellItem*> batch(batchSize, nullptr);
+        std::vector<ComPtr<IShellItem>> owned;
+        owned.reserve(batchSize);
+        while (true) {
+            ULONG fetched = 0;
+            hr = enumShellItems->Next(batchSize, batch.data(), &fetched);
+            if (FAILED(hr)) {
+                break;
+            }
+            // Owned from here on, so a throwing record fill leaks none of the batch
+            for (ULONG i = 0; i < fetched; ++i) {
+                owned.push_back(ComPtr<IShellItem>::attach(batch[i]));
+                batch[i] = nullptr;
+            }
+            for (ComPtr<IShellItem>& item : owned) {
+                records.emplace_back();
+                fillShellItemRecord(reader, item, records.back());
+                item = nullptr;
+            }
+            owned.clear();
+            // S_FALSE means the enumerator ran dry inside this batch
+            if (hr != S_OK || fetched < batchSize) {
+                break;
+            }
+        }
+        return FAILED(hr) ? hr : S_OK;
+    }
+
+    // No enumerator, index the array directly
+    for (DWORD i = 0; i < itemCount; ++i) {
+        ComPtr<IShellItem> item;
+        hr = pItemArray->GetItemAt(i, item.put());
+        records.emplace_back();
+        if (FAILED(hr) || !item) {
+            records.back().attributes = 0;
+            records.back().hr = FAILED(hr) ? hr : E_POINTER;
+            continue;
+        }
+        fillShellItemRecord(reader, item, records.back());
+    }
+    return S_OK;
+}
@@ -0,0 +1,24 @@
+#ifndef SHELL_ITEM_EXTRACTOR_H
+#define SHELL_ITEM_EXTRACTOR_H
+
+#include <vector>
+#include <string>
+#include "IFileDialog.h"
+
+// Flat per-item result, filled in a single pass over the selection
+struct ShellItemRecord {
+    std::wstring path;         // SIGDN_FILESYSPATH
+    std::wstring displayName;  // SIGDN_NORMALDISPLAY
+    SFGAOF attributes;         // SFGAO_FILESYSTEM | SFGAO_FOLDER
+    std::wstring parent;       // SIGDN_NORMALDISPLAY of the parent item
+    HRESULT hr;                // First failure while filling this record, S_OK otherwise
+};
+
+// Number of items requested from IEnumShellItems::Next per call
+const ULONG kShellItemBatchSize = 256;
+
+// Walks pItemArray once, fetching items in batches of batchSize, and appends one record per item.
+// Falls back to GetItemAt when the array cannot be enumerated.
+HRESULT extractShellItemRecords(COMFunctionPointers& comFuncs, IShellItemArray* pItemArray, std::vector<ShellItemRecord>& records, ULONG batchSize = kShellItemBatchSize);
+
+#endif // SHELL_ITEM_EXTRACTOR_H
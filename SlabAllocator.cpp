@@ -0,0 +1,240 @@
+#include "SlabAllocator.h"
+#include <stdexcept>
+
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/asan_interface.h>
+// A free block is poisoned but for its link, so ASan still catches a use after Release
+#define SLAB_POISON(block, bytes) __asan_poison_memory_region(reinterpret_cast<char*>(block) + sizeof(SlabFreeBlock), (bytes) - sizeof(SlabFreeBlock))
+#define SLAB_UNPOISON(block, bytes) __asan_unpoison_memory_region(block, bytes)
+#else
+#define SLAB_POISON(block, bytes) ((void)0)
+#define SLAB_UNPOISON(block, bytes) ((void)0)
+#endif
+
+static const size_t kMaxAllocators = 16;
+static const unsigned kSlabShift = 20;
+static_assert((size_t(1) << kSlabShift) == SlabAllocator::kSlabBytes, "kSlabShift must match kSlabBytes");
+
+// Which 1 MiB slabs belong to an allocator, as a two-level map over the user address space (the
+// layout tcmalloc's page map uses): deallocate asks it whether a pointer is a block or came from
+// ::operator new. Entries are only ever set, so readers need no lock.
+static const unsigned kAddressBits = sizeof(void*) == 8 ? 48 : 32;
+static const unsigned kIndexBits = kAddressBits - kSlabShift;
+static const unsigned kLeafBits = kIndexBits / 2;
+static const unsigned kRootBits = kIndexBits - kLeafBits;
+
+struct SlabMapLeaf {
+    std::atomic<uint8_t> owned[size_t(1) << kLeafBits];
+};
+
+static std::atomic<SlabMapLeaf*> slabMap[size_t(1) << kRootBits];
+static std::mutex slabMapMutex;
+
+// Whether the slab map can describe address (not above 2^48 with five-level paging)
+static bool inSlabMap(uintptr_t address) {
+    return (static_cast<uint64_t>(address) >> kAddressBits) == 0;
+}
+
+static bool registerSlab(const void* slab) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(slab);
+    if (!inSlabMap(address)) {
+        return false;
+    }
+    size_t index = address >> kSlabShift;
+    std::atomic<SlabMapLeaf*>& root = slabMap[index >> kLeafBits];
+    std::lock_guard<std::mutex> lock(slabMapMutex);
+    SlabMapLeaf* leaf = root.load(std::memory_order_relaxed);
+    if (!leaf) {
+        leaf = new SlabMapLeaf();
+        root.store(leaf, std::memory_order_release);
+    }
+    leaf->owned[index & ((size_t(1) << kLeafBits) - 1)].store(1, std::memory_order_release);
+    return true;
+}
+
+bool SlabAllocator::ownsBlock(const void* p) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(p);
+    if (!inSlabMap(address)) {
+        return false;
+    }
+    size_t index = address >> kSlabShift;
+    SlabMapLeaf* leaf = slabMap[index >> kLeafBits].load(std::memory_order_acquire);
+    return leaf && leaf->owned[index & ((size_t(1) << kLeafBits) - 1)].load(std::memory_order_acquire) != 0;
+}
+
+static std::atomic<bool> slabAllocation(true);
+
+void setSlabAllocation(bool enabled) {
+    slabAllocation.store(enabled, std::memory_order_relaxed);
+}
+
+bool slabAllocationEnabled() {
+    return slabAllocation.load(std::memory_order_relaxed);
+}
+
+// Free blocks are linked through their own first word
+struct SlabFreeBlock {
+    SlabFreeBlock* next;
+};
+
+struct SlabThreadCache {
+    SlabFreeBlock* head;
+    size_t count;
+};
+
+static SlabAllocator* allocators[kMaxAllocators];
+static std::atomic<size_t> allocatorCount(0);
+
+// Trivially destructible, so still usable while the flush below runs at thread exit
+static thread_local SlabThreadCache threadCaches[kMaxAllocators];
+static thread_local bool threadCachesClosed = false;
+
+// Constructed on a thread's first refill; hands the thread's cached blocks back when it exits
+struct SlabThreadCacheFlush {
+    bool armed = false;
+
+    ~SlabThreadCacheFlush() {
+        threadCachesClosed = true;
+        size_t count = allocatorCount.load();
+        for (size_t i = 0; i < count && i < kMaxAllocators; ++i) {
+            if (allocators[i]) {
+                allocators[i]->drain(threadCaches[i], 0);
+            }
+        }
+    }
+};
+static thread_local SlabThreadCacheFlush threadCacheFlush;
+
+SlabAllocator::SlabAllocator(size_t blockSize, size_t blockAlign)
+    : id(allocatorCount.fetch_add(1)), slabs(0), sharedFree(nullptr), carve(nullptr), carveEnd(nullptr) {
+    if (id >= kMaxAllocators) {
+        throw std::length_error("SlabAllocator: too many allocators");
+    }
+    size_t align = blockAlign < alignof(SlabFreeBlock) ? alignof(SlabFreeBlock) : blockAlign;
+    size_t size = blockSize < sizeof(SlabFreeBlock) ? sizeof(SlabFreeBlock) : blockSize;
+    blockBytes = (size + align - 1) / align * align;
+    allocators[id] = this;
+}
+
+SlabThreadCache* SlabAllocator::threadCache() {
+    return threadCachesClosed ? nullptr : &threadCaches[id];
+}
+
+void* SlabAllocator::allocate(size_t size) {
+    if (size > blockBytes || !slabAllocation.load(std::memory_order_relaxed)) {
+        return ::operator new(size);
+    }
+    SlabThreadCache* cache = threadCache();
+    if (!cache) {
+        std::lock_guard<std::mutex> lock(mutex);
+        SlabFreeBlock* block = sharedFree;
+        size_t carved = 0;
+        if (block) {
+            sharedFree = block->next;
+        } else {
+            block = carveBlocks(1, nullptr, carved);
+        }
+        if (!block) {
+            return ::operator new(size);
+        }
+        SLAB_UNPOISON(block, blockBytes);
+        return block;
+    }
+    if (!cache->head) {
+        refill(*cache);
+        if (!cache->head) {
+            return ::operator new(size);
+        }
+    }
+    SlabFreeBlock* block = cache->head;
+    cache->head = block->next;
+    --cache->count;
+    SLAB_UNPOISON(block, blockBytes);
+    return block;
+}
+
+void SlabAllocator::deallocate(void* p) {
+    if (!p) {
+        return;
+    }
+    if (!ownsBlock(p)) {
+        ::operator delete(p);
+        return;
+    }
+    SlabFreeBlock* block = static_cast<SlabFreeBlock*>(p);
+    SLAB_POISON(block, blockBytes);
+    SlabThreadCache* cache = threadCache();
+    if (!cache) {
+        std::lock_guard<std::mutex> lock(mutex);
+        block->next = sharedFree;
+        sharedFree = block;
+        return;
+    }
+    block->next = cache->head;
+    cache->head = block;
+    if (++cache->count > kCacheLimit) {
+        drain(*cache, kCacheLimit - kBatch);
+    }
+}
+
+// A batch from the shared list, topped up from the current slab or a new one
+void SlabAllocator::refill(SlabThreadCache& cache) {
+    threadCacheFlush.armed = true;
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t taken = 0;
+    while (sharedFree && taken < kBatch) {
+        SlabFreeBlock* block = sharedFree;
+        sharedFree = block->next;
+        block->next = cache.head;
+        cache.head = block;
+        ++taken;
+    }
+    if (taken < kBatch) {
+        size_t carved = 0;
+        cache.head = carveBlocks(kBatch - taken, cache.head, carved);
+        taken += carved;
+    }
+    cache.count += taken;
+}
+
+// Pushes up to count fresh blocks in front of head; returns the new head
+SlabFreeBlock* SlabAllocator::carveBlocks(size_t count, SlabFreeBlock* head, size_t& carved) {
+    for (carved = 0; carved < count; ++carved) {
+        if (carve == carveEnd) {
+            void* slab = ::operator new(kSlabBytes, std::align_val_t(kSlabBytes), std::nothrow);
+            if (!slab) {
+                break;
+            }
+            if (!registerSlab(slab)) {
+                ::operator delete(slab, std::align_val_t(kSlabBytes));
+                break;
+            }
+            slabs.fetch_add(1, std::memory_order_relaxed);
+            carve = static_cast<char*>(slab);
+            carveEnd = carve + kSlabBytes / blockBytes * blockBytes;
+        }
+        SlabFreeBlock* block = reinterpret_cast<SlabFreeBlock*>(carve);
+        carve += blockBytes;
+        block->next = head;
+        SLAB_POISON(block, blockBytes);
+        head = block;
+    }
+    return head;
+}
+
+// Hands all but keep of the cached blocks to the shared list
+void SlabAllocator::drain(SlabThreadCache& cache, size_t keep) {
+    if (cache.count <= keep) {
+        return;
+    }
+    SlabFreeBlock* first = cache.head;
+    SlabFreeBlock* last = first;
+    for (size_t i = 1; i < cache.count - keep; ++i) {
+        last = last->next;
+    }
+    cache.head = last->next;
+    cache.count = keep;
+    std::lock_guard<std::mutex> lock(mutex);
+    last->next = sharedFree;
+    sharedFree = first;
+}
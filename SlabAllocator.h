@@ -0,0 +1,86 @@
+#ifndef SLAB_ALLOCATOR_H
+#define SLAB_ALLOCATOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+struct SlabFreeBlock;
+struct SlabThreadCache;
+
+// Fixed-size blocks carved from 1 MiB slabs, for the small same-layout COM objects result handling
+// creates by the million (shell items from GetItemAt, GetParent and Next).
+//
+// Each thread keeps a cache of free blocks per allocator: an intrusive list threaded through the
+// blocks themselves, so allocate and deallocate are a pointer pop/push with no lock. A cache that
+// runs dry takes a batch from the shared free list (or carves a new slab); one that grows past
+// kCacheLimit hands a batch back, so a block freed on another thread is reused there. Slabs are
+// never returned; the allocator keeps the high-water mark of what its objects needed.
+class SlabAllocator {
+public:
+    static const size_t kSlabBytes = size_t(1) << 20;
+    static const size_t kBatch = 64;
+    static const size_t kCacheLimit = 4 * kBatch;
+
+    // Allocators live for the rest of the process (blocks may be freed during static destruction)
+    SlabAllocator(size_t blockSize, size_t blockAlign);
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+    // A block, or ::operator new when slab allocation is off or size does not fit a block
+    void* allocate(size_t size);
+    // Either kind of pointer allocate returned
+    void deallocate(void* p);
+
+    size_t blockSize() const { return blockBytes; }
+    size_t slabCount() const { return slabs.load(std::memory_order_relaxed); }
+
+    // Whether p lies in a slab of any allocator
+    static bool ownsBlock(const void* p);
+
+private:
+    friend struct SlabThreadCacheFlush;
+
+    // nullptr once the calling thread's caches were flushed at its exit
+    SlabThreadCache* threadCache();
+    void refill(SlabThreadCache& cache);
+    void drain(SlabThreadCache& cache, size_t keep);
+    SlabFreeBlock* carveBlocks(size_t count, SlabFreeBlock* head, size_t& carved);  // mutex held
+
+    size_t id;
+    size_t blockBytes;
+    std::atomic<size_t> slabs;
+
+    std::mutex mutex;  // Guards what follows
+    SlabFreeBlock* sharedFree;
+    char* carve;       // Next uncarved block of the newest slab
+    char* carveEnd;
+};
+
+// Turns slab allocation on or off for every SlabAllocated class (on by default). Objects keep
+// whichever memory they were created in; deallocate tells the two apart.
+void setSlabAllocation(bool enabled);
+bool slabAllocationEnabled();
+
+// Class-specific operator new/delete from one SlabAllocator per T. Derive the object class from
+// it; a Release that deletes the object then recycles its block.
+template <typename T>
+class SlabAllocated {
+public:
+    static void* operator new(size_t size) {
+        return allocator().allocate(size);
+    }
+
+    static void operator delete(void* p) noexcept {
+        allocator().deallocate(p);
+    }
+
+    static SlabAllocator& allocator() {
+        static SlabAllocator* instance = new SlabAllocator(sizeof(T), alignof(T));
+        return *instance;
+    }
+};
+
+#endif // SLAB_ALLOCATOR_H
@@ -0,0 +1,315 @@
+#include "SnapshotShellItemArray.h"
+#include "QueryInterfaceTable.h"
+#include "SlabAllocator.h"
+#include "ProjWinUtils.h"
+#include "CollationKey.h"
+#include "ShellItemDisplayNames.h"
+#include <string>
+
+std::wstring ShellItemSnapshot::path(size_t index) const {
+    std::wstring result;
+    appendPath(index, result);
+    return result;
+}
+
+void ShellItemSnapshot::appendPath(size_t index, std::wstring& out) const {
+    std::wstring_view parent = folder(index);
+    std::wstring_view name = names[index];
+    out.append(parent.data(), parent.size());
+    out.append(name.data(), name.size());
+}
+
+static void copyPathTable(const PathTable& from, PathTable& to) {
+    to.reserve(from.size(), from.payloadChars());
+    for (size_t i = 0; i < from.size(); ++i) {
+        to.append(from[i]);
+    }
+}
+
+ShellItemSnapshot& writableSnapshot(std::shared_ptr<ShellItemSnapshot>& snapshot) {
+    if (!snapshot) {
+        snapshot = std::make_shared<ShellItemSnapshot>();
+    } else if (snapshot.use_count() > 1) {
+        std::shared_ptr<ShellItemSnapshot> copy = std::make_shared<ShellItemSnapshot>();
+        copyPathTable(snapshot->folders, copy->folders);
+        copyPathTable(snapshot->names, copy->names);
+        copy->folderIndex = snapshot->folderIndex;
+        copy->attributes = snapshot->attributes;
+        snapshot = std::move(copy);
+    }
+    return *snapshot;
+}
+
+HRESULT appendToSnapshot(ShellItemSnapshot& snapshot, IShellItem* const* items, size_t count, SFGAOF attributeMask) {
+    ShellItemNameReader reader(taskMemFree);
+    for (size_t i = 0; i < count; ++i) {
+        reader.reset(items[i]);
+        std::wstring_view path;
+        HRESULT hr = reader.read(SIGDN_FILESYSPATH, path);
+        if (FAILED(hr)) {
+            return hr;
+        }
+        SFGAOF attributes = 0;
+        items[i]->GetAttributes(attributeMask, &attributes);
+
+        size_t split = path.find_last_of(L"/\\");
+        split = (split == std::wstring_view::npos) ? 0 : split + 1;
+        std::wstring_view parent = path.substr(0, split);
+        if (snapshot.folders.empty() || snapshot.folders[snapshot.folders.size() - 1] != parent) {
+            snapshot.folders.append(parent);
+        }
+        snapshot.names.append(path.substr(split));
+        snapshot.folderIndex.push_back(static_cast<uint32_t>(snapshot.folders.size() - 1));
+        snapshot.attributes.push_back(attributes);
+    }
+    return S_OK;
+}
+
+// Item for one snapshot entry: the snapshot reference, the index and the entry's path
+class SnapshotShellItem : public IShellItem, public IShellItemCollation, public IShellItemDisplayNames, public SlabAllocated<SnapshotShellItem> {
+public:
+    SnapshotShellItem(std::shared_ptr<const ShellItemSnapshot> snapshot, size_t index, PFN_SHCreateItemFromParsingName pParse)
+        : refCount(1), snapshot(std::move(snapshot)), index(index), pParse(pParse), path(this->snapshot->path(index)) {
+        key.assign(path.c_str(), path.size(), this->snapshot->folder(index).size());
+    }
+
+    // IUnknown methods
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppv) {
+        return QueryInterfaceTable<SnapshotShellItem, IShellItem, IShellItemCollation, IShellItemDisplayNames>::query(this, riid, ppv);
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() {
+        return InterlockedIncrement(&refCount);
+    }
+
+    ULONG STDMETHODCALLTYPE Release() {
+        ULONG count = InterlockedDecrement(&refCount);
+        if (count == 0) {
+            delete this;
+        }
+        return count;
+    }
+
+    // IShellItem methods
+    HRESULT STDMETHODCALLTYPE BindToHandler(IUnknown *pbc, REFGUID bhid, REFIID riid, void **ppv) {
+        *ppv = nullptr;
+        IShellItem* pItem = nullptr;
+        HRESULT hr = pParse ? pParse(path.c_str(), NULL, IID_IShellItem, reinterpret_cast<void**>(&pItem)) : E_NOTIMPL;
+        if (FAILED(hr)) {
+            return hr;
+        }
+        hr = pItem->BindToHandler(pbc, bhid, riid, ppv);
+        pItem->Release();
+        return hr;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetParent(IShellItem **ppsi) {
+        *ppsi = nullptr;
+        std::wstring_view parent = snapshot->folder(index);
+        if (!pParse || parent.size() <= 1) {
+            return E_FAIL;
+        }
+        std::wstring path(parent.substr(0, parent.size() - 1));
+        return pParse(path.c_str(), NULL, IID_IShellItem, reinterpret_cast<void**>(ppsi));
+    }
+
+    HRESULT STDMETHODCALLTYPE GetDisplayName(int sigdnName, LPWSTR *ppszName) {
+        LPCWSTR pszName = nullptr;
+        size_t length = 0;
+        if (FAILED(BorrowDisplayName(sigdnName, &pszName, &length))) {
+            *ppszName = nullptr;
+            return E_INVALIDARG;
+        }
+        *ppszName = coTaskMemDup(pszName, length);
+        return *ppszName ? S_OK : E_OUTOFMEMORY;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetAttributes(ULONG sfgaoMask, ULONG *psfgaoAttribs) {
+        *psfgaoAttribs = snapshot->attributes[index] & sfgaoMask;
+        return (*psfgaoAttribs == sfgaoMask) ? S_OK : S_FALSE;
+    }
+
+    HRESULT STDMETHODCALLTYPE Compare(IShellItem *psi, DWORD hint, int *piOrder) {
+        return compareWithCollationKey(key, psi, hint, piOrder);
+    }
+
+    // IShellItemCollation methods
+    HRESULT STDMETHODCALLTYPE GetCollationKey(const CollationKey **ppKey) {
+        *ppKey = &key;
+        return S_OK;
+    }
+
+    // IShellItemDisplayNames methods
+    HRESULT STDMETHODCALLTYPE BorrowDisplayName(int sigdnName, LPCWSTR *ppszName, size_t *pcchName) {
+        switch (shellItemNameForm(sigdnName)) {
+            case ShellItemNamePath:
+                *ppszName = path.c_str();
+                *pcchName = path.size();
+                return S_OK;
+            case ShellItemNameLeaf: {
+                std::wstring_view name = snapshot->names[index];
+                *ppszName = name.data();
+                *pcchName = name.size();
+                return S_OK;
+            }
+            default:
+                *ppszName = nullptr;
+                *pcchName = 0;
+                return E_INVALIDARG;
+        }
+    }
+
+    HRESULT STDMETHODCALLTYPE BorrowItemDisplayName(IShellItem *pItem, int sigdnName, LPCWSTR *ppszName, size_t *pcchName) {
+        SnapshotShellItem* pOther = sameClassShellItem(this, pItem);
+        if (!pOther) {
+            *ppszName = nullptr;
+            *pcchName = 0;
+            return E_NOINTERFACE;
+        }
+        return pOther->BorrowDisplayName(sigdnName, ppszName, pcchName);
+    }
+
+protected:
+    virtual ~SnapshotShellItem() = default;
+
+private:
+    LONG refCount;
+    std::shared_ptr<const ShellItemSnapshot> snapshot;
+    size_t index;
+    PFN_SHCreateItemFromParsingName pParse;
+    std::wstring path;  // The key is built from it anyway, so it is kept for the path forms
+    CollationKey key;
+};
+
+class SnapshotEnumShellItems : public IEnumShellItems {
+public:
+    SnapshotEnumShellItems(std::shared_ptr<const ShellItemSnapshot> snapshot, size_t cursor, PFN_SHCreateItemFromParsingName pParse)
+        : refCount(1), snapshot(std::move(snapshot)), cursor(cursor), pParse(pParse) {}
+
+    // IUnknown methods
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppv) {
+        return QueryInterfaceTable<SnapshotEnumShellItems, IEnumShellItems>::query(this, riid, ppv);
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() {
+        return InterlockedIncrement(&refCount);
+    }
+
+    ULONG STDMETHODCALLTYPE Release() {
+        ULONG count = InterlockedDecrement(&refCount);
+        if (count == 0) {
+            delete this;
+        }
+        return count;
+    }
+
+    // IEnumShellItems methods
+    HRESULT STDMETHODCALLTYPE Next(ULONG celt, IShellItem **rgelt, ULONG *pceltFetched) {
+        if (!pceltFetched && celt != 1) {
+            return E_INVALIDARG;
+        }
+        ULONG fetched = 0;
+        size_t count = snapshot->size();
+        while (fetched < celt && cursor < count) {
+            rgelt[fetched++] = new SnapshotShellItem(snapshot, cursor++, pParse);
+        }
+        if (pceltFetched) {
+            *pceltFetched = fetched;
+        }
+        return (fetched == celt) ? S_OK : S_FALSE;
+    }
+
+    HRESULT STDMETHODCALLTYPE Skip(ULONG celt) {
+        size_t remaining = snapshot->size() - cursor;
+        cursor += (celt < remaining) ? celt : remaining;
+        return (celt <= remaining) ? S_OK : S_FALSE;
+    }
+
+    HRESULT STDMETHODCALLTYPE Reset() {
+        cursor = 0;
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE Clone(IEnumShellItems **ppenum) {
+        *ppenum = new SnapshotEnumShellItems(snapshot, cursor, pParse);
+        return S_OK;
+    }
+
+protected:
+    virtual ~SnapshotEnumShellItems() = default;
+
+private:
+    LONG refCount;
+    std::shared_ptr<const ShellItemSnapshot> snapshot;
+    size_t cursor;
+    PFN_SHCreateItemFromParsingName pParse;
+};
+
+class SnapshotShellItemArray : public IShellItemArray, public IShellItemSnapshotSource {
+public:
+    SnapshotShellItemArray(std::shared_ptr<const ShellItemSnapshot> snapshot, PFN_SHCreateItemFromParsingName pParse)
+        : refCount(1), snapshot(std::move(snapshot)), pParse(pParse) {}
+
+    // IUnknown methods
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppv) {
+        return QueryInterfaceTable<SnapshotShellItemArray, IShellItemArray, IShellItemSnapshotSource>::query(this, riid, ppv);
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() {
+        return InterlockedIncrement(&refCount);
+    }
+
+    ULONG STDMETHODCALLTYPE Release() {
+        ULONG count = InterlockedDecrement(&refCount);
+        if (count == 0) {
+            delete this;
+        }
+        return count;
+    }
+
+    // IShellItemArray methods
+    HRESULT STDMETHODCALLTYPE GetCount(DWORD *pdwNumItems) {
+        *pdwNumItems = static_cast<DWORD>(snapshot->size());
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetItemAt(DWORD dwIndex, IShellItem **ppsi) {
+        if (dwIndex >= snapshot->size()) {
+            *ppsi = nullptr;
+            return E_INVALIDARG;
+        }
+        *ppsi = new SnapshotShellItem(snapshot, dwIndex, pParse);
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE EnumItems(IEnumShellItems **ppenumShellItems) {
+        *ppenumShellItems = new SnapshotEnumShellItems(snapshot, 0, pParse);
+        return S_OK;
+    }
+
+    // IShellItemSnapshotSource methods
+    HRESULT STDMETHODCALLTYPE GetSnapshot(std::shared_ptr<const ShellItemSnapshot> *pSnapshot) {
+        *pSnapshot = snapshot;
+        return S_OK;
+    }
+
+protected:
+    virtual ~SnapshotShellItemArray() = default;
+
+private:
+    LONG refCount;
+    std::shared_ptr<const ShellItemSnapshot> snapshot;
+    PFN_SHCreateItemFromParsingName pParse;
+};
+
+HRESULT createSnapshotShellItemArray(std::shared_ptr<const ShellItemSnapshot> snapshot, PFN_SHCreateItemFromParsingName pParse, IShellItemArray** ppsia) {
+    if (!ppsia) {
+        return E_POINTER;
+    }
+    *ppsia = nullptr;
+    if (!snapshot) {
+        return E_INVALIDARG;
+    }
+    *ppsia = static_cast<IShellItemArray*>(new SnapshotShellItemArray(std::move(snapshot), pParse));
+    return S_OK;
+}
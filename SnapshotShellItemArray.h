@@ -0,0 +1,47 @@
+#ifndef SNAPSHOT_SHELL_ITEM_ARRAY_H
+#define SNAPSHOT_SHELL_ITEM_ARRAY_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "IFileDialog.h"
+
+// Paths and SFGAO attributes of a selection: everything GetCount, GetAttributes and path-only
+// consumers need. Each item keeps only its leaf name; parent folders are stored once per run of
+// consecutive items in the same folder, which for a dialog selection is usually the whole list.
+struct ShellItemSnapshot {
+    PathTable folders;                  // Parent folders, each with its trailing separator
+    PathTable names;                    // Leaf name of each item
+    std::vector<uint32_t> folderIndex;  // Per item, into folders
+    std::vector<SFGAOF> attributes;
+
+    size_t size() const { return names.size(); }
+    std::wstring_view folder(size_t index) const { return folders[folderIndex[index]]; }
+    std::wstring path(size_t index) const;
+    void appendPath(size_t index, std::wstring& out) const;
+};
+
+// Copy-on-write: clones the snapshot first if any array or enumerator still shares it
+ShellItemSnapshot& writableSnapshot(std::shared_ptr<ShellItemSnapshot>& snapshot);
+
+// Capture count items (one GetDisplayName(SIGDN_FILESYSPATH) and GetAttributes(attributeMask) each)
+HRESULT appendToSnapshot(ShellItemSnapshot& snapshot, IShellItem* const* items, size_t count, SFGAOF attributeMask = SFGAO_FILESYSTEM | SFGAO_FOLDER);
+
+// Lets consumers that only need paths read an array's snapshot instead of creating its items
+#define DEFINE_IShellItemSnapshotSource_METHODS \
+    virtual HRESULT STDMETHODCALLTYPE GetSnapshot(std::shared_ptr<const ShellItemSnapshot> *pSnapshot) = 0;
+
+interface IShellItemSnapshotSource;  // Forward declaration of the interface
+static constexpr IID IID_IShellItemSnapshotSource = guidFromString("3F6B2D8E-9C41-4E7A-B5D2-8A1C7E4F9B63");
+COM_INTERFACE_ID(IShellItemSnapshotSource, IID_IShellItemSnapshotSource)
+typedef interface IShellItemSnapshotSource IShellItemSnapshotSource;
+DEFINE_INTERFACE(IShellItemSnapshotSource, IUnknown, DEFINE_IShellItemSnapshotSource_METHODS)
+
+// IShellItemArray (and IShellItemSnapshotSource) over a shared snapshot. GetCount is O(1); GetItemAt
+// and the EnumItems enumerators, which share the same snapshot, build a small item per request.
+// Those items answer GetDisplayName/GetAttributes/Compare from the snapshot and parse their path
+// with pParse for GetParent and BindToHandler (which fail when pParse is null).
+HRESULT createSnapshotShellItemArray(std::shared_ptr<const ShellItemSnapshot> snapshot, PFN_SHCreateItemFromParsingName pParse, IShellItemArray** ppsia);
+
+#endif // SNAPSHOT_SHELL_ITEM_ARRAY_H
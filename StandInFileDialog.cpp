@@ -0,0 +1,668 @@
+#include "StandInFileDialog.h"
+#include "FilterSet.h"
+#include "EventSinkRegistry.h"
+#include "SnapshotShellItemArray.h"
+#include "QueryInterfaceTable.h"
+#include "ClassFactoryRegistry.h"
+#ifndef _WIN32
+#include "PosixShellItem.h"
+#include "ShellItemDisplayNames.h"
+#include "ProjUtil.h"
+#include <cerrno>
+#include <sys/stat.h>
+#endif // _WIN32
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <utility>
+
+#ifndef E_UNEXPECTED
+#define E_UNEXPECTED ((HRESULT)0x8000FFFFL)
+#endif
+
+// Swap a held interface pointer, keeping the reference counts balanced
+template <typename T>
+static void assignInterface(T*& target, T* value) {
+    if (value) {
+        value->AddRef();
+    }
+    if (target) {
+        target->Release();
+    }
+    target = value;
+}
+
+static std::atomic<size_t> dialogPoolCapacity(16);
+static std::atomic<bool> folderPrefetchEnabled(false);
+
+class StandInDialogPool;
+
+// What a dialog pool needs of the dialogs it keeps
+class PooledDialog {
+public:
+    // Leave the pool with one reference, which the last Release hands back to pool
+    virtual IFileDialog* reuse(StandInDialogPool* pool) = 0;
+    virtual void destroy() = 0;
+
+protected:
+    ~PooledDialog() {}
+};
+
+// Class object for one stand-in dialog class. A dialog whose last reference goes is reset to the
+// state a new one starts in and kept (up to the pool capacity) for the next CreateInstance, so
+// repeated sessions skip construction and teardown and reuse the capacity of its lists and strings.
+class StandInDialogPool : public IClassFactory {
+public:
+    typedef PooledDialog* (*Create)();
+
+    explicit StandInDialogPool(Create create) : refCount(1), create(create) {}
+
+    // IUnknown methods
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppv) {
+        return QueryInterfaceTable<StandInDialogPool, IClassFactory>::query(this, riid, ppv);
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() {
+        return InterlockedIncrement(&refCount);
+    }
+
+    ULONG STDMETHODCALLTYPE Release() {
+        ULONG count = InterlockedDecrement(&refCount);
+        if (count == 0) {
+            delete this;
+        }
+        return count;
+    }
+
+    // IClassFactory methods
+    HRESULT STDMETHODCALLTYPE CreateInstance(IUnknown *pUnkOuter, REFIID riid, void **ppvObject) {
+        if (!ppvObject) {
+            return E_POINTER;
+        }
+        *ppvObject = nullptr;
+        if (pUnkOuter) {
+            return CLASS_E_NOAGGREGATION;
+        }
+        PooledDialog* pDialog = take();
+        if (!pDialog) {
+            pDialog = create();
+        }
+        AddRef();  // Held by the dialog until it comes back
+        IFileDialog* pFileDialog = pDialog->reuse(this);
+        HRESULT hr = pFileDialog->QueryInterface(riid, ppvObject);
+        pFileDialog->Release();
+        return hr;
+    }
+
+    HRESULT STDMETHODCALLTYPE LockServer(BOOL fLock) {
+        return S_OK;
+    }
+
+    // Keeps an already reset dialog for reuse; false when the pool is full or disabled
+    bool recycle(PooledDialog* pDialog) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (idle.size() >= dialogPoolCapacity.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        idle.push_back(pDialog);
+        return true;
+    }
+
+protected:
+    virtual ~StandInDialogPool() {
+        for (PooledDialog* pDialog : idle) {
+            pDialog->destroy();
+        }
+    }
+
+private:
+    PooledDialog* take() {
+        std::vector<PooledDialog*> surplus;
+        PooledDialog* pDialog = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            size_t capacity = dialogPoolCapacity.load(std::memory_order_relaxed);
+            if (capacity > 0 && !idle.empty()) {
+                pDialog = idle.back();
+                idle.pop_back();
+            }
+            // Shrunk since they were kept
+            while (idle.size() > capacity) {
+                surplus.push_back(idle.back());
+                idle.pop_back();
+            }
+        }
+        for (PooledDialog* pSurplus : surplus) {
+            pSurplus->destroy();
+        }
+        return pDialog;
+    }
+
+    LONG refCount;
+    Create create;
+    std::mutex mutex;
+    std::vector<PooledDialog*> idle;
+};
+
+// Shared IFileDialog implementation. Base is IFileOpenDialog or IFileSaveDialog.
+template <typename Base>
+class StandInFileDialog : public Base, public IStandInDialogControl, public PooledDialog {
+public:
+    explicit StandInFileDialog(DWORD defaultOptions)
+        : refCount(1), defaultOptions(defaultOptions), options(defaultOptions), fileTypeIndex(1), pFolder(nullptr), pDefaultFolder(nullptr), pFilter(nullptr), pool(nullptr) {}
+
+    // IUnknown methods
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppv) {
+        return QueryInterfaceTable<StandInFileDialog, IFileDialog, Base, IStandInDialogControl>::query(this, riid, ppv);
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() {
+        return InterlockedIncrement(&refCount);
+    }
+
+    ULONG STDMETHODCALLTYPE Release() {
+        ULONG count = InterlockedDecrement(&refCount);
+        if (count == 0) {
+            StandInDialogPool* owner = pool;
+            pool = nullptr;
+            reset();
+            if (!owner || !owner->recycle(this)) {
+                delete this;
+            }
+            if (owner) {
+                owner->Release();
+            }
+        }
+        return count;
+    }
+
+    // PooledDialog methods
+    IFileDialog* reuse(StandInDialogPool* owner) {
+        pool = owner;
+        refCount = 1;
+        return this;
+    }
+
+    void destroy() {
+        delete this;
+    }
+
+    // IModalWindow methods
+    HRESULT STDMETHODCALLTYPE Show(HWND hwndOwner) {
+        releaseItems(results);
+        resultsSnapshot.reset();
+
+        IShellItem* pStartFolder = pFolder ? pFolder : pDefaultFolder;
+        if (prefetch) {
+            prefetch->waitForFirstItem();
+        }
+        if (pStartFolder) {
+            forEachSink([&](IFileDialogEvents* pEvents) { return pEvents->OnFolderChanging(this, pStartFolder); });
+            forEachSink([&](IFileDialogEvents* pEvents) { return pEvents->OnFolderChange(this); });
+        }
+
+        bool pickFolders = (options & FOS_PICKFOLDERS) != 0;
+        for (IShellItem* pItem : selection) {
+            SFGAOF attributes = 0;
+            pItem->GetAttributes(SFGAO_FOLDER, &attributes);
+            if (((attributes & SFGAO_FOLDER) != 0) != pickFolders) {
+                continue;
+            }
+            if (pFilter && pFilter->IncludeItem(pItem) != S_OK) {
+                continue;
+            }
+            pItem->AddRef();
+            results.push_back(pItem);
+            if (!(options & FOS_ALLOWMULTISELECT)) {
+                break;
+            }
+        }
+        if (results.empty()) {
+            IShellItem* pTyped = typedItem();
+            if (!pTyped) {
+                return kDialogCancelled;
+            }
+            results.push_back(pTyped);
+        }
+
+        forEachSink([&](IFileDialogEvents* pEvents) { return pEvents->OnSelectionChange(this); });
+        HRESULT hr = confirmResults();
+        if (hr == S_OK) {
+            hr = forEachSink([&](IFileDialogEvents* pEvents) { return pEvents->OnFileOk(this); });
+        }
+        if (hr != S_OK) {
+            releaseItems(results);
+            resultsSnapshot.reset();
+            return kDialogCancelled;
+        }
+        return S_OK;
+    }
+
+    // IFileDialog methods
+    HRESULT STDMETHODCALLTYPE SetFileTypes(UINT cFileTypes, const COMDLG_FILTERSPEC *rgFilterSpec) {
+        if (cFileTypes && !rgFilterSpec) {
+            return E_INVALIDARG;
+        }
+        fileTypes.clear();
+        for (UINT i = 0; i < cFileTypes; ++i) {
+            fileTypes.add(rgFilterSpec[i].pszName ? rgFilterSpec[i].pszName : L"", rgFilterSpec[i].pszSpec ? rgFilterSpec[i].pszSpec : L"");
+        }
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE SetFileTypeIndex(UINT iFileType) {
+        fileTypeIndex = iFileType;
+        forEachSink([&](IFileDialogEvents* pEvents) { return pEvents->OnTypeChange(this); });
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetFileTypeIndex(UINT *piFileType) {
+        *piFileType = fileTypeIndex;
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE Advise(IUnknown *pfde, DWORD *pdwCookie) {
+        return sinks.advise(pfde, pdwCookie);
+    }
+
+    HRESULT STDMETHODCALLTYPE Unadvise(DWORD dwCookie) {
+        return sinks.unadvise(dwCookie);
+    }
+
+    HRESULT STDMETHODCALLTYPE SetOptions(DWORD fos) {
+        options = fos;
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetOptions(DWORD *pfos) {
+        *pfos = options;
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE SetDefaultFolder(IShellItem *psi) {
+        assignInterface(pDefaultFolder, psi);
+        restartPrefetch();
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE SetFolder(IShellItem *psi) {
+        assignInterface(pFolder, psi);
+        restartPrefetch();
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetFolder(IShellItem **ppsi) {
+        *ppsi = pFolder ? pFolder : pDefaultFolder;
+        if (!*ppsi) {
+            return E_FAIL;
+        }
+        (*ppsi)->AddRef();
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetCurrentSelection(IShellItem **ppsi) {
+        return GetResult(ppsi);
+    }
+
+    HRESULT STDMETHODCALLTYPE SetFileName(LPCWSTR pszName) {
+        fileName = pszName ? pszName : L"";
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetFileName(LPWSTR *pszName) {
+        *pszName = coTaskMemDup(fileName.c_str(), fileName.size());
+        return *pszName ? S_OK : E_OUTOFMEMORY;
+    }
+
+    HRESULT STDMETHODCALLTYPE SetTitle(LPCWSTR pszTitle) {
+        title = pszTitle ? pszTitle : L"";
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE SetOkButtonLabel(LPCWSTR pszText) {
+        okButtonLabel = pszText ? pszText : L"";
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE SetFileNameLabel(LPCWSTR pszLabel) {
+        fileNameLabel = pszLabel ? pszLabel : L"";
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetResult(IShellItem **ppsi) {
+        if (results.empty()) {
+            *ppsi = nullptr;
+            return E_UNEXPECTED;
+        }
+        *ppsi = results.front();
+        (*ppsi)->AddRef();
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE AddPlace(IShellItem *psi, int fdap) {
+        return psi ? S_OK : E_INVALIDARG;
+    }
+
+    HRESULT STDMETHODCALLTYPE SetDefaultExtension(LPCWSTR pszDefaultExtension) {
+        defaultExtension = pszDefaultExtension ? pszDefaultExtension : L"";
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE Close(HRESULT hr) {
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE SetClientGuid(REFGUID guid) {
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE ClearClientData() {
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE SetFilter(IShellItemFilter *pFilter) {
+        assignInterface(this->pFilter, pFilter);
+        return S_OK;
+    }
+
+    // IStandInDialogControl methods
+    HRESULT STDMETHODCALLTYPE SetSelection(UINT cItems, IShellItem **rgItems) {
+        releaseItems(selection);
+        selectionSnapshot.reset();
+        for (UINT i = 0; i < cItems; ++i) {
+            if (rgItems[i]) {
+                rgItems[i]->AddRef();
+                selection.push_back(rgItems[i]);
+            }
+        }
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetPrefetchMetrics(FolderPrefetchMetrics *pMetrics) {
+        if (!pMetrics) {
+            return E_POINTER;
+        }
+        if (!prefetch) {
+            return E_FAIL;
+        }
+        *pMetrics = prefetch->metrics();
+        return S_OK;
+    }
+
+protected:
+    virtual ~StandInFileDialog() {
+        if (prefetch) {
+            prefetch->cancel();
+        }
+        releaseItems(selection);
+        releaseItems(results);
+        assignInterface(pFolder, static_cast<IShellItem*>(nullptr));
+        assignInterface(pDefaultFolder, static_cast<IShellItem*>(nullptr));
+        assignInterface(pFilter, static_cast<IShellItemFilter*>(nullptr));
+    }
+
+    // Back to the state a new dialog starts in, keeping the capacity of the strings and lists
+    virtual void reset() {
+        if (prefetch) {
+            prefetch->cancel();
+            prefetch.reset();
+        }
+        sinks.unadviseAll();
+        releaseItems(selection);
+        releaseItems(results);
+        selectionSnapshot.reset();
+        resultsSnapshot.reset();
+        assignInterface(pFolder, static_cast<IShellItem*>(nullptr));
+        assignInterface(pDefaultFolder, static_cast<IShellItem*>(nullptr));
+        assignInterface(pFilter, static_cast<IShellItemFilter*>(nullptr));
+        options = defaultOptions;
+        fileTypeIndex = 1;
+        fileTypes.clear();
+        fileName.clear();
+        title.clear();
+        okButtonLabel.clear();
+        fileNameLabel.clear();
+        defaultExtension.clear();
+    }
+
+    // The item for the name in the file name box, when nothing was picked; null when there is none
+    virtual IShellItem* typedItem() { return nullptr; }
+
+    // Last chance for the concrete dialog to veto the picked results (S_OK to accept)
+    virtual HRESULT confirmResults() { return S_OK; }
+
+    // Call fn for every advised sink; returns the first non-S_OK answer, or S_OK
+    template <typename Fn>
+    HRESULT forEachSink(Fn fn) {
+        return sinks.forEach(fn);
+    }
+
+    // Prefetch the folder Show would open in, when turned on, dropping a prefetch for any other folder
+    void restartPrefetch() {
+        IShellItem* pTarget = pFolder ? pFolder : pDefaultFolder;
+        if (prefetch && prefetch->folder() == pTarget) {
+            return;
+        }
+        if (prefetch) {
+            prefetch->cancel();
+            prefetch.reset();
+        }
+        if (pTarget && folderPrefetchEnabled.load(std::memory_order_relaxed)) {
+            prefetch = startFolderPrefetch(pTarget);
+        }
+    }
+
+    // Array over a snapshot of items, captured on first use and shared by later calls until the
+    // items change. Arrays already handed out keep the snapshot they were given.
+    static HRESULT snapshotArray(const std::vector<IShellItem*>& items, std::shared_ptr<ShellItemSnapshot>& snapshot, IShellItemArray **ppsia) {
+        if (!snapshot) {
+            HRESULT hr = appendToSnapshot(writableSnapshot(snapshot), items.data(), items.size());
+            if (FAILED(hr)) {
+                snapshot.reset();
+                *ppsia = nullptr;
+                return hr;
+            }
+        }
+#ifndef _WIN32
+        return createSnapshotShellItemArray(snapshot, PosixSHCreateItemFromParsingName, ppsia);
+#else
+        // shell32 is not linked; GetParent/BindToHandler on these items are unavailable
+        return createSnapshotShellItemArray(snapshot, nullptr, ppsia);
+#endif // _WIN32
+    }
+
+    static void releaseItems(std::vector<IShellItem*>& items) {
+        for (IShellItem* pItem : items) {
+            pItem->Release();
+        }
+        items.clear();
+    }
+
+    LONG refCount;
+    DWORD defaultOptions;
+    DWORD options;
+    UINT fileTypeIndex;
+    FilterSet fileTypes;
+    IShellItem* pFolder;
+    IShellItem* pDefaultFolder;
+    IShellItemFilter* pFilter;
+    std::wstring fileName;
+    std::wstring title;
+    std::wstring okButtonLabel;
+    std::wstring fileNameLabel;
+    std::wstring defaultExtension;
+    std::vector<IShellItem*> selection;
+    std::vector<IShellItem*> results;
+    std::shared_ptr<ShellItemSnapshot> selectionSnapshot;
+    std::shared_ptr<ShellItemSnapshot> resultsSnapshot;
+    EventSinkRegistry sinks;
+    std::shared_ptr<FolderPrefetch> prefetch;
+    StandInDialogPool* pool;  // Referenced while the dialog is out of it
+};
+
+class StandInFileOpenDialog : public StandInFileDialog<IFileOpenDialog> {
+public:
+    // Defaults of the system open dialog
+    StandInFileOpenDialog() : StandInFileDialog<IFileOpenDialog>(FOS_PATHMUSTEXIST | FOS_FILEMUSTEXIST | FOS_NOCHANGEDIR) {}
+
+    // IFileOpenDialog methods
+    HRESULT STDMETHODCALLTYPE GetResults(IShellItemArray **ppenum) {
+        if (results.empty()) {
+            *ppenum = nullptr;
+            return E_UNEXPECTED;
+        }
+        return snapshotArray(results, resultsSnapshot, ppenum);
+    }
+
+    HRESULT STDMETHODCALLTYPE GetSelectedItems(IShellItemArray **ppsai) {
+        return snapshotArray(selection, selectionSnapshot, ppsai);
+    }
+};
+
+class StandInFileSaveDialog : public StandInFileDialog<IFileSaveDialog> {
+public:
+    // Defaults of the system save dialog
+    StandInFileSaveDialog() : StandInFileDialog<IFileSaveDialog>(FOS_OVERWRITEPROMPT | FOS_NOREADONLYRETURN | FOS_PATHMUSTEXIST | FOS_NOCHANGEDIR), pSaveAsItem(nullptr), typedItemIsNew(false) {}
+
+    // IFileSaveDialog methods
+    HRESULT STDMETHODCALLTYPE SetSaveAsItem(IShellItem* psi) {
+        assignInterface(pSaveAsItem, psi);
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE SetProperties(IUnknown* pStore) {
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE SetCollectedProperties(IUnknown* pStore, BOOL fAppendDefault) {
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetProperties(IUnknown** ppStore) {
+        *ppStore = nullptr;
+        return E_NOTIMPL;
+    }
+
+    HRESULT STDMETHODCALLTYPE ApplyProperties(IShellItem* psi, IUnknown* pStore, HWND hwnd, IUnknown* pSink) {
+        return E_NOTIMPL;
+    }
+
+protected:
+    ~StandInFileSaveDialog() {
+        assignInterface(pSaveAsItem, static_cast<IShellItem*>(nullptr));
+    }
+
+    void reset() {
+        assignInterface(pSaveAsItem, static_cast<IShellItem*>(nullptr));
+        typedItemIsNew = false;
+        StandInFileDialog<IFileSaveDialog>::reset();
+    }
+
+    // The file name, with the default extension when it has none, in the folder Show opened; the
+    // file need not exist yet
+    IShellItem* typedItem() {
+        typedItemIsNew = false;
+#ifndef _WIN32
+        if (fileName.empty()) {
+            return nullptr;
+        }
+        std::wstring path;
+        if (fileName[0] != L'/') {
+            IShellItem* pStartFolder = pFolder ? pFolder : pDefaultFolder;
+            if (!pStartFolder) {
+                return nullptr;
+            }
+            ShellItemNameReader reader(taskMemFree);
+            reader.reset(pStartFolder);
+            std::wstring_view folderPath;
+            if (FAILED(reader.read(SIGDN_FILESYSPATH, folderPath))) {
+                return nullptr;
+            }
+            path.assign(folderPath);
+            if (path.empty() || path.back() != L'/') {
+                path += L'/';
+            }
+        }
+        path += fileName;
+        normalizePosixPath(path);
+        size_t leaf = path.rfind(L'/') + 1;
+        if (!defaultExtension.empty() && path.find(L'.', leaf) == std::wstring::npos) {
+            path += L'.';
+            path += defaultExtension;
+        }
+
+        IShellItem* pItem = nullptr;
+        HRESULT hr = PosixSHCreateItemFromParsingName(path.c_str(), nullptr, IID_IShellItem, reinterpret_cast<void**>(&pItem));
+        if (hr != hresultFromErrno(ENOENT)) {
+            return SUCCEEDED(hr) ? pItem : nullptr;
+        }
+        // A new file: its folder must exist, and the item describes an empty regular file
+        PosixItemInfo info = {};
+        if ((options & FOS_PATHMUSTEXIST) && leaf > 1) {
+            std::wstring folderPath = path.substr(0, leaf - 1);
+            if (FAILED(queryPosixItemInfo(wideToUtf8(folderPath.c_str(), folderPath.size()), info)) || !S_ISDIR(info.mode)) {
+                return nullptr;
+            }
+        }
+        info = {};
+        info.mode = S_IFREG | 0644;
+        if (FAILED(createPosixShellItem(path, info, &pItem))) {
+            return nullptr;
+        }
+        typedItemIsNew = true;
+        return pItem;
+#else
+        // shell32 is not linked, so there is nothing to make the item with
+        return nullptr;
+#endif // _WIN32
+    }
+
+    // Picking an existing file asks the sinks whether to overwrite it
+    HRESULT confirmResults() {
+        if (!(options & FOS_OVERWRITEPROMPT) || typedItemIsNew) {
+            return S_OK;
+        }
+        IShellItem* pItem = results.front();
+        return forEachSink([&](IFileDialogEvents* pEvents) {
+            FDE_OVERWRITE_RESPONSE response = FDESVR_DEFAULT;
+            HRESULT hr = pEvents->OnOverwrite(this, pItem, &response);
+            return (SUCCEEDED(hr) && response == FDESVR_REFUSE) ? S_FALSE : S_OK;
+        });
+    }
+
+private:
+    IShellItem* pSaveAsItem;
+    bool typedItemIsNew;  // The last typedItem() names a file that does not exist yet
+};
+
+HRESULT STDMETHODCALLTYPE StandInCoCreateInstance(REFCLSID rclsid, LPUNKNOWN pUnkOuter, DWORD dwClsContext, REFIID riid, LPVOID* ppv) {
+    static std::once_flag registered;
+    std::call_once(registered, registerStandInDialogClasses);
+    return classFactoryRegistry().createInstance(rclsid, pUnkOuter, riid, ppv);
+}
+
+void registerStandInDialogClasses() {
+    StandInDialogPool* pOpen = new StandInDialogPool([]() -> PooledDialog* { return new StandInFileOpenDialog(); });
+    StandInDialogPool* pSave = new StandInDialogPool([]() -> PooledDialog* { return new StandInFileSaveDialog(); });
+    classFactoryRegistry().registerClass(CLSID_FileOpenDialog, pOpen);
+    classFactoryRegistry().registerClass(CLSID_FileDialog, pOpen);
+    classFactoryRegistry().registerClass(CLSID_FileSaveDialog, pSave);
+    pOpen->Release();
+    pSave->Release();
+}
+
+void setStandInDialogPoolCapacity(size_t capacity) {
+    dialogPoolCapacity.store(capacity, std::memory_order_relaxed);
+}
+
+void setStandInFolderPrefetch(bool enabled) {
+    folderPrefetchEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+HRESULT STDMETHODCALLTYPE StandInCoInitialize(LPVOID pvReserved) {
+    return S_OK;
+}
+
+void STDMETHODCALLTYPE StandInCoUninitialize() {
+}
@@ -0,0 +1,48 @@
+#ifndef STAND_IN_FILE_DIALOG_H
+#define STAND_IN_FILE_DIALOG_H
+
+#include "IFileDialog.h"
+#include "FolderPrefetch.h"
+
+// In-process IFileDialog/IFileOpenDialog/IFileSaveDialog with no UI, for headless scenarios and
+// benchmarks. Show() "picks" the items handed over through IStandInDialogControl::SetSelection,
+// applies FOS_PICKFOLDERS, FOS_ALLOWMULTISELECT and any IShellItemFilter to them, fires the
+// IFileDialogEvents a real dialog would, and cancels when nothing is left.
+// With setStandInFolderPrefetch on, SetFolder/SetDefaultFolder start a background prefetch of the
+// folder's contents (a newer folder cancels the previous one), and Show waits for its first items,
+// as a real dialog would before painting; GetPrefetchMetrics reports how that went. Nothing reads
+// the listing itself, so sessions that only want results leave it off. GetResults and
+// GetSelectedItems hand out snapshot-backed arrays (SnapshotShellItemArray.h) instead of one live
+// item per entry.
+
+#define DEFINE_IStandInDialogControl_METHODS \
+    virtual HRESULT STDMETHODCALLTYPE SetSelection(UINT cItems, IShellItem **rgItems) = 0; \
+    virtual HRESULT STDMETHODCALLTYPE GetPrefetchMetrics(FolderPrefetchMetrics *pMetrics) = 0;
+
+interface IStandInDialogControl;  // Forward declaration of the interface
+static constexpr IID IID_IStandInDialogControl = guidFromString("5A3C4F0E-8E1B-4C7D-9B2A-6D1E0F3C7A41");
+COM_INTERFACE_ID(IStandInDialogControl, IID_IStandInDialogControl)
+typedef interface IStandInDialogControl IStandInDialogControl;
+DEFINE_INTERFACE(IStandInDialogControl, IUnknown, DEFINE_IStandInDialogControl_METHODS)
+
+// HRESULT_FROM_WIN32(ERROR_CANCELLED), what Show returns when the user backs out
+const HRESULT kDialogCancelled = static_cast<HRESULT>(0x800704C7L);
+
+// Drop-ins for the ole32 entry points in COMFunctionPointers. StandInCoCreateInstance creates
+// through classFactoryRegistry() (ClassFactoryRegistry.h), registering the stand-in dialogs for
+// CLSID_FileOpenDialog, CLSID_FileSaveDialog and CLSID_FileDialog on first use.
+HRESULT STDMETHODCALLTYPE StandInCoCreateInstance(REFCLSID rclsid, LPUNKNOWN pUnkOuter, DWORD dwClsContext, REFIID riid, LPVOID* ppv);
+HRESULT STDMETHODCALLTYPE StandInCoInitialize(LPVOID pvReserved);
+void STDMETHODCALLTYPE StandInCoUninitialize();
+
+// Register the stand-in dialogs' class objects with classFactoryRegistry(), replacing whatever
+// served those CLSIDs. Released dialogs go back to their class object's pool for reuse.
+void registerStandInDialogClasses();
+
+// Released dialogs each stand-in class keeps for reuse (default 16); 0 turns pooling off
+void setStandInDialogPoolCapacity(size_t capacity);
+
+// Whether stand-in dialogs prefetch folders set on them from now on (default off)
+void setStandInFolderPrefetch(bool enabled);
+
+#endif // STAND_IN_FILE_DIALOG_H
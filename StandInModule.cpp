@@ -0,0 +1,33 @@
+// Built on POSIX as libCIFileDialogStandIn.so (see CMakeLists.txt), not into the executable.
+// LoadCOMFunctionPointers dlopens it the way it loads ole32/shell32 on Windows. The entry points
+// forward to the stand-ins the executable exports, so objects and task memory all come from one
+// place however the table was loaded.
+#include "ProjWinUtils.h"
+#include "PosixShellItem.h"
+#include "StandInFileDialog.h"
+
+#define STAND_IN_EXPORT EXTERN_C __attribute__((visibility("default")))
+
+STAND_IN_EXPORT HRESULT STDMETHODCALLTYPE StandInModuleCoCreateInstance(REFCLSID rclsid, LPUNKNOWN pUnkOuter, DWORD dwClsContext, REFIID riid, LPVOID* ppv) {
+    return StandInCoCreateInstance(rclsid, pUnkOuter, dwClsContext, riid, ppv);
+}
+
+STAND_IN_EXPORT void STDMETHODCALLTYPE StandInModuleCoUninitialize() {
+    StandInCoUninitialize();
+}
+
+STAND_IN_EXPORT void STDMETHODCALLTYPE StandInModuleCoTaskMemFree(LPVOID pv) {
+    CoTaskMemFree(pv);
+}
+
+STAND_IN_EXPORT HRESULT STDMETHODCALLTYPE StandInModuleCoInitialize(LPVOID pvReserved) {
+    return StandInCoInitialize(pvReserved);
+}
+
+STAND_IN_EXPORT HRESULT STDMETHODCALLTYPE StandInModuleSHCreateItemFromParsingName(LPCWSTR pszPath, LPVOID pbc, REFIID riid, void** ppv) {
+    return PosixSHCreateItemFromParsingName(pszPath, pbc, riid, ppv);
+}
+
+STAND_IN_EXPORT LPVOID STDMETHODCALLTYPE StandInModuleCoTaskMemAlloc(size_t cb) {
+    return CoTaskMemAlloc(cb);
+}
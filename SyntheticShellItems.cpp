@@ -0,0 +1,291 @@
+#include "SyntheticShellItems.h"
+#include "QueryInterfaceTable.h"
+#include "SlabAllocator.h"
+#include "CollationKey.h"
+#include "PathTrie.h"
+#include "ShellItemDisplayNames.h"
+#include <mutex>
+#include <string>
+#include <cwchar>
+
+// Per thread, so counting adds no shared cache line of its own
+static thread_local uint64_t refCountCalls = 0;
+
+uint64_t syntheticRefCountCalls() {
+    return refCountCalls;
+}
+
+// Scratch for the one full path an item's key is built from
+static thread_local std::wstring keyPath;
+
+class SyntheticShellItem : public IShellItem, public IShellItemCollation, public IShellItemDisplayNames, public SlabAllocated<SyntheticShellItem> {
+public:
+    // A file in folder
+    SyntheticShellItem(const PathNode* folder, std::wstring name, SFGAOF attributes)
+        : refCount(1), folder(folder), ownedName(std::move(name)), name(ownedName), attributes(attributes) {}
+
+    // A folder, whose name the trie already holds
+    SyntheticShellItem(const PathNode* node, SFGAOF attributes)
+        : refCount(1), folder(node->parent), name(PathTrie::name(node)), attributes(attributes) {}
+
+    // IUnknown methods
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppv) {
+        return QueryInterfaceTable<SyntheticShellItem, IShellItem, IShellItemCollation, IShellItemDisplayNames>::query(this, riid, ppv);
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() {
+        ++refCountCalls;
+        return InterlockedIncrement(&refCount);
+    }
+
+    ULONG STDMETHODCALLTYPE Release() {
+        ++refCountCalls;
+        ULONG count = InterlockedDecrement(&refCount);
+        if (count == 0) {
+            delete this;
+        }
+        return count;
+    }
+
+    // IShellItem methods
+    HRESULT STDMETHODCALLTYPE BindToHandler(IUnknown *pbc, REFGUID bhid, REFIID riid, void **ppv) {
+        *ppv = nullptr;
+        return E_NOTIMPL;
+    }
+
+    // One hop up the folder chain; the top-level folder has no parent, as before
+    HRESULT STDMETHODCALLTYPE GetParent(IShellItem **ppsi) {
+        if (!folder->parent) {
+            *ppsi = nullptr;
+            return E_FAIL;
+        }
+        *ppsi = new SyntheticShellItem(folder, SFGAO_FILESYSTEM | SFGAO_FOLDER);
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetDisplayName(int sigdnName, LPWSTR *ppszName) {
+        switch (shellItemNameForm(sigdnName)) {
+            case ShellItemNamePath: {
+                // Rebuilt from the folder chain into the caller's buffer
+                size_t length = PathTrie::pathLength(folder, name);
+                *ppszName = static_cast<LPWSTR>(taskMemAlloc((length + 1) * sizeof(wchar_t)));
+                if (*ppszName) {
+                    PathTrie::copyPath(folder, name, *ppszName);
+                }
+                break;
+            }
+            case ShellItemNameLeaf:
+                *ppszName = coTaskMemDup(name.data(), name.size());
+                break;
+            default:
+                *ppszName = nullptr;
+                return E_INVALIDARG;
+        }
+        return *ppszName ? S_OK : E_OUTOFMEMORY;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetAttributes(ULONG sfgaoMask, ULONG *psfgaoAttribs) {
+        *psfgaoAttribs = attributes & sfgaoMask;
+        return (*psfgaoAttribs == sfgaoMask) ? S_OK : S_FALSE;
+    }
+
+    HRESULT STDMETHODCALLTYPE Compare(IShellItem *psi, DWORD hint, int *piOrder) {
+        return compareWithCollationKey(collationKey(), psi, hint, piOrder);
+    }
+
+    // IShellItemCollation methods
+    HRESULT STDMETHODCALLTYPE GetCollationKey(const CollationKey **ppKey) {
+        *ppKey = &collationKey();
+        return S_OK;
+    }
+
+    // IShellItemDisplayNames methods
+    HRESULT STDMETHODCALLTYPE BorrowDisplayName(int sigdnName, LPCWSTR *ppszName, size_t *pcchName) {
+        switch (shellItemNameForm(sigdnName)) {
+            case ShellItemNamePath:
+                *ppszName = path.get(folder, name);
+                *pcchName = PathTrie::pathLength(folder, name);
+                return S_OK;
+            case ShellItemNameLeaf:
+                *ppszName = name.data();
+                *pcchName = name.size();
+                return S_OK;
+            default:
+                *ppszName = nullptr;
+                *pcchName = 0;
+                return E_INVALIDARG;
+        }
+    }
+
+    HRESULT STDMETHODCALLTYPE BorrowItemDisplayName(IShellItem *pItem, int sigdnName, LPCWSTR *ppszName, size_t *pcchName) {
+        SyntheticShellItem* pOther = sameClassShellItem(this, pItem);
+        if (!pOther) {
+            *ppszName = nullptr;
+            *pcchName = 0;
+            return E_NOINTERFACE;
+        }
+        return pOther->BorrowDisplayName(sigdnName, ppszName, pcchName);
+    }
+
+protected:
+    virtual ~SyntheticShellItem() = default;
+
+private:
+    // Built on first use, so GetParent chains and items never compared skip it
+    const CollationKey& collationKey() {
+        std::call_once(keyOnce, [this] {
+            PathTrie::assignPath(folder, name, keyPath);
+            key.assign(keyPath.c_str(), keyPath.size(), keyPath.size() - name.size());
+        });
+        return key;
+    }
+
+    LONG refCount;
+    const PathNode* folder;  // Interned in pathTrie()
+    std::wstring ownedName;  // Storage for a file's name
+    std::wstring_view name;  // ownedName, or a folder's name in the trie
+    SFGAOF attributes;
+    std::once_flag keyOnce;
+    CollationKey key;
+    CachedTriePath path;  // Built on the first borrow; GetDisplayName copies from the folder chain
+};
+
+class SyntheticShellItemArray : public IShellItemArray {
+public:
+    SyntheticShellItemArray(DWORD itemCount, DWORD itemsPerFolder, DWORD folderDepth)
+        : refCount(1), itemCount(itemCount), itemsPerFolder(itemsPerFolder ? itemsPerFolder : 1), folderDepth(folderDepth ? folderDepth : 1),
+          base(pathTrie().intern(L"/synthetic")) {}
+
+    // IUnknown methods
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppv) {
+        return QueryInterfaceTable<SyntheticShellItemArray, IShellItemArray>::query(this, riid, ppv);
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() {
+        ++refCountCalls;
+        return InterlockedIncrement(&refCount);
+    }
+
+    ULONG STDMETHODCALLTYPE Release() {
+        ++refCountCalls;
+        ULONG count = InterlockedDecrement(&refCount);
+        if (count == 0) {
+            delete this;
+        }
+        return count;
+    }
+
+    // IShellItemArray methods
+    HRESULT STDMETHODCALLTYPE GetCount(DWORD *pdwNumItems) {
+        *pdwNumItems = itemCount;
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetItemAt(DWORD dwIndex, IShellItem **ppsi) {
+        if (dwIndex >= itemCount) {
+            *ppsi = nullptr;
+            return E_INVALIDARG;
+        }
+        wchar_t folderName[16];
+        int folderLength = swprintf(folderName, 16, L"dir%u", static_cast<unsigned>(dwIndex / itemsPerFolder));
+        const PathNode* folder = pathTrie().child(base, std::wstring_view(folderName, folderLength));
+        for (DWORD level = 1; level < folderDepth; ++level) {
+            folderLength = swprintf(folderName, 16, L"d%u", static_cast<unsigned>(level));
+            folder = pathTrie().child(folder, std::wstring_view(folderName, folderLength));
+        }
+        wchar_t fileName[24];
+        int fileLength = swprintf(fileName, 24, L"file%u.dat", static_cast<unsigned>(dwIndex));
+        *ppsi = new SyntheticShellItem(folder, std::wstring(fileName, fileLength), SFGAO_FILESYSTEM);
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE EnumItems(IEnumShellItems **ppenumShellItems);
+
+    DWORD count() const { return itemCount; }
+
+protected:
+    virtual ~SyntheticShellItemArray() = default;
+
+private:
+    LONG refCount;
+    DWORD itemCount;
+    DWORD itemsPerFolder;
+    DWORD folderDepth;
+    const PathNode* base;  // "/synthetic"
+};
+
+class SyntheticEnumShellItems : public IEnumShellItems {
+public:
+    SyntheticEnumShellItems(SyntheticShellItemArray* pArray, DWORD cursor) : refCount(1), pArray(pArray), cursor(cursor) {
+        pArray->AddRef();
+    }
+
+    // IUnknown methods
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppv) {
+        return QueryInterfaceTable<SyntheticEnumShellItems, IEnumShellItems>::query(this, riid, ppv);
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() {
+        ++refCountCalls;
+        return InterlockedIncrement(&refCount);
+    }
+
+    ULONG STDMETHODCALLTYPE Release() {
+        ++refCountCalls;
+        ULONG count = InterlockedDecrement(&refCount);
+        if (count == 0) {
+            delete this;
+        }
+        return count;
+    }
+
+    // IEnumShellItems methods
+    HRESULT STDMETHODCALLTYPE Next(ULONG celt, IShellItem **rgelt, ULONG *pceltFetched) {
+        if (!pceltFetched && celt != 1) {
+            return E_INVALIDARG;
+        }
+        ULONG fetched = 0;
+        while (fetched < celt && cursor < pArray->count()) {
+            pArray->GetItemAt(cursor++, &rgelt[fetched++]);
+        }
+        if (pceltFetched) {
+            *pceltFetched = fetched;
+        }
+        return (fetched == celt) ? S_OK : S_FALSE;
+    }
+
+    HRESULT STDMETHODCALLTYPE Skip(ULONG celt) {
+        DWORD remaining = pArray->count() - cursor;
+        cursor += (celt < remaining) ? celt : remaining;
+        return (celt <= remaining) ? S_OK : S_FALSE;
+    }
+
+    HRESULT STDMETHODCALLTYPE Reset() {
+        cursor = 0;
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE Clone(IEnumShellItems **ppenum) {
+        *ppenum = new SyntheticEnumShellItems(pArray, cursor);
+        return S_OK;
+    }
+
+protected:
+    virtual ~SyntheticEnumShellItems() {
+        pArray->Release();
+    }
+
+private:
+    LONG refCount;
+    SyntheticShellItemArray* pArray;
+    DWORD cursor;
+};
+
+HRESULT STDMETHODCALLTYPE SyntheticShellItemArray::EnumItems(IEnumShellItems **ppenumShellItems) {
+    *ppenumShellItems = new SyntheticEnumShellItems(this, 0);
+    return S_OK;
+}
+
+IShellItemArray* createSyntheticShellItemArray(DWORD itemCount, DWORD itemsPerFolder, DWORD folderDepth) {
+    return new SyntheticShellItemArray(itemCount, itemsPerFolder, folderDepth);
+}
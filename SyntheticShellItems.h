@@ -0,0 +1,16 @@
+#ifndef SYNTHETIC_SHELL_ITEMS_H
+#define SYNTHETIC_SHELL_ITEMS_H
+
+#include <cstdint>
+#include "IFileDialog.h"
+
+// In-process IShellItemArray that fabricates itemCount file items on demand, so result handling
+// can be driven without a shell. Item i is "/synthetic/dir<i / itemsPerFolder>/file<i>.dat", with
+// folderDepth - 1 more folders "d1/d2/..." before the file when folderDepth is above 1.
+// The returned array has a reference count of 1.
+IShellItemArray* createSyntheticShellItemArray(DWORD itemCount, DWORD itemsPerFolder = 1000, DWORD folderDepth = 1);
+
+// AddRef and Release calls this thread has made on synthetic items, arrays and enumerators
+uint64_t syntheticRefCountCalls();
+
+#endif // SYNTHETIC_SHELL_ITEMS_H
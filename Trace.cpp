@@ -0,0 +1,388 @@
+#include "Trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define TRACE_HAS_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACE_HAS_TSC 1
+#endif
+
+// Record layout, three 64-bit words:
+//   0: timestamp in ticks (TSC where there is one, steady_clock nanoseconds otherwise)
+//   1: event (bits 0-15), thread (bits 16-31), HRESULT (bits 32-63)
+//   2: item; for ClockSync the steady_clock nanoseconds matching the ticks in word 0
+static const size_t kTraceWords = 3;
+static const size_t kTraceRingRecords = 4096;  // Per thread; a power of two
+static const uint64_t kTraceMagic = 0x3143525444464943ull;  // "CIFDTRC1", little-endian
+static const uint64_t kTraceVersion = 1;
+static const std::chrono::milliseconds kTraceDrainInterval(20);
+
+#define TRACE_EVENT_MESSAGE(name, message, indexed) message,
+static const char* const kTraceEventMessages[] = {
+    TRACE_EVENTS(TRACE_EVENT_MESSAGE)
+};
+#undef TRACE_EVENT_MESSAGE
+
+#define TRACE_EVENT_INDEXED(name, message, indexed) indexed,
+static const bool kTraceEventIndexed[] = {
+    TRACE_EVENTS(TRACE_EVENT_INDEXED)
+};
+#undef TRACE_EVENT_INDEXED
+
+const char* traceEventMessage(TraceEvent event) {
+    return (event >= 0 && event < kTraceEventCount) ? kTraceEventMessages[event] : "unknown trace event";
+}
+
+static uint64_t traceTicks() {
+#ifdef TRACE_HAS_TSC
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+static uint64_t steadyNanoseconds() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+struct TraceRecord {
+    uint64_t words[kTraceWords];
+
+    TraceEvent event() const { return static_cast<TraceEvent>(words[1] & 0xffff); }
+    unsigned thread() const { return static_cast<unsigned>((words[1] >> 16) & 0xffff); }
+    HRESULT hr() const { return static_cast<HRESULT>(static_cast<int32_t>(words[1] >> 32)); }
+};
+
+static TraceRecord makeTraceRecord(uint64_t ticks, TraceEvent event, unsigned thread, HRESULT hr, uint64_t item) {
+    TraceRecord record = { { ticks, (static_cast<uint64_t>(static_cast<uint32_t>(hr)) << 32) | ((thread & 0xffff) << 16) | (event & 0xffff), item } };
+    return record;
+}
+
+// One writer (the owning thread), one reader (the drain). Slots are relaxed atomics so a drain
+// racing an overwrite reads a torn record rather than undefined behaviour, and then discards it.
+struct TraceRing {
+    explicit TraceRing(unsigned thread) : thread(thread), head(0), drained(0) {
+        for (std::atomic<uint64_t>& word : words) {
+            word.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    unsigned thread;
+    std::atomic<uint64_t> head;  // Records ever written
+    uint64_t drained;            // Records the drain has consumed or given up on
+    std::atomic<uint64_t> words[kTraceRingRecords * kTraceWords];
+};
+
+class TraceRegistry {
+public:
+    // Never destroyed: threads may trace while statics are torn down
+    static TraceRegistry& instance() {
+        static TraceRegistry* registry = new TraceRegistry();
+        return *registry;
+    }
+
+    TraceRing* addRing() {
+        std::lock_guard<std::mutex> lock(mutex);
+        rings.push_back(std::unique_ptr<TraceRing>(new TraceRing(static_cast<unsigned>(rings.size() + 1))));
+        return rings.back().get();
+    }
+
+    // Everything written since the last collect, oldest first; counts what was overwritten unread
+    void collect(std::vector<TraceRecord>& records) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const std::unique_ptr<TraceRing>& ring : rings) {
+            collectRing(*ring, records);
+        }
+        std::stable_sort(records.begin(), records.end(), [](const TraceRecord& a, const TraceRecord& b) {
+            return a.words[0] < b.words[0];
+        });
+    }
+
+    uint64_t lostRecords() const {
+        return lost.load(std::memory_order_relaxed);
+    }
+
+private:
+    void collectRing(TraceRing& ring, std::vector<TraceRecord>& records) {
+        uint64_t head = ring.head.load(std::memory_order_acquire);
+        uint64_t skipped = 0;
+        if (head - ring.drained > kTraceRingRecords) {
+            skipped = head - kTraceRingRecords - ring.drained;
+            ring.drained = head - kTraceRingRecords;
+        }
+        size_t first = records.size();
+        for (uint64_t index = ring.drained; index < head; ++index) {
+            const std::atomic<uint64_t>* slot = &ring.words[(index % kTraceRingRecords) * kTraceWords];
+            TraceRecord record;
+            for (size_t w = 0; w < kTraceWords; ++w) {
+                record.words[w] = slot[w].load(std::memory_order_relaxed);
+            }
+            records.push_back(record);
+        }
+        // The writer may have lapped the copy: a slot it reached (or is writing, at index after) no
+        // longer holds the record copied from it
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t after = ring.head.load(std::memory_order_relaxed);
+        if (after + 1 > ring.drained + kTraceRingRecords) {
+            uint64_t overwritten = std::min<uint64_t>(after + 1 - kTraceRingRecords - ring.drained, head - ring.drained);
+            records.erase(records.begin() + first, records.begin() + first + static_cast<size_t>(overwritten));
+            skipped += overwritten;
+        }
+        ring.drained = head;
+        if (skipped) {
+            lost.fetch_add(skipped, std::memory_order_relaxed);
+            records.push_back(makeTraceRecord(traceTicks(), kTraceLost, ring.thread, S_OK, skipped));
+        }
+    }
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceRing>> rings;  // Kept after their thread exits
+    std::atomic<uint64_t> lost{0};
+};
+
+static thread_local TraceRing* threadRing = nullptr;
+
+void trace(TraceEvent event, HRESULT hr, uint64_t item) {
+    TraceRing* ring = threadRing;
+    if (!ring) {
+        ring = threadRing = TraceRegistry::instance().addRing();
+    }
+    uint64_t index = ring->head.load(std::memory_order_relaxed);
+    TraceRecord record = makeTraceRecord(traceTicks(), event, ring->thread, hr, item);
+    std::atomic<uint64_t>* slot = &ring->words[(index % kTraceRingRecords) * kTraceWords];
+    // Pairs with the drain's acquire fence: seeing any word of this record means seeing head == index
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t w = 0; w < kTraceWords; ++w) {
+        slot[w].store(record.words[w], std::memory_order_relaxed);
+    }
+    ring->head.store(index + 1, std::memory_order_release);
+}
+
+uint64_t traceRecordsLost() {
+    return TraceRegistry::instance().lostRecords();
+}
+
+// Maps ticks to nanoseconds from two ClockSync records
+class TraceClock {
+public:
+    TraceClock() : haveFirst(false), firstTicks(0), firstNanoseconds(0), lastTicks(0), lastNanoseconds(0) {}
+
+    void sync(const TraceRecord& record) {
+        if (!haveFirst) {
+            haveFirst = true;
+            firstTicks = record.words[0];
+            firstNanoseconds = record.words[2];
+        }
+        lastTicks = record.words[0];
+        lastNanoseconds = record.words[2];
+    }
+
+    // Seconds since the first sync
+    double seconds(uint64_t ticks) const {
+        if (!haveFirst) {
+            return 0.0;
+        }
+        double scale = 1.0;
+        if (lastTicks > firstTicks) {
+            scale = static_cast<double>(lastNanoseconds - firstNanoseconds) / static_cast<double>(lastTicks - firstTicks);
+        }
+        return (static_cast<double>(ticks) - static_cast<double>(firstTicks)) * scale / 1e9;
+    }
+
+private:
+    bool haveFirst;
+    uint64_t firstTicks;
+    uint64_t firstNanoseconds;
+    uint64_t lastTicks;
+    uint64_t lastNanoseconds;
+};
+
+static TraceRecord clockSyncRecord() {
+    return makeTraceRecord(traceTicks(), kTraceClockSync, 0, S_OK, steadyNanoseconds());
+}
+
+// "+0.012345s thread 2: Failed to read item (item 17) HRESULT 0x80004005"
+static void writeTraceText(std::wostream& out, const TraceRecord& record, const TraceClock& clock) {
+    const char* message = traceEventMessage(record.event());
+    out << L"+" << std::fixed << std::setprecision(6) << clock.seconds(record.words[0]) << L"s thread " << record.thread() << L": ";
+    for (const char* c = message; *c; ++c) {
+        out << static_cast<wchar_t>(*c);
+    }
+    if (record.event() == kTraceLost) {
+        out << L" (" << record.words[2] << L")";
+    } else if (record.event() < kTraceEventCount && kTraceEventIndexed[record.event()]) {
+        out << L" (item " << record.words[2] << L")";
+    }
+    if (record.hr() != S_OK) {
+        out << L" HRESULT 0x" << std::hex << std::setw(8) << std::setfill(L'0') << static_cast<uint32_t>(record.hr())
+            << std::dec << std::setfill(L' ');
+    }
+    out << L'\n';
+}
+
+// Background thread moving records from the rings to a file or a text stream
+class TraceDrain {
+public:
+    TraceDrain(FILE* file, std::wostream* text) : file(file), text(text), stopping(false), requested(0), completed(0) {
+        write(std::vector<TraceRecord>(1, clockSyncRecord()));
+        worker = std::thread([this]() { run(); });
+    }
+
+    ~TraceDrain() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+        if (file) {
+            fclose(file);
+        }
+    }
+
+    void flush() {
+        std::unique_lock<std::mutex> lock(mutex);
+        uint64_t ticket = ++requested;
+        wake.notify_one();
+        done.wait(lock, [&]() { return completed >= ticket; });
+    }
+
+private:
+    void run() {
+        std::vector<TraceRecord> records;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait_for(lock, kTraceDrainInterval, [&]() { return stopping || requested > completed; });
+            uint64_t ticket = requested;
+            bool last = stopping;
+            lock.unlock();
+
+            records.clear();
+            TraceRegistry::instance().collect(records);
+            if (!records.empty() || last) {
+                records.push_back(clockSyncRecord());
+                write(records);
+            }
+
+            lock.lock();
+            completed = ticket;
+            done.notify_all();
+            if (last) {
+                return;
+            }
+        }
+    }
+
+    void write(const std::vector<TraceRecord>& records) {
+        if (file) {
+            fwrite(records.data(), sizeof(TraceRecord), records.size(), file);
+            fflush(file);
+        }
+        if (text) {
+            // Calibrate with the pass's closing sync before printing what it brackets
+            for (const TraceRecord& record : records) {
+                if (record.event() == kTraceClockSync) {
+                    clock.sync(record);
+                }
+            }
+            for (const TraceRecord& record : records) {
+                if (record.event() != kTraceClockSync) {
+                    writeTraceText(*text, record, clock);
+                }
+            }
+            text->flush();
+        }
+    }
+
+    FILE* file;
+    std::wostream* text;
+    TraceClock clock;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    bool stopping;
+    uint64_t requested;
+    uint64_t completed;
+    std::thread worker;
+};
+
+static std::mutex traceDrainMutex;
+static std::unique_ptr<TraceDrain> traceDrain;
+
+bool startTraceFile(const std::string& fileName) {
+    std::lock_guard<std::mutex> lock(traceDrainMutex);
+    traceDrain.reset();
+    FILE* file = fopen(fileName.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    uint64_t header[kTraceWords] = { kTraceMagic, kTraceVersion, sizeof(TraceRecord) };
+    fwrite(header, sizeof(header), 1, file);
+    traceDrain.reset(new TraceDrain(file, nullptr));
+    return true;
+}
+
+void startTraceConsole(std::wostream& out) {
+    std::lock_guard<std::mutex> lock(traceDrainMutex);
+    traceDrain.reset();
+    traceDrain.reset(new TraceDrain(nullptr, &out));
+}
+
+void flushTrace() {
+    std::lock_guard<std::mutex> lock(traceDrainMutex);
+    if (traceDrain) {
+        traceDrain->flush();
+    }
+}
+
+void stopTrace() {
+    std::lock_guard<std::mutex> lock(traceDrainMutex);
+    traceDrain.reset();
+}
+
+int decodeTraceFile(const std::string& fileName, std::wostream& out) {
+    FILE* file = fopen(fileName.c_str(), "rb");
+    if (!file) {
+        out << L"Cannot open trace file" << std::endl;
+        return 2;
+    }
+    uint64_t header[kTraceWords] = {};
+    if (fread(header, sizeof(header), 1, file) != 1 || header[0] != kTraceMagic || header[1] != kTraceVersion || header[2] != sizeof(TraceRecord)) {
+        out << L"Not a trace file, or written by another version" << std::endl;
+        fclose(file);
+        return 2;
+    }
+
+    // Syncs come first and last in every drain pass, so the clock is calibrated over the whole file
+    std::vector<TraceRecord> records;
+    TraceRecord record;
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        records.push_back(record);
+    }
+    fclose(file);
+    TraceClock clock;
+    for (const TraceRecord& entry : records) {
+        if (entry.event() == kTraceClockSync) {
+            clock.sync(entry);
+        }
+    }
+    size_t count = 0;
+    for (const TraceRecord& entry : records) {
+        if (entry.event() != kTraceClockSync) {
+            writeTraceText(out, entry, clock);
+            ++count;
+        }
+    }
+    out << count << L" records" << std::endl;
+    return 0;
+}
@@ -0,0 +1,53 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include "Unknwn.h"
+
+// Every trace point, as X(name, message, whether its item is an item index)
+#define TRACE_EVENTS(X) \
+    X(ClockSync, "clock sync", false) \
+    X(Lost, "trace records lost", false) \
+    X(CreateDialogFailed, "Failed to create file dialog", false) \
+    X(ShowFailed, "Failed to show the file dialog", false) \
+    X(SetFileTypesFailed, "Failed to set file types", false) \
+    X(SetFolderFailed, "Failed to set default folder", false) \
+    X(SetOptionsFailed, "Failed to set dialog options", false) \
+    X(GetResultsFailed, "Failed to get dialog results", false) \
+    X(GetCountFailed, "Failed to get item count", false) \
+    X(EnumerateFailed, "Failed to enumerate dialog results", false) \
+    X(ReadItemFailed, "Failed to read item", true) \
+    X(CreateItemFailed, "Failed to create shell item from path", false) \
+    X(GetItemFailed, "Failed to get item from shell item array", true) \
+    X(GetDisplayNameFailed, "Failed to get display name from shell item", true)
+
+#define TRACE_EVENT_ID(name, message, indexed) kTrace##name,
+enum TraceEvent {
+    TRACE_EVENTS(TRACE_EVENT_ID)
+    kTraceEventCount
+};
+#undef TRACE_EVENT_ID
+
+const char* traceEventMessage(TraceEvent event);
+
+// Append a fixed-size record (event, hr, item, timestamp) to the calling thread's ring. Never locks,
+// allocates or blocks: each thread owns its ring, and a drain that falls a full ring behind loses
+// the oldest records (and says so) rather than stalling the writer.
+void trace(TraceEvent event, HRESULT hr = S_OK, uint64_t item = 0);
+
+// A background drain empties the rings every few milliseconds. Starting one stops the previous.
+// The binary file holds a header record and then raw records; decodeTraceFile turns it into text.
+bool startTraceFile(const std::string& fileName);
+void startTraceConsole(std::wostream& out);  // Decoded text, one line per record
+void flushTrace();                           // Drain now and wait for it
+void stopTrace();                            // Final drain; closes the file
+
+// Records overwritten before any drain saw them
+uint64_t traceRecordsLost();
+
+// Entry point for: CIFileDialogTester --trace-decode <file>
+int decodeTraceFile(const std::string& fileName, std::wostream& out);
+
+#endif // TRACE_H
@@ -1,7 +1,48 @@
 #ifndef MY_IUNKNOWN_H
 #define MY_IUNKNOWN_H
 
+#ifdef _WIN32
 #include <guiddef.h> // For REFIID and GUID
+#else
+#include <cstdint>
+#include <cstdlib>
+#include <cwchar>
+
+// Non-Windows builds have no guiddef.h/windows.h, so the SDK pieces we rely on are defined here
+// with the same widths as the LLP64 Windows ABI (32-bit LONG/DWORD/HRESULT).
+#define __IID_DEFINED__
+typedef struct _GUID {
+    uint32_t Data1;
+    uint16_t Data2;
+    uint16_t Data3;
+    uint8_t  Data4[8];
+} GUID;
+typedef GUID IID;
+typedef GUID CLSID;
+#define REFIID const IID &
+#define REFCLSID const IID &
+
+inline bool operator==(const GUID& a, const GUID& b) {
+    return a.Data1 == b.Data1 && a.Data2 == b.Data2 && a.Data3 == b.Data3 &&
+           a.Data4[0] == b.Data4[0] && a.Data4[1] == b.Data4[1] && a.Data4[2] == b.Data4[2] && a.Data4[3] == b.Data4[3] &&
+           a.Data4[4] == b.Data4[4] && a.Data4[5] == b.Data4[5] && a.Data4[6] == b.Data4[6] && a.Data4[7] == b.Data4[7];
+}
+inline bool operator!=(const GUID& a, const GUID& b) { return !(a == b); }
+
+#define HRESULT_DEFINED
+typedef int32_t HRESULT;
+#define ULONG_DEFINED
+typedef uint32_t ULONG;
+#define LONG_DEFINED
+typedef int32_t LONG;
+
+#ifndef EXTERN_C
+#define EXTERN_C extern "C"
+#endif
+#define __stdcall
+#define __declspec(x)
+#define STDMETHODCALLTYPE
+#endif // _WIN32
 
 // Define REFIID and GUID if not already defined
 #ifndef __IID_DEFINED__
@@ -44,7 +85,11 @@ typedef wchar_t* LPWSTR;
 typedef const wchar_t* LPCWSTR;
 typedef unsigned int UINT;
 typedef int BOOL;
+#ifdef _WIN32
 typedef unsigned long DWORD;
+#else
+typedef uint32_t DWORD;
+#endif
 typedef void* HMODULE;
 
 // Define LPUNKNOWN
@@ -55,10 +100,42 @@ typedef struct IUnknown* LPUNKNOWN;
 #define S_OK ((HRESULT)0L)
 #endif
 
+#ifndef S_FALSE
+#define S_FALSE ((HRESULT)1L)
+#endif
+
+#ifndef E_NOTIMPL
+#define E_NOTIMPL ((HRESULT)0x80004001L)
+#endif
+
 #ifndef E_NOINTERFACE
 #define E_NOINTERFACE ((HRESULT)0x80004002L)
 #endif
 
+#ifndef E_POINTER
+#define E_POINTER ((HRESULT)0x80004003L)
+#endif
+
+#ifndef E_ABORT
+#define E_ABORT ((HRESULT)0x80004004L)
+#endif
+
+#ifndef E_FAIL
+#define E_FAIL ((HRESULT)0x80004005L)
+#endif
+
+#ifndef E_PENDING
+#define E_PENDING ((HRESULT)0x8000000AL)
+#endif
+
+#ifndef E_OUTOFMEMORY
+#define E_OUTOFMEMORY ((HRESULT)0x8007000EL)
+#endif
+
+#ifndef E_INVALIDARG
+#define E_INVALIDARG ((HRESULT)0x80070057L)
+#endif
+
 // Define CLSCTX_INPROC_SERVER
 #ifndef CLSCTX_INPROC_SERVER
 #define CLSCTX_INPROC_SERVER 0x1
@@ -74,10 +151,19 @@ typedef struct IUnknown* LPUNKNOWN;
 #endif
 
 // Forward declaration for InterlockedIncrement and InterlockedDecrement
+#ifdef _WIN32
 extern "C" {
     __declspec(dllimport) LONG __stdcall InterlockedIncrement(LONG volatile *Addend);
     __declspec(dllimport) LONG __stdcall InterlockedDecrement(LONG volatile *Addend);
 }
+#else
+inline LONG InterlockedIncrement(LONG volatile *Addend) { return __atomic_add_fetch(Addend, 1, __ATOMIC_SEQ_CST); }
+inline LONG InterlockedDecrement(LONG volatile *Addend) { return __atomic_sub_fetch(Addend, 1, __ATOMIC_SEQ_CST); }
+
+// Task allocator used for strings handed out by GetDisplayName
+inline LPVOID CoTaskMemAlloc(size_t cb) { return std::malloc(cb); }
+inline void CoTaskMemFree(LPVOID pv) { std::free(pv); }
+#endif // _WIN32
 
 // Define interface macros if not already defined
 #ifndef __RPC_FAR
@@ -3,18 +3,29 @@
 #include <random>
 #include <string>
 #include <stdexcept>
+#include <algorithm>
 #include "IFileDialog.h"
+#include "Bench.h"
+#include "DialogOptions.h"
+#include "ScenarioRunner.h"
+#include "ConfigFuzzer.h"
+#include "FilterSet.h"
+#include "Trace.h"
+#include "ResultSink.h"
+#include <cstdio>
+#include <memory>
 
 // Undefine the max macro to prevent limits vs windows.h conflicts
 #undef max
 
-enum OptionState { Default = 0, Enabled = 1, Disabled = -1 };
+// Echo menu input handling to std::wcerr (--debug)
+static bool debugInput = false;
 
 // Function to generate a random number in the range [low, high]
 int GetRandomNumber(int low, int high) {
     if (low > high) throw std::invalid_argument("Lower bound must be less than or equal to upper bound.");
-    std::random_device rd;
-    std::mt19937 gen(rd());
+    // Seeded once per thread; reseeding on every call made each number cost a random_device read
+    static thread_local std::mt19937 gen(std::random_device{}());
     std::uniform_int_distribution<> dis(low, high);
     return dis(gen);
 }
@@ -34,38 +45,40 @@ std::wstring getUserInputStr(const std::wstring& prompt, const std::wstring& def
 
 // Function to get user input as an integer with validation
 int getUserInputInt(const std::wstring& prompt, const std::vector<int>& validChoices, int defaultValue) {
-    std::wcerr << L"DEBUG: Prompt: " << prompt << std::endl;
-    std::wcerr << L"DEBUG: Valid Choices: ";
-    for (const auto& choice : validChoices) {
-        std::wcerr << choice << L" ";
+    if (debugInput) {
+        std::wcerr << L"DEBUG: Prompt: " << prompt << std::endl;
+        std::wcerr << L"DEBUG: Valid Choices: ";
+        for (const auto& choice : validChoices) {
+            std::wcerr << choice << L" ";
+        }
+        std::wcerr << std::endl;
+        std::wcerr << L"DEBUG: Default Value: " << defaultValue << std::endl;
     }
-    std::wcerr << std::endl;
-    std::wcerr << L"DEBUG: Default Value: " << defaultValue << std::endl;
 
     while (true) {
         std::wstring input;
         std::wcout << prompt;
         std::getline(std::wcin, input);
 
-        std::wcerr << L"DEBUG: User input: \"" << input << L"\"" << std::endl;
+        if (debugInput) std::wcerr << L"DEBUG: User input: \"" << input << L"\"" << std::endl;
 
         if (input.empty()) {
-            std::wcerr << L"DEBUG: No input provided, using default value: " << defaultValue << std::endl;
+            if (debugInput) std::wcerr << L"DEBUG: No input provided, using default value: " << defaultValue << std::endl;
             return defaultValue;
         }
 
         try {
             int value = std::stoi(input);
-            std::wcerr << L"DEBUG: Parsed input: " << value << std::endl;
+            if (debugInput) std::wcerr << L"DEBUG: Parsed input: " << value << std::endl;
 
             if (std::find(validChoices.begin(), validChoices.end(), value) != validChoices.end()) {
-                std::wcerr << L"DEBUG: Input is a valid choice: " << value << std::endl;
+                if (debugInput) std::wcerr << L"DEBUG: Input is a valid choice: " << value << std::endl;
                 return value;
             } else {
-                std::wcerr << L"DEBUG: Input is not a valid choice: " << value << std::endl;
+                if (debugInput) std::wcerr << L"DEBUG: Input is not a valid choice: " << value << std::endl;
             }
         } catch (const std::exception& e) {
-            std::wcerr << L"DEBUG: Exception caught: " << e.what() << std::endl;
+            if (debugInput) std::wcerr << L"DEBUG: Exception caught: " << e.what() << std::endl;
         }
 
         std::wcout << L"Invalid input. Please enter a valid choice." << std::endl;
@@ -73,14 +86,17 @@ int getUserInputInt(const std::wstring& prompt, const std::vector<int>& validCho
 }
 
 // Function to manage file type filters
-void manageFilters(std::vector<COMDLG_FILTERSPEC>& filters, bool randomize) {
+void manageFilters(FilterSet& filters, bool randomize) {
     if (randomize) {
         int numFilters = GetRandomNumber(1, 25);
-        filters.push_back({ _wcsdup(L"All Files"), _wcsdup(L"*.*") });
+        filters.reserve(numFilters + 1, 32 * (numFilters + 1));
+        filters.add(L"All Files", L"*.*");
         for (int i = 0; i < numFilters; ++i) {
-            std::wstring filterName = L"Random Filter " + std::to_wstring(i + 1);
-            std::wstring filterSpec = L"*." + std::to_wstring(i + 1);
-            filters.push_back({ _wcsdup(filterName.c_str()), _wcsdup(filterSpec.c_str()) });
+            wchar_t filterName[32];
+            wchar_t filterSpec[16];
+            swprintf(filterName, 32, L"Random Filter %d", i + 1);
+            swprintf(filterSpec, 16, L"*.%d", i + 1);
+            filters.add(filterName, filterSpec);
         }
         return;
     }
@@ -89,7 +105,7 @@ void manageFilters(std::vector<COMDLG_FILTERSPEC>& filters, bool randomize) {
         std::wcout << L"\nFile Type Filters Menu:\n";
         std::wcout << L"1. Add New Filter\n";
         for (size_t i = 0; i < filters.size(); ++i) {
-            std::wcout << (i + 2) << L". Edit Filter: " << filters[i].pszName << L" (" << filters[i].pszSpec << L")\n";
+            std::wcout << (i + 2) << L". Edit Filter: " << filters.name(i) << L" (" << filters.spec(i) << L")\n";
         }
         std::wcout << (filters.size() + 2) << L". Done\n";
         int choice = getUserInputInt(L"Choose an option: ", { 1, static_cast<int>(filters.size() + 2) }, filters.size() + 2);
@@ -97,40 +113,25 @@ void manageFilters(std::vector<COMDLG_FILTERSPEC>& filters, bool randomize) {
         if (choice == 1) {
             std::wstring filterName = getUserInputStr(L"Enter filter name: ", L"Default Filter");
             std::wstring filterSpec = getUserInputStr(L"Enter filter spec: ", L"*.*");
-            filters.push_back({ _wcsdup(filterName.c_str()), _wcsdup(filterSpec.c_str()) });
+            filters.add(filterName, filterSpec);
         } else if (choice == filters.size() + 2) {
             break;
         } else {
             size_t filterIndex = choice - 2;
-            std::wcout << L"\nEditing Filter: " << filters[filterIndex].pszName << L" (" << filters[filterIndex].pszSpec << L")\n";
-            filters[filterIndex].pszName = _wcsdup(getUserInputStr(L"Enter new filter name: ", filters[filterIndex].pszName).c_str());
-            filters[filterIndex].pszSpec = _wcsdup(getUserInputStr(L"Enter new filter spec: ", filters[filterIndex].pszSpec).c_str());
+            std::wcout << L"\nEditing Filter: " << filters.name(filterIndex) << L" (" << filters.spec(filterIndex) << L")\n";
+            std::wstring filterName = getUserInputStr(L"Enter new filter name: ", std::wstring(filters.name(filterIndex)));
+            std::wstring filterSpec = getUserInputStr(L"Enter new filter spec: ", std::wstring(filters.spec(filterIndex)));
+            filters.set(filterIndex, filterName, filterSpec);
         }
     }
 }
 
 // Function to display and get user choices for file dialog options
 void configureDialogOptions(std::vector<int>& optionStates, bool randomize) {
-    struct Option {
-        std::wstring name;
-        int defaultValue;
-    };
-
-    std::vector<Option> dialogOptions = {
-        { L"Allow multiple selection", Default },
-        { L"Do not add to recent", Default },
-        { L"Show hidden files", Default },
-        { L"No change dir", Default },
-        { L"Confirm overwrite", Default },
-        { L"Hide MRU places", Default },
-        { L"Hide pinned places", Default },
-        { L"Share aware", Default }
-    };
-
-    optionStates.resize(dialogOptions.size(), Default); // Ensure optionStates is properly initialized
+    optionStates.resize(kDialogOptionCount, Default); // Ensure optionStates is properly initialized
 
     if (randomize) {
-        for (size_t i = 0; i < dialogOptions.size(); ++i) {
+        for (size_t i = 0; i < kDialogOptionCount; ++i) {
             optionStates[i] = GetRandomNumber(-1, 1);
         }
         return;
@@ -146,27 +147,28 @@ void configureDialogOptions(std::vector<int>& optionStates, bool randomize) {
 
     while (true) {
         std::wcout << L"\nDialog Options Menu:\n";
-        for (size_t i = 0; i < dialogOptions.size(); ++i) {
-            std::wcout << (i + 1) << L". " << dialogOptions[i].name << L" (Current: " << optionStateToString(optionStates[i]) << L")\n";
+        for (size_t i = 0; i < kDialogOptionCount; ++i) {
+            std::wcout << (i + 1) << L". " << kDialogOptions[i].name << L" (Current: " << optionStateToString(optionStates[i]) << L")\n";
         }
-        std::wcout << (dialogOptions.size() + 1) << L". Done\n";
+        std::wcout << (kDialogOptionCount + 1) << L". Done\n";
 
         std::vector<int> validChoices;
-        for (int i = 1; i <= dialogOptions.size() + 1; ++i) {
+        for (int i = 1; i <= static_cast<int>(kDialogOptionCount) + 1; ++i) {
             validChoices.push_back(i);
         }
         
-        int choice = getUserInputInt(L"Choose an option to change or done to continue: ", validChoices, dialogOptions.size() + 1);
-        std::wcerr << L"DEBUG: User chose option: " << choice << std::endl;
+        int choice = getUserInputInt(L"Choose an option to change or done to continue: ", validChoices, kDialogOptionCount + 1);
+        if (debugInput) std::wcerr << L"DEBUG: User chose option: " << choice << std::endl;
 
-        if (choice == dialogOptions.size() + 1) {
+        if (choice == static_cast<int>(kDialogOptionCount) + 1) {
             break;
         } else {
             size_t optionIndex = choice - 1;
-            std::wcerr << L"DEBUG: Changing option: " << dialogOptions[optionIndex].name << std::endl;
+            std::wstring optionName = kDialogOptions[optionIndex].name;
+            if (debugInput) std::wcerr << L"DEBUG: Changing option: " << optionName << std::endl;
 
-            int newValue = getUserInputInt(L"Select " + dialogOptions[optionIndex].name + L" option:\n1. Enabled\n2. Disabled\n3. Default\nChoose an option: ", { 1, 2, 3 }, 3);
-            std::wcerr << L"DEBUG: New value for " << dialogOptions[optionIndex].name << L": " << newValue << std::endl;
+            int newValue = getUserInputInt(L"Select " + optionName + L" option:\n1. Enabled\n2. Disabled\n3. Default\nChoose an option: ", { 1, 2, 3 }, 3);
+            if (debugInput) std::wcerr << L"DEBUG: New value for " << optionName << L": " << newValue << std::endl;
 
             optionStates[optionIndex] = (newValue == 1) ? Enabled : (newValue == 2) ? Disabled : Default;
         }
@@ -175,42 +177,102 @@ void configureDialogOptions(std::vector<int>& optionStates, bool randomize) {
 
 
 // Function to get file dialog options from user
-DWORD getFileDialogOptions(bool isSaveDialog, bool randomize, std::vector<COMDLG_FILTERSPEC>& filters) {
-    DWORD options = FOS_FILEMUSTEXIST | FOS_PATHMUSTEXIST | FOS_FORCEFILESYSTEM;
-
+DWORD getFileDialogOptions(bool isSaveDialog, bool randomize, FilterSet& filters) {
     std::vector<int> optionStates;
     configureDialogOptions(optionStates, randomize);
+    DWORD options = applyOptionStates(kBaseDialogOptions, optionStates);
 
-    struct OptionFlag {
-        DWORD flag;
-        bool isSaveDialogOnly;
-    };
+    manageFilters(filters, randomize);
 
-    std::vector<OptionFlag> optionFlags = {
-        { FOS_ALLOWMULTISELECT, false },
-        { FOS_DONTADDTORECENT, false },
-        { FOS_FORCESHOWHIDDEN, false },
-        { FOS_NOCHANGEDIR, false },
-        { FOS_OVERWRITEPROMPT, true },
-        { FOS_HIDEMRUPLACES, false },
-        { FOS_HIDEPINNEDPLACES, false },
-        { FOS_SHAREAWARE, false }
-    };
+    return options;
+}
+
+// Sink for --results <format> at --verbosity <level>; ndjson and binary write to the file after the
+// colon, opened into file. Null when either argument is not recognised.
+static std::unique_ptr<ResultSink> createResultSink(const std::string& format, const std::string& verbosityName, std::unique_ptr<FILE, int (*)(FILE*)>& file) {
+    ResultVerbosity verbosity;
+    if (verbosityName == "count") {
+        verbosity = ResultVerbosityCount;
+    } else if (verbosityName == "paths") {
+        verbosity = ResultVerbosityPaths;
+    } else if (verbosityName == "full") {
+        verbosity = ResultVerbosityFull;
+    } else {
+        return nullptr;
+    }
+
+    if (format == "text") {
+        return std::unique_ptr<ResultSink>(new TextResultSink(std::wcout, verbosity));
+    }
+    if (format == "null") {
+        return std::unique_ptr<ResultSink>(new NullResultSink(verbosity));
+    }
+    size_t colon = format.find(':');
+    std::string kind = format.substr(0, colon);
+    if (colon == std::string::npos || colon + 1 == format.size() || (kind != "ndjson" && kind != "binary")) {
+        return nullptr;
+    }
+    file.reset(fopen(format.substr(colon + 1).c_str(), "wb"));
+    if (!file) {
+        std::cerr << "Cannot open results file " << format.substr(colon + 1) << std::endl;
+        return nullptr;
+    }
+    if (kind == "ndjson") {
+        return std::unique_ptr<ResultSink>(new NdjsonResultSink(file.get(), verbosity));
+    }
+    return std::unique_ptr<ResultSink>(new BinaryResultSink(file.get(), verbosity));
+}
 
-    for (size_t i = 0; i < optionStates.size(); ++i) {
-        if (optionStates[i] == Enabled) {
-            options |= optionFlags[i].flag;
-        } else if (optionStates[i] == Disabled) {
-            options &= ~optionFlags[i].flag;
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        return runBenchmark(std::vector<std::string>(argv + 2, argv + argc));
+    }
+    if (argc > 2 && std::string(argv[1]) == "--trace-decode") {
+        return decodeTraceFile(argv[2], std::wcout);
+    }
+    if (argc > 1 && (std::string(argv[1]) == "--scenario" || std::string(argv[1]) == "--fuzz")) {
+        startTraceConsole(std::wcerr);
+        std::vector<std::string> args(argv + 2, argv + argc);
+        int status = std::string(argv[1]) == "--scenario" ? runScenarios(args) : runFuzzer(args);
+        stopTrace();
+        return status;
+    }
+
+    // Failures are traced, not printed: to a binary file with --trace <file>, else decoded to std::wcerr
+    std::string traceFile;
+    std::string resultFormat = "text";
+    std::string verbosityName = "full";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--debug") {
+            debugInput = true;
+        } else if (arg == "--trace" && i + 1 < argc) {
+            traceFile = argv[++i];
+        } else if (arg == "--results" && i + 1 < argc) {
+            resultFormat = argv[++i];
+        } else if (arg == "--verbosity" && i + 1 < argc) {
+            verbosityName = argv[++i];
         }
     }
 
-    manageFilters(filters, randomize);
+    std::unique_ptr<FILE, int (*)(FILE*)> resultFile(nullptr, fclose);
+    std::unique_ptr<ResultSink> resultSink = createResultSink(resultFormat, verbosityName, resultFile);
+    if (!resultSink) {
+        std::cerr << "Usage: --results text|null|ndjson:<file>|binary:<file> [--verbosity count|paths|full]" << std::endl;
+        return 1;
+    }
 
-    return options;
-}
+    if (traceFile.empty()) {
+        startTraceConsole(std::wcerr);
+    } else if (!startTraceFile(traceFile)) {
+        std::cerr << "Cannot open trace file " << traceFile << std::endl;
+        return 1;
+    }
+
+    // Held for the whole run, so each session's Load/Free below only takes a reference
+    COMFunctionPointers processComFuncs = LoadCOMFunctionPointers();
+    if (debugInput) std::wcerr << L"DEBUG: COM functions from: " << comFunctionTableSource() << std::endl;
 
-int main() {
     while (true) {
         std::wcout << L"Select Dialog Type:\n1. Open File Dialog\n2. Save File Dialog\n3. Base File Dialog (parent of open/save dialogs)\n4. Randomize all options\nChoose an option: ";
         int dialogType = getUserInputInt(L"", { 1, 2, 3, 4 }, 4);
@@ -221,7 +283,7 @@ int main() {
         std::wstring title = randomize ? L"My C++ IFileOpenDialog" : getUserInputStr(L"Dialog title (default: My C++ IFileOpenDialog): ", L"My C++ IFileOpenDialog");
         std::wstring defaultFolder = randomize ? L"C:" : getUserInputStr(L"Default folder path (default: C:): ", L"C:");
 
-        std::vector<COMDLG_FILTERSPEC> filters;
+        FilterSet filters;
         DWORD options = getFileDialogOptions(isSaveDialog, randomize, filters);
 
         COMFunctionPointers comFuncs = LoadCOMFunctionPointers();
@@ -248,20 +310,21 @@ int main() {
 
             if (!isSaveDialog) {
                 IFileOpenDialog* pFileOpenDialog = static_cast<IFileOpenDialog*>(pFileDialog);
-                std::vector<std::wstring> results = getFileDialogResults(comFuncs, pFileOpenDialog);
-                for (const auto& filePath : results) {
-                    std::wcout << L"Selected file: " << filePath << std::endl;
-                }
+                getFileDialogResults(comFuncs, pFileOpenDialog, *resultSink);
             }
 
             pFileDialog->Release();
             comFuncs.pCoUninitialize();
             FreeCOMFunctionPointers(comFuncs);
+            flushTrace();
 
         } catch (const std::exception& ex) {
+            flushTrace();
             std::cerr << "Error: " << ex.what() << std::endl;
             if (comFuncs.pCoUninitialize) comFuncs.pCoUninitialize();
             FreeCOMFunctionPointers(comFuncs);
+            FreeCOMFunctionPointers(processComFuncs);
+            stopTrace();
             return 1;
         }
 
@@ -273,5 +336,7 @@ int main() {
         }
     }
 
+    FreeCOMFunctionPointers(processComFuncs);
+    stopTrace();
     return 0;
 }
\ No newline at end of file
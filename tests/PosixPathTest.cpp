@@ -0,0 +1,72 @@
+// Parsing names with ".", ".." and repeated slashes gives the same item as the plain path
+#include "PosixShellItem.h"
+#include "ProjWinUtils.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+#ifndef _WIN32
+static std::wstring normalized(std::wstring path) {
+    normalizePosixPath(path);
+    return path;
+}
+
+// SIGDN_FILESYSPATH of the item parsed from path, or empty when parsing fails
+static std::wstring parsedPath(const std::wstring& path) {
+    IShellItem* pItem = nullptr;
+    if (FAILED(PosixSHCreateItemFromParsingName(path.c_str(), nullptr, IID_IShellItem, reinterpret_cast<void**>(&pItem)))) {
+        return std::wstring();
+    }
+    std::wstring result;
+    LPWSTR pszPath = nullptr;
+    if (SUCCEEDED(pItem->GetDisplayName(SIGDN_FILESYSPATH, &pszPath))) {
+        result = pszPath;
+        taskMemFree(pszPath);
+    }
+    pItem->Release();
+    return result;
+}
+#endif // _WIN32
+
+int main() {
+#ifndef _WIN32
+    check(normalized(L"/") == L"/", "root");
+    check(normalized(L"//") == L"/", "repeated root slashes");
+    check(normalized(L"/a//b///c") == L"/a/b/c", "repeated slashes collapse");
+    check(normalized(L"/a/b/") == L"/a/b", "trailing slash dropped");
+    check(normalized(L"/a/./b/.") == L"/a/b", "'.' dropped");
+    check(normalized(L"/a/b/../c") == L"/a/c", "'..' removes the name before it");
+    check(normalized(L"/a/b/../../..") == L"/", "'..' stops at the root");
+    check(normalized(L"/..") == L"/", "'..' of the root");
+    check(normalized(L"/a/.hidden/..b/...") == L"/a/.hidden/..b/...", "dot names that are not '.' or '..' stay");
+
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "CIFileDialogTester-PosixPathTest";
+    std::filesystem::create_directories(dir / "sub");
+    std::ofstream(dir / "a.txt") << "a";
+    std::wstring base = dir.wstring();
+    std::wstring plain = parsedPath(base + L"/a.txt");
+    check(plain == base + L"/a.txt", "plain path parses");
+    check(parsedPath(base + L"//a.txt") == plain, "'//' parses to the same item");
+    check(parsedPath(base + L"/./a.txt") == plain, "'/./' parses to the same item");
+    check(parsedPath(base + L"/sub/../a.txt") == plain, "'sub/..' parses to the same item");
+    check(parsedPath(base + L"/sub/") == base + L"/sub", "a trailing slash names the folder");
+    check(parsedPath(L"/..") == L"/", "'/..' is the root");
+    std::filesystem::remove_all(dir);
+#endif // _WIN32
+
+    if (failures) {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "PosixPathTest passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,107 @@
+// Applies random additions, removals, duplicates and reorders to a recent-items index and checks
+// every query against an index loaded from scratch with the same paths
+#include "RecentItems.h"
+#include <iostream>
+#include <random>
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+// Serves whatever paths the test last put in it; the test bumps version with each change
+class MemoryRecentItemsBackend : public RecentItemsBackend {
+public:
+    MemoryRecentItemsBackend(const std::vector<std::wstring>* source, const uint64_t* version) : source(source), version(version) {}
+
+    bool changeStamp(uint64_t& stamp) {
+        stamp = *version;
+        return true;
+    }
+
+    bool load(std::vector<std::wstring>& paths) {
+        paths = *source;
+        return true;
+    }
+
+private:
+    const std::vector<std::wstring>* source;
+    const uint64_t* version;
+};
+
+static std::wstring randomPath(std::mt19937& random) {
+    static const wchar_t* const folders[] = { L"/home/user/Docs/", L"/home/user/docs/old/", L"/tmp/", L"/srv/Share/" };
+    return folders[random() % 4] + std::wstring(L"File ") + std::to_wstring(random() % 400) + ((random() % 2) ? L".TXT" : L".md");
+}
+
+static void checkQueries(const RecentItemsIndex& index, const RecentItemsIndex& reference, const wchar_t* query) {
+    std::vector<size_t> got;
+    std::vector<size_t> expected;
+    for (size_t limit : { size_t(3), SIZE_MAX }) {
+        index.prefixSearch(query, got, limit);
+        reference.prefixSearch(query, expected, limit);
+        check(got == expected, "prefix search matches a fresh index");
+        index.substringSearch(query, got, limit);
+        reference.substringSearch(query, expected, limit);
+        check(got == expected, "substring search matches a fresh index");
+    }
+}
+
+int main() {
+    std::mt19937 random(20261017);
+    std::vector<std::wstring> source;
+    uint64_t version = 0;
+    RecentItemsIndex index(std::unique_ptr<RecentItemsBackend>(new MemoryRecentItemsBackend(&source, &version)));
+    static const wchar_t* const queries[] = { L"/home/user/docs", L"/TMP/file 1", L"file 12", L"le 3", L".md", L"xyz", L"d", L"" };
+
+    for (int round = 0; round < 200; ++round) {
+        std::vector<std::wstring> next = source;
+        switch (random() % 4) {
+        case 0:  // New paths, some already listed
+            for (int i = random() % 20; i >= 0; --i) {
+                next.insert(next.begin() + random() % (next.size() + 1), randomPath(random));
+            }
+            break;
+        case 1:  // Removals
+            for (int i = random() % 20; i >= 0 && !next.empty(); --i) {
+                next.erase(next.begin() + random() % next.size());
+            }
+            break;
+        case 2:  // An item reopened: it moves to the front
+            if (!next.empty()) {
+                size_t from = random() % next.size();
+                std::wstring path = next[from];
+                next.erase(next.begin() + from);
+                next.insert(next.begin(), path);
+            }
+            break;
+        default:  // Everything gone now and then
+            if (random() % 10 == 0) {
+                next.clear();
+            }
+            break;
+        }
+        source.swap(next);
+        ++version;
+        index.refresh();
+
+        std::vector<std::wstring> snapshot = source;
+        RecentItemsIndex reference(std::unique_ptr<RecentItemsBackend>(new MemoryRecentItemsBackend(&snapshot, &version)));
+        reference.refresh();
+        check(index.allPaths() == source, "paths follow the source's recency order");
+        for (const wchar_t* query : queries) {
+            checkQueries(index, reference, query);
+        }
+    }
+
+    if (failures) {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "RecentItemsTest passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,94 @@
+// Parses the scenario example in README.md as written, plus the comment rules it relies on
+#include "ScenarioRunner.h"
+#include "DialogOptions.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+static bool parseText(const std::string& text, std::vector<DialogScenario>& scenarios, std::string& error) {
+    std::string fileName = (std::filesystem::temp_directory_path() / "CIFileDialogTester-ScenarioParseTest.ini").string();
+    {
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        file << text;
+    }
+    bool parsed = parseScenarioFile(fileName, scenarios, error);
+    std::filesystem::remove(fileName);
+    return parsed;
+}
+
+// The first ```ini block of README.md
+static std::string readmeScenario(const std::string& sourceDir) {
+    std::ifstream readme(sourceDir + "/README.md", std::ios::binary);
+    std::stringstream text;
+    text << readme.rdbuf();
+    std::string markdown = text.str();
+    size_t start = markdown.find("```ini\n");
+    if (start == std::string::npos) {
+        return std::string();
+    }
+    start += 7;
+    size_t end = markdown.find("```", start);
+    return markdown.substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
+
+int main(int argc, char** argv) {
+    std::string sourceDir = (argc > 1) ? argv[1] : ".";
+
+    std::string example = readmeScenario(sourceDir);
+    check(!example.empty(), "README.md has an ini scenario example");
+    std::vector<DialogScenario> scenarios;
+    std::string error;
+    bool parsed = parseText(example, scenarios, error);
+    if (!parsed) {
+        std::cerr << error << std::endl;
+    }
+    check(parsed, "README example parses");
+    check(scenarios.size() == 1, "README example has one scenario");
+    if (scenarios.size() == 1) {
+        const DialogScenario& scenario = scenarios[0];
+        check(scenario.name == L"pick one text file", "scenario name");
+        check(scenario.dialogType == 1, "type = open, with a trailing comment");
+        check(scenario.title == L"My C++ IFileOpenDialog", "title");
+        check(scenario.folder == L"/tmp/data", "folder");
+        check(scenario.optionStates[findDialogOption(L"multiselect")] == Disabled, "multiselect = off, with a trailing comment");
+        check(scenario.filters.size() == 1 && scenario.filters.name(0) == L"Text" && scenario.filters.spec(0) == L"*.txt;*.md",
+              "filter keeps the ';' inside its spec and drops the comment");
+        check(scenario.selection == std::vector<std::wstring>{ L"a.txt" }, "select");
+        check(scenario.expected == std::vector<std::wstring>{ L"a.txt" }, "expect");
+        check(scenario.repeat == 1000, "repeat");
+    }
+
+    scenarios.clear();
+    parsed = parseText("; leading comment\n[s]\ntitle = Notes#1\nselect = a.txt\t; tab before the comment\n", scenarios, error);
+    check(parsed && scenarios.size() == 1, "comment lines and tab-separated comments parse");
+    if (scenarios.size() == 1) {
+        check(scenarios[0].title == L"Notes#1", "a '#' not after whitespace stays in the value");
+        check(scenarios[0].selection == std::vector<std::wstring>{ L"a.txt" }, "tab-separated comment is dropped");
+    }
+
+    scenarios.clear();
+    parsed = parseText("[save]\ntype = save\nfilename = new file.txt\nexpect = new file.txt\n", scenarios, error);
+    check(parsed && scenarios.size() == 1, "save scenario with a file name parses");
+    if (scenarios.size() == 1) {
+        check(scenarios[0].dialogType == 2, "type = save");
+        check(scenarios[0].fileName == L"new file.txt", "filename");
+        check(scenarios[0].selection.empty(), "filename is not a selection");
+    }
+
+    if (failures) {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "ScenarioParseTest passed" << std::endl;
+    return 0;
+}